@@ -0,0 +1,1833 @@
+#include "pch.h"
+
+#include "Core/Benchmarks.h"
+#include "Core/DescriptorAllocator.h"
+#include "Core/Logger.h"
+#include "Core/ECS/TransformBatch.h"
+#include "Core/FrameArena.h"
+#include "Core/GenerationalSet.h"
+#include "Core/Jobs/JobSystem.h"
+#include "Core/Jobs/JoltJobSystem.h"
+#include "Core/Math.h"
+#include "Core/ECS/Components/RigidBodyComponent.h"
+#include "Core/Rendering/BoundingVolumeHierarchy.h"
+#include "Core/Rendering/DepthRasterizer.h"
+#include "Core/Rendering/HiZ.h"
+#include "Core/Rendering/InstanceBatcher.h"
+#include "Core/Rendering/InstanceCuller.h"
+#include "Core/Rendering/InstanceLodSelector.h"
+#include "Core/Rendering/LSystem.h"
+#include "Core/Rendering/LSystemDefinitions.h"
+#include "Core/Rendering/Meshlets.h"
+#include "Core/Rendering/ParallelRecorder.h"
+#include "Core/Rendering/ProceduralMesh.h"
+#include "Core/Rendering/RenderQueue.h"
+#include "Core/Rendering/ShadowCascades.h"
+#include "Core/Rendering/SoftwareOcclusionCuller.h"
+
+#include <spdlog/sinks/basic_file_sink.h>
+#include <Jolt/Core/JobSystemThreadPool.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <random>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+namespace Gradient::Benchmarks
+{
+    namespace
+    {
+        double Median(std::vector<double> values)
+        {
+            std::sort(values.begin(), values.end());
+            return values[values.size() / 2];
+        }
+
+        // Runs fn a number of times and returns the median time in milliseconds.
+        template <typename Fn>
+        double MedianMilliseconds(int iterations, Fn&& fn)
+        {
+            std::vector<double> timings;
+            timings.reserve(iterations);
+
+            for (int i = 0; i < iterations; i++)
+            {
+                auto start = std::chrono::high_resolution_clock::now();
+                fn();
+                auto end = std::chrono::high_resolution_clock::now();
+
+                timings.push_back(
+                    std::chrono::duration<double, std::milli>(end - start).count());
+            }
+
+            return Median(timings);
+        }
+
+        // The expansion that LSystem used before it had its own engine,
+        // kept here as a baseline.
+        std::string ExpandWithStringStreams(const Rendering::LSystemDefinition& definition)
+        {
+            std::unordered_map<char, std::string> productionRules(
+                definition.Rules.begin(), definition.Rules.end());
+
+            std::string previousRule = definition.StartingRule;
+
+            for (int i = 0; i < definition.NumGenerations; i++)
+            {
+                std::stringstream stream(previousRule);
+                std::ostringstream nextRule;
+
+                for (int j = 0; j < previousRule.size(); j++)
+                {
+                    char c;
+                    stream >> c;
+
+                    auto entry = productionRules.find(c);
+
+                    if (entry != productionRules.end())
+                    {
+                        nextRule << entry->second;
+                    }
+                    else
+                    {
+                        nextRule << c;
+                    }
+                }
+
+                previousRule = nextRule.str();
+            }
+
+            return previousRule;
+        }
+
+        // A small amount of arithmetic that the compiler can't throw away
+        void BusyWork(int iterations, std::atomic<uint64_t>& sink)
+        {
+            uint64_t value = iterations;
+            for (int i = 0; i < iterations; i++)
+            {
+                value = value * 6364136223846793005ull + 1442695040888963407ull;
+            }
+            sink.fetch_add(value & 1, std::memory_order_relaxed);
+        }
+
+        // Runs jobs through Jolt's interface, the way the physics system does.
+        void RunJoltJobs(JPH::JobSystem& jobSystem, int numJobs, int iterations,
+            std::atomic<uint64_t>& sink)
+        {
+            auto barrier = jobSystem.CreateBarrier();
+
+            for (int i = 0; i < numJobs; i++)
+            {
+                auto handle = jobSystem.CreateJob("Benchmark",
+                    JPH::Color::sGreen,
+                    [iterations, &sink]()
+                    {
+                        BusyWork(iterations, sink);
+                    });
+                barrier->AddJob(handle);
+            }
+
+            jobSystem.WaitForJobs(barrier);
+            jobSystem.DestroyBarrier(barrier);
+        }
+    }
+
+    void RunAll()
+    {
+        auto logger = Logger::Get();
+        logger->sinks().push_back(
+            std::make_shared<spdlog::sinks::basic_file_sink_mt>("benchmarks.log", true));
+
+        logger->info("Running benchmarks");
+
+        RunLSystemBenchmarks();
+        RunGeometryBenchmarks();
+        RunJobSystemBenchmarks();
+        RunTransformBenchmarks();
+        RunCullingBenchmarks();
+        RunShadowCascadeBenchmarks();
+        RunFrameArenaBenchmarks();
+        RunPrepassSetBenchmarks();
+        RunRenderQueueBenchmarks();
+        RunInstanceBatcherBenchmarks();
+        RunParallelRecordingBenchmarks();
+        RunInstanceCullingBenchmarks();
+        RunInstanceLodBenchmarks();
+        RunMeshletBenchmarks();
+        RunOcclusionBenchmarks();
+        RunSoftwareOcclusionBenchmarks();
+        RunDescriptorAllocatorBenchmarks();
+
+        logger->info("Finished running benchmarks");
+        logger->flush();
+    }
+
+    void RunLSystemBenchmarks()
+    {
+        constexpr int iterations = 10;
+        auto logger = Logger::Get();
+
+        logger->info("L-system expansion ({} iterations, median)", iterations);
+
+        for (const auto& [name, definition] : Rendering::LSystemDefinitions::All)
+        {
+            Rendering::LSystem lsystem;
+            definition.Configure(lsystem);
+
+            auto expectedLength = lsystem.ExpandedLength(definition.StartingRule,
+                definition.NumGenerations);
+
+            std::string baselineResult;
+            auto baselineTime = MedianMilliseconds(iterations, [&]()
+                {
+                    baselineResult = ExpandWithStringStreams(definition);
+                });
+
+            std::string parallelResult;
+            auto parallelTime = MedianMilliseconds(iterations, [&]()
+                {
+                    parallelResult = lsystem.Expand(definition.StartingRule,
+                        definition.NumGenerations);
+                });
+
+            uint64_t checksum = 0;
+            auto streamingTime = MedianMilliseconds(iterations, [&]()
+                {
+                    checksum = 0;
+                    lsystem.ForEachExpandedSymbol(definition.StartingRule,
+                        definition.NumGenerations,
+                        [&checksum](char c)
+                        {
+                            checksum = checksum * 31 + static_cast<unsigned char>(c);
+                        });
+                });
+
+            logger->info("  {}: {} symbols, stringstream {:.3f} ms, parallel {:.3f} ms ({:.1f}x), streaming {:.3f} ms ({:.1f}x)",
+                name,
+                expectedLength,
+                baselineTime,
+                parallelTime,
+                baselineTime / parallelTime,
+                streamingTime,
+                baselineTime / streamingTime);
+        }
+
+        logger->info("L-system interpretation ({} iterations, median)", iterations);
+
+        for (const auto& [name, definition] : Rendering::LSystemDefinitions::All)
+        {
+            std::vector<double> referenceTimes;
+            std::vector<double> compileTimes;
+            std::vector<double> executeTimes;
+            Rendering::LSystem::BuildStatistics statistics;
+            uint64_t expandedLength = 0;
+
+            for (int i = 0; i < iterations; i++)
+            {
+                Rendering::LSystem reference;
+                definition.Configure(reference);
+                reference.UseReferenceInterpreter = true;
+                reference.Build(definition.StartingRule,
+                    definition.NumGenerations,
+                    definition.NumVerticalSections);
+                referenceTimes.push_back(reference.GetBuildStatistics().InterpretMilliseconds);
+
+                Rendering::LSystem compiled;
+                definition.Configure(compiled);
+                compiled.Build(definition.StartingRule,
+                    definition.NumGenerations,
+                    definition.NumVerticalSections);
+
+                statistics = compiled.GetBuildStatistics();
+                expandedLength = compiled.ExpandedLength(definition.StartingRule,
+                    definition.NumGenerations);
+                compileTimes.push_back(statistics.CompileMilliseconds);
+                executeTimes.push_back(statistics.InterpretMilliseconds);
+            }
+
+            auto referenceTime = Median(referenceTimes);
+            auto compiledTime = Median(compileTimes) + Median(executeTimes);
+
+            logger->info("  {}: {} blocks, {} stored / {} executed instructions ({} bytes, expanded rule is {} bytes), reference {:.3f} ms, compile {:.3f} ms + execute {:.3f} ms ({:.1f}x)",
+                name,
+                statistics.NumBlocks,
+                statistics.NumInstructions,
+                statistics.NumExecutedInstructions,
+                statistics.ProgramSizeInBytes,
+                expandedLength,
+                referenceTime,
+                Median(compileTimes),
+                Median(executeTimes),
+                referenceTime / compiledTime);
+        }
+    }
+
+    void RunGeometryBenchmarks()
+    {
+        using namespace DirectX::SimpleMath;
+
+        constexpr int iterations = 10;
+        constexpr int numFrusta = 20000;
+        auto logger = Logger::Get();
+
+        std::mt19937 generator(1);
+        std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+
+        auto randomRotation = [&]()
+            {
+                Vector3 axis(distribution(generator), distribution(generator), distribution(generator));
+                axis.Normalize();
+                return Quaternion::CreateFromAxisAngle(axis, distribution(generator) * DirectX::XM_PI);
+            };
+
+        std::vector<Rendering::ProceduralMesh::AngledFrustumParameters> frusta;
+        frusta.reserve(numFrusta);
+
+        for (int i = 0; i < numFrusta; i++)
+        {
+            frusta.push_back({
+                Vector3(distribution(generator), distribution(generator), distribution(generator)) * 10.f,
+                randomRotation(),
+                0.1f,
+                0.08f,
+                Vector3(0, 0.3f, 0),
+                randomRotation()
+                });
+        }
+
+        logger->info("Angled frustum emission, {} frusta ({} iterations, median)", numFrusta, iterations);
+
+        for (int numVerticalSections : { 3, 6 })
+        {
+            auto perPartTime = MedianMilliseconds(iterations, [&]()
+                {
+                    Rendering::ProceduralMesh::MeshPart out;
+
+                    for (const auto& frustum : frusta)
+                    {
+                        auto part = Rendering::ProceduralMesh::CreateAngledFrustumPart(
+                            frustum.BottomRadius,
+                            frustum.TopRadius,
+                            frustum.TopRelativeTranslation,
+                            frustum.TopRelativeRotation,
+                            numVerticalSections);
+
+                        out.AppendInPlace(part, frustum.BottomTranslation, frustum.BottomRotation);
+                    }
+                });
+
+            auto batchedTime = MedianMilliseconds(iterations, [&]()
+                {
+                    auto out = Rendering::ProceduralMesh::CreateAngledFrustumParts(frusta,
+                        numVerticalSections);
+                });
+
+            logger->info("  {} sections: per part {:.3f} ms, batched {:.3f} ms ({:.1f}x)",
+                numVerticalSections,
+                perPartTime,
+                batchedTime,
+                perPartTime / batchedTime);
+        }
+    }
+
+    void RunJobSystemBenchmarks()
+    {
+        constexpr int iterations = 10;
+        constexpr int numJobs = 1024;
+        auto logger = Logger::Get();
+
+        JPH::RegisterDefaultAllocator();
+
+        std::atomic<uint64_t> sink = 0;
+
+        const uint32_t hardwareThreads = std::max(std::thread::hardware_concurrency(), 2u);
+        std::vector<uint32_t> threadCounts;
+        for (uint32_t threads : { 4u, 8u, 16u, 32u, 64u })
+        {
+            if (threads < hardwareThreads)
+            {
+                threadCounts.push_back(threads);
+            }
+        }
+        threadCounts.push_back(hardwareThreads);
+
+        logger->info("Job systems, {} jobs per run ({} iterations, median)", numJobs, iterations);
+
+        for (int jobSize : { 100, 10000 })
+        {
+            for (auto threads : threadCounts)
+            {
+                // Both pools get the same number of workers, and the
+                // calling thread helps out while it waits in each case.
+                Jobs::JobSystem jobSystem(threads - 1);
+                Jobs::JoltJobSystem joltAdapter(&jobSystem,
+                    JPH::cMaxPhysicsJobs,
+                    JPH::cMaxPhysicsBarriers);
+                JPH::JobSystemThreadPool joltPool(JPH::cMaxPhysicsJobs,
+                    JPH::cMaxPhysicsBarriers,
+                    threads - 1);
+
+                auto nativeTime = MedianMilliseconds(iterations, [&]()
+                    {
+                        Jobs::JobCounter counter;
+                        for (int i = 0; i < numJobs; i++)
+                        {
+                            jobSystem.Submit([jobSize, &sink]()
+                                {
+                                    BusyWork(jobSize, sink);
+                                }, &counter);
+                        }
+                        jobSystem.Wait(counter);
+                    });
+
+                auto parallelForTime = MedianMilliseconds(iterations, [&]()
+                    {
+                        jobSystem.ParallelFor(numJobs, 16, [jobSize, &sink](size_t begin, size_t end)
+                            {
+                                for (size_t i = begin; i < end; i++)
+                                {
+                                    BusyWork(jobSize, sink);
+                                }
+                            });
+                    });
+
+                auto adapterTime = MedianMilliseconds(iterations, [&]()
+                    {
+                        RunJoltJobs(joltAdapter, numJobs, jobSize, sink);
+                    });
+
+                auto joltPoolTime = MedianMilliseconds(iterations, [&]()
+                    {
+                        RunJoltJobs(joltPool, numJobs, jobSize, sink);
+                    });
+
+                logger->info("  {} iterations per job, {} threads: Jolt pool {:.3f} ms, Jolt on JobSystem {:.3f} ms ({:.1f}x), JobSystem {:.3f} ms ({:.1f}x), ParallelFor {:.3f} ms ({:.1f}x)",
+                    jobSize,
+                    threads,
+                    joltPoolTime,
+                    adapterTime,
+                    joltPoolTime / adapterTime,
+                    nativeTime,
+                    joltPoolTime / nativeTime,
+                    parallelForTime,
+                    joltPoolTime / parallelForTime);
+            }
+        }
+    }
+
+    void RunTransformBenchmarks()
+    {
+        using namespace DirectX::SimpleMath;
+
+        constexpr int iterations = 20;
+        constexpr int numTransforms = 20000;
+        auto logger = Logger::Get();
+
+        std::mt19937 generator(1);
+        std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+
+        // The old layout, which stored each part as a full matrix
+        struct MatrixTransform
+        {
+            Matrix Scale;
+            Matrix Rotation;
+            Matrix Translation;
+        };
+
+        std::vector<MatrixTransform> matrixTransforms;
+        std::vector<ECS::Components::TransformComponent> transforms;
+        matrixTransforms.reserve(numTransforms);
+        transforms.reserve(numTransforms);
+
+        for (int i = 0; i < numTransforms; i++)
+        {
+            Vector3 axis(distribution(generator), distribution(generator), distribution(generator));
+            axis.Normalize();
+
+            ECS::Components::TransformComponent transform;
+            transform.Translation = Vector3(distribution(generator), distribution(generator), distribution(generator)) * 100.f;
+            transform.Rotation = Quaternion::CreateFromAxisAngle(axis, distribution(generator) * DirectX::XM_PI);
+            transform.Scale = Vector3(1.f + 0.5f * distribution(generator));
+
+            transforms.push_back(transform);
+            matrixTransforms.push_back({
+                Matrix::CreateScale(transform.Scale),
+                Matrix::CreateFromQuaternion(transform.Rotation),
+                Matrix::CreateTranslation(transform.Translation)
+                });
+        }
+
+        std::vector<Matrix> out(numTransforms);
+
+        auto matrixTime = MedianMilliseconds(iterations, [&]()
+            {
+                for (int i = 0; i < numTransforms; i++)
+                {
+                    const auto& transform = matrixTransforms[i];
+                    out[i] = transform.Scale * transform.Rotation * transform.Translation;
+                }
+            });
+
+        auto perEntityTime = MedianMilliseconds(iterations, [&]()
+            {
+                for (int i = 0; i < numTransforms; i++)
+                {
+                    out[i] = transforms[i].GetWorldMatrix();
+                }
+            });
+
+        ECS::TransformBatch batch;
+        batch.Reserve(numTransforms);
+
+        // Includes gathering into the batch, as UpdateTransforms does
+        auto batchedTime = MedianMilliseconds(iterations, [&]()
+            {
+                batch.Clear();
+                for (const auto& transform : transforms)
+                {
+                    batch.Add(transform);
+                }
+                batch.ComputeWorldMatrices(out);
+            });
+
+        logger->info("World matrices, {} transforms ({} iterations, median)", numTransforms, iterations);
+        logger->info("  Matrices ({} bytes each): {:.3f} ms", sizeof(MatrixTransform), matrixTime);
+        logger->info("  Per entity ({} bytes each): {:.3f} ms", sizeof(ECS::Components::TransformComponent), perEntityTime);
+        logger->info("  Batched: {:.3f} ms ({:.1f}x)", batchedTime, matrixTime / batchedTime);
+    }
+
+    void RunCullingBenchmarks()
+    {
+        using namespace DirectX::SimpleMath;
+
+        constexpr int iterations = 20;
+        constexpr int numEntities = 100000;
+        auto logger = Logger::Get();
+
+        std::mt19937 generator(1);
+        std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+
+        // Boxes scattered over a square kilometre, like the trees and bushes
+        struct Entity
+        {
+            DirectX::BoundingBox LocalBounds;
+            Matrix World;
+        };
+
+        std::vector<Entity> entities;
+        entities.reserve(numEntities);
+
+        for (int i = 0; i < numEntities; i++)
+        {
+            Vector3 extents(1.f + distribution(generator) * 0.5f, 3.f, 1.f + distribution(generator) * 0.5f);
+            Vector3 position(distribution(generator) * 500.f, 0.f, distribution(generator) * 500.f);
+
+            entities.push_back({
+                DirectX::BoundingBox(Vector3(0, extents.y, 0), extents),
+                Matrix::CreateRotationY(distribution(generator) * DirectX::XM_PI)
+                    * Matrix::CreateTranslation(position)
+                });
+        }
+
+        auto frustum = Math::MakeFrustum(
+            Matrix::CreateLookAt(Vector3(0, 10, 0), Vector3(1, 9, 1), Vector3::UnitY),
+            Matrix::CreatePerspectiveFieldOfView(DirectX::XM_PIDIV4, 16.f / 9.f, 0.1f, 300.f));
+        auto planes = Math::GetPlanes(frustum);
+
+        size_t inlineVisible = 0;
+
+        // What DrawAllEntities used to do for every entity in every pass
+        auto inlineTime = MedianMilliseconds(iterations, [&]()
+            {
+                inlineVisible = 0;
+                for (const auto& entity : entities)
+                {
+                    DirectX::BoundingBox worldBounds;
+                    entity.LocalBounds.Transform(worldBounds, entity.World);
+                    if (frustum.Intersects(worldBounds))
+                    {
+                        inlineVisible++;
+                    }
+                }
+            });
+
+        std::vector<Rendering::BoundingVolumeHierarchy::Item> items(numEntities);
+
+        // Done once per frame for the entities that moved
+        auto gatherTime = MedianMilliseconds(iterations, [&]()
+            {
+                for (int i = 0; i < numEntities; i++)
+                {
+                    entities[i].LocalBounds.Transform(items[i].Bounds, entities[i].World);
+                    items[i].Id = static_cast<uint32_t>(i);
+                }
+            });
+
+        Rendering::BoundingVolumeHierarchy bvh;
+
+        // Done when entities are added or removed
+        auto buildTime = MedianMilliseconds(iterations, [&]()
+            {
+                bvh.Build(items);
+            });
+
+        // Done when a tenth of the entities move every frame
+        auto refitTime = MedianMilliseconds(iterations, [&]()
+            {
+                for (int i = 0; i < numEntities; i += 10)
+                {
+                    bvh.SetBounds(i, items[i].Bounds);
+                }
+                bvh.Refit();
+            });
+
+        std::vector<uint32_t> bvhVisible;
+        bvhVisible.reserve(numEntities);
+
+        // Done once per view
+        auto serialTime = MedianMilliseconds(iterations, [&]()
+            {
+                bvhVisible.clear();
+                bvh.Query(planes, bvhVisible);
+            });
+
+        size_t serialVisible = bvhVisible.size();
+
+        auto parallelTime = MedianMilliseconds(iterations, [&]()
+            {
+                bvhVisible.clear();
+                bvh.Query(planes, bvhVisible, *Jobs::JobSystem::Get());
+            });
+
+        logger->info("Frustum culling, {} entities ({} iterations, median)", numEntities, iterations);
+        logger->info("  Inline transform and intersect: {:.3f} ms, {} visible", inlineTime, inlineVisible);
+        logger->info("  Gathering world bounds: {:.3f} ms", gatherTime);
+        logger->info("  BVH build: {:.3f} ms, refitting a tenth: {:.3f} ms", buildTime, refitTime);
+        logger->info("  BVH query, one thread: {:.3f} ms ({:.1f}x), {} visible",
+            serialTime,
+            inlineTime / serialTime,
+            serialVisible);
+        logger->info("  BVH query, {} threads: {:.3f} ms ({:.1f}x), {} visible",
+            Jobs::JobSystem::Get()->GetMaxConcurrency(),
+            parallelTime,
+            inlineTime / parallelTime,
+            bvhVisible.size());
+    }
+
+    void RunShadowCascadeBenchmarks()
+    {
+        using namespace DirectX::SimpleMath;
+
+        constexpr int iterations = 20;
+        constexpr int numFrames = 1000;
+        constexpr uint32_t numCascades = 4;
+        constexpr uint32_t resolution = 2048;
+        constexpr float sceneRadius = 200.f;
+        auto logger = Logger::Get();
+
+        Vector3 lightDirection(-0.7f, -0.7f, 0.7f);
+        lightDirection.Normalize();
+        auto lightView = Matrix::CreateLookAt(-2.f * sceneRadius * lightDirection,
+            Vector3::Zero,
+            Vector3::UnitY);
+
+        auto projection = Matrix::CreatePerspectiveFieldOfView(DirectX::XM_PIDIV4,
+            16.f / 9.f,
+            0.1f,
+            70.f);
+
+        // A camera strolling forward at 30cm/s, at 60 frames a second
+        std::vector<DirectX::BoundingFrustum> frustums;
+        frustums.reserve(numFrames);
+        for (int i = 0; i < numFrames; i++)
+        {
+            Vector3 forward(std::sin(0.3f), -0.1f, std::cos(0.3f));
+            Vector3 position = Vector3(0.f, 2.f, 0.f) + i * 0.005f * Vector3(forward.x, 0.f, forward.z);
+
+            frustums.push_back(Math::MakeFrustum(
+                Matrix::CreateLookAt(position, position + forward, Vector3::UnitY),
+                projection));
+        }
+
+        auto fitFrame = [&](const DirectX::BoundingFrustum& frustum,
+            std::array<Rendering::ShadowCascades::Cascade, numCascades>& cascades)
+            {
+                auto splits = Rendering::ShadowCascades::ComputeSplitDistances(0.1f,
+                    70.f,
+                    numCascades,
+                    0.75f);
+
+                for (uint32_t c = 0; c < numCascades; c++)
+                {
+                    cascades[c] = Rendering::ShadowCascades::FitCascade(
+                        Rendering::ShadowCascades::GetSlice(frustum, splits[c], splits[c + 1]),
+                        lightView,
+                        sceneRadius,
+                        resolution);
+                }
+            };
+
+        std::array<Rendering::ShadowCascades::Cascade, numCascades> cascades;
+
+        auto fitTime = MedianMilliseconds(iterations, [&]()
+            {
+                fitFrame(frustums[0], cascades);
+            });
+
+        // A cascade should only move, invalidating its cached
+        // shadows, when the camera moves by a whole texel.
+        std::array<int, numCascades> moves = {};
+        std::array<Matrix, numCascades> previous;
+
+        auto splits = Rendering::ShadowCascades::ComputeSplitDistances(0.1f, 70.f, numCascades, 0.75f);
+
+        for (int i = 0; i < numFrames; i++)
+        {
+            fitFrame(frustums[i], cascades);
+
+            for (uint32_t c = 0; c < numCascades; c++)
+            {
+                if (i > 0 && cascades[c].Projection != previous[c])
+                {
+                    moves[c]++;
+                }
+
+                previous[c] = cascades[c].Projection;
+            }
+        }
+
+        logger->info("Shadow cascades, {} cascades at {}x{} ({} iterations, median)",
+            numCascades, resolution, resolution, iterations);
+        logger->info("  Fitting all cascades: {:.4f} ms", fitTime);
+        logger->info("  Split distances: {:.2f}, {:.2f}, {:.2f}, {:.2f}, {:.2f}",
+            splits[0], splits[1], splits[2], splits[3], splits[4]);
+        logger->info("  Cascade moves over {} frames: {}, {}, {}, {}",
+            numFrames, moves[0], moves[1], moves[2], moves[3]);
+    }
+
+    void RunFrameArenaBenchmarks()
+    {
+        constexpr int iterations = 20;
+        constexpr int numQueries = 2000;
+        auto logger = Logger::Get();
+
+        // Shaped like the render path's temporaries: a traversal
+        // stack per culling query, each growing past its reserve.
+        auto frame = [&]<typename Vector>(Vector& stack)
+            {
+                uint32_t sum = 0;
+                for (int q = 0; q < numQueries; q++)
+                {
+                    Vector local(stack.get_allocator());
+                    local.reserve(64);
+                    for (uint32_t i = 0; i < 100; i++)
+                    {
+                        local.push_back(i);
+                    }
+                    sum += local.back();
+                }
+                return sum;
+            };
+
+        auto heapTime = MedianMilliseconds(iterations, [&]()
+            {
+                std::vector<uint32_t> stack;
+                frame(stack);
+            });
+
+        auto arenaTime = MedianMilliseconds(iterations, [&]()
+            {
+                FrameVector<uint32_t> stack;
+                frame(stack);
+                FrameArena::ResetAll();
+            });
+
+        size_t bytesPerFrame = 0;
+        {
+            FrameVector<uint32_t> stack;
+            frame(stack);
+            bytesPerFrame = FrameArena::GetTotalBytesUsed();
+            FrameArena::ResetAll();
+        }
+
+        logger->info("Frame arena, {} temporary vectors per frame ({} iterations, median)", numQueries, iterations);
+        logger->info("  Heap: {:.3f} ms", heapTime);
+        logger->info("  Arena: {:.3f} ms ({:.1f}x), {:.1f} KB per frame",
+            arenaTime,
+            heapTime / arenaTime,
+            bytesPerFrame / 1024.f);
+    }
+
+    void RunPrepassSetBenchmarks()
+    {
+        constexpr int iterations = 10;
+        auto logger = Logger::Get();
+
+        logger->info("Z-prepass membership ({} iterations, median)", iterations);
+
+        for (uint32_t numEntities : { 10000u, 100000u, 1000000u })
+        {
+            // Drawn in culling order rather than entity order, with
+            // a few skipped in the prepass.
+            std::vector<entt::entity> drawOrder(numEntities);
+            for (uint32_t i = 0; i < numEntities; i++)
+            {
+                drawOrder[i] = static_cast<entt::entity>(i);
+            }
+            std::shuffle(drawOrder.begin(), drawOrder.end(), std::mt19937(1));
+
+            auto isPrepassed = [](uint32_t i) { return i % 10 != 0; };
+
+            size_t setReadOnly = 0;
+            auto setTime = MedianMilliseconds(iterations, [&]()
+                {
+                    std::set<entt::entity> prepassed;
+                    for (uint32_t i = 0; i < numEntities; i++)
+                    {
+                        if (isPrepassed(i)) prepassed.insert(drawOrder[i]);
+                    }
+
+                    setReadOnly = 0;
+                    for (auto entity : drawOrder)
+                    {
+                        setReadOnly += prepassed.contains(entity);
+                    }
+                });
+
+            std::vector<entt::entity> sorted;
+            size_t sortedReadOnly = 0;
+            auto sortedTime = MedianMilliseconds(iterations, [&]()
+                {
+                    sorted.clear();
+                    for (uint32_t i = 0; i < numEntities; i++)
+                    {
+                        if (isPrepassed(i)) sorted.push_back(drawOrder[i]);
+                    }
+                    std::sort(sorted.begin(), sorted.end());
+
+                    sortedReadOnly = 0;
+                    for (auto entity : drawOrder)
+                    {
+                        sortedReadOnly += std::binary_search(sorted.begin(), sorted.end(), entity);
+                    }
+                });
+
+            GenerationalSet generational;
+            size_t generationalReadOnly = 0;
+            auto generationalTime = MedianMilliseconds(iterations, [&]()
+                {
+                    generational.Clear();
+                    for (uint32_t i = 0; i < numEntities; i++)
+                    {
+                        if (isPrepassed(i)) generational.Insert(entt::to_entity(drawOrder[i]));
+                    }
+
+                    generationalReadOnly = 0;
+                    for (auto entity : drawOrder)
+                    {
+                        generationalReadOnly += generational.Contains(entt::to_entity(entity));
+                    }
+                });
+
+            logger->info("  {} entities: std::set {:.3f} ms, sorted vector {:.3f} ms ({:.1f}x), generational {:.3f} ms ({:.1f}x)",
+                numEntities,
+                setTime,
+                sortedTime,
+                setTime / sortedTime,
+                generationalTime,
+                setTime / generationalTime);
+        }
+    }
+
+    void RunRenderQueueBenchmarks()
+    {
+        using Rendering::RenderQueue;
+        using DrawType = RenderQueue::DrawType;
+        constexpr int iterations = 10;
+        auto logger = Logger::Get();
+
+        logger->info("Render queue sorting ({} iterations, median)", iterations);
+
+        for (uint32_t numDraws : { 1000u, 10000u, 100000u, 1000000u })
+        {
+            // Spread over a few pipelines, a hundred materials and 
+            // a thousand meshes, in the order culling produces them.
+            std::mt19937 rng(1);
+            std::uniform_int_distribution<uint32_t> pipelineDist(0, 3);
+            std::uniform_int_distribution<uint32_t> materialDist(0, 99);
+            std::uniform_int_distribution<uint32_t> meshDist(0, 999);
+            std::uniform_real_distribution<float> depthDist(0.f, 1000.f);
+
+            std::vector<RenderQueue::Item> items(numDraws);
+            for (uint32_t i = 0; i < numDraws; i++)
+            {
+                auto material = materialDist(rng);
+                items[i].Key = RenderQueue::MakeKey(
+                    static_cast<RenderQueue::Pipeline>(pipelineDist(rng)),
+                    i % 4 == 0 ? DrawType::PixelDepthReadWrite : DrawType::PixelDepthReadOnly,
+                    material % 8 == 0,
+                    material,
+                    meshDist(rng),
+                    depthDist(rng));
+                items[i].Entity = static_cast<entt::entity>(i);
+            }
+
+            // The bits that pick a PSO
+            auto countStateChanges = [](std::span<const RenderQueue::Item> sorted, int shift)
+                {
+                    uint32_t changes = 0;
+                    for (size_t i = 0; i < sorted.size(); i++)
+                    {
+                        if (i == 0 || (sorted[i].Key >> shift) != (sorted[i - 1].Key >> shift))
+                            changes++;
+                    }
+                    return changes;
+                };
+
+            std::vector<RenderQueue::Item> stdSorted;
+            auto stdTime = MedianMilliseconds(iterations, [&]()
+                {
+                    stdSorted = items;
+                    std::stable_sort(stdSorted.begin(), stdSorted.end(),
+                        [](const auto& a, const auto& b) { return a.Key < b.Key; });
+                });
+
+            RenderQueue serialQueue;
+            auto serialTime = MedianMilliseconds(iterations, [&]()
+                {
+                    serialQueue.Clear();
+                    for (const auto& item : items) serialQueue.Add(item.Key, item.Entity);
+                    serialQueue.Sort(false);
+                });
+
+            RenderQueue parallelQueue;
+            auto parallelTime = MedianMilliseconds(iterations, [&]()
+                {
+                    parallelQueue.Clear();
+                    for (const auto& item : items) parallelQueue.Add(item.Key, item.Entity);
+                    parallelQueue.Sort();
+                });
+
+            logger->info("  {} draws: std::stable_sort {:.3f} ms, radix {:.3f} ms ({:.1f}x), parallel radix {:.3f} ms ({:.1f}x)",
+                numDraws,
+                stdTime,
+                serialTime,
+                stdTime / serialTime,
+                parallelTime,
+                stdTime / parallelTime);
+            // Shifts leave the pipeline, draw type and masked bits, 
+            // and then the material bits above them too.
+            logger->info("    PSO changes unsorted {}, sorted {}; material changes unsorted {}, sorted {}",
+                countStateChanges(items, 58),
+                countStateChanges(stdSorted, 58),
+                countStateChanges(items, 43),
+                countStateChanges(stdSorted, 43));
+        }
+    }
+
+    void RunInstanceBatcherBenchmarks()
+    {
+        using namespace DirectX::SimpleMath;
+        using Rendering::InstanceBatcher;
+        using Rendering::PBRMaterial;
+        using DrawType = InstanceBatcher::DrawType;
+        constexpr int iterations = 10;
+        auto logger = Logger::Get();
+
+        logger->info("Instance batching ({} iterations, median)", iterations);
+
+        // Materials are compared by value, so these 
+        // just need to differ from each other.
+        std::vector<PBRMaterial> materials(8);
+        for (size_t i = 0; i < materials.size(); i++)
+        {
+            materials[i].Tiling = 1.f + i;
+            materials[i].Masked = i % 2 == 0;
+        }
+
+        for (uint32_t numDraws : { 150u, 1500u, 15000u })
+        {
+            struct TestDraw
+            {
+                entt::entity Entity;
+                BufferManager::MeshHandle Mesh;
+                const PBRMaterial* Material;
+                Matrix World;
+            };
+
+            std::mt19937 rng(1);
+            std::uniform_int_distribution<size_t> meshDist(0, 15);
+            std::uniform_int_distribution<size_t> materialDist(0, materials.size() - 1);
+            std::uniform_real_distribution<float> positionDist(-500.f, 500.f);
+            std::uniform_real_distribution<float> angleDist(0.f, DirectX::XM_2PI);
+
+            std::vector<TestDraw> draws(numDraws);
+            for (uint32_t i = 0; i < numDraws; i++)
+            {
+                // Mostly unscaled like the trees, with some scaled
+                // copies and a few that can't be instanced.
+                Matrix scale = Matrix::Identity;
+                if (i % 10 == 1) scale = Matrix::CreateScale(2.f);
+                if (i % 50 == 2) scale = Matrix::CreateScale(1.f, 3.f, 1.f);
+
+                draws[i] = TestDraw{
+                    static_cast<entt::entity>(i),
+                    meshDist(rng),
+                    &materials[materialDist(rng)],
+                    scale
+                        * Matrix::CreateFromYawPitchRoll(angleDist(rng), angleDist(rng), 0.f)
+                        * Matrix::CreateTranslation(positionDist(rng), positionDist(rng), positionDist(rng))
+                };
+            }
+
+            InstanceBatcher batcher;
+            uint32_t rejected = 0;
+            auto time = MedianMilliseconds(iterations, [&]()
+                {
+                    batcher.Clear();
+                    rejected = 0;
+                    for (const auto& draw : draws)
+                    {
+                        if (!batcher.Add(draw.Entity, DrawType::PixelDepthReadOnly, draw.Mesh, *draw.Material, draw.World))
+                            rejected++;
+                    }
+                    batcher.Build();
+                });
+
+            const size_t drawCalls = batcher.GetBatches().size() + batcher.GetUnbatched().size() + rejected;
+
+            logger->info("  {} draws: {:.3f} ms, {} draw calls ({} batches, {} unbatched, {} not instanceable)",
+                numDraws,
+                time,
+                drawCalls,
+                batcher.GetBatches().size(),
+                batcher.GetUnbatched().size(),
+                rejected);
+        }
+    }
+
+    void RunParallelRecordingBenchmarks()
+    {
+        using Rendering::ICommandListPool;
+        using Rendering::ParallelRecorder;
+        constexpr int iterations = 10;
+        constexpr int workPerDraw = 2000;
+        auto logger = Logger::Get();
+
+        // Stands in for the bundles, keeping the draws each list got
+        class TestPool : public ICommandListPool
+        {
+        public:
+            void Reset()
+            {
+                m_lists.clear();
+            }
+
+            void Record(ListHandle list, size_t draw)
+            {
+                m_lists[list].push_back(draw);
+            }
+
+            ListHandle Acquire() override
+            {
+                std::lock_guard lock(m_mutex);
+                m_lists.emplace_back();
+                return static_cast<ListHandle>(m_lists.size() - 1);
+            }
+
+            void Close(ListHandle) override
+            {
+            }
+
+            void Submit(std::span<const ListHandle>) override
+            {
+            }
+
+        private:
+            std::mutex m_mutex;
+            // A deque, so lists stay put while others are acquired
+            std::deque<std::vector<size_t>> m_lists;
+        };
+
+        const size_t maxChunks = Jobs::JobSystem::Get()->GetMaxConcurrency();
+
+        logger->info("Parallel recording ({} iterations, median, {} threads)", iterations, maxChunks);
+
+        std::atomic<uint64_t> sink = 0;
+        for (size_t numDraws : { 100u, 1000u, 10000u })
+        {
+            TestPool pool;
+            double serialTime = 0.0;
+
+            for (size_t chunks = 1; ; chunks = std::min(chunks * 2, maxChunks))
+            {
+                ParallelRecorder recorder(64, chunks);
+
+                auto time = MedianMilliseconds(iterations, [&]()
+                    {
+                        pool.Reset();
+                        recorder.Record(pool, numDraws,
+                            [&](ICommandListPool::ListHandle list, size_t, size_t begin, size_t end)
+                            {
+                                for (size_t i = begin; i < end; i++)
+                                {
+                                    BusyWork(workPerDraw, sink);
+                                    pool.Record(list, i);
+                                }
+                            });
+                    });
+
+                if (chunks == 1)
+                    serialTime = time;
+
+                logger->info("  {} draws, up to {} chunks: {:.3f} ms ({:.1f}x) in {} chunks",
+                    numDraws,
+                    chunks,
+                    time,
+                    serialTime / time,
+                    recorder.GetChunkCount(numDraws));
+
+                if (chunks == maxChunks)
+                    break;
+            }
+        }
+    }
+
+    void RunInstanceCullingBenchmarks()
+    {
+        using namespace DirectX::SimpleMath;
+        using Rendering::InstanceCuller;
+        constexpr int iterations = 20;
+        auto logger = Logger::Get();
+
+        logger->info("Instance culling reference ({} iterations, median)", iterations);
+
+        auto frustum = Math::MakeFrustum(
+            Matrix::CreateLookAt(Vector3(0, 10, 0), Vector3(1, 9, 1), Vector3::UnitY),
+            Matrix::CreatePerspectiveFieldOfView(DirectX::XM_PIDIV4, 16.f / 9.f, 0.1f, 300.f));
+        auto planes = Math::GetPlanes(frustum);
+
+        // A branch mesh, placed off its origin like the L-system parts are
+        DirectX::BoundingBox meshBounds(Vector3(0.f, 1.5f, 0.f), Vector3(0.3f, 1.5f, 0.3f));
+
+        for (uint32_t numInstances : { 1000u, 10000u, 100000u })
+        {
+            std::mt19937 rng(1);
+            std::uniform_real_distribution<float> positionDist(-200.f, 200.f);
+            std::uniform_real_distribution<float> angleDist(0.f, DirectX::XM_2PI);
+
+            std::vector<BufferManager::InstanceData> instances(numInstances);
+            for (auto& instance : instances)
+            {
+                instance.Position = Vector3(positionDist(rng), positionDist(rng) * 0.1f, positionDist(rng));
+                instance.RotationQuat = Quaternion::CreateFromYawPitchRoll(angleDist(rng), angleDist(rng), 0.f);
+            }
+
+            Matrix world = Matrix::CreateScale(1.5f) * Matrix::CreateTranslation(50.f, 0.f, 50.f);
+            float radius = InstanceCuller::GetInstanceRadius(meshBounds, world);
+
+            std::vector<uint32_t> visible;
+            uint32_t numVisible = 0;
+            auto time = MedianMilliseconds(iterations, [&]()
+                {
+                    numVisible = InstanceCuller::CullOnCpu(instances, world, radius, planes, visible);
+                });
+
+            // How many of the drawn instances' meshes are really in the frustum
+            size_t numInFrustum = 0;
+            for (uint32_t i = 0; i < numInstances; i++)
+            {
+                const auto& instance = instances[i];
+                Matrix instanceWorld = Matrix::CreateFromQuaternion(instance.RotationQuat)
+                    * Matrix::CreateTranslation(instance.Position)
+                    * world;
+
+                DirectX::BoundingOrientedBox instanceBox;
+                DirectX::BoundingOrientedBox::CreateFromBoundingBox(instanceBox, meshBounds);
+                instanceBox.Transform(instanceBox, instanceWorld);
+
+                if (frustum.Intersects(instanceBox))
+                {
+                    numInFrustum++;
+                }
+            }
+
+            logger->info("  {} instances: {:.3f} ms, {} drawn of {} ({} in the frustum)",
+                numInstances,
+                time,
+                numVisible,
+                numInstances,
+                numInFrustum);
+        }
+    }
+
+    void RunInstanceLodBenchmarks()
+    {
+        using namespace DirectX::SimpleMath;
+        using Rendering::InstanceLodSelector;
+        using Rendering::ProceduralMesh;
+        constexpr int iterations = 20;
+        auto logger = Logger::Get();
+
+        // A bent branch, a frustum at a time like the L-system builds it
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<float> bendDist(-0.15f, 0.15f);
+
+        std::vector<ProceduralMesh::AngledFrustumParameters> segments;
+        Vector3 bottom = Vector3::Zero;
+        Quaternion rotation = Quaternion::Identity;
+        float radius = 0.2f;
+        for (int i = 0; i < 40; i++)
+        {
+            auto bend = Quaternion::CreateFromYawPitchRoll(bendDist(rng), bendDist(rng), bendDist(rng));
+            segments.push_back({ bottom, rotation, radius, radius * 0.97f, Vector3(0, 0.1f, 0), bend });
+
+            bottom += Vector3::Transform(Vector3(0, 0.1f, 0), rotation);
+            rotation = bend * rotation;
+            radius *= 0.97f;
+        }
+
+        auto branch = ProceduralMesh::Optimize(ProceduralMesh::CreateAngledFrustumParts(segments, 8));
+        auto meshBounds = ProceduralMesh::ComputeBoundingBox(branch.Vertices);
+
+        ProceduralMesh::LodChain lodChain;
+        auto buildTime = MedianMilliseconds(iterations, [&]()
+            {
+                lodChain = ProceduralMesh::BuildLodChain(branch.Vertices, branch.Indices);
+            });
+
+        logger->info("Instance LOD chain, {} triangles ({} iterations, median): {:.3f} ms",
+            branch.Indices.size() / 3,
+            iterations,
+            buildTime);
+
+        for (size_t i = 0; i < lodChain.Lods.size(); i++)
+        {
+            const auto& lod = lodChain.Lods[i];
+            logger->info("  LOD {}: {} triangles, error {:.4f}",
+                i,
+                lod.IndexCount / 3,
+                lod.Error);
+        }
+
+        logger->info("Instance LOD selection ({} iterations, median)", iterations);
+
+        InstanceLodSelector::View view{
+            Vector3(0, 10, 0),
+            // A 1080p view with a 45 degree vertical field of view
+            0.5f * 1080.f / std::tan(DirectX::XM_PIDIV4 * 0.5f),
+            1.f
+        };
+
+        auto frustum = Math::MakeFrustum(
+            Matrix::CreateLookAt(view.CameraPosition, Vector3(1, 9, 1), Vector3::UnitY),
+            Matrix::CreatePerspectiveFieldOfView(DirectX::XM_PIDIV4, 16.f / 9.f, 0.1f, 300.f));
+        auto planes = Math::GetPlanes(frustum);
+
+        for (uint32_t numInstances : { 10000u, 100000u })
+        {
+            // Runs of nearby branches, like the trees in the scene have
+            std::uniform_real_distribution<float> treeDist(-200.f, 200.f);
+            std::uniform_real_distribution<float> branchDist(-3.f, 3.f);
+            std::uniform_real_distribution<float> angleDist(0.f, DirectX::XM_2PI);
+
+            std::vector<BufferManager::InstanceData> instances(numInstances);
+            Vector3 treePosition;
+            for (uint32_t i = 0; i < numInstances; i++)
+            {
+                if (i % 100 == 0)
+                {
+                    treePosition = Vector3(treeDist(rng), 0.f, treeDist(rng));
+                }
+
+                instances[i].Position = treePosition
+                    + Vector3(branchDist(rng), branchDist(rng) + 5.f, branchDist(rng));
+                instances[i].RotationQuat = Quaternion::CreateFromYawPitchRoll(angleDist(rng), angleDist(rng), 0.f);
+            }
+
+            Matrix world = Matrix::CreateScale(1.5f) * Matrix::CreateTranslation(50.f, 0.f, 50.f);
+
+            for (uint32_t clusterSize : { 1u, InstanceLodSelector::DefaultClusterSize })
+            {
+                auto clusters = InstanceLodSelector::BuildClusters(instances, meshBounds, clusterSize);
+
+                InstanceLodSelector selector;
+                auto time = MedianMilliseconds(iterations, [&]()
+                    {
+                        selector.Select(clusters, lodChain.Lods, world, view, planes);
+                    });
+
+                auto bucketed = selector.GetInstances();
+                auto ranges = selector.GetRanges();
+
+                uint64_t numIndicesDrawn = 0;
+                for (uint32_t lod = 0; lod < ranges.size(); lod++)
+                {
+                    numIndicesDrawn += uint64_t(ranges[lod].InstanceCount) * lodChain.Lods[lod].IndexCount;
+                }
+
+                std::ostringstream levels;
+                for (const auto& range : ranges)
+                {
+                    levels << " " << range.InstanceCount;
+                }
+
+                logger->info("  {} instances, clusters of {}: {:.3f} ms, {} drawn, per level{}, {:.1f}% of the full triangles",
+                    numInstances,
+                    clusterSize,
+                    time,
+                    bucketed.size(),
+                    levels.str(),
+                    bucketed.empty() ? 0.0 : 100.0 * numIndicesDrawn
+                        / (double(bucketed.size()) * lodChain.Lods[0].IndexCount));
+            }
+        }
+    }
+
+    void RunMeshletBenchmarks()
+    {
+        using namespace DirectX::SimpleMath;
+        using namespace Rendering::LSystemDefinitions;
+        namespace Meshlets = Rendering::Meshlets;
+        constexpr int iterations = 20;
+        auto logger = Logger::Get();
+
+        const std::vector<NamedDefinition> trunkDefinitions = {
+            { "TreeTrunk1", TreeTrunk1 },
+            { "TreeTrunk2", TreeTrunk2 },
+            { "TreeTrunk3", TreeTrunk3 },
+        };
+
+        logger->info("Meshlets ({} iterations, median)", iterations);
+
+        for (const auto& [name, definition] : trunkDefinitions)
+        {
+            // As the scene builds it
+            auto lsystem = definition.Create();
+            auto trunk = Rendering::ProceduralMesh::Optimize(lsystem.GetTrunk(), 0.1f, 0.1f);
+            auto bounds = Rendering::ProceduralMesh::ComputeBoundingBox(trunk.Vertices);
+
+            Meshlets::MeshletData meshlets;
+            auto buildTime = MedianMilliseconds(iterations, [&]()
+                {
+                    meshlets = Meshlets::Build(&trunk.Vertices[0].position.x,
+                        trunk.Vertices.size(),
+                        sizeof(Rendering::ProceduralMesh::VertexType),
+                        trunk.Indices);
+                });
+
+            const size_t numTriangles = trunk.Indices.size() / 3;
+
+            logger->info("  {}: {} triangles into {} meshlets ({:.1f} triangles, {:.1f} vertices each), {:.3f} ms, {} bytes",
+                name,
+                numTriangles,
+                meshlets.Meshlets.size(),
+                double(numTriangles) / std::max<size_t>(meshlets.Meshlets.size(), 1),
+                double(meshlets.Vertices.size()) / std::max<size_t>(meshlets.Meshlets.size(), 1),
+                buildTime,
+                meshlets.Meshlets.size() * sizeof(Meshlets::Meshlet)
+                    + meshlets.Vertices.size() * sizeof(uint32_t)
+                    + meshlets.Triangles.size() * sizeof(uint32_t));
+
+            // Rotated and scaled uniformly, like the trees in the scene
+            Matrix world = Matrix::CreateScale(1.5f)
+                * Matrix::CreateFromAxisAngle(Vector3::UnitY, 0.7f)
+                * Matrix::CreateTranslation(20.f, 0.f, -10.f);
+            DirectX::XMFLOAT4X4 world4x4;
+            DirectX::XMStoreFloat4x4(&world4x4, world);
+
+            DirectX::BoundingBox worldBounds;
+            bounds.Transform(worldBounds, world);
+            const Vector3 center = worldBounds.Center;
+            const float extent = Vector3(worldBounds.Extents).Length();
+
+            struct CameraSetup
+            {
+                const char* Name;
+                Vector3 Position;
+                Vector3 Target;
+            };
+
+            const CameraSetup cameras[] = {
+                { "far", center + Vector3(3.f, 0.5f, 0.f) * extent, center },
+                { "near", center + Vector3(0.f, 0.f, 0.8f) * extent, center },
+                { "from below", Vector3(center.x + extent, worldBounds.Center.y - worldBounds.Extents.y + 1.f, center.z), center },
+                { "off to the side", center + Vector3(-2.f, 0.f, 0.f) * extent, center + Vector3(-2.f, 0.f, 1.5f) * extent },
+            };
+
+            std::vector<uint32_t> visibleMeshlets;
+
+            for (const auto& camera : cameras)
+            {
+                auto frustum = Math::MakeFrustum(
+                    Matrix::CreateLookAt(camera.Position, camera.Target, Vector3::UnitY),
+                    Matrix::CreatePerspectiveFieldOfView(DirectX::XM_PIDIV4, 16.f / 9.f, 0.1f, 1000.f));
+                auto planes = Math::GetPlanes(frustum);
+
+                auto frustumStats = Meshlets::CullAll(meshlets.Meshlets,
+                    world4x4,
+                    camera.Position,
+                    planes,
+                    false,
+                    visibleMeshlets);
+
+                Meshlets::CullStats stats;
+                auto time = MedianMilliseconds(iterations, [&]()
+                    {
+                        stats = Meshlets::CullAll(meshlets.Meshlets,
+                            world4x4,
+                            camera.Position,
+                            planes,
+                            true,
+                            visibleMeshlets);
+                    });
+
+                logger->info("    {}: {:.4f} ms, {} of {} meshlets outside the frustum, {} back-facing, {:.1f}% of triangles rejected ({:.1f}% by the frustum alone)",
+                    camera.Name,
+                    time,
+                    stats.NumOutsideFrustum,
+                    stats.NumMeshlets,
+                    stats.NumBackFacing,
+                    stats.NumTriangles == 0 ? 0.0 : 100.0 * stats.NumTrianglesRejected / stats.NumTriangles,
+                    frustumStats.NumTriangles == 0 ? 0.0 : 100.0 * frustumStats.NumTrianglesRejected / frustumStats.NumTriangles);
+            }
+        }
+    }
+
+    void RunOcclusionBenchmarks()
+    {
+        using namespace DirectX::SimpleMath;
+        using Rendering::DepthRasterizer;
+        namespace HiZ = Rendering::HiZ;
+        constexpr int iterations = 20;
+        auto logger = Logger::Get();
+
+        logger->info("Occlusion culling ({} iterations, median)", iterations);
+
+        // Rolling hills, laid out like the scene's terrain
+        constexpr uint32_t sampleCount = 257;
+        constexpr float gridWidth = 400.f;
+        constexpr float terrainHeight = 40.f;
+
+        std::vector<float> heights(sampleCount * sampleCount);
+        for (uint32_t z = 0; z < sampleCount; z++)
+        {
+            for (uint32_t x = 0; x < sampleCount; x++)
+            {
+                heights[z * sampleCount + x] = 0.5f
+                    + 0.25f * std::sin(x * 0.05f) * std::cos(z * 0.07f)
+                    + 0.25f * std::sin(z * 0.11f + x * 0.02f);
+            }
+        }
+
+        auto terrainHeightAt = [&](float worldX, float worldZ)
+            {
+                const float scale = gridWidth / (sampleCount - 1);
+                const auto x = std::min(static_cast<uint32_t>((worldX + gridWidth / 2.f) / scale), sampleCount - 1);
+                const auto z = std::min(static_cast<uint32_t>((worldZ + gridWidth / 2.f) / scale), sampleCount - 1);
+                return heights[z * sampleCount + x] * terrainHeight;
+            };
+
+        DepthRasterizer::OccluderMesh occluder;
+        auto occluderTime = MedianMilliseconds(iterations, [&]()
+            {
+                occluder = DepthRasterizer::CreateHeightfieldOccluder(heights,
+                    sampleCount,
+                    gridWidth,
+                    terrainHeight,
+                    Vector3::Zero,
+                    4);
+            });
+
+        logger->info("  Occluder: {} triangles from {} samples, {:.3f} ms",
+            occluder.Indices.size() / 3,
+            heights.size(),
+            occluderTime);
+
+        // Not a power of two, so level 0 of the pyramid has to cover more than one pixel
+        constexpr uint32_t width = 960;
+        constexpr uint32_t height = 540;
+
+        const Vector3 cameraPosition(0.f, terrainHeightAt(0.f, -180.f) + 4.f, -180.f);
+        Matrix viewProj = Matrix::CreateLookAt(cameraPosition, Vector3(0.f, 15.f, 0.f), Vector3::UnitY)
+            * Matrix::CreatePerspectiveFieldOfView(DirectX::XM_PIDIV4, 16.f / 9.f, 0.1f, 300.f);
+
+        DepthRasterizer rasterizer(width, height);
+        auto rasterTime = MedianMilliseconds(iterations, [&]()
+            {
+                rasterizer.Clear();
+                rasterizer.DrawTriangles(occluder.Positions, occluder.Indices, viewProj);
+            });
+
+        auto depths = rasterizer.GetDepths();
+        size_t numCovered = std::count_if(depths.begin(), depths.end(),
+            [](float depth) { return depth < 1.f; });
+
+        HiZ::Pyramid pyramid;
+        auto buildTime = MedianMilliseconds(iterations, [&]()
+            {
+                HiZ::Build(depths, width, height, viewProj, pyramid);
+            });
+
+        logger->info("  Rasterized at {}x{}: {:.3f} ms, {:.1f}% covered, pyramid of {} levels from {}x{}: {:.3f} ms",
+            width,
+            height,
+            rasterTime,
+            100.0 * numCovered / depths.size(),
+            pyramid.GetLevelCount(),
+            pyramid.Width,
+            pyramid.Height,
+            buildTime);
+
+        // Trees standing on the terrain, all over it
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<float> positionDist(-gridWidth / 2.f + 10.f, gridWidth / 2.f - 10.f);
+        std::uniform_real_distribution<float> sizeDist(0.5f, 3.f);
+
+        std::vector<DirectX::BoundingBox> boxes(10000);
+        for (auto& box : boxes)
+        {
+            const float x = positionDist(rng);
+            const float z = positionDist(rng);
+            const float size = sizeDist(rng);
+            box.Center = Vector3(x, terrainHeightAt(x, z) + size * 2.f, z);
+            box.Extents = Vector3(size, size * 2.f, size);
+        }
+
+        std::vector<uint8_t> occluded(boxes.size());
+        auto testTime = MedianMilliseconds(iterations, [&]()
+            {
+                for (size_t i = 0; i < boxes.size(); i++)
+                {
+                    occluded[i] = HiZ::IsOccluded(pyramid, boxes[i].Center, boxes[i].Extents);
+                }
+            });
+
+        size_t numCulled = std::count(occluded.begin(), occluded.end(), 1);
+
+        logger->info("  {} boxes: {:.3f} ms, {} culled",
+            boxes.size(),
+            testTime,
+            numCulled);
+    }
+
+    void RunSoftwareOcclusionBenchmarks()
+    {
+        using namespace DirectX::SimpleMath;
+        using Rendering::DepthRasterizer;
+        using Rendering::SoftwareOcclusionCuller;
+        constexpr int iterations = 20;
+        auto logger = Logger::Get();
+
+        logger->info("Software occlusion culling ({} iterations, median)", iterations);
+
+        // The scene's terrain, from the same heightmap
+        std::vector<float> heights;
+        uint32_t sampleCount = 0;
+        try
+        {
+            heights = ECS::Components::RigidBodyComponent::LoadHeightData(
+                L"Assets\\island_height_32bit.dds", sampleCount);
+        }
+        catch (const std::exception&)
+        {
+            logger->info("  Skipped, couldn't load the heightmap");
+            return;
+        }
+
+        constexpr float gridWidth = 256.f;
+        constexpr float terrainHeight = 10.f;
+        const Vector3 terrainPosition(0.f, -1.f, 0.f);
+        const Matrix terrainWorld = Matrix::CreateTranslation(terrainPosition);
+
+        auto terrainHeightAt = [&](float worldX, float worldZ)
+            {
+                const float scale = gridWidth / (sampleCount - 1);
+                const auto x = std::min(static_cast<uint32_t>((worldX + gridWidth / 2.f) / scale), sampleCount - 1);
+                const auto z = std::min(static_cast<uint32_t>((worldZ + gridWidth / 2.f) / scale), sampleCount - 1);
+                return terrainPosition.y + heights[z * sampleCount + x] * terrainHeight;
+            };
+
+        // Built the same way as in Scene::AddTerrain
+        const uint32_t step = std::max(1u, (sampleCount - 1) / 256);
+        DepthRasterizer::OccluderMesh grid;
+        auto gridTime = MedianMilliseconds(1, [&]()
+            {
+                grid = DepthRasterizer::CreateHeightfieldOccluder(heights,
+                    sampleCount,
+                    gridWidth,
+                    terrainHeight,
+                    Vector3::Zero,
+                    step);
+            });
+
+        DepthRasterizer::OccluderMesh occluder;
+        auto simplifyTime = MedianMilliseconds(1, [&]()
+            {
+                occluder = DepthRasterizer::SimplifyOccluder(grid, 4096);
+            });
+
+        logger->info("  Occluder: {} samples across, grid of {} triangles: {:.3f} ms, simplified to {}: {:.3f} ms",
+            sampleCount,
+            grid.Indices.size() / 3,
+            gridTime,
+            occluder.Indices.size() / 3,
+            simplifyTime);
+
+        constexpr uint32_t width = SoftwareOcclusionCuller::Width;
+        constexpr uint32_t height = SoftwareOcclusionCuller::Height;
+
+        // Standing on the shore, looking inland
+        const Vector3 cameraPosition(0.f, terrainHeightAt(0.f, -100.f) + 2.f, -100.f);
+        const Matrix viewProj = Matrix::CreateLookAt(cameraPosition, Vector3(0.f, terrainPosition.y + terrainHeight * 0.5f, 0.f), Vector3::UnitY)
+            * Matrix::CreatePerspectiveFieldOfView(DirectX::XM_PIDIV4, 16.f / 9.f, 0.1f, 500.f);
+        const Matrix occluderViewProj = terrainWorld * viewProj;
+
+        DepthRasterizer rasterizer(width, height);
+        auto setupTime = MedianMilliseconds(iterations, [&]()
+            {
+                rasterizer.Clear();
+                rasterizer.AddTriangles(occluder.Positions, occluder.Indices, occluderViewProj);
+            });
+
+        auto referenceTime = MedianMilliseconds(iterations, [&]()
+            {
+                for (uint32_t band = 0; band < rasterizer.GetBandCount(); band++)
+                {
+                    rasterizer.DrawBandReference(band);
+                }
+            });
+
+        rasterizer.Clear();
+        rasterizer.AddTriangles(occluder.Positions, occluder.Indices, occluderViewProj);
+        auto simdTime = MedianMilliseconds(iterations, [&]()
+            {
+                for (uint32_t band = 0; band < rasterizer.GetBandCount(); band++)
+                {
+                    rasterizer.DrawBand(band);
+                }
+            });
+
+        logger->info("  {}x{}, {} bands: setup {:.3f} ms, one pixel at a time {:.3f} ms, four at a time {:.3f} ms",
+            width,
+            height,
+            rasterizer.GetBandCount(),
+            setupTime,
+            referenceTime,
+            simdTime);
+
+        // All of it, the way the renderer does it every frame
+        SoftwareOcclusionCuller culler;
+        std::array<SoftwareOcclusionCuller::Occluder, 1> occluders = { {
+            { &occluder, terrainWorld }
+        } };
+        auto renderTime = MedianMilliseconds(iterations, [&]()
+            {
+                culler.Render(occluders, viewProj);
+            });
+
+        size_t numCovered = std::count_if(culler.GetRasterizer().GetDepths().begin(),
+            culler.GetRasterizer().GetDepths().end(),
+            [](float depth) { return depth < 1.f; });
+
+        logger->info("  Drawn across the job system with the pyramid: {:.3f} ms, {:.1f}% covered",
+            renderTime,
+            100.0 * numCovered / (width * height));
+
+        // Trees standing on the terrain, all over it
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<float> positionDist(-gridWidth / 2.f + 5.f, gridWidth / 2.f - 5.f);
+        std::uniform_real_distribution<float> sizeDist(0.25f, 1.5f);
+
+        std::vector<DirectX::BoundingBox> boxes(10000);
+        for (auto& box : boxes)
+        {
+            const float x = positionDist(rng);
+            const float z = positionDist(rng);
+            const float size = sizeDist(rng);
+            box.Center = Vector3(x, terrainHeightAt(x, z) + size * 2.f, z);
+            box.Extents = Vector3(size, size * 2.f, size);
+        }
+
+        std::vector<uint8_t> occluded(boxes.size());
+        auto testTime = MedianMilliseconds(iterations, [&]()
+            {
+                for (size_t i = 0; i < boxes.size(); i++)
+                {
+                    occluded[i] = culler.IsOccluded(boxes[i]);
+                }
+            });
+
+        size_t numCulled = std::count(occluded.begin(), occluded.end(), 1);
+
+        logger->info("  {} boxes: {:.3f} ms, {} culled",
+            boxes.size(),
+            testTime,
+            numCulled);
+    }
+
+    void RunDescriptorAllocatorBenchmarks()
+    {
+        constexpr int iterations = 20;
+        constexpr uint32_t capacity = 4096;
+        constexpr int numOperations = 100000;
+        auto logger = Logger::Get();
+
+        logger->info("Descriptor allocation, {} descriptors ({} iterations, median)", capacity, iterations);
+
+        // Allocating and freeing the way a loader does, a few at a time
+        std::vector<uint32_t> held;
+        held.reserve(64);
+
+        // What GraphicsMemoryManager used to do, with a lock to make it thread-safe
+        std::set<uint32_t> freeSet;
+        std::mutex setMutex;
+        uint32_t setTop = 0;
+        auto setTime = MedianMilliseconds(iterations, [&]()
+            {
+                for (int i = 0; i < numOperations; i++)
+                {
+                    std::lock_guard lock(setMutex);
+                    if (held.size() < 64 && (i & 3) != 3)
+                    {
+                        if (!freeSet.empty())
+                        {
+                            held.push_back(*freeSet.begin());
+                            freeSet.erase(freeSet.begin());
+                        }
+                        else
+                        {
+                            held.push_back(setTop++);
+                        }
+                    }
+                    else if (!held.empty())
+                    {
+                        freeSet.insert(held.back());
+                        held.pop_back();
+                    }
+                }
+            });
+        held.clear();
+
+        DescriptorAllocator allocator(capacity);
+        auto allocatorTime = MedianMilliseconds(iterations, [&]()
+            {
+                for (int i = 0; i < numOperations; i++)
+                {
+                    if (held.size() < 64 && (i & 3) != 3)
+                    {
+                        held.push_back(allocator.Allocate());
+                    }
+                    else if (!held.empty())
+                    {
+                        allocator.Free(held.back());
+                        held.pop_back();
+                    }
+                }
+            });
+        for (auto index : held)
+        {
+            allocator.Free(index);
+        }
+
+        logger->info("  {} operations on one thread: std::set with a lock {:.3f} ms, lock-free {:.3f} ms ({:.1f}x)",
+            numOperations,
+            setTime,
+            allocatorTime,
+            setTime / allocatorTime);
+
+        // Every thread allocates and frees at once, half of the frees waiting
+        // on a fence that another thread keeps advancing and reclaiming.
+        const uint32_t numThreads = std::clamp(std::thread::hardware_concurrency(), 2u, 16u);
+        constexpr uint32_t maxHeldPerThread = 128;
+
+        DescriptorAllocator shared(capacity);
+        std::atomic<uint64_t> completedFence = 0;
+        std::atomic<bool> stop = false;
+        std::atomic<uint64_t> exhausted = 0;
+
+        auto stressTime = MedianMilliseconds(1, [&]()
+            {
+                std::thread reclaimer([&]()
+                    {
+                        while (!stop.load())
+                        {
+                            shared.Reclaim(completedFence.fetch_add(1) + 1);
+                            std::this_thread::yield();
+                        }
+                    });
+
+                std::vector<std::thread> workers;
+                for (uint32_t t = 0; t < numThreads; t++)
+                {
+                    workers.emplace_back([&, t]()
+                        {
+                            std::mt19937 rng(t);
+                            std::vector<uint32_t> mine;
+                            mine.reserve(maxHeldPerThread);
+
+                            for (int i = 0; i < numOperations; i++)
+                            {
+                                if (mine.size() < maxHeldPerThread && (rng() & 1))
+                                {
+                                    uint32_t index;
+                                    try
+                                    {
+                                        index = shared.Allocate();
+                                    }
+                                    catch (const std::runtime_error&)
+                                    {
+                                        // Everything free is still waiting on the fence
+                                        exhausted++;
+                                        continue;
+                                    }
+
+                                    mine.push_back(index);
+                                }
+                                else if (!mine.empty())
+                                {
+                                    auto index = mine.back();
+                                    mine.pop_back();
+
+                                    if (rng() & 1)
+                                    {
+                                        shared.Free(index);
+                                    }
+                                    else
+                                    {
+                                        shared.FreeAfter(index, completedFence.load() + 1);
+                                    }
+                                }
+                            }
+
+                            for (auto index : mine)
+                            {
+                                shared.Free(index);
+                            }
+                        });
+                }
+
+                for (auto& worker : workers)
+                {
+                    worker.join();
+                }
+
+                stop = true;
+                reclaimer.join();
+            });
+
+        logger->info("  {} threads, {} operations each: {:.3f} ms, {} allocations found nothing free",
+            numThreads,
+            numOperations,
+            stressTime,
+            exhausted.load());
+    }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "pch.h"
+
+namespace Gradient::Benchmarks
+{
+    // CPU-side micro-benchmarks. None of these need a device,
+    // so they can run headless with the --benchmark argument.
+    // Results are logged, and also written to benchmarks.log.
+    void RunAll();
+
+    void RunLSystemBenchmarks();
+    void RunGeometryBenchmarks();
+    void RunJobSystemBenchmarks();
+    void RunTransformBenchmarks();
+    void RunCullingBenchmarks();
+    void RunShadowCascadeBenchmarks();
+    void RunFrameArenaBenchmarks();
+    void RunPrepassSetBenchmarks();
+    void RunRenderQueueBenchmarks();
+    void RunInstanceBatcherBenchmarks();
+    void RunParallelRecordingBenchmarks();
+    void RunInstanceCullingBenchmarks();
+    void RunInstanceLodBenchmarks();
+    void RunMeshletBenchmarks();
+    void RunOcclusionBenchmarks();
+    void RunSoftwareOcclusionBenchmarks();
+    void RunDescriptorAllocatorBenchmarks();
+}
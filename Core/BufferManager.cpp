@@ -28,6 +28,23 @@ namespace Gradient
         ID3D12Device* device,
         ID3D12CommandQueue* cq,
         const std::vector<InstanceData>& instanceData)
+    {
+        DirectX::ResourceUploadBatch uploadBatch(device);
+
+        uploadBatch.Begin();
+
+        auto handle = CreateInstanceBuffer(device, uploadBatch, instanceData);
+
+        auto uploadFinished = uploadBatch.End(cq);
+        uploadFinished.wait();
+
+        return handle;
+    }
+
+    BufferManager::InstanceBufferHandle BufferManager::CreateInstanceBuffer(
+        ID3D12Device* device,
+        DirectX::ResourceUploadBatch& uploadBatch,
+        std::span<const InstanceData> instanceData)
     {
         auto handle = m_instanceBuffers.Allocate({
             BarrierResource(),
@@ -36,10 +53,6 @@ namespace Gradient
 
         auto entry = m_instanceBuffers.Get(handle);
 
-        DirectX::ResourceUploadBatch uploadBatch(device);
-
-        uploadBatch.Begin();
-
         // TODO: set flag to allow access as a UAV?
         DX::ThrowIfFailed(
             DirectX::CreateStaticBuffer(device,
@@ -50,8 +63,16 @@ namespace Gradient
                 entry->Resource.ReleaseAndGetAddressOf()));
         entry->Resource.SetState(D3D12_RESOURCE_STATE_ALL_SHADER_RESOURCE);
 
-        auto uploadFinished = uploadBatch.End(cq);
-        uploadFinished.wait();
+        D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+        srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+        srvDesc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
+        srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+        srvDesc.Buffer.NumElements = static_cast<UINT>(instanceData.size());
+        srvDesc.Buffer.StructureByteStride = sizeof(InstanceData);
+
+        entry->SRV = GraphicsMemoryManager::Get()->CreateSRV(device,
+            entry->Resource.Get(),
+            &srvDesc);
 
         return handle;
     }
@@ -188,5 +209,40 @@ namespace Gradient
         ));
     }
 
+    BufferManager::MeshHandle BufferManager::CreateFromOptimizedPart(
+        ID3D12Device* device,
+        DirectX::ResourceUploadBatch& uploadBatch,
+        const Rendering::ProceduralMesh::MeshPart& part)
+    {
+        return AddMesh(Rendering::ProceduralMesh::CreateFromOptimizedPart(
+            device, uploadBatch, part
+        ));
+    }
+
+    BufferManager::MeshHandle BufferManager::CreateFromOptimizedPart(
+        ID3D12Device* device,
+        DirectX::ResourceUploadBatch& uploadBatch,
+        std::span<const Rendering::ProceduralMesh::VertexType> vertices,
+        std::span<const uint32_t> indices,
+        const DirectX::BoundingBox& boundingBox,
+        bool buildMeshlets)
+    {
+        return AddMesh(Rendering::ProceduralMesh::CreateFromOptimizedPart(
+            device, uploadBatch, vertices, indices, boundingBox, buildMeshlets
+        ));
+    }
+
+    BufferManager::MeshHandle BufferManager::CreateFromOptimizedPart(
+        ID3D12Device* device,
+        DirectX::ResourceUploadBatch& uploadBatch,
+        std::span<const Rendering::ProceduralMesh::VertexType> vertices,
+        const Rendering::ProceduralMesh::LodChain& lodChain,
+        const DirectX::BoundingBox& boundingBox)
+    {
+        return AddMesh(Rendering::ProceduralMesh::CreateFromOptimizedPart(
+            device, uploadBatch, vertices, lodChain, boundingBox
+        ));
+    }
+
 #pragma endregion
 }
\ No newline at end of file
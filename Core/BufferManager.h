@@ -4,9 +4,11 @@
 
 #include "Core/BarrierResource.h"
 #include "Core/FreeListAllocator.h"
+#include "Core/GraphicsMemoryManager.h"
 #include "Core/Rendering/ProceduralMesh.h"
 
 #include <optional>
+#include <span>
 
 namespace Gradient
 {
@@ -28,6 +30,8 @@ namespace Gradient
         {
             BarrierResource Resource;
             uint32_t InstanceCount;
+            // For shaders that pick the buffer from the descriptor heap
+            GraphicsMemoryManager::DescriptorView SRV;
         };
 
         using InstanceBufferList = FreeListAllocator<InstanceBufferEntry>;
@@ -43,6 +47,10 @@ namespace Gradient
         InstanceBufferHandle CreateInstanceBuffer(ID3D12Device* device,
             ID3D12CommandQueue* cq,
             const std::vector<InstanceData>& instanceData);
+        // Queues the upload onto a batch that the caller ends.
+        InstanceBufferHandle CreateInstanceBuffer(ID3D12Device* device,
+            DirectX::ResourceUploadBatch& uploadBatch,
+            std::span<const InstanceData> instanceData);
         InstanceBufferEntry* GetInstanceBuffer(InstanceBufferHandle handle);
 
         MeshHandle AddMesh(Rendering::ProceduralMesh&& mesh);
@@ -117,6 +125,31 @@ namespace Gradient
             float errorRate = 0.1f
         );
 
+        // For parts that have been through ProceduralMesh::Optimize.
+        // Queues the upload onto a batch that the caller ends.
+        MeshHandle CreateFromOptimizedPart(
+            ID3D12Device* device,
+            DirectX::ResourceUploadBatch& uploadBatch,
+            const Rendering::ProceduralMesh::MeshPart& part
+        );
+
+        MeshHandle CreateFromOptimizedPart(
+            ID3D12Device* device,
+            DirectX::ResourceUploadBatch& uploadBatch,
+            std::span<const Rendering::ProceduralMesh::VertexType> vertices,
+            std::span<const uint32_t> indices,
+            const DirectX::BoundingBox& boundingBox,
+            bool buildMeshlets = false
+        );
+
+        MeshHandle CreateFromOptimizedPart(
+            ID3D12Device* device,
+            DirectX::ResourceUploadBatch& uploadBatch,
+            std::span<const Rendering::ProceduralMesh::VertexType> vertices,
+            const Rendering::ProceduralMesh::LodChain& lodChain,
+            const DirectX::BoundingBox& boundingBox
+        );
+
 #pragma endregion
 
     private:
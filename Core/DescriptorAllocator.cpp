@@ -0,0 +1,121 @@
+#include "Core/DescriptorAllocator.h"
+
+#include <cassert>
+#include <stdexcept>
+
+namespace Gradient
+{
+    DescriptorAllocator::DescriptorAllocator(uint32_t capacity)
+        : m_free(capacity),
+        m_pendingNext(std::make_unique<uint32_t[]>(capacity)),
+        m_fenceValues(std::make_unique<uint64_t[]>(capacity))
+#ifdef _DEBUG
+        , m_allocated(std::make_unique<std::atomic<uint8_t>[]>(capacity))
+#endif
+    {
+    }
+
+    uint32_t DescriptorAllocator::Allocate()
+    {
+        uint32_t index;
+        if (!m_free.TryAllocate(index))
+        {
+            throw std::runtime_error("Ran out of descriptors");
+        }
+
+#ifdef _DEBUG
+        MarkAllocated(index);
+#endif
+        return index;
+    }
+
+    void DescriptorAllocator::Free(uint32_t index)
+    {
+        assert(index < GetCapacity());
+#ifdef _DEBUG
+        MarkFreed(index);
+#endif
+        m_free.Free(index);
+    }
+
+    void DescriptorAllocator::FreeAfter(uint32_t index, uint64_t fenceValue)
+    {
+        assert(index < GetCapacity());
+#ifdef _DEBUG
+        MarkFreed(index);
+#endif
+        m_fenceValues[index] = fenceValue;
+        PushPending(index, index);
+    }
+
+    void DescriptorAllocator::Reclaim(uint64_t completedFenceValue)
+    {
+        // Taking the whole stack at once leaves nothing for
+        // another thread to pop from under this one.
+        auto index = m_pendingHead.exchange(InvalidIndex, std::memory_order_acquire);
+
+        uint32_t waitingFirst = InvalidIndex;
+        uint32_t waitingLast = InvalidIndex;
+
+        while (index != InvalidIndex)
+        {
+            auto next = m_pendingNext[index];
+
+            if (m_fenceValues[index] <= completedFenceValue)
+            {
+                m_free.Free(index);
+            }
+            else
+            {
+                m_pendingNext[index] = waitingFirst;
+                if (waitingFirst == InvalidIndex)
+                {
+                    waitingLast = index;
+                }
+                waitingFirst = index;
+            }
+
+            index = next;
+        }
+
+        if (waitingFirst != InvalidIndex)
+        {
+            PushPending(waitingFirst, waitingLast);
+        }
+    }
+
+    uint32_t DescriptorAllocator::GetCapacity() const
+    {
+        return m_free.GetCapacity();
+    }
+
+    uint32_t DescriptorAllocator::GetHighWaterMark() const
+    {
+        return m_free.GetHighWaterMark();
+    }
+
+#ifdef _DEBUG
+    void DescriptorAllocator::MarkAllocated(uint32_t index)
+    {
+        [[maybe_unused]] auto wasAllocated = m_allocated[index].exchange(1, std::memory_order_relaxed);
+        assert(!wasAllocated && "Handed out a descriptor that's already in use");
+    }
+
+    void DescriptorAllocator::MarkFreed(uint32_t index)
+    {
+        [[maybe_unused]] auto wasAllocated = m_allocated[index].exchange(0, std::memory_order_relaxed);
+        assert(wasAllocated && "Freed a descriptor that isn't in use");
+    }
+#endif
+
+    void DescriptorAllocator::PushPending(uint32_t first, uint32_t last)
+    {
+        auto oldHead = m_pendingHead.load(std::memory_order_relaxed);
+        do
+        {
+            m_pendingNext[last] = oldHead;
+        } while (!m_pendingHead.compare_exchange_weak(oldHead, first,
+            std::memory_order_release,
+            std::memory_order_relaxed));
+    }
+}
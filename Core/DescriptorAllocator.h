@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Core/IndexFreeList.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+// Nothing here touches D3D12, so the allocator
+// can be built and checked on any platform.
+namespace Gradient
+{
+    // Hands out indices into a descriptor heap of a fixed size, from an
+    // IndexFreeList. Frees can also wait on a fence, since the GPU may
+    // still be reading the descriptor.
+    class DescriptorAllocator
+    {
+    public:
+        static constexpr uint32_t InvalidIndex = IndexFreeList::InvalidIndex;
+
+        explicit DescriptorAllocator(uint32_t capacity);
+
+        // Throws if every index is in use, or still waiting on the GPU
+        uint32_t Allocate();
+        // The index can be handed out again straight away. In debug
+        // builds, freeing an index that isn't handed out asserts.
+        void Free(uint32_t index);
+        // The index is handed out again once Reclaim is
+        // called with a completed fence value this high.
+        void FreeAfter(uint32_t index, uint64_t fenceValue);
+        // Frees everything whose fence value has been reached
+        void Reclaim(uint64_t completedFenceValue);
+
+        uint32_t GetCapacity() const;
+        // How many indices have ever been handed out
+        uint32_t GetHighWaterMark() const;
+
+    private:
+        // Pushes the indices from first to last, already linked together
+        void PushPending(uint32_t first, uint32_t last);
+
+        IndexFreeList m_free;
+
+        // Frees waiting on a fence are kept on a stack of their own. It's
+        // only ever emptied all at once, so unlike the free list's it needs
+        // no count: a push that sees the same head as before is still right.
+        std::unique_ptr<uint32_t[]> m_pendingNext;
+        // Only read by Reclaim, after the index has been taken off the pending stack
+        std::unique_ptr<uint64_t[]> m_fenceValues;
+        std::atomic<uint32_t> m_pendingHead = InvalidIndex;
+
+#ifdef _DEBUG
+        // Which indices are handed out, to catch an index being freed twice
+        std::unique_ptr<std::atomic<uint8_t>[]> m_allocated;
+
+        void MarkAllocated(uint32_t index);
+        void MarkFreed(uint32_t index);
+#endif
+    };
+}
@@ -19,7 +19,7 @@ namespace Gradient::ECS::Components
 
     BoundingBoxComponent BoundingBoxComponent::CreateFromInstanceData(
         const DirectX::BoundingBox& instanceBox,
-        const std::vector<BufferManager::InstanceData>& instances
+        std::span<const BufferManager::InstanceData> instances
     )
     {
         using namespace DirectX::SimpleMath;
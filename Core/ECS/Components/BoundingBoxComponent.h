@@ -5,6 +5,8 @@
 #include <directxtk12/SimpleMath.h>
 #include "Core/BufferManager.h"
 
+#include <span>
+
 namespace Gradient::ECS::Components
 {
     struct BoundingBoxComponent
@@ -16,7 +18,7 @@ namespace Gradient::ECS::Components
 
         static BoundingBoxComponent CreateFromInstanceData(
             const DirectX::BoundingBox& instanceBox,
-            const std::vector<BufferManager::InstanceData>& instances
+            std::span<const BufferManager::InstanceData> instances
         );
     };
 }
\ No newline at end of file
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "pch.h"
+
+#include "Core/Rendering/InstanceLodSelector.h"
+
+#include <vector>
+
+namespace Gradient::ECS::Components
+{
+    // Groups of the instances in the entity's InstanceDataComponent,
+    // which are culled and given a level of detail together.
+    struct InstanceClusterComponent
+    {
+        std::vector<Rendering::InstanceLodSelector::Cluster> Clusters;
+    };
+}
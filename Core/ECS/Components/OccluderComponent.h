@@ -0,0 +1,18 @@
+#pragma once
+
+#include "pch.h"
+
+#include "Core/Rendering/DepthRasterizer.h"
+
+#include <memory>
+
+namespace Gradient::ECS::Components
+{
+    // A simplified mesh, in the entity's local space, that's drawn on the
+    // CPU every frame to cull whatever it hides. It must never reach past
+    // what the entity draws, or things behind it will go missing.
+    struct OccluderComponent
+    {
+        std::shared_ptr<const Rendering::DepthRasterizer::OccluderMesh> Mesh;
+    };
+}
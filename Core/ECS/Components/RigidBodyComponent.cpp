@@ -95,6 +95,21 @@ namespace Gradient::ECS::Components
         DirectX::SimpleMath::Vector3 origin,
         std::function<JPH::BodyCreationSettings(JPH::BodyCreationSettings)> settingsFn
     )
+    {
+        uint32_t sampleCount = 0;
+        auto heightData = LoadHeightData(heightmapPath, sampleCount);
+
+        return CreateHeightField(heightData,
+            sampleCount,
+            gridWidth,
+            height,
+            origin,
+            settingsFn);
+    }
+
+    std::vector<float> RigidBodyComponent::LoadHeightData(
+        const std::wstring& heightmapPath,
+        uint32_t& sampleCount)
     {
         using namespace DirectX::SimpleMath;
 
@@ -112,10 +127,7 @@ namespace Gradient::ECS::Components
         // Read all the height information.
         size_t sampleOffset = 1;
         assert((info.width - 1) % sampleOffset == 0);
-        size_t sampleCount = ((info.width - 1) / sampleOffset) + 1;
-        float scaleFactor = gridWidth / ((float)sampleCount - 1.f);
-        JPH::RVec3 offset = { -gridWidth / 2.f, 0, -gridWidth / 2.f };
-        JPH::RVec3 scale = { scaleFactor, height ,scaleFactor };
+        sampleCount = static_cast<uint32_t>(((info.width - 1) / sampleOffset) + 1);
         DirectX::EvaluateImage(*image->GetImage(0, 0, 0),
             [&](const DirectX::XMVECTOR* pixels, size_t width, size_t y)
             {
@@ -128,6 +140,21 @@ namespace Gradient::ECS::Components
                 }
             });
 
+        return heightData;
+    }
+
+    RigidBodyComponent RigidBodyComponent::CreateHeightField(
+        std::span<const float> heightData,
+        uint32_t sampleCount,
+        float gridWidth,
+        float height,
+        DirectX::SimpleMath::Vector3 origin,
+        std::function<JPH::BodyCreationSettings(JPH::BodyCreationSettings)> settingsFn
+    )
+    {
+        float scaleFactor = gridWidth / ((float)sampleCount - 1.f);
+        JPH::RVec3 offset = { -gridWidth / 2.f, 0, -gridWidth / 2.f };
+        JPH::RVec3 scale = { scaleFactor, height ,scaleFactor };
 
         // Create the body.
         JPH::BodyInterface& bodyInterface
@@ -7,6 +7,8 @@
 #include <directxtk12/SimpleMath.h>
 
 #include <functional>
+#include <span>
+#include <vector>
 
 namespace Gradient::ECS::Components
 {
@@ -33,5 +35,17 @@ namespace Gradient::ECS::Components
             float height,
             DirectX::SimpleMath::Vector3 origin = DirectX::SimpleMath::Vector3::Zero,
             std::function<JPH::BodyCreationSettings(JPH::BodyCreationSettings)> settingsFn = nullptr);
+        static RigidBodyComponent CreateHeightField(
+            std::span<const float> heightData,
+            uint32_t sampleCount,
+            float gridWidth,
+            float height,
+            DirectX::SimpleMath::Vector3 origin = DirectX::SimpleMath::Vector3::Zero,
+            std::function<JPH::BodyCreationSettings(JPH::BodyCreationSettings)> settingsFn = nullptr);
+
+        // Reads the heights out of a square heightmap, a row at a time,
+        // as fractions of the height the heightfield is scaled to.
+        static std::vector<float> LoadHeightData(const std::wstring& heightmapPath,
+            uint32_t& sampleCount);
     };
 }
\ No newline at end of file
@@ -6,7 +6,9 @@ namespace Gradient::ECS::Components
 {
     DirectX::SimpleMath::Matrix TransformComponent::GetWorldMatrix() const
     {
-        return this->Scale * this->Rotation * this->Translation;
+        return DirectX::SimpleMath::Matrix::CreateScale(Scale)
+            * DirectX::SimpleMath::Matrix::CreateFromQuaternion(Rotation)
+            * DirectX::SimpleMath::Matrix::CreateTranslation(Translation);
     }
 
     DirectX::SimpleMath::Vector3 TransformComponent::GetRotationYawPitchRoll() const
@@ -16,6 +18,6 @@ namespace Gradient::ECS::Components
 
     DirectX::SimpleMath::Vector3 TransformComponent::GetTranslation() const
     {
-        return Translation.Translation();
+        return Translation;
     }
 }
\ No newline at end of file
@@ -8,12 +8,17 @@ namespace Gradient::ECS::Components
 {
     struct TransformComponent
     {
-        DirectX::SimpleMath::Matrix Scale
-            = DirectX::SimpleMath::Matrix::Identity;
-        DirectX::SimpleMath::Matrix Rotation
-            = DirectX::SimpleMath::Matrix::Identity;
-        DirectX::SimpleMath::Matrix Translation
-            = DirectX::SimpleMath::Matrix::Identity;
+        DirectX::SimpleMath::Vector3 Translation
+            = DirectX::SimpleMath::Vector3::Zero;
+        DirectX::SimpleMath::Quaternion Rotation
+            = DirectX::SimpleMath::Quaternion::Identity;
+        DirectX::SimpleMath::Vector3 Scale
+            = DirectX::SimpleMath::Vector3::One;
+
+        // Set this after changing the fields above, so the
+        // cached world matrices of this entity and its children
+        // are recomputed.
+        bool Dirty = true;
 
         DirectX::SimpleMath::Matrix GetWorldMatrix() const;
         DirectX::SimpleMath::Vector3 GetRotationYawPitchRoll() const;
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "pch.h"
+
+#include <directxtk12/SimpleMath.h>
+
+namespace Gradient::ECS::Components
+{
+    // The cached world matrix of an entity with a TransformComponent.
+    // Kept up to date by EntityManager::UpdateTransforms.
+    struct WorldMatrixComponent
+    {
+        DirectX::SimpleMath::Matrix World
+            = DirectX::SimpleMath::Matrix::Identity;
+        // The number of ancestors. Entities are sorted by this,
+        // so parents are always updated before their children.
+        uint32_t Depth = 0;
+        // Whether World changed in the last update.
+        bool Changed = true;
+    };
+}
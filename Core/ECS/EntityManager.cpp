@@ -5,6 +5,8 @@
 #include "Core/ECS/Components/TransformComponent.h"
 #include "Core/ECS/Components/DrawableComponent.h"
 #include "Core/ECS/Components/BoundingBoxComponent.h"
+#include "Core/ECS/Components/MaterialComponent.h"
+#include "Core/ECS/Components/InstanceDataComponent.h"
 #include "Core/TextureManager.h"
 #include <directxtk12/GeometricPrimitive.h>
 #include <directxtk12/SimpleMath.h>
@@ -20,6 +22,22 @@ namespace Gradient
 
     EntityManager::EntityManager()
     {
+        Registry.on_construct<TransformComponent>()
+            .connect<&EntityManager::OnTransformConstructed>(*this);
+        Registry.on_destroy<TransformComponent>()
+            .connect<&EntityManager::OnTransformDestroyed>(*this);
+        Registry.on_construct<RelationshipComponent>()
+            .connect<&EntityManager::OnHierarchyChanged>(*this);
+        Registry.on_update<RelationshipComponent>()
+            .connect<&EntityManager::OnHierarchyChanged>(*this);
+        Registry.on_destroy<RelationshipComponent>()
+            .connect<&EntityManager::OnHierarchyChanged>(*this);
+
+        ConnectDrawableLayoutSignals<DrawableComponent>();
+        ConnectDrawableLayoutSignals<MaterialComponent>();
+        ConnectDrawableLayoutSignals<InstanceDataComponent>();
+        ConnectDrawableLayoutSignals<BoundingBoxComponent>();
+        ConnectDrawableLayoutSignals<RigidBodyComponent>();
     }
 
     void EntityManager::Initialize()
@@ -62,19 +80,178 @@ namespace Gradient
                 auto joltRotation 
                     = bodyInterface.GetRotation(rigidBody.BodyID);
 
-                transform.Rotation = Matrix::CreateFromQuaternion(
-                    Quaternion(joltRotation.GetX(),
-                        joltRotation.GetY(),
-                        joltRotation.GetZ(),
-                        joltRotation.GetW())
-                );
-                transform.Translation = Matrix::CreateTranslation(
-                    joltPosition.GetX(),
+                transform.Rotation = Quaternion(joltRotation.GetX(),
+                    joltRotation.GetY(),
+                    joltRotation.GetZ(),
+                    joltRotation.GetW());
+                transform.Translation = Vector3(joltPosition.GetX(),
                     joltPosition.GetY(),
-                    joltPosition.GetZ()
-                );
+                    joltPosition.GetZ());
+                transform.Dirty = true;
             }
         }
+
+        UpdateTransforms();
+    }
+
+    void EntityManager::UpdateTransforms()
+    {
+        if (m_hierarchyChanged)
+        {
+            auto view = Registry.view<WorldMatrixComponent>();
+            for (auto entity : view)
+            {
+                view.get<WorldMatrixComponent>(entity).Depth = ComputeDepth(entity);
+            }
+
+            Registry.sort<WorldMatrixComponent>(
+                [](const WorldMatrixComponent& lhs, const WorldMatrixComponent& rhs)
+                {
+                    return lhs.Depth < rhs.Depth;
+                });
+        }
+
+        // Parents come before their children, so whether a parent
+        // changed is already known by the time its children are reached.
+        m_transformBatch.Clear();
+        m_changedEntities.clear();
+
+        auto view = Registry.view<WorldMatrixComponent>();
+        for (auto entity : view)
+        {
+            auto& world = view.get<WorldMatrixComponent>(entity);
+            auto transform = Registry.try_get<TransformComponent>(entity);
+            if (transform == nullptr)
+            {
+                // Otherwise its children would keep seeing it as changed
+                world.Changed = false;
+                continue;
+            }
+
+            auto parentWorld = TryGetParentComponent<WorldMatrixComponent>(entity);
+
+            world.Changed = m_hierarchyChanged
+                || transform->Dirty
+                || (parentWorld != nullptr && parentWorld->Changed);
+
+            if (!world.Changed) continue;
+
+            m_transformBatch.Add(*transform);
+            m_changedEntities.push_back(entity);
+            transform->Dirty = false;
+        }
+
+        m_localMatrices.resize(m_changedEntities.size());
+        m_transformBatch.ComputeWorldMatrices(m_localMatrices);
+
+        // Still in hierarchy order, so each parent's
+        // world matrix is final before it's used.
+        for (size_t i = 0; i < m_changedEntities.size(); i++)
+        {
+            auto entity = m_changedEntities[i];
+            auto& world = Registry.get<WorldMatrixComponent>(entity);
+            world.World = m_localMatrices[i];
+
+            auto parentWorld = TryGetParentComponent<WorldMatrixComponent>(entity);
+            if (parentWorld != nullptr)
+            {
+                world.World *= parentWorld->World;
+            }
+        }
+
+        m_hierarchyChanged = false;
+    }
+
+    void EntityManager::OnTransformConstructed(entt::registry& registry, entt::entity entity)
+    {
+        registry.emplace_or_replace<WorldMatrixComponent>(entity);
+        m_hierarchyChanged = true;
+        m_drawableLayoutVersion++;
+    }
+
+    void EntityManager::OnTransformDestroyed(entt::registry& registry, entt::entity entity)
+    {
+        // Nothing would keep its world matrix up to date
+        registry.remove<WorldMatrixComponent>(entity);
+        m_hierarchyChanged = true;
+        m_drawableLayoutVersion++;
+    }
+
+    void EntityManager::OnHierarchyChanged(entt::registry&, entt::entity)
+    {
+        m_hierarchyChanged = true;
+        m_drawableLayoutVersion++;
+    }
+
+    void EntityManager::OnDrawableLayoutChanged(entt::registry&, entt::entity)
+    {
+        m_drawableLayoutVersion++;
+    }
+
+    uint64_t EntityManager::GetDrawableLayoutVersion() const
+    {
+        return m_drawableLayoutVersion;
+    }
+
+    std::span<const entt::entity> EntityManager::GetChangedEntities() const
+    {
+        return m_changedEntities;
+    }
+
+    uint32_t EntityManager::ComputeDepth(entt::entity entity) const
+    {
+        uint32_t depth = 0;
+
+        auto relationship = Registry.try_get<RelationshipComponent>(entity);
+        while (relationship != nullptr
+            && Registry.try_get<WorldMatrixComponent>(relationship->Parent) != nullptr)
+        {
+            depth++;
+            relationship = Registry.try_get<RelationshipComponent>(relationship->Parent);
+        }
+
+        return depth;
+    }
+
+    bool EntityManager::IsTransformDirty(entt::entity entity) const
+    {
+        auto current = entity;
+
+        while (true)
+        {
+            auto transform = Registry.try_get<TransformComponent>(current);
+            if (transform == nullptr) 
+                return false;
+            if (transform->Dirty) 
+                return true;
+
+            auto relationship = Registry.try_get<RelationshipComponent>(current);
+            if (relationship == nullptr) 
+                return false;
+
+            current = relationship->Parent;
+        }
+    }
+
+    DirectX::SimpleMath::Matrix EntityManager::ComputeWorldMatrix(entt::entity entity) const
+    {
+        DirectX::SimpleMath::Matrix outWorld = DirectX::SimpleMath::Matrix::Identity;
+
+        auto transform = Registry.try_get<TransformComponent>(entity);
+        if (transform == nullptr)
+        {
+            return outWorld;
+        }
+
+        outWorld = transform->GetWorldMatrix();
+
+        auto relationship = Registry.try_get<RelationshipComponent>(entity);
+        if (relationship != nullptr)
+        {
+            outWorld *= ComputeWorldMatrix(relationship->Parent);
+        }
+
+        return outWorld;
     }
 
     entt::entity EntityManager::AddEntity()
@@ -103,7 +280,8 @@ namespace Gradient
         auto& transform 
             = Registry.get<TransformComponent>(entity);
 
-        transform.Rotation = Matrix::CreateFromYawPitchRoll(yaw, pitch, roll);
+        transform.Rotation = Quaternion::CreateFromYawPitchRoll(yaw, pitch, roll);
+        transform.Dirty = true;
 
         auto pRigidBody = Registry.try_get<RigidBodyComponent>(entity);
         if (pRigidBody != nullptr
@@ -126,7 +304,8 @@ namespace Gradient
         auto& transform
             = Registry.get<TransformComponent>(entity);
 
-        transform.Translation = Matrix::CreateTranslation(offset);
+        transform.Translation = offset;
+        transform.Dirty = true;
 
         auto pRigidBody = Registry.try_get<RigidBodyComponent>(entity);
 
@@ -155,27 +334,30 @@ namespace Gradient
 
     DirectX::SimpleMath::Matrix EntityManager::GetWorldMatrix(entt::entity entity) const
     {
-        // TODO: Follow the relationship chain all the way up
-
-        DirectX::SimpleMath::Matrix outWorld = DirectX::SimpleMath::Matrix::Identity;
+        auto world = Registry.try_get<WorldMatrixComponent>(entity);
 
-        auto childTransform = Registry.try_get<TransformComponent>(entity);
-        if (childTransform)
+        if (world != nullptr
+            && !m_hierarchyChanged
+            && !IsTransformDirty(entity))
         {
-            outWorld = childTransform->GetWorldMatrix();
+            return world->World;
         }
 
-        auto parentTransform = TryGetParentComponent<TransformComponent>(entity);
+        return ComputeWorldMatrix(entity);
+    }
 
-        if (parentTransform)
+    std::optional<DirectX::BoundingBox> EntityManager::GetBoundingBox(entt::entity entity) const
+    {
+        if (!Registry.all_of<BoundingBoxComponent>(entity))
         {
-            outWorld *= parentTransform->GetWorldMatrix();
+            return std::nullopt;
         }
 
-        return outWorld;
+        return GetBoundingBox(entity, GetWorldMatrix(entity));
     }
 
-    std::optional<DirectX::BoundingBox> EntityManager::GetBoundingBox(entt::entity entity) const
+    std::optional<DirectX::BoundingBox> EntityManager::GetBoundingBox(entt::entity entity,
+        const DirectX::SimpleMath::Matrix& worldMatrix) const
     {
         auto bbComponent = Registry.try_get<BoundingBoxComponent>(entity);
 
@@ -184,8 +366,6 @@ namespace Gradient
             return std::nullopt;
         }
 
-        auto worldMatrix = GetWorldMatrix(entity);
-
         DirectX::BoundingBox out;
         bbComponent->BoundingBox.Transform(out, worldMatrix);
 
@@ -7,12 +7,15 @@
 #include <unordered_map>
 #include <set>
 #include <optional>
+#include <span>
 #include <directxtk12/SimpleMath.h>
 #include <entt/entt.hpp>
 #include "StepTimer.h"
 
 #include "Core/ECS/Components/TransformComponent.h"
 #include "Core/ECS/Components/RelationshipComponent.h"
+#include "Core/ECS/Components/WorldMatrixComponent.h"
+#include "Core/ECS/TransformBatch.h"
 
 namespace Gradient
 {
@@ -27,13 +30,31 @@ namespace Gradient
 
         void UpdateAll(DX::StepTimer const&);
 
+        // Recomputes the cached world matrices of entities whose
+        // transforms, or whose ancestors' transforms, are dirty.
+        void UpdateTransforms();
+
+        // Bumped whenever something starts or stops being drawn, changes
+        // its bounds or how it's drawn, or is reparented or given a
+        // rigid body. Anything that caches per-entity draw data can 
+        // rebuild when this changes.
+        uint64_t GetDrawableLayoutVersion() const;
+
+        // The entities whose world matrices changed
+        // in the last call to UpdateTransforms.
+        std::span<const entt::entity> GetChangedEntities() const;
+
         entt::entity AddEntity();
 
         template <typename T>
         const T* TryGetParentComponent(entt::entity entity) const;
 
+        // Returns the cached world matrix, or walks the hierarchy
+        // if it has changed since the last UpdateTransforms.
         DirectX::SimpleMath::Matrix GetWorldMatrix(entt::entity entity) const;
         std::optional<DirectX::BoundingBox> GetBoundingBox(entt::entity entity) const;
+        std::optional<DirectX::BoundingBox> GetBoundingBox(entt::entity entity,
+            const DirectX::SimpleMath::Matrix& worldMatrix) const;
         
         // Returns a bounding box that can be used to cull 
         // the object when drawing directional shadows.
@@ -54,8 +75,41 @@ namespace Gradient
     private:
         EntityManager();
         static std::unique_ptr<EntityManager> s_instance;
+
+        void OnTransformConstructed(entt::registry& registry, entt::entity entity);
+        void OnTransformDestroyed(entt::registry& registry, entt::entity entity);
+        void OnHierarchyChanged(entt::registry& registry, entt::entity entity);
+        void OnDrawableLayoutChanged(entt::registry& registry, entt::entity entity);
+
+        template <typename T>
+        void ConnectDrawableLayoutSignals();
+
+        uint32_t ComputeDepth(entt::entity entity) const;
+        DirectX::SimpleMath::Matrix ComputeWorldMatrix(entt::entity entity) const;
+        bool IsTransformDirty(entt::entity entity) const;
+
+        // Set when entities or relationships are added or removed,
+        // so that the depths are recomputed and re-sorted.
+        bool m_hierarchyChanged = true;
+        uint64_t m_drawableLayoutVersion = 0;
+
+        // Scratch space for UpdateTransforms
+        ECS::TransformBatch m_transformBatch;
+        std::vector<entt::entity> m_changedEntities;
+        std::vector<DirectX::SimpleMath::Matrix> m_localMatrices;
     };
 
+    template <typename T>
+    void EntityManager::ConnectDrawableLayoutSignals()
+    {
+        Registry.on_construct<T>()
+            .template connect<&EntityManager::OnDrawableLayoutChanged>(*this);
+        Registry.on_update<T>()
+            .template connect<&EntityManager::OnDrawableLayoutChanged>(*this);
+        Registry.on_destroy<T>()
+            .template connect<&EntityManager::OnDrawableLayoutChanged>(*this);
+    }
+
     template <typename T>
     const T* EntityManager::TryGetParentComponent(entt::entity entity) const
     {
@@ -0,0 +1,140 @@
+#include "pch.h"
+
+#include "Core/ECS/TransformBatch.h"
+
+using namespace DirectX;
+
+namespace Gradient::ECS
+{
+    namespace
+    {
+        XMVECTOR XM_CALLCONV LoadFour(const std::vector<float>& values, size_t index)
+        {
+            return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&values[index]));
+        }
+    }
+
+    void TransformBatch::Clear()
+    {
+        m_translationX.clear();
+        m_translationY.clear();
+        m_translationZ.clear();
+        m_rotationX.clear();
+        m_rotationY.clear();
+        m_rotationZ.clear();
+        m_rotationW.clear();
+        m_scaleX.clear();
+        m_scaleY.clear();
+        m_scaleZ.clear();
+    }
+
+    void TransformBatch::Reserve(size_t count)
+    {
+        m_translationX.reserve(count);
+        m_translationY.reserve(count);
+        m_translationZ.reserve(count);
+        m_rotationX.reserve(count);
+        m_rotationY.reserve(count);
+        m_rotationZ.reserve(count);
+        m_rotationW.reserve(count);
+        m_scaleX.reserve(count);
+        m_scaleY.reserve(count);
+        m_scaleZ.reserve(count);
+    }
+
+    void TransformBatch::Add(const Components::TransformComponent& transform)
+    {
+        m_translationX.push_back(transform.Translation.x);
+        m_translationY.push_back(transform.Translation.y);
+        m_translationZ.push_back(transform.Translation.z);
+        m_rotationX.push_back(transform.Rotation.x);
+        m_rotationY.push_back(transform.Rotation.y);
+        m_rotationZ.push_back(transform.Rotation.z);
+        m_rotationW.push_back(transform.Rotation.w);
+        m_scaleX.push_back(transform.Scale.x);
+        m_scaleY.push_back(transform.Scale.y);
+        m_scaleZ.push_back(transform.Scale.z);
+    }
+
+    size_t TransformBatch::Size() const
+    {
+        return m_translationX.size();
+    }
+
+    void TransformBatch::ComputeWorldMatrices(std::span<SimpleMath::Matrix> out) const
+    {
+        assert(out.size() >= Size());
+
+        const size_t count = Size();
+        const XMVECTOR zero = XMVectorZero();
+        const XMVECTOR one = XMVectorSplatOne();
+
+        size_t i = 0;
+
+        // Each vector holds the same quantity for four transforms.
+        for (; i + 4 <= count; i += 4)
+        {
+            XMVECTOR qx = LoadFour(m_rotationX, i);
+            XMVECTOR qy = LoadFour(m_rotationY, i);
+            XMVECTOR qz = LoadFour(m_rotationZ, i);
+            XMVECTOR qw = LoadFour(m_rotationW, i);
+
+            XMVECTOR x2 = XMVectorAdd(qx, qx);
+            XMVECTOR y2 = XMVectorAdd(qy, qy);
+            XMVECTOR z2 = XMVectorAdd(qz, qz);
+
+            XMVECTOR xx = XMVectorMultiply(qx, x2);
+            XMVECTOR yy = XMVectorMultiply(qy, y2);
+            XMVECTOR zz = XMVectorMultiply(qz, z2);
+            XMVECTOR xy = XMVectorMultiply(qx, y2);
+            XMVECTOR xz = XMVectorMultiply(qx, z2);
+            XMVECTOR yz = XMVectorMultiply(qy, z2);
+            XMVECTOR wx = XMVectorMultiply(qw, x2);
+            XMVECTOR wy = XMVectorMultiply(qw, y2);
+            XMVECTOR wz = XMVectorMultiply(qw, z2);
+
+            // The same rotation matrix as XMMatrixRotationQuaternion,
+            // with each row scaled by the matching scale component.
+            XMVECTOR sx = LoadFour(m_scaleX, i);
+            XMVECTOR sy = LoadFour(m_scaleY, i);
+            XMVECTOR sz = LoadFour(m_scaleZ, i);
+
+            XMVECTOR m00 = XMVectorMultiply(XMVectorSubtract(one, XMVectorAdd(yy, zz)), sx);
+            XMVECTOR m01 = XMVectorMultiply(XMVectorAdd(xy, wz), sx);
+            XMVECTOR m02 = XMVectorMultiply(XMVectorSubtract(xz, wy), sx);
+
+            XMVECTOR m10 = XMVectorMultiply(XMVectorSubtract(xy, wz), sy);
+            XMVECTOR m11 = XMVectorMultiply(XMVectorSubtract(one, XMVectorAdd(xx, zz)), sy);
+            XMVECTOR m12 = XMVectorMultiply(XMVectorAdd(yz, wx), sy);
+
+            XMVECTOR m20 = XMVectorMultiply(XMVectorAdd(xz, wy), sz);
+            XMVECTOR m21 = XMVectorMultiply(XMVectorSubtract(yz, wx), sz);
+            XMVECTOR m22 = XMVectorMultiply(XMVectorSubtract(one, XMVectorAdd(xx, yy)), sz);
+
+            // Transposing turns "one element of four matrices"
+            // into "one row of each matrix".
+            XMMATRIX rows0 = XMMatrixTranspose(XMMATRIX(m00, m01, m02, zero));
+            XMMATRIX rows1 = XMMatrixTranspose(XMMATRIX(m10, m11, m12, zero));
+            XMMATRIX rows2 = XMMatrixTranspose(XMMATRIX(m20, m21, m22, zero));
+            XMMATRIX rows3 = XMMatrixTranspose(XMMATRIX(
+                LoadFour(m_translationX, i),
+                LoadFour(m_translationY, i),
+                LoadFour(m_translationZ, i),
+                one));
+
+            for (size_t j = 0; j < 4; j++)
+            {
+                XMStoreFloat4x4(&out[i + j],
+                    XMMATRIX(rows0.r[j], rows1.r[j], rows2.r[j], rows3.r[j]));
+            }
+        }
+
+        for (; i < count; i++)
+        {
+            out[i] = SimpleMath::Matrix::CreateScale(m_scaleX[i], m_scaleY[i], m_scaleZ[i])
+                * SimpleMath::Matrix::CreateFromQuaternion(
+                    SimpleMath::Quaternion(m_rotationX[i], m_rotationY[i], m_rotationZ[i], m_rotationW[i]))
+                * SimpleMath::Matrix::CreateTranslation(m_translationX[i], m_translationY[i], m_translationZ[i]);
+        }
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "pch.h"
+
+#include <span>
+#include <vector>
+#include <directxtk12/SimpleMath.h>
+
+#include "Core/ECS/Components/TransformComponent.h"
+
+namespace Gradient::ECS
+{
+    // Transforms gathered into structure-of-arrays form, so
+    // that their world matrices can be computed four at a time.
+    class TransformBatch
+    {
+    public:
+        void Clear();
+        void Reserve(size_t count);
+        void Add(const Components::TransformComponent& transform);
+
+        size_t Size() const;
+
+        // Computes Scale * Rotation * Translation for each transform,
+        // in the order they were added. out must hold Size() matrices.
+        void ComputeWorldMatrices(std::span<DirectX::SimpleMath::Matrix> out) const;
+
+    private:
+        std::vector<float> m_translationX;
+        std::vector<float> m_translationY;
+        std::vector<float> m_translationZ;
+        std::vector<float> m_rotationX;
+        std::vector<float> m_rotationY;
+        std::vector<float> m_rotationZ;
+        std::vector<float> m_rotationW;
+        std::vector<float> m_scaleX;
+        std::vector<float> m_scaleY;
+        std::vector<float> m_scaleZ;
+    };
+}
@@ -0,0 +1,128 @@
+#include "pch.h"
+
+#include "Core/FrameArena.h"
+
+#include <algorithm>
+#include <mutex>
+
+namespace Gradient
+{
+    namespace
+    {
+        std::mutex s_arenasMutex;
+        std::vector<FrameArena*> s_arenas;
+        std::atomic<uint64_t> s_heapAllocationCount = 0;
+
+        thread_local std::unique_ptr<FrameArena> t_arena;
+
+        size_t AlignUp(size_t value, size_t alignment)
+        {
+            return (value + alignment - 1) & ~(alignment - 1);
+        }
+    }
+
+    FrameArena::FrameArena(size_t blockSize)
+        : m_blockSize(blockSize)
+    {
+        std::scoped_lock lock(s_arenasMutex);
+        s_arenas.push_back(this);
+    }
+
+    FrameArena::~FrameArena()
+    {
+        std::scoped_lock lock(s_arenasMutex);
+        std::erase(s_arenas, this);
+    }
+
+    FrameArena& FrameArena::Get()
+    {
+        if (t_arena == nullptr)
+        {
+            t_arena = std::make_unique<FrameArena>();
+        }
+
+        return *t_arena;
+    }
+
+    void FrameArena::ResetAll()
+    {
+        std::scoped_lock lock(s_arenasMutex);
+        for (auto arena : s_arenas)
+        {
+            arena->Reset();
+        }
+    }
+
+    uint64_t FrameArena::GetHeapAllocationCount()
+    {
+        return s_heapAllocationCount.load(std::memory_order_relaxed);
+    }
+
+    size_t FrameArena::GetTotalBytesUsed()
+    {
+        std::scoped_lock lock(s_arenasMutex);
+
+        size_t total = 0;
+        for (auto arena : s_arenas)
+        {
+            total += arena->GetBytesUsed();
+        }
+        return total;
+    }
+
+    void* FrameArena::Allocate(size_t size, size_t alignment)
+    {
+        assert((alignment & (alignment - 1)) == 0);
+
+        // Move on through the blocks kept from earlier frames,
+        // and only go to the heap once they've run out.
+        while (m_currentBlock < m_blocks.size())
+        {
+            auto& block = m_blocks[m_currentBlock];
+            auto address = reinterpret_cast<uintptr_t>(block.Data.get());
+            size_t start = AlignUp(address + m_offset, alignment) - address;
+
+            if (start + size <= block.Size)
+            {
+                m_offset = start + size;
+                m_bytesUsed.fetch_add(size, std::memory_order_relaxed);
+                return block.Data.get() + start;
+            }
+
+            m_currentBlock++;
+            m_offset = 0;
+        }
+
+        // Anything bigger than a block gets a block to itself
+        size_t blockSize = std::max(m_blockSize, size + alignment);
+        m_blocks.push_back({ std::make_unique_for_overwrite<std::byte[]>(blockSize), blockSize });
+        s_heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+
+        m_currentBlock = m_blocks.size() - 1;
+        m_offset = 0;
+
+        return Allocate(size, alignment);
+    }
+
+    void FrameArena::Reset()
+    {
+        m_currentBlock = 0;
+        m_offset = 0;
+        m_bytesUsed.store(0, std::memory_order_relaxed);
+    }
+
+    size_t FrameArena::GetBytesUsed() const
+    {
+        return m_bytesUsed.load(std::memory_order_relaxed);
+    }
+
+    size_t FrameArena::GetCapacity() const
+    {
+        size_t capacity = 0;
+        for (const auto& block : m_blocks)
+        {
+            capacity += block.Size;
+        }
+        return capacity;
+    }
+}
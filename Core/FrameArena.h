@@ -0,0 +1,122 @@
+#pragma once
+
+#include "pch.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace Gradient
+{
+    // A bump allocator for data that only lives for one frame. Each 
+    // thread has its own, so allocating never takes a lock, and freeing
+    // does nothing. ResetAll releases everything at once at the end of
+    // the frame.
+    //
+    // Blocks are kept between frames, so once the arenas have grown to
+    // fit a frame they stop allocating from the heap. Nothing allocated
+    // from an arena may outlive the frame, so containers using 
+    // FrameAllocator should only ever be locals.
+    class FrameArena
+    {
+    public:
+        static constexpr size_t DefaultBlockSize = 1 << 20;
+
+        explicit FrameArena(size_t blockSize = DefaultBlockSize);
+        ~FrameArena();
+
+        FrameArena(const FrameArena&) = delete;
+        FrameArena& operator=(const FrameArena&) = delete;
+
+        // The calling thread's arena, created on first use.
+        static FrameArena& Get();
+
+        // Resets every thread's arena. This must only be called
+        // between frames, when no thread holds any frame memory.
+        static void ResetAll();
+
+        // The number of heap blocks allocated by every arena. This 
+        // stops growing once the arenas are big enough for a frame.
+        static uint64_t GetHeapAllocationCount();
+        // The bytes handed out by every arena since the last reset.
+        static size_t GetTotalBytesUsed();
+
+        void* Allocate(size_t size, size_t alignment);
+
+        template <typename T>
+        T* Allocate(size_t count)
+        {
+            return static_cast<T*>(Allocate(count * sizeof(T), alignof(T)));
+        }
+
+        void Reset();
+
+        size_t GetBytesUsed() const;
+        size_t GetCapacity() const;
+
+    private:
+        struct Block
+        {
+            std::unique_ptr<std::byte[]> Data;
+            size_t Size;
+        };
+
+        std::vector<Block> m_blocks;
+        size_t m_blockSize;
+        size_t m_currentBlock = 0;
+        size_t m_offset = 0;
+        // Written by the owning thread, read when showing stats
+        std::atomic<size_t> m_bytesUsed = 0;
+    };
+
+    // Lets standard containers allocate from a frame arena. 
+    // The arena is the one belonging to the thread that 
+    // constructed the allocator.
+    template <typename T>
+    class FrameAllocator
+    {
+    public:
+        using value_type = T;
+
+        FrameAllocator() noexcept
+            : m_arena(&FrameArena::Get())
+        {
+        }
+
+        explicit FrameAllocator(FrameArena& arena) noexcept
+            : m_arena(&arena)
+        {
+        }
+
+        template <typename U>
+        FrameAllocator(const FrameAllocator<U>& other) noexcept
+            : m_arena(other.m_arena)
+        {
+        }
+
+        T* allocate(size_t count)
+        {
+            return m_arena->Allocate<T>(count);
+        }
+
+        void deallocate(T*, size_t) noexcept
+        {
+            // Freed when the arena is reset
+        }
+
+        template <typename U>
+        bool operator==(const FrameAllocator<U>& other) const noexcept
+        {
+            return m_arena == other.m_arena;
+        }
+
+    private:
+        template <typename U>
+        friend class FrameAllocator;
+
+        FrameArena* m_arena;
+    };
+
+    template <typename T>
+    using FrameVector = std::vector<T, FrameAllocator<T>>;
+}
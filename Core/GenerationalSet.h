@@ -0,0 +1,56 @@
+#pragma once
+
+#include "pch.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace Gradient
+{
+    // A set of small, dense keys, like entity indices, that's cleared in
+    // constant time. Each key's slot holds the generation it was last
+    // inserted in, so clearing just starts a new generation.
+    class GenerationalSet
+    {
+    public:
+        void Reserve(size_t numKeys)
+        {
+            if (numKeys > m_generations.size())
+            {
+                m_generations.resize(numKeys, 0);
+            }
+        }
+
+        void Clear()
+        {
+            m_generation++;
+
+            if (m_generation == 0)
+            {
+                // Wrapped around, so old slots could look current
+                std::fill(m_generations.begin(), m_generations.end(), 0);
+                m_generation = 1;
+            }
+        }
+
+        void Insert(uint32_t key)
+        {
+            if (key >= m_generations.size())
+            {
+                Reserve(std::max<size_t>(key + 1, m_generations.size() * 2));
+            }
+
+            m_generations[key] = m_generation;
+        }
+
+        bool Contains(uint32_t key) const
+        {
+            return key < m_generations.size()
+                && m_generations[key] == m_generation;
+        }
+
+    private:
+        std::vector<uint32_t> m_generations;
+        uint32_t m_generation = 1;
+    };
+}
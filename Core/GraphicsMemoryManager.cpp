@@ -10,64 +10,71 @@ namespace Gradient
     {
         m_graphicsMemory = std::make_unique<DirectX::GraphicsMemory>(device);
 
+        // Only used for their heaps, since the
+        // indices are handed out by the allocators.
         m_srvDescriptors = std::make_unique<DirectX::DescriptorPile>(device,
-            256);
+            SrvCapacity);
         m_rtvDescriptors = std::make_unique<DirectX::DescriptorPile>(device,
             D3D12_DESCRIPTOR_HEAP_TYPE_RTV,
             D3D12_DESCRIPTOR_HEAP_FLAG_NONE,
-            64);
+            RtvCapacity);
         m_dsvDescriptors = std::make_unique<DirectX::DescriptorPile>(device,
             D3D12_DESCRIPTOR_HEAP_TYPE_DSV,
             D3D12_DESCRIPTOR_HEAP_FLAG_NONE,
-            64);
+            DsvCapacity);
+
+        DX::ThrowIfFailed(
+            device->CreateFence(0,
+                D3D12_FENCE_FLAG_NONE,
+                IID_PPV_ARGS(m_fence.ReleaseAndGetAddressOf())));
+        m_fence->SetName(L"Descriptor release fence");
+
+        // Cleared every frame, but keeps its capacity, so this
+        // only grows while the scene is warming up.
+        m_frameGraphicsResources.reserve(4096);
     }
 
     void GraphicsMemoryManager::Commit(ID3D12CommandQueue* cq)
     {
         m_frameGraphicsResources.clear();
         m_graphicsMemory->Commit(cq);
-    }
 
-    GraphicsMemoryManager::DescriptorIndex GraphicsMemoryManager::AllocateSrvOrUav()
-    {
-        if (!m_freeSrvIndices.empty())
-        {
-            auto index_it = m_freeSrvIndices.begin();
-            auto index = *index_it;
-            m_freeSrvIndices.erase(index_it);
-            TrackCpuDescriptorHandle(index);
-            return index;
-        }
+        // Anything freed from here on waits for the next signal
+        auto fenceValue = m_fenceValue.fetch_add(1) + 1;
+        DX::ThrowIfFailed(cq->Signal(m_fence.Get(), fenceValue));
 
-        auto index = m_srvDescriptors->Allocate();
-        TrackCpuDescriptorHandle(index);
-        return index;
+        m_srvIndices.Reclaim(m_fence->GetCompletedValue());
     }
 
-    void GraphicsMemoryManager::TrackCpuDescriptorHandle(DescriptorIndex index)
+    uint64_t GraphicsMemoryManager::GetReleaseFenceValue() const
     {
-        auto cpuHandle = m_srvDescriptors->GetCpuHandle(index);
-        m_cpuHandleToSrvIndex.insert({ cpuHandle, index });
+        return m_fenceValue.load() + 1;
     }
 
-    void GraphicsMemoryManager::UntrackCpuDescriptorHandle(DescriptorIndex index)
+    GraphicsMemoryManager::DescriptorIndex GraphicsMemoryManager::AllocateSrvOrUav()
     {
-        auto cpuHandle = m_srvDescriptors->GetCpuHandle(index);
-        m_cpuHandleToSrvIndex.erase(cpuHandle);
+        return m_srvIndices.Allocate();
     }
 
     void GraphicsMemoryManager::FreeSrvOrUav(GraphicsMemoryManager::DescriptorIndex index)
     {
-        UntrackCpuDescriptorHandle(index);
-        m_freeSrvIndices.insert(index);
+        m_srvIndices.FreeAfter(static_cast<uint32_t>(index), GetReleaseFenceValue());
     }
 
     void GraphicsMemoryManager::FreeSrvByCpuHandle(D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle)
     {
-        if (auto it = m_cpuHandleToSrvIndex.find(cpuHandle); it != m_cpuHandleToSrvIndex.end())
-        {
-            FreeSrvOrUav(it->second);
-        }
+        // Handles are evenly spaced from the start of the heap,
+        // so anything else didn't come from this one.
+        const auto first = m_srvDescriptors->GetFirstCpuHandle().ptr;
+        const auto increment = m_srvDescriptors->Increment();
+        const bool isInHeap = cpuHandle.ptr >= first
+            && (cpuHandle.ptr - first) % increment == 0
+            && (cpuHandle.ptr - first) / increment < SrvCapacity;
+
+        assert(isInHeap && "Freed a handle from another descriptor heap");
+        if (!isInHeap) return;
+
+        FreeSrvOrUav(static_cast<DescriptorIndex>((cpuHandle.ptr - first) / increment));
     }
 
     GraphicsMemoryManager::DescriptorView GraphicsMemoryManager::CreateSRV(
@@ -115,20 +122,12 @@ namespace Gradient
 
     GraphicsMemoryManager::DescriptorIndex GraphicsMemoryManager::AllocateRTV()
     {
-        if (!m_freeRTVIndices.empty())
-        {
-            auto index_it = m_freeRTVIndices.begin();
-            auto index = *index_it;
-            m_freeRTVIndices.erase(index_it);
-            return index;
-        }
-
-        return m_rtvDescriptors->Allocate();
+        return m_rtvIndices.Allocate();
     }
 
     void GraphicsMemoryManager::FreeRTV(DescriptorIndex index)
     {
-        m_freeRTVIndices.insert(index);
+        m_rtvIndices.Free(static_cast<uint32_t>(index));
     }
 
     GraphicsMemoryManager::DescriptorView GraphicsMemoryManager::CreateRTV(
@@ -169,20 +168,12 @@ namespace Gradient
 
     GraphicsMemoryManager::DescriptorIndex GraphicsMemoryManager::AllocateDSV()
     {
-        if (!m_freeDSVIndices.empty())
-        {
-            auto index_it = m_freeDSVIndices.begin();
-            auto index = *index_it;
-            m_freeDSVIndices.erase(index_it);
-            return index;
-        }
-
-        return m_dsvDescriptors->Allocate();
+        return m_dsvIndices.Allocate();
     }
 
     void GraphicsMemoryManager::FreeDSV(DescriptorIndex index)
     {
-        m_freeDSVIndices.insert(index);
+        m_dsvIndices.Free(static_cast<uint32_t>(index));
     }
 
     GraphicsMemoryManager::DescriptorView GraphicsMemoryManager::CreateDSV(
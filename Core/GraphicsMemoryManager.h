@@ -2,21 +2,36 @@
 
 #include "pch.h"
 
-#include <set>
-#include <map>
+#include "Core/DescriptorAllocator.h"
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <span>
+#include <type_traits>
 #include <directxtk12/DescriptorHeap.h>
 #include <directxtk12/DirectXHelpers.h>
 
 namespace Gradient
 {
-    // Manages resources and descriptors. Not currently thread-safe.
+    // Manages resources and descriptors. Everything here can be used
+    // from any thread, apart from Commit.
+    //
+    // Freed SRVs and UAVs aren't reused until the GPU has finished the
+    // frame they were freed in, so a view can be dropped while a command
+    // list that uses it is still in flight. RTVs and DSVs are reused
+    // straight away, since they're copied into the command list when
+    // it's recorded and the GPU never reads the heap.
     class GraphicsMemoryManager
     {
     public:
-        // TODO: Make these things free themselves.
-        // The descriptor heap runs out of space whenever the 
-        // window is resized because the old descriptors are 
-        // never reclaimed.
+        static constexpr uint32_t SrvCapacity = 256;
+        static constexpr uint32_t RtvCapacity = 64;
+        // The shadow maps need most of these, and Renderer checks
+        // that they fit. DSVs are never shader visible, so spare
+        // ones cost next to nothing.
+        static constexpr uint32_t DsvCapacity = 256;
+
         using DescriptorIndex = DirectX::DescriptorPile::IndexType;
 
         enum class DescriptorIndexType
@@ -50,7 +65,13 @@ namespace Gradient
 
         template <typename T>
         inline D3D12_GPU_VIRTUAL_ADDRESS AllocateConstant(const T& data);
+        // Copies data into upload memory that lasts until the 
+        // frame is done, such as for a structured buffer.
+        template <typename T>
+        inline D3D12_GPU_VIRTUAL_ADDRESS AllocateArray(std::span<const T> data);
 
+        // Ends the frame, and reclaims the descriptors
+        // freed in frames the GPU has finished.
         void Commit(ID3D12CommandQueue* cq);
 
 
@@ -119,8 +140,9 @@ namespace Gradient
 
     private:
         GraphicsMemoryManager(ID3D12Device* device);
-        void TrackCpuDescriptorHandle(DescriptorIndex index);
-        void UntrackCpuDescriptorHandle(DescriptorIndex index);
+        // The fence value the GPU will have passed
+        // once it's done with everything submitted so far
+        uint64_t GetReleaseFenceValue() const;
 
         static std::unique_ptr<GraphicsMemoryManager> s_instance;
 
@@ -129,40 +151,42 @@ namespace Gradient
         std::unique_ptr<DirectX::DescriptorPile> m_rtvDescriptors;
         std::unique_ptr<DirectX::DescriptorPile> m_dsvDescriptors;
 
-        std::set<DescriptorIndex> m_freeSrvIndices;
-        std::set<DescriptorIndex> m_freeRTVIndices;
-        std::set<DescriptorIndex> m_freeDSVIndices;
-
-        std::vector<DirectX::GraphicsResource> m_frameGraphicsResources;
-
-        struct DescriptorHandleHash
-        {
-            std::size_t operator()(const D3D12_CPU_DESCRIPTOR_HANDLE& h) const noexcept
-            {
-                return std::hash<SIZE_T>{}(h.ptr);
-            }
-        };
+        DescriptorAllocator m_srvIndices{ SrvCapacity };
+        DescriptorAllocator m_rtvIndices{ RtvCapacity };
+        DescriptorAllocator m_dsvIndices{ DsvCapacity };
 
-        struct DescriptorHandleEqual
-        {
-            constexpr bool operator()(const D3D12_CPU_DESCRIPTOR_HANDLE& l,
-                const D3D12_CPU_DESCRIPTOR_HANDLE& r) const
-            {
-                return l.ptr == r.ptr;
-            }
-        };
+        // Signalled at the end of every frame
+        Microsoft::WRL::ComPtr<ID3D12Fence> m_fence;
+        std::atomic<uint64_t> m_fenceValue = 0;
 
-        std::unordered_map<D3D12_CPU_DESCRIPTOR_HANDLE, 
-            DescriptorIndex, 
-            DescriptorHandleHash,
-            DescriptorHandleEqual> 
-            m_cpuHandleToSrvIndex;
+        // Draws are recorded on several threads at once
+        std::mutex m_frameResourcesMutex;
+        std::vector<DirectX::GraphicsResource> m_frameGraphicsResources;
     };
 
     template <typename T>
     inline D3D12_GPU_VIRTUAL_ADDRESS GraphicsMemoryManager::AllocateConstant(const T& data)
     {
-        m_frameGraphicsResources.push_back(m_graphicsMemory->AllocateConstant(data));
-        return m_frameGraphicsResources.back().GpuAddress();
+        auto resource = m_graphicsMemory->AllocateConstant(data);
+        auto address = resource.GpuAddress();
+
+        std::lock_guard lock(m_frameResourcesMutex);
+        m_frameGraphicsResources.push_back(std::move(resource));
+        return address;
+    }
+
+    template <typename T>
+    inline D3D12_GPU_VIRTUAL_ADDRESS GraphicsMemoryManager::AllocateArray(std::span<const T> data)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+
+        auto resource = m_graphicsMemory->Allocate(data.size_bytes(), 16);
+        std::memcpy(resource.Memory(), data.data(), data.size_bytes());
+
+        auto address = resource.GpuAddress();
+
+        std::lock_guard lock(m_frameResourcesMutex);
+        m_frameGraphicsResources.push_back(std::move(resource));
+        return address;
     }
 }
\ No newline at end of file
@@ -0,0 +1,116 @@
+#include "Core/HeapAllocations.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    std::atomic<uint64_t> s_count = 0;
+
+    void* Allocate(std::size_t size)
+    {
+        s_count.fetch_add(1, std::memory_order_relaxed);
+
+        // malloc may return null for a size of zero, but new mustn't
+        if (auto memory = std::malloc(size == 0 ? 1 : size))
+            return memory;
+
+        throw std::bad_alloc();
+    }
+
+    void* AllocateAligned(std::size_t size, std::align_val_t alignment)
+    {
+        s_count.fetch_add(1, std::memory_order_relaxed);
+
+        const auto align = static_cast<std::size_t>(alignment);
+#ifdef _MSC_VER
+        auto memory = _aligned_malloc(size == 0 ? 1 : size, align);
+#else
+        // aligned_alloc wants the size to be a multiple of the alignment
+        auto memory = std::aligned_alloc(align, ((size == 0 ? 1 : size) + align - 1) & ~(align - 1));
+#endif
+        if (memory)
+            return memory;
+
+        throw std::bad_alloc();
+    }
+
+    void FreeAligned(void* memory)
+    {
+#ifdef _MSC_VER
+        _aligned_free(memory);
+#else
+        std::free(memory);
+#endif
+    }
+}
+
+namespace Gradient::HeapAllocations
+{
+    uint64_t GetCount()
+    {
+        return s_count.load(std::memory_order_relaxed);
+    }
+}
+
+// The nothrow forms call these, so they're counted too
+void* operator new(std::size_t size)
+{
+    return Allocate(size);
+}
+
+void* operator new[](std::size_t size)
+{
+    return Allocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    return AllocateAligned(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return AllocateAligned(size, alignment);
+}
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept
+{
+    FreeAligned(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t) noexcept
+{
+    FreeAligned(memory);
+}
+
+void operator delete(void* memory, std::size_t, std::align_val_t) noexcept
+{
+    FreeAligned(memory);
+}
+
+void operator delete[](void* memory, std::size_t, std::align_val_t) noexcept
+{
+    FreeAligned(memory);
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+
+// Nothing here touches D3D12 or the precompiled header, so the
+// counter can be built into the portable tests as well.
+namespace Gradient::HeapAllocations
+{
+    // The number of allocations made through the global operator new,
+    // on every thread, since the program started. HeapAllocations.cpp
+    // replaces operator new to count them, so the difference between
+    // two calls is every heap allocation made in between.
+    uint64_t GetCount();
+}
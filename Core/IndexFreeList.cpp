@@ -0,0 +1,103 @@
+#include "Core/IndexFreeList.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace Gradient
+{
+    namespace
+    {
+        // The index goes in the low half and the count in the high half
+        uint64_t PackHead(uint32_t index, uint32_t count)
+        {
+            return (static_cast<uint64_t>(count) << 32) | index;
+        }
+
+        uint32_t GetHeadIndex(uint64_t head)
+        {
+            return static_cast<uint32_t>(head);
+        }
+
+        uint32_t GetHeadCount(uint64_t head)
+        {
+            return static_cast<uint32_t>(head >> 32);
+        }
+    }
+
+    IndexFreeList::IndexFreeList(uint32_t capacity)
+        : m_capacity(capacity),
+        m_next(std::make_unique<std::atomic<uint32_t>[]>(capacity)),
+        m_head(PackHead(InvalidIndex, 0))
+    {
+    }
+
+    bool IndexFreeList::TryAllocate(uint32_t& index)
+    {
+        if (TryPop(index))
+            return true;
+
+        index = m_untouched.load(std::memory_order_relaxed);
+        while (index < m_capacity
+            && !m_untouched.compare_exchange_weak(index, index + 1,
+                std::memory_order_relaxed))
+        {
+        }
+
+        // Something may have been freed while the untouched ones ran out
+        if (index >= m_capacity && !TryPop(index))
+        {
+            index = InvalidIndex;
+            return false;
+        }
+
+        return true;
+    }
+
+    void IndexFreeList::Free(uint32_t index)
+    {
+        assert(index < m_capacity);
+
+        auto oldHead = m_head.load(std::memory_order_relaxed);
+        uint64_t newHead;
+        do
+        {
+            m_next[index].store(GetHeadIndex(oldHead), std::memory_order_relaxed);
+            newHead = PackHead(index, GetHeadCount(oldHead) + 1);
+        } while (!m_head.compare_exchange_weak(oldHead, newHead,
+            std::memory_order_release,
+            std::memory_order_relaxed));
+    }
+
+    uint32_t IndexFreeList::GetCapacity() const
+    {
+        return m_capacity;
+    }
+
+    uint32_t IndexFreeList::GetHighWaterMark() const
+    {
+        return std::min(m_untouched.load(std::memory_order_relaxed), m_capacity);
+    }
+
+    bool IndexFreeList::TryPop(uint32_t& index)
+    {
+        auto oldHead = m_head.load(std::memory_order_acquire);
+        uint64_t newHead;
+        do
+        {
+            index = GetHeadIndex(oldHead);
+            if (index == InvalidIndex)
+            {
+                return false;
+            }
+
+            // This might already be stale, in which case the count
+            // won't match and the exchange will go round again.
+            auto next = m_next[index].load(std::memory_order_relaxed);
+            newHead = PackHead(next, GetHeadCount(oldHead) + 1);
+        } while (!m_head.compare_exchange_weak(oldHead, newHead,
+            std::memory_order_acquire,
+            std::memory_order_acquire));
+
+        return true;
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+// Nothing here touches D3D12, so the list
+// can be built and checked on any platform.
+namespace Gradient
+{
+    // Hands out indices into a fixed size array. Any number of threads
+    // can allocate and free at once without taking a lock, and both take
+    // constant time, apart from retries when threads collide.
+    //
+    // Free indices are kept on a stack threaded through an array of next
+    // indices. The head carries a count that changes on every push and pop,
+    // so a thread holding a stale head can't swap it back in after the
+    // same index has been popped and pushed again in the meantime.
+    //
+    // DescriptorAllocator hands out descriptor heap slots with one,
+    // and the job system keeps its pool of jobs with another.
+    class IndexFreeList
+    {
+    public:
+        static constexpr uint32_t InvalidIndex = UINT32_MAX;
+
+        explicit IndexFreeList(uint32_t capacity);
+
+        // Returns false, and sets index to InvalidIndex, if every index is in use
+        bool TryAllocate(uint32_t& index);
+        // The index can be handed out again straight away
+        void Free(uint32_t index);
+
+        uint32_t GetCapacity() const;
+        // How many indices have ever been handed out
+        uint32_t GetHighWaterMark() const;
+
+    private:
+        bool TryPop(uint32_t& index);
+
+        uint32_t m_capacity;
+        std::unique_ptr<std::atomic<uint32_t>[]> m_next;
+
+        std::atomic<uint64_t> m_head;
+        // Indices from here on have never been handed out
+        std::atomic<uint32_t> m_untouched = 0;
+    };
+}
@@ -0,0 +1,376 @@
+#include "Core/Jobs/JobSystem.h"
+
+#include <utility>
+
+namespace Gradient::Jobs
+{
+    std::unique_ptr<JobSystem> JobSystem::s_instance;
+
+    namespace
+    {
+        thread_local const JobSystem* t_jobSystem = nullptr;
+        thread_local int t_workerIndex = -1;
+        // Workers are given theirs. Other threads are seeded the first
+        // time they steal, so they don't all pick the same victims.
+        thread_local uint32_t t_randomState = 0;
+        std::atomic<uint32_t> s_nextSeed = 1;
+
+        // A different seed for every thread that steals
+        uint32_t NextSeed()
+        {
+            // xorshift gets stuck at zero, so the seed never is
+            return (s_nextSeed.fetch_add(1, std::memory_order_relaxed) * 0x9E3779B9u) | 1;
+        }
+
+        uint32_t NextRandom(uint32_t& state)
+        {
+            // xorshift32
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            return state;
+        }
+    }
+
+    JobSystem::JobSystem(uint32_t numWorkers)
+        : m_jobPool(std::make_unique<Job[]>(JobPoolCapacity)),
+        m_freeJobs(JobPoolCapacity)
+    {
+        if (numWorkers == 0)
+        {
+            numWorkers = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+        }
+
+        // Every worker has to exist before any of them
+        // starts looking for something to steal.
+        m_workers.reserve(numWorkers);
+        for (uint32_t i = 0; i < numWorkers; i++)
+        {
+            m_workers.push_back(std::make_unique<Worker>());
+            m_workers.back()->RandomState = NextSeed();
+        }
+
+        for (uint32_t i = 0; i < numWorkers; i++)
+        {
+            m_workers[i]->Thread = std::thread([this, i]()
+                {
+                    WorkerLoop(i);
+                });
+        }
+    }
+
+    JobSystem::~JobSystem()
+    {
+        {
+            std::scoped_lock lock(m_sleepMutex);
+            m_stopping.store(true);
+        }
+        m_wakeCondition.notify_all();
+
+        for (auto& worker : m_workers)
+        {
+            worker->Thread.join();
+        }
+    }
+
+    void JobSystem::Initialize(uint32_t numWorkers)
+    {
+        s_instance = std::make_unique<JobSystem>(numWorkers);
+    }
+
+    void JobSystem::Shutdown()
+    {
+        s_instance.reset();
+    }
+
+    JobSystem* JobSystem::Get()
+    {
+        return s_instance.get();
+    }
+
+    void JobSystem::Submit(std::function<void()> fn,
+        JobCounter* counter,
+        JobPriority priority)
+    {
+        auto job = CreateJob(std::move(fn), counter);
+
+        if (counter != nullptr)
+        {
+            counter->m_count.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // Counted before it can be found, so that a thread taking
+        // it straight away never brings the count below zero.
+        m_numQueued.fetch_add(1);
+
+        const auto priorityIndex = static_cast<size_t>(priority);
+        const int workerIndex = GetWorkerIndex();
+
+        if (workerIndex < 0
+            || !m_workers[workerIndex]->Deques[priorityIndex].Push(job))
+        {
+            std::scoped_lock lock(m_sharedQueueMutex);
+            auto& queue = m_sharedQueues[priorityIndex];
+
+            if (queue.Tail != nullptr)
+            {
+                queue.Tail->Next = job;
+            }
+            else
+            {
+                queue.Head = job;
+            }
+            queue.Tail = job;
+            m_numShared.fetch_add(1);
+        }
+
+        WakeWorkers(1);
+    }
+
+    void JobSystem::Wait(JobCounter& counter)
+    {
+        WaitUntilDone(counter);
+
+        // Cleared as it's rethrown, so the counter can be used again
+        if (counter.m_failed.load(std::memory_order_relaxed))
+        {
+            auto exception = std::exchange(counter.m_exception, nullptr);
+            counter.m_failed.store(false, std::memory_order_relaxed);
+            std::rethrow_exception(exception);
+        }
+    }
+
+    void JobSystem::WaitUntilDone(JobCounter& counter)
+    {
+        const int workerIndex = GetWorkerIndex();
+
+        while (!counter.IsDone())
+        {
+            if (auto job = FindJob(workerIndex))
+            {
+                Execute(job);
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    uint32_t JobSystem::GetWorkerCount() const
+    {
+        return static_cast<uint32_t>(m_workers.size());
+    }
+
+    uint32_t JobSystem::GetMaxConcurrency() const
+    {
+        return GetWorkerCount() + 1;
+    }
+
+    void JobSystem::WorkerLoop(uint32_t workerIndex)
+    {
+        t_jobSystem = this;
+        t_workerIndex = static_cast<int>(workerIndex);
+        t_randomState = m_workers[workerIndex]->RandomState;
+
+        constexpr int numSpins = 64;
+
+        while (true)
+        {
+            if (auto job = FindJob(workerIndex))
+            {
+                Execute(job);
+                continue;
+            }
+
+            // Spin for a little while before going to sleep,
+            // since more work usually turns up soon.
+            bool workAvailable = false;
+            for (int i = 0; i < numSpins && !workAvailable; i++)
+            {
+                std::this_thread::yield();
+                workAvailable = m_numQueued.load(std::memory_order_relaxed) > 0;
+            }
+
+            if (workAvailable)
+                continue;
+
+            std::unique_lock lock(m_sleepMutex);
+
+            // Submit checks m_numSleeping after bumping m_numQueued, and this
+            // checks m_numQueued after bumping m_numSleeping, so at least
+            // one of the two sees the other and no wakeup is lost.
+            m_numSleeping.fetch_add(1);
+            m_wakeCondition.wait(lock, [this]()
+                {
+                    return m_numQueued.load() > 0 || m_stopping.load();
+                });
+            m_numSleeping.fetch_sub(1);
+
+            if (m_stopping.load() && m_numQueued.load() == 0)
+                return;
+        }
+    }
+
+    int JobSystem::GetWorkerIndex() const
+    {
+        return t_jobSystem == this ? t_workerIndex : -1;
+    }
+
+    JobSystem::Job* JobSystem::FindJob(int workerIndex)
+    {
+        for (size_t priority = 0; priority < NumPriorities; priority++)
+        {
+            Job* job = nullptr;
+
+            if (workerIndex >= 0)
+            {
+                job = m_workers[workerIndex]->Deques[priority].Pop();
+            }
+
+            if (job == nullptr && m_numShared.load(std::memory_order_relaxed) > 0)
+            {
+                std::scoped_lock lock(m_sharedQueueMutex);
+                auto& queue = m_sharedQueues[priority];
+
+                if (queue.Head != nullptr)
+                {
+                    job = queue.Head;
+                    queue.Head = job->Next;
+                    if (queue.Head == nullptr)
+                    {
+                        queue.Tail = nullptr;
+                    }
+
+                    job->Next = nullptr;
+                    m_numShared.fetch_sub(1);
+                }
+            }
+
+            if (job == nullptr)
+            {
+                job = Steal(workerIndex, priority);
+            }
+
+            if (job != nullptr)
+            {
+                m_numQueued.fetch_sub(1);
+                return job;
+            }
+        }
+
+        return nullptr;
+    }
+
+    JobSystem::Job* JobSystem::Steal(int workerIndex, size_t priority)
+    {
+        const auto numWorkers = m_workers.size();
+        if (numWorkers == 0)
+            return nullptr;
+
+        if (t_randomState == 0)
+        {
+            t_randomState = NextSeed();
+        }
+
+        // Start from a random victim, so thieves spread out
+        // instead of all hitting the same worker.
+        const size_t start = NextRandom(t_randomState) % numWorkers;
+
+        for (size_t i = 0; i < numWorkers; i++)
+        {
+            const size_t victim = (start + i) % numWorkers;
+            if (static_cast<int>(victim) == workerIndex)
+                continue;
+
+            if (auto job = m_workers[victim]->Deques[priority].Steal())
+                return job;
+        }
+
+        return nullptr;
+    }
+
+    void JobSystem::Execute(Job* job)
+    {
+        try
+        {
+            job->Fn();
+        }
+        catch (...)
+        {
+            // Nothing waits on a job without a counter, so there's
+            // nowhere for this to go. Letting it escape would end a
+            // worker the same way, or surface in an unrelated Wait.
+            if (job->Counter == nullptr)
+            {
+                std::terminate();
+            }
+
+            // The counter is still counting this job, so it's still alive
+            if (!job->Counter->m_failed.exchange(true))
+            {
+                job->Counter->m_exception = std::current_exception();
+            }
+        }
+
+        // The counter may be destroyed as soon as it reaches zero,
+        // so it mustn't be touched after this.
+        if (job->Counter != nullptr)
+        {
+            job->Counter->m_count.fetch_sub(1, std::memory_order_release);
+        }
+
+        DestroyJob(job);
+    }
+
+    JobSystem::Job* JobSystem::CreateJob(std::function<void()>&& fn, JobCounter* counter)
+    {
+        Job* job;
+
+        uint32_t index;
+        if (m_freeJobs.TryAllocate(index))
+        {
+            job = &m_jobPool[index];
+            job->PoolIndex = index;
+        }
+        else
+        {
+            job = new Job;
+        }
+
+        job->Fn = std::move(fn);
+        job->Counter = counter;
+        return job;
+    }
+
+    void JobSystem::DestroyJob(Job* job)
+    {
+        if (job->PoolIndex == IndexFreeList::InvalidIndex)
+        {
+            delete job;
+            return;
+        }
+
+        // Lets go of whatever the function captured before
+        // the job can be handed out again
+        job->Fn = nullptr;
+        m_freeJobs.Free(job->PoolIndex);
+    }
+
+    void JobSystem::WakeWorkers(uint32_t numJobs)
+    {
+        if (m_numSleeping.load() == 0)
+            return;
+
+        std::scoped_lock lock(m_sleepMutex);
+
+        if (numJobs == 1)
+        {
+            m_wakeCondition.notify_one();
+        }
+        else
+        {
+            m_wakeCondition.notify_all();
+        }
+    }
+}
@@ -0,0 +1,197 @@
+#pragma once
+
+#include "Core/Jobs/WorkStealingDeque.h"
+#include "Core/IndexFreeList.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Nothing here touches D3D12 or the precompiled header, so
+// the job system can be built and checked on any platform.
+namespace Gradient::Jobs
+{
+    enum class JobPriority : uint8_t
+    {
+        High,
+        Normal,
+        Low,
+        Count
+    };
+
+    // Counts submitted jobs that haven't finished yet.
+    // JobSystem::Wait runs other jobs until it reaches zero,
+    // and then rethrows the first exception any of them threw.
+    class JobCounter
+    {
+    public:
+        bool IsDone() const
+        {
+            return m_count.load(std::memory_order_acquire) == 0;
+        }
+
+    private:
+        friend class JobSystem;
+
+        std::atomic<uint32_t> m_count = 0;
+        // Only the job that sets m_failed writes m_exception, before
+        // it counts itself as done, so Wait can read it afterwards.
+        std::atomic<bool> m_failed = false;
+        std::exception_ptr m_exception;
+    };
+
+    // The engine's worker threads. Each worker keeps a lock-free deque per
+    // priority, and steals from the other workers when its own run dry.
+    // Threads that aren't workers submit through a shared queue, and
+    // help run jobs while they wait on a counter.
+    //
+    // Physics runs on this too, through JoltJobSystem, so nothing else
+    // needs to keep threads of its own.
+    class JobSystem
+    {
+    public:
+        // Zero workers means one fewer than the number of hardware threads,
+        // leaving room for the thread that submits the work.
+        explicit JobSystem(uint32_t numWorkers = 0);
+        ~JobSystem();
+
+        static void Initialize(uint32_t numWorkers = 0);
+        static void Shutdown();
+        static JobSystem* Get();
+
+        // A job without a counter mustn't throw, since nothing would ever
+        // see the exception. If one does, the program is terminated, as
+        // it would be for an exception escaping a std::thread.
+        void Submit(std::function<void()> fn,
+            JobCounter* counter = nullptr,
+            JobPriority priority = JobPriority::Normal);
+
+        // Runs jobs on this thread until the counter reaches zero. If any
+        // of the counted jobs threw, the first exception is rethrown here.
+        void Wait(JobCounter& counter);
+
+        // Calls fn(begin, end) over [0, count) in batches of batchSize,
+        // and returns once every batch has finished. If a batch throws,
+        // the exception is rethrown here once the others are done.
+        template <typename Fn>
+        void ParallelFor(size_t count,
+            size_t batchSize,
+            Fn&& fn,
+            JobPriority priority = JobPriority::Normal);
+
+        uint32_t GetWorkerCount() const;
+        // The workers, plus the thread that waits
+        uint32_t GetMaxConcurrency() const;
+
+    private:
+        struct Job
+        {
+            std::function<void()> Fn;
+            JobCounter* Counter = nullptr;
+            // The next job in a shared queue
+            Job* Next = nullptr;
+            // Where the job is in m_jobPool, or InvalidIndex
+            // if the pool ran out and it came from the heap
+            uint32_t PoolIndex = IndexFreeList::InvalidIndex;
+        };
+
+        // Jobs are linked through Job::Next, so
+        // queueing one never allocates
+        struct SharedQueue
+        {
+            Job* Head = nullptr;
+            Job* Tail = nullptr;
+        };
+
+        static constexpr size_t NumPriorities = static_cast<size_t>(JobPriority::Count);
+        static constexpr size_t DequeCapacity = 1024;
+        static constexpr uint32_t JobPoolCapacity = 4096;
+
+        struct Worker
+        {
+            std::array<WorkStealingDeque<Job, DequeCapacity>, NumPriorities> Deques;
+            std::thread Thread;
+            uint32_t RandomState;
+        };
+
+        void WorkerLoop(uint32_t workerIndex);
+        // Returns the index of the calling thread's worker,
+        // or -1 if it isn't one of this system's workers.
+        int GetWorkerIndex() const;
+        // Like Wait, without rethrowing
+        void WaitUntilDone(JobCounter& counter);
+        Job* FindJob(int workerIndex);
+        Job* Steal(int workerIndex, size_t priority);
+        Job* CreateJob(std::function<void()>&& fn, JobCounter* counter);
+        void DestroyJob(Job* job);
+        void Execute(Job* job);
+        void WakeWorkers(uint32_t numJobs);
+
+        std::vector<std::unique_ptr<Worker>> m_workers;
+
+        // Jobs are taken from here while it lasts, so that
+        // submitting work doesn't touch the heap.
+        std::unique_ptr<Job[]> m_jobPool;
+        IndexFreeList m_freeJobs;
+
+        std::mutex m_sharedQueueMutex;
+        std::array<SharedQueue, NumPriorities> m_sharedQueues;
+        std::atomic<uint32_t> m_numShared = 0;
+
+        // Jobs that have been submitted but not picked up yet
+        std::atomic<uint32_t> m_numQueued = 0;
+        std::atomic<uint32_t> m_numSleeping = 0;
+        std::mutex m_sleepMutex;
+        std::condition_variable m_wakeCondition;
+        std::atomic<bool> m_stopping = false;
+
+        static std::unique_ptr<JobSystem> s_instance;
+    };
+
+    template <typename Fn>
+    void JobSystem::ParallelFor(size_t count,
+        size_t batchSize,
+        Fn&& fn,
+        JobPriority priority)
+    {
+        if (count == 0)
+            return;
+
+        batchSize = std::max<size_t>(batchSize, 1);
+
+        JobCounter counter;
+
+        // The last batch runs on this thread.
+        size_t lastBegin = ((count - 1) / batchSize) * batchSize;
+
+        for (size_t begin = 0; begin < lastBegin; begin += batchSize)
+        {
+            size_t end = begin + batchSize;
+            Submit([&fn, begin, end]()
+                {
+                    fn(begin, end);
+                }, &counter, priority);
+        }
+
+        // The jobs refer to fn and the counter, so they have to
+        // finish before this returns, even if this batch throws.
+        try
+        {
+            fn(lastBegin, count);
+        }
+        catch (...)
+        {
+            WaitUntilDone(counter);
+            throw;
+        }
+
+        Wait(counter);
+    }
+}
@@ -0,0 +1,79 @@
+#include "pch.h"
+
+#include "Core/Jobs/JoltJobSystem.h"
+
+#include <chrono>
+
+namespace Gradient::Jobs
+{
+    JoltJobSystem::JoltJobSystem(JobSystem* jobSystem,
+        JPH::uint maxJobs,
+        JPH::uint maxBarriers)
+        : JPH::JobSystemWithBarrier(maxBarriers),
+        m_jobSystem(jobSystem)
+    {
+        m_jobs.Init(maxJobs, maxJobs);
+    }
+
+    int JoltJobSystem::GetMaxConcurrency() const
+    {
+        return static_cast<int>(m_jobSystem->GetMaxConcurrency());
+    }
+
+    JoltJobSystem::JobHandle JoltJobSystem::CreateJob(const char* inName,
+        JPH::ColorArg inColor,
+        const JobFunction& inJobFunction,
+        JPH::uint32 inNumDependencies)
+    {
+        // Wait for a free slot, as JobSystemThreadPool does
+        JPH::uint32 index;
+        while (true)
+        {
+            index = m_jobs.ConstructObject(inName, inColor, this, inJobFunction, inNumDependencies);
+            if (index != AvailableJobs::cInvalidObjectIndex)
+                break;
+
+            JPH_ASSERT(false, "No jobs available!");
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+
+        Job* job = &m_jobs.Get(index);
+
+        // The handle keeps a reference, since the job
+        // could finish as soon as it's queued.
+        JobHandle handle(job);
+
+        if (inNumDependencies == 0)
+        {
+            QueueJob(job);
+        }
+
+        return handle;
+    }
+
+    void JoltJobSystem::QueueJob(Job* inJob)
+    {
+        // Released once the job has run
+        inJob->AddRef();
+
+        // Physics steps at a fixed rate, so it goes ahead of other work.
+        m_jobSystem->Submit([inJob]()
+            {
+                inJob->Execute();
+                inJob->Release();
+            }, nullptr, JobPriority::High);
+    }
+
+    void JoltJobSystem::QueueJobs(Job** inJobs, JPH::uint inNumJobs)
+    {
+        for (JPH::uint i = 0; i < inNumJobs; i++)
+        {
+            QueueJob(inJobs[i]);
+        }
+    }
+
+    void JoltJobSystem::FreeJob(Job* inJob)
+    {
+        m_jobs.DestroyObject(inJob);
+    }
+}
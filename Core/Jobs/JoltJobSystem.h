@@ -0,0 +1,39 @@
+#pragma once
+
+#include "pch.h"
+
+#include "Core/Jobs/JobSystem.h"
+
+#include <Jolt/Core/FixedSizeFreeList.h>
+#include <Jolt/Core/JobSystemWithBarrier.h>
+
+namespace Gradient::Jobs
+{
+    // Lets Jolt run its jobs on the engine's JobSystem, in place of
+    // JobSystemThreadPool and the threads that it keeps to itself.
+    // Jolt's barriers are reused as-is.
+    class JoltJobSystem final : public JPH::JobSystemWithBarrier
+    {
+    public:
+        JoltJobSystem(JobSystem* jobSystem,
+            JPH::uint maxJobs,
+            JPH::uint maxBarriers);
+
+        virtual int GetMaxConcurrency() const override;
+        virtual JobHandle CreateJob(const char* inName,
+            JPH::ColorArg inColor,
+            const JobFunction& inJobFunction,
+            JPH::uint32 inNumDependencies = 0) override;
+
+    protected:
+        virtual void QueueJob(Job* inJob) override;
+        virtual void QueueJobs(Job** inJobs, JPH::uint inNumJobs) override;
+        virtual void FreeJob(Job* inJob) override;
+
+    private:
+        using AvailableJobs = JPH::FixedSizeFreeList<Job>;
+
+        JobSystem* m_jobSystem;
+        AvailableJobs m_jobs;
+    };
+}
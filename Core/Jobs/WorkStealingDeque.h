@@ -0,0 +1,107 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace Gradient::Jobs
+{
+    // A fixed-size Chase-Lev deque. The owning thread pushes and pops
+    // at the bottom, and any other thread can steal from the top.
+    // None of the operations take a lock.
+    template <typename T, size_t Capacity>
+    class WorkStealingDeque
+    {
+        static_assert((Capacity& (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+    public:
+        WorkStealingDeque()
+        {
+            for (auto& slot : m_buffer)
+            {
+                slot.store(nullptr, std::memory_order_relaxed);
+            }
+        }
+
+        // Owner only. Returns false if the deque is full.
+        bool Push(T* item)
+        {
+            auto bottom = m_bottom.load(std::memory_order_relaxed);
+            auto top = m_top.load(std::memory_order_acquire);
+
+            if (bottom - top >= static_cast<int64_t>(Capacity))
+                return false;
+
+            m_buffer[bottom & Mask].store(item, std::memory_order_relaxed);
+            m_bottom.store(bottom + 1, std::memory_order_release);
+
+            return true;
+        }
+
+        // Owner only. Takes the most recently pushed item.
+        T* Pop()
+        {
+            auto bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+            m_bottom.store(bottom, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            auto top = m_top.load(std::memory_order_relaxed);
+
+            if (top > bottom)
+            {
+                // Empty
+                m_bottom.store(bottom + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+
+            T* item = m_buffer[bottom & Mask].load(std::memory_order_relaxed);
+
+            if (top == bottom)
+            {
+                // The last item, which a thief could be taking too.
+                if (!m_top.compare_exchange_strong(top, top + 1,
+                    std::memory_order_seq_cst,
+                    std::memory_order_relaxed))
+                {
+                    item = nullptr;
+                }
+
+                m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            }
+
+            return item;
+        }
+
+        // Any thread. Takes the oldest item.
+        T* Steal()
+        {
+            auto top = m_top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            auto bottom = m_bottom.load(std::memory_order_acquire);
+
+            if (top >= bottom)
+                return nullptr;
+
+            T* item = m_buffer[top & Mask].load(std::memory_order_relaxed);
+
+            if (!m_top.compare_exchange_strong(top, top + 1,
+                std::memory_order_seq_cst,
+                std::memory_order_relaxed))
+            {
+                // Lost the race to another thief or the owner
+                return nullptr;
+            }
+
+            return item;
+        }
+
+    private:
+        static constexpr int64_t Mask = static_cast<int64_t>(Capacity) - 1;
+
+        // Kept on separate cache lines, since the owner
+        // writes one and thieves write the other.
+        alignas(64) std::atomic<int64_t> m_top = 0;
+        alignas(64) std::atomic<int64_t> m_bottom = 0;
+        alignas(64) std::array<std::atomic<T*>, Capacity> m_buffer;
+    };
+}
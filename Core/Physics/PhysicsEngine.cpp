@@ -105,10 +105,11 @@ namespace Gradient::Physics
         s_engine = std::unique_ptr<PhysicsEngine>(engine);
 
         s_engine->m_tempAllocator = std::make_unique<JPH::TempAllocatorImpl>(10 * 1024 * 1024);
-        s_engine->m_jobSystem = std::make_unique<JPH::JobSystemThreadPool>(
+        // Physics shares the engine's workers rather than keeping its own.
+        s_engine->m_jobSystem = std::make_unique<Jobs::JoltJobSystem>(
+            Jobs::JobSystem::Get(),
             JPH::cMaxPhysicsJobs,
-            JPH::cMaxPhysicsBarriers,
-            std::max(std::thread::hardware_concurrency() - 4, 2u)
+            JPH::cMaxPhysicsBarriers
         );
 
         s_engine->m_physicsSystem = std::make_unique<JPH::PhysicsSystem>();
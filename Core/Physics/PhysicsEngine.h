@@ -7,11 +7,11 @@
 #include "Core/Physics/Layers.h"
 #include "Core/Physics/DebugRenderer.h"
 #include "StepTimer.h"
+#include "Core/Jobs/JoltJobSystem.h"
 
 #include <Jolt/RegisterTypes.h>
 #include <Jolt/Core/Factory.h>
 #include <Jolt/Core/TempAllocator.h>
-#include <Jolt/Core/JobSystemThreadPool.h>
 #include <Jolt/Physics/PhysicsSettings.h>
 #include <Jolt/Physics/PhysicsSystem.h>
 #include <Jolt/Physics/Collision/Shape/BoxShape.h>
@@ -84,8 +84,7 @@ namespace Gradient::Physics
 
         std::unique_ptr<JPH::TempAllocatorImpl> m_tempAllocator;
 
-        // TODO: Replace this with a custom job system used across the engine
-        std::unique_ptr<JPH::JobSystemThreadPool> m_jobSystem;
+        std::unique_ptr<Jobs::JoltJobSystem> m_jobSystem;
         std::unique_ptr<JPH::PhysicsSystem> m_physicsSystem;
         std::unique_ptr<std::thread> m_simulationWorker;
         DX::StepTimer m_stepTimer;
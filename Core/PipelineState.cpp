@@ -1,5 +1,6 @@
 #include "pch.h"
 #include "Core/PipelineState.h"
+#include "Core/RenderStateCache.h"
 
 #include <directxtk12/VertexTypes.h>
 #include <directxtk12/CommonStates.h>
@@ -182,9 +183,9 @@ namespace Gradient
     {
         assert(m_isBuilt);
 
-        if (multisampled)
-            cl->SetPipelineState(m_multisampledPSO.Get());
-        else
-            cl->SetPipelineState(m_singleSampledPSO.Get());
+        auto pso = multisampled ? m_multisampledPSO.Get() : m_singleSampledPSO.Get();
+
+        if (RenderStateCache::Get().SetPipelineState(pso))
+            cl->SetPipelineState(pso);
     }
 }
\ No newline at end of file
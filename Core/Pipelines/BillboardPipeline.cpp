@@ -221,9 +221,7 @@ namespace Gradient::Pipelines
         m_rootSignature.SetCBV(cl, 1, 0, drawConstants);
 
         LightCB lightBufferData;
-        lightBufferData.directionalLight.colour = SunlightParams.DirectionalLightColour.ToVector3();
-        lightBufferData.directionalLight.direction = SunlightParams.LightDirection;
-        lightBufferData.directionalLight.irradiance = SunlightParams.LightIrradiance;
+        lightBufferData.directionalLight = SunlightParams.Light;
 
         lightBufferData.numPointLights = std::min(MAX_POINT_LIGHTS, PointLights.size());
         for (int i = 0; i < lightBufferData.numPointLights; i++)
@@ -249,7 +247,6 @@ namespace Gradient::Pipelines
         PixelCB pixelConstants;
         pixelConstants.cameraPosition = CameraPosition;
         pixelConstants.tiling = Material.Tiling;
-        pixelConstants.shadowTransform = DirectX::XMMatrixTranspose(SunlightParams.ShadowTransform);
         pixelConstants.emissiveRadiance = Material.EmissiveRadiance;
 
         m_rootSignature.SetCBV(cl, 1, 1, pixelConstants);
@@ -270,10 +267,6 @@ namespace Gradient::Pipelines
     void BillboardPipeline::SetDirectionalLight(Rendering::DirectionalLight* dlight)
     {
         SunlightParams.ShadowMap = dlight->GetShadowMapSRV();
-        SunlightParams.ShadowTransform = dlight->GetShadowTransform();
-
-        SunlightParams.DirectionalLightColour = dlight->GetColour();
-        SunlightParams.LightIrradiance = dlight->GetIrradiance();
-        SunlightParams.LightDirection = dlight->GetDirection();
+        SunlightParams.Light = dlight->GetShaderConstants();
     }
 }
@@ -49,7 +49,6 @@ namespace Gradient::Pipelines
             float tiling;
             DirectX::XMFLOAT3 emissiveRadiance;
             float pad2;
-            DirectX::XMMATRIX shadowTransform;
         };
 
         struct __declspec(align(16)) LightCB
@@ -90,13 +89,9 @@ namespace Gradient::Pipelines
 
         float TotalTimeSeconds = 0.f;
 
-        // TODO: Extract this into Params::DirectionalLight
         struct DirectionalLightParams
         {
-            DirectX::SimpleMath::Color   DirectionalLightColour;
-            DirectX::SimpleMath::Vector3 LightDirection;
-            float LightIrradiance;
-            DirectX::SimpleMath::Matrix ShadowTransform;
+            AlignedDirectionalLight Light;
             GraphicsMemoryManager::DescriptorView ShadowMap;
         };
 
@@ -118,9 +113,9 @@ namespace Gradient::Pipelines
         RootSignature m_rootSignature;
 
         // All billboards are assumed to be masked
-        std::unique_ptr<PipelineState> m_maskedShadowPSO;
-        std::unique_ptr<PipelineState> m_maskedDepthWriteOnlyPSO;
-        std::unique_ptr<PipelineState> m_maskedPixelDepthReadPSO;
-        std::unique_ptr<PipelineState> m_maskedPixelDepthReadWritePSO;
+        std::shared_ptr<PipelineState> m_maskedShadowPSO;
+        std::shared_ptr<PipelineState> m_maskedDepthWriteOnlyPSO;
+        std::shared_ptr<PipelineState> m_maskedPixelDepthReadPSO;
+        std::shared_ptr<PipelineState> m_maskedPixelDepthReadWritePSO;
     };
 }
\ No newline at end of file
@@ -5,12 +5,19 @@
 
 namespace Gradient::Pipelines
 {
+    // Must match MAX_SHADOW_CASCADES in LightStructs.hlsli
+    constexpr uint32_t MaxShadowCascades = 4;
+
     struct AlignedDirectionalLight
     {
         DirectX::XMFLOAT3 colour;
         float irradiance;
         DirectX::XMFLOAT3 direction;
         float pad;
+        DirectX::XMMATRIX shadowTransforms[MaxShadowCascades];
+        uint32_t numCascades;
+        float shadowMapTexelSize;
+        float pad2[2];
     };
 
     struct AlignedPointLight
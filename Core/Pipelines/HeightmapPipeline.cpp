@@ -281,9 +281,7 @@ namespace Gradient::Pipelines
 
         LightCB lightConstants;
 
-        lightConstants.directionalLight.colour = static_cast<DirectX::XMFLOAT3>(m_directionalLightColour);
-        lightConstants.directionalLight.irradiance = m_lightIrradiance;
-        lightConstants.directionalLight.direction = m_lightDirection;
+        lightConstants.directionalLight = m_directionalLight;
         lightConstants.numPointLights = std::min(MAX_POINT_LIGHTS, m_pointLights.size());
         for (int i = 0; i < lightConstants.numPointLights; i++)
         {
@@ -309,7 +307,6 @@ namespace Gradient::Pipelines
         PixelParamCB pixelConstants;
         pixelConstants.cameraPosition = m_cameraPosition;
         pixelConstants.tiling = m_material.Tiling;
-        pixelConstants.shadowTransform = DirectX::XMMatrixTranspose(m_shadowTransform);
 
         m_rootSignature.SetCBV(cl, 1, 2, pixelConstants);
 
@@ -376,16 +373,14 @@ namespace Gradient::Pipelines
 
     void HeightmapPipeline::SetDirectionalLight(Rendering::DirectionalLight* dlight)
     {
-        m_directionalLightColour = dlight->GetColour();
-        m_lightDirection = dlight->GetDirection();
-        m_lightIrradiance = dlight->GetIrradiance();
+        m_directionalLight = dlight->GetShaderConstants();
         m_shadowMap = dlight->GetShadowMapSRV();
-        m_shadowTransform = dlight->GetShadowTransform();
     }
 
-    void HeightmapPipeline::SetPointLights(std::vector<Params::PointLight> pointLights)
+    void HeightmapPipeline::SetPointLights(std::span<const Params::PointLight> pointLights)
     {
-        m_pointLights = pointLights;
+        // Reuses the vector's storage from the last frame
+        m_pointLights.assign(pointLights.begin(), pointLights.end());
     }
 
     void HeightmapPipeline::SetEnvironmentMap(GraphicsMemoryManager::DescriptorView index)
@@ -13,6 +13,7 @@
 #include <directxtk12/SimpleMath.h>
 #include <directxtk12/BufferHelpers.h>
 #include <directxtk12/CommonStates.h>
+#include <span>
 #include <array>
 
 namespace Gradient::Pipelines
@@ -57,7 +58,6 @@ namespace Gradient::Pipelines
         {
             DirectX::XMFLOAT3 cameraPosition;
             float tiling;
-            DirectX::XMMATRIX shadowTransform;
         };
 
         using VertexType = DirectX::VertexPositionNormalTexture;
@@ -82,7 +82,7 @@ namespace Gradient::Pipelines
         void SetCameraPosition(DirectX::SimpleMath::Vector3 cameraPosition);
         void SetCameraDirection(DirectX::SimpleMath::Vector3 cameraDirection);
         void SetDirectionalLight(Rendering::DirectionalLight* dlight);
-        void SetPointLights(std::vector<Params::PointLight> pointLights);
+        void SetPointLights(std::span<const Params::PointLight> pointLights);
         void SetEnvironmentMap(GraphicsMemoryManager::DescriptorView index);
         void SetShadowCubeArray(GraphicsMemoryManager::DescriptorView index);
         GraphicsMemoryManager::DescriptorView GTAOTexture;
@@ -97,10 +97,10 @@ namespace Gradient::Pipelines
         void ApplyDepthWriteOnlyPipeline(ID3D12GraphicsCommandList* cl, bool multisampled);
 
         RootSignature m_rootSignature;
-        std::unique_ptr<PipelineState> m_pso;
-        std::unique_ptr<PipelineState> m_shadowPso;
-        std::unique_ptr<PipelineState> m_depthWritePso;
-        std::unique_ptr<PipelineState> m_pixelDepthReadPso;
+        std::shared_ptr<PipelineState> m_pso;
+        std::shared_ptr<PipelineState> m_shadowPso;
+        std::shared_ptr<PipelineState> m_depthWritePso;
+        std::shared_ptr<PipelineState> m_pixelDepthReadPso;
 
         GraphicsMemoryManager::DescriptorView m_shadowMap;
         GraphicsMemoryManager::DescriptorView m_environmentMap;
@@ -109,17 +109,13 @@ namespace Gradient::Pipelines
         DirectX::SimpleMath::Matrix m_world;
         DirectX::SimpleMath::Matrix m_view;
         DirectX::SimpleMath::Matrix m_proj;
-        DirectX::SimpleMath::Matrix m_shadowTransform;
 
         Rendering::PBRMaterial m_material;
 
         DirectX::SimpleMath::Vector3 m_cameraPosition;
         DirectX::SimpleMath::Vector3 m_cameraDirection;
 
-        // TODO: Store a Params::DirectionalLight instead.
-        DirectX::SimpleMath::Color   m_directionalLightColour;
-        DirectX::SimpleMath::Vector3 m_lightDirection;
-        float m_lightIrradiance;
+        AlignedDirectionalLight m_directionalLight;
 
         std::vector<Params::PointLight> m_pointLights;
 
@@ -28,15 +28,17 @@ namespace Gradient::Pipelines
 
         virtual ~IRenderPipeline() noexcept = default;
 
-        IRenderPipeline(const IRenderPipeline&) = delete;
-        IRenderPipeline& operator=(const IRenderPipeline&) = delete;
-
         virtual void Apply(ID3D12GraphicsCommandList* cl, bool multisampled = true, DrawType passType = DrawType::PixelDepthReadWrite) = 0;
 
         virtual void SetMaterial(const Rendering::PBRMaterial& material);
 
     protected:
         IRenderPipeline() = default;
+        // Pipelines that can be copied share their PSOs and root 
+        // signature with the copy, so that each thread recording
+        // draws can have its own copy to set per-draw state on.
+        IRenderPipeline(const IRenderPipeline&) = default;
+        IRenderPipeline& operator=(const IRenderPipeline&) = default;
         IRenderPipeline(IRenderPipeline&&) = default;
         IRenderPipeline& operator=(IRenderPipeline&&) = default;
     };
@@ -11,10 +11,16 @@ namespace Gradient::Pipelines
     InstancedPBRPipeline::InstancedPBRPipeline(ID3D12Device2* device)
     {
         InitializeRootSignature(device);
-        InitializeShadowPSO(device);
-        InitializeDepthWritePSO(device);
-        InitializePixelDepthReadPSO(device);
-        InitializePixelDepthReadWritePSO(device);
+
+        for (auto [vsPath, pipelineStates] : {
+            std::pair{ L"Instanced_VS.cso", &m_pipelineStates },
+            std::pair{ L"InstancedCulled_VS.cso", &m_culledPipelineStates } })
+        {
+            InitializeShadowPSO(device, vsPath, *pipelineStates);
+            InitializeDepthWritePSO(device, vsPath, *pipelineStates);
+            InitializePixelDepthReadPSO(device, vsPath, *pipelineStates);
+            InitializePixelDepthReadWritePSO(device, vsPath, *pipelineStates);
+        }
     }
 
     void InstancedPBRPipeline::InitializeRootSignature(ID3D12Device2* device)
@@ -24,6 +30,7 @@ namespace Gradient::Pipelines
         m_rootSignature.AddCBV(1, 1);
 
         m_rootSignature.AddRootSRV(0, 0); // instance data
+        m_rootSignature.AddRootSRV(1, 0); // visible instance indices
         m_rootSignature.AddSRV(0, 1);
         m_rootSignature.AddSRV(1, 1);
         m_rootSignature.AddSRV(2, 1);
@@ -56,32 +63,36 @@ namespace Gradient::Pipelines
         m_rootSignature.Build(device);
     }
 
-    void InstancedPBRPipeline::InitializeShadowPSO(ID3D12Device2* device)
+    void InstancedPBRPipeline::InitializeShadowPSO(ID3D12Device2* device,
+        const wchar_t* vsPath,
+        PipelineStates& out)
     {
         D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = PipelineState::GetDefaultShadowDesc();
 
-        auto vsData = DX::ReadData(L"Instanced_VS.cso");
+        auto vsData = DX::ReadData(vsPath);
 
         psoDesc.pRootSignature = m_rootSignature.Get();
         psoDesc.InputLayout = VertexType::InputLayout;
         psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
         psoDesc.VS = { vsData.data(), vsData.size() };
 
-        m_unmaskedShadowPipelineState = std::make_unique<PipelineState>(psoDesc);
-        m_unmaskedShadowPipelineState->Build(device);
+        out.UnmaskedShadow = std::make_unique<PipelineState>(psoDesc);
+        out.UnmaskedShadow->Build(device);
 
         auto maskedPSData = DX::ReadData(L"MaskedDepth_PS.cso");
 
         psoDesc.PS = { maskedPSData.data(), maskedPSData.size() };
-        m_maskedShadowPipelineState = std::make_unique<PipelineState>(psoDesc);
-        m_maskedShadowPipelineState->Build(device);
+        out.MaskedShadow = std::make_unique<PipelineState>(psoDesc);
+        out.MaskedShadow->Build(device);
     }
 
-    void InstancedPBRPipeline::InitializePixelDepthReadPSO(ID3D12Device2* device)
+    void InstancedPBRPipeline::InitializePixelDepthReadPSO(ID3D12Device2* device,
+        const wchar_t* vsPath,
+        PipelineStates& out)
     {
         D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = PipelineState::GetDepthWriteDisableDesc();
 
-        auto vsData = DX::ReadData(L"Instanced_VS.cso");
+        auto vsData = DX::ReadData(vsPath);
         auto psData = DX::ReadData(L"PBR_PS.cso");
 
         psoDesc.pRootSignature = m_rootSignature.Get();
@@ -90,21 +101,23 @@ namespace Gradient::Pipelines
         psoDesc.VS = { vsData.data(), vsData.size() };
         psoDesc.PS = { psData.data(), psData.size() };
 
-        m_unmaskedPixelDepthReadPSO = std::make_unique<PipelineState>(psoDesc);
-        m_unmaskedPixelDepthReadPSO->Build(device);
+        out.UnmaskedPixelDepthRead = std::make_unique<PipelineState>(psoDesc);
+        out.UnmaskedPixelDepthRead->Build(device);
 
         auto maskedPSData = DX::ReadData(L"PBR_Masked_PS.cso");
 
         psoDesc.PS = { maskedPSData.data(), maskedPSData.size() };
-        m_maskedPixelDepthReadPSO = std::make_unique<PipelineState>(psoDesc);
-        m_maskedPixelDepthReadPSO->Build(device);
+        out.MaskedPixelDepthRead = std::make_unique<PipelineState>(psoDesc);
+        out.MaskedPixelDepthRead->Build(device);
     }
 
-    void InstancedPBRPipeline::InitializePixelDepthReadWritePSO(ID3D12Device2* device)
+    void InstancedPBRPipeline::InitializePixelDepthReadWritePSO(ID3D12Device2* device,
+        const wchar_t* vsPath,
+        PipelineStates& out)
     {
         D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = PipelineState::GetDefaultDesc();
 
-        auto vsData = DX::ReadData(L"Instanced_VS.cso");
+        auto vsData = DX::ReadData(vsPath);
         auto psData = DX::ReadData(L"PBR_PS.cso");
 
         psoDesc.pRootSignature = m_rootSignature.Get();
@@ -113,61 +126,65 @@ namespace Gradient::Pipelines
         psoDesc.VS = { vsData.data(), vsData.size() };
         psoDesc.PS = { psData.data(), psData.size() };
 
-        m_unmaskedPixelDepthReadWritePSO = std::make_unique<PipelineState>(psoDesc);
-        m_unmaskedPixelDepthReadWritePSO->Build(device);
+        out.UnmaskedPixelDepthReadWrite = std::make_unique<PipelineState>(psoDesc);
+        out.UnmaskedPixelDepthReadWrite->Build(device);
 
         auto maskedPSData = DX::ReadData(L"PBR_Masked_PS.cso");
 
         psoDesc.PS = { maskedPSData.data(), maskedPSData.size() };
-        m_maskedPixelDepthReadWritePSO = std::make_unique<PipelineState>(psoDesc);
-        m_maskedPixelDepthReadWritePSO->Build(device);
+        out.MaskedPixelDepthReadWrite = std::make_unique<PipelineState>(psoDesc);
+        out.MaskedPixelDepthReadWrite->Build(device);
     }
 
-    void InstancedPBRPipeline::InitializeDepthWritePSO(ID3D12Device2* device)
+    void InstancedPBRPipeline::InitializeDepthWritePSO(ID3D12Device2* device,
+        const wchar_t* vsPath,
+        PipelineStates& out)
     {
         D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = PipelineState::GetDefaultDesc();
 
-        auto vsData = DX::ReadData(L"Instanced_VS.cso");
+        auto vsData = DX::ReadData(vsPath);
 
         psoDesc.pRootSignature = m_rootSignature.Get();
         psoDesc.InputLayout = VertexType::InputLayout;
         psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
         psoDesc.VS = { vsData.data(), vsData.size() };
 
-        m_unmaskedDepthWriteOnlyPSO = std::make_unique<PipelineState>(psoDesc);
-        m_unmaskedDepthWriteOnlyPSO->Build(device);
+        out.UnmaskedDepthWriteOnly = std::make_unique<PipelineState>(psoDesc);
+        out.UnmaskedDepthWriteOnly->Build(device);
 
         auto maskedPSData = DX::ReadData(L"MaskedDepth_PS.cso");
 
         psoDesc.PS = { maskedPSData.data(), maskedPSData.size() };
-        m_maskedDepthWriteOnlyPSO = std::make_unique<PipelineState>(psoDesc);
-        m_maskedDepthWriteOnlyPSO->Build(device);
+        out.MaskedDepthWriteOnly = std::make_unique<PipelineState>(psoDesc);
+        out.MaskedDepthWriteOnly->Build(device);
     }
 
     void InstancedPBRPipeline::ApplyDepthOnlyPipeline(ID3D12GraphicsCommandList* cl,
         bool multisampled,
         DrawType passType)
     {
+        const auto& pipelineStates = GetPipelineStates();
+
         if (passType == DrawType::ShadowPass)
         {
             if (m_material.Masked)
             {
-                m_maskedShadowPipelineState->Set(cl, false);
+                pipelineStates.MaskedShadow->Set(cl, false);
             }
             else
             {
-                m_unmaskedShadowPipelineState->Set(cl, false);
+                pipelineStates.UnmaskedShadow->Set(cl, false);
             }
         }
         else if (passType == DrawType::DepthWriteOnly)
         {
             if (m_material.Masked)
             {
-                m_maskedDepthWriteOnlyPSO->Set(cl, multisampled);
+                pipelineStates.MaskedDepthWriteOnly->Set(cl, multisampled);
             }
             else
             {
-                m_unmaskedDepthWriteOnlyPSO->Set(cl, multisampled);
+                pipelineStates.UnmaskedDepthWriteOnly->Set(cl, multisampled);
             }
         }
 
@@ -178,7 +195,7 @@ namespace Gradient::Pipelines
         vertexConstants.viewProj = DirectX::XMMatrixTranspose(m_view * m_proj);
 
         m_rootSignature.SetCBV(cl, 0, 0, vertexConstants);
-        m_rootSignature.SetStructuredBufferSRV(cl, 0, 0, m_instanceHandle);
+        SetInstanceBuffers(cl);
         m_rootSignature.SetSRV(cl, 0, 1, m_material.Texture);
 
         cl->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
@@ -193,26 +210,29 @@ namespace Gradient::Pipelines
             ApplyDepthOnlyPipeline(cl, multisampled, passType);
             return;
         }
-        else if (passType == DrawType::PixelDepthReadOnly)
+
+        const auto& pipelineStates = GetPipelineStates();
+
+        if (passType == DrawType::PixelDepthReadOnly)
         {
             if (m_material.Masked)
             {
-                m_maskedPixelDepthReadPSO->Set(cl, multisampled);
+                pipelineStates.MaskedPixelDepthRead->Set(cl, multisampled);
             }
             else
             {
-                m_unmaskedPixelDepthReadPSO->Set(cl, multisampled);
+                pipelineStates.UnmaskedPixelDepthRead->Set(cl, multisampled);
             }
         }
         else if (passType == DrawType::PixelDepthReadWrite)
         {
             if (m_material.Masked)
             {
-                m_maskedPixelDepthReadWritePSO->Set(cl, multisampled);
+                pipelineStates.MaskedPixelDepthReadWrite->Set(cl, multisampled);
             }
             else
             {
-                m_unmaskedPixelDepthReadWritePSO->Set(cl, multisampled);
+                pipelineStates.UnmaskedPixelDepthReadWrite->Set(cl, multisampled);
             }
         }
 
@@ -224,7 +244,7 @@ namespace Gradient::Pipelines
         vertexConstants.viewProj = DirectX::XMMatrixTranspose(m_view * m_proj);
 
         m_rootSignature.SetCBV(cl, 0, 0, vertexConstants);
-        m_rootSignature.SetStructuredBufferSRV(cl, 0, 0, m_instanceHandle);
+        SetInstanceBuffers(cl);
 
         auto lightBufferData = m_dLightCBData;
         lightBufferData.numPointLights = std::min(MAX_POINT_LIGHTS, m_pointLights.size());
@@ -251,7 +271,6 @@ namespace Gradient::Pipelines
         PixelCB pixelConstants;
         pixelConstants.cameraPosition = m_cameraPosition;
         pixelConstants.tiling = m_material.Tiling;
-        pixelConstants.shadowTransform = DirectX::XMMatrixTranspose(m_shadowTransform);
         pixelConstants.emissiveRadiance = m_material.EmissiveRadiance;
 
         m_rootSignature.SetCBV(cl, 1, 1, pixelConstants);
@@ -287,16 +306,13 @@ namespace Gradient::Pipelines
     void InstancedPBRPipeline::SetDirectionalLight(Rendering::DirectionalLight* dlight)
     {
         m_shadowMap = dlight->GetShadowMapSRV();
-        m_shadowTransform = dlight->GetShadowTransform();
-
-        m_dLightCBData.directionalLight.colour = static_cast<DirectX::XMFLOAT3>(dlight->GetColour());
-        m_dLightCBData.directionalLight.irradiance = dlight->GetIrradiance();
-        m_dLightCBData.directionalLight.direction = dlight->GetDirection();
+        m_dLightCBData.directionalLight = dlight->GetShaderConstants();
     }
 
-    void InstancedPBRPipeline::SetPointLights(std::vector<Params::PointLight> pointLights)
+    void InstancedPBRPipeline::SetPointLights(std::span<const Params::PointLight> pointLights)
     {
-        m_pointLights = pointLights;
+        // Reuses the vector's storage from the last frame
+        m_pointLights.assign(pointLights.begin(), pointLights.end());
     }
 
     void InstancedPBRPipeline::SetWorld(DirectX::FXMMATRIX value)
@@ -328,6 +344,34 @@ namespace Gradient::Pipelines
 
     void InstancedPBRPipeline::SetInstanceData(const ECS::Components::InstanceDataComponent& instanceComponent)
     {
-        m_instanceHandle = instanceComponent.BufferHandle;
+        auto bufferEntry = BufferManager::Get()->GetInstanceBuffer(instanceComponent.BufferHandle);
+
+        assert(bufferEntry);
+        m_instanceBuffer = bufferEntry->Resource.GetGpuAddress();
+    }
+
+    void InstancedPBRPipeline::SetInstanceBuffer(D3D12_GPU_VIRTUAL_ADDRESS address)
+    {
+        m_instanceBuffer = address;
+    }
+
+    void InstancedPBRPipeline::SetVisibleInstances(D3D12_GPU_VIRTUAL_ADDRESS address)
+    {
+        m_visibleInstances = address;
+    }
+
+    const InstancedPBRPipeline::PipelineStates& InstancedPBRPipeline::GetPipelineStates() const
+    {
+        return m_visibleInstances != 0 ? m_culledPipelineStates : m_pipelineStates;
+    }
+
+    void InstancedPBRPipeline::SetInstanceBuffers(ID3D12GraphicsCommandList* cl)
+    {
+        m_rootSignature.SetStructuredBufferSRV(cl, 0, 0, m_instanceBuffer);
+
+        if (m_visibleInstances != 0)
+        {
+            m_rootSignature.SetStructuredBufferSRV(cl, 1, 0, m_visibleInstances);
+        }
     }
 }
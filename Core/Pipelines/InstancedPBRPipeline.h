@@ -13,6 +13,7 @@
 #include <directxtk12/SimpleMath.h>
 #include <directxtk12/BufferHelpers.h>
 #include <directxtk12/CommonStates.h>
+#include <span>
 
 namespace Gradient::Pipelines
 {
@@ -33,7 +34,6 @@ namespace Gradient::Pipelines
             float tiling;
             DirectX::XMFLOAT3 emissiveRadiance;
             float pad2;
-            DirectX::XMMATRIX shadowTransform;
         };
 
         struct __declspec(align(256)) LightCB
@@ -60,32 +60,47 @@ namespace Gradient::Pipelines
         void XM_CALLCONV SetMatrices(DirectX::FXMMATRIX world, DirectX::CXMMATRIX view, DirectX::CXMMATRIX projection);
 
         void SetInstanceData(const ECS::Components::InstanceDataComponent& instanceComponent);
+        // For instance data that isn't in a buffer of its own,
+        // such as instances batched up for this frame.
+        void SetInstanceBuffer(D3D12_GPU_VIRTUAL_ADDRESS address);
+        // Draws only the instances with indices in this buffer, which
+        // InstanceCuller writes. Zero draws all of the instances.
+        void SetVisibleInstances(D3D12_GPU_VIRTUAL_ADDRESS address);
         void SetCameraPosition(DirectX::SimpleMath::Vector3 cameraPosition);
         void SetDirectionalLight(Rendering::DirectionalLight* dlight);
-        void SetPointLights(std::vector<Params::PointLight> pointLights);
+        void SetPointLights(std::span<const Params::PointLight> pointLights);
         void SetEnvironmentMap(GraphicsMemoryManager::DescriptorView index);
         void SetShadowCubeArray(GraphicsMemoryManager::DescriptorView index);
 
         GraphicsMemoryManager::DescriptorView GTAOTexture;
 
     private:
+        // The PSOs for one vertex shader
+        struct PipelineStates
+        {
+            std::shared_ptr<PipelineState> UnmaskedShadow;
+            std::shared_ptr<PipelineState> UnmaskedDepthWriteOnly;
+            std::shared_ptr<PipelineState> UnmaskedPixelDepthRead;
+            std::shared_ptr<PipelineState> UnmaskedPixelDepthReadWrite;
+
+            std::shared_ptr<PipelineState> MaskedShadow;
+            std::shared_ptr<PipelineState> MaskedDepthWriteOnly;
+            std::shared_ptr<PipelineState> MaskedPixelDepthRead;
+            std::shared_ptr<PipelineState> MaskedPixelDepthReadWrite;
+        };
+
         void InitializeRootSignature(ID3D12Device2* device);
-        void InitializeShadowPSO(ID3D12Device2* device);
-        void InitializePixelDepthReadPSO(ID3D12Device2* device);
-        void InitializePixelDepthReadWritePSO(ID3D12Device2* device);
-        void InitializeDepthWritePSO(ID3D12Device2* device);
+        void InitializeShadowPSO(ID3D12Device2* device, const wchar_t* vsPath, PipelineStates& out);
+        void InitializePixelDepthReadPSO(ID3D12Device2* device, const wchar_t* vsPath, PipelineStates& out);
+        void InitializePixelDepthReadWritePSO(ID3D12Device2* device, const wchar_t* vsPath, PipelineStates& out);
+        void InitializeDepthWritePSO(ID3D12Device2* device, const wchar_t* vsPath, PipelineStates& out);
         void ApplyDepthOnlyPipeline(ID3D12GraphicsCommandList* cl, bool multisampled, DrawType passType);
+        const PipelineStates& GetPipelineStates() const;
+        void SetInstanceBuffers(ID3D12GraphicsCommandList* cl);
 
         RootSignature m_rootSignature;
-        std::unique_ptr<PipelineState> m_unmaskedShadowPipelineState;
-        std::unique_ptr<PipelineState> m_unmaskedDepthWriteOnlyPSO;
-        std::unique_ptr<PipelineState> m_unmaskedPixelDepthReadPSO;
-        std::unique_ptr<PipelineState> m_unmaskedPixelDepthReadWritePSO;
-
-        std::unique_ptr<PipelineState> m_maskedShadowPipelineState;
-        std::unique_ptr<PipelineState> m_maskedDepthWriteOnlyPSO;
-        std::unique_ptr<PipelineState> m_maskedPixelDepthReadPSO;
-        std::unique_ptr<PipelineState> m_maskedPixelDepthReadWritePSO;
+        PipelineStates m_pipelineStates;
+        PipelineStates m_culledPipelineStates;
 
         Rendering::PBRMaterial m_material;
 
@@ -93,11 +108,11 @@ namespace Gradient::Pipelines
         GraphicsMemoryManager::DescriptorView m_environmentMap;
         GraphicsMemoryManager::DescriptorView m_shadowCubeArray;
 
-        BufferManager::InstanceBufferHandle m_instanceHandle;
+        D3D12_GPU_VIRTUAL_ADDRESS m_instanceBuffer = 0;
+        D3D12_GPU_VIRTUAL_ADDRESS m_visibleInstances = 0;
         DirectX::SimpleMath::Matrix m_world;
         DirectX::SimpleMath::Matrix m_view;
         DirectX::SimpleMath::Matrix m_proj;
-        DirectX::SimpleMath::Matrix m_shadowTransform;
 
         DirectX::SimpleMath::Vector3 m_cameraPosition;
 
@@ -5,6 +5,8 @@
 #include "Core/RootSignature.h"
 #include <directxtk12/VertexTypes.h>
 #include "Core/ReadData.h"
+#include "Core/Math.h"
+#include "Core/Rendering/Meshlets.h"
 
 namespace Gradient::Pipelines
 {
@@ -15,6 +17,7 @@ namespace Gradient::Pipelines
         InitializeRenderPSO(device);
         InitializeDepthWritePSO(device);
         InitializePixelDepthReadPSO(device);
+        InitializeMeshletPSOs(device);
     }
 
     void PBRPipeline::InitializeRootSignature(ID3D12Device* device)
@@ -22,6 +25,12 @@ namespace Gradient::Pipelines
         m_rootSignature.AddCBV(0, 0);
         m_rootSignature.AddCBV(0, 1);
         m_rootSignature.AddCBV(1, 1);
+        m_rootSignature.AddCBV(1, 0); // meshlet culling
+
+        m_rootSignature.AddRootSRV(0, 0); // vertices
+        m_rootSignature.AddRootSRV(1, 0); // meshlets
+        m_rootSignature.AddRootSRV(2, 0); // meshlet vertex indices
+        m_rootSignature.AddRootSRV(3, 0); // meshlet triangles
 
         m_rootSignature.AddSRV(0, 1);
         m_rootSignature.AddSRV(1, 1);
@@ -66,14 +75,14 @@ namespace Gradient::Pipelines
         psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
         psoDesc.VS = { vsData.data(), vsData.size() };
 
-        m_unmaskedShadowPipelineState = std::make_unique<PipelineState>(psoDesc);
-        m_unmaskedShadowPipelineState->Build(device);
+        m_pipelineStates.UnmaskedShadow = std::make_unique<PipelineState>(psoDesc);
+        m_pipelineStates.UnmaskedShadow->Build(device);
 
         auto maskedPSData = DX::ReadData(L"MaskedDepth_PS.cso");
 
         psoDesc.PS = { maskedPSData.data(), maskedPSData.size() };
-        m_maskedShadowPipelineState = std::make_unique<PipelineState>(psoDesc);
-        m_maskedShadowPipelineState->Build(device);
+        m_pipelineStates.MaskedShadow = std::make_unique<PipelineState>(psoDesc);
+        m_pipelineStates.MaskedShadow->Build(device);
     }
 
     void PBRPipeline::InitializeRenderPSO(ID3D12Device2* device)
@@ -89,14 +98,14 @@ namespace Gradient::Pipelines
         psoDesc.VS = { vsData.data(), vsData.size() };
         psoDesc.PS = { psData.data(), psData.size() };
 
-        m_unmaskedPipelineState = std::make_unique<PipelineState>(psoDesc);
-        m_unmaskedPipelineState->Build(device);
+        m_pipelineStates.UnmaskedPixelDepthReadWrite = std::make_unique<PipelineState>(psoDesc);
+        m_pipelineStates.UnmaskedPixelDepthReadWrite->Build(device);
 
         auto maskedPSData = DX::ReadData(L"PBR_Masked_PS.cso");
 
         psoDesc.PS = { maskedPSData.data(), maskedPSData.size() };
-        m_maskedPipelineState = std::make_unique<PipelineState>(psoDesc);
-        m_maskedPipelineState->Build(device);
+        m_pipelineStates.MaskedPixelDepthReadWrite = std::make_unique<PipelineState>(psoDesc);
+        m_pipelineStates.MaskedPixelDepthReadWrite->Build(device);
     }
 
     void PBRPipeline::InitializeDepthWritePSO(ID3D12Device2* device)
@@ -110,14 +119,14 @@ namespace Gradient::Pipelines
         psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
         psoDesc.VS = { vsData.data(), vsData.size() };
 
-        m_unmaskedDepthWriteOnlyPSO = std::make_unique<PipelineState>(psoDesc);
-        m_unmaskedDepthWriteOnlyPSO->Build(device);
+        m_pipelineStates.UnmaskedDepthWriteOnly = std::make_unique<PipelineState>(psoDesc);
+        m_pipelineStates.UnmaskedDepthWriteOnly->Build(device);
 
         auto maskedPSData = DX::ReadData(L"MaskedDepth_PS.cso");
 
         psoDesc.PS = { maskedPSData.data(), maskedPSData.size() };
-        m_maskedDepthWriteOnlyPSO = std::make_unique<PipelineState>(psoDesc);
-        m_maskedDepthWriteOnlyPSO->Build(device);
+        m_pipelineStates.MaskedDepthWriteOnly = std::make_unique<PipelineState>(psoDesc);
+        m_pipelineStates.MaskedDepthWriteOnly->Build(device);
     }
 
     void PBRPipeline::InitializePixelDepthReadPSO(ID3D12Device2* device)
@@ -133,40 +142,82 @@ namespace Gradient::Pipelines
         psoDesc.VS = { vsData.data(), vsData.size() };
         psoDesc.PS = { psData.data(), psData.size() };
 
-        m_unmaskedPixelDepthReadPSO = std::make_unique<PipelineState>(psoDesc);
-        m_unmaskedPixelDepthReadPSO->Build(device);
+        m_pipelineStates.UnmaskedPixelDepthRead = std::make_unique<PipelineState>(psoDesc);
+        m_pipelineStates.UnmaskedPixelDepthRead->Build(device);
 
         auto maskedPSData = DX::ReadData(L"PBR_Masked_PS.cso");
 
         psoDesc.PS = { maskedPSData.data(), maskedPSData.size() };
-        m_maskedPixelDepthReadPSO = std::make_unique<PipelineState>(psoDesc);
-        m_maskedPixelDepthReadPSO->Build(device);
+        m_pipelineStates.MaskedPixelDepthRead = std::make_unique<PipelineState>(psoDesc);
+        m_pipelineStates.MaskedPixelDepthRead->Build(device);
+    }
+
+    void PBRPipeline::InitializeMeshletPSOs(ID3D12Device2* device)
+    {
+        auto asData = DX::ReadData(L"Meshlet_AS.cso");
+        auto msData = DX::ReadData(L"Meshlet_MS.cso");
+        auto psData = DX::ReadData(L"PBR_PS.cso");
+        auto maskedPSData = DX::ReadData(L"PBR_Masked_PS.cso");
+        auto maskedDepthPSData = DX::ReadData(L"MaskedDepth_PS.cso");
+
+        auto build = [&](D3DX12_MESH_SHADER_PIPELINE_STATE_DESC psoDesc,
+            const std::vector<uint8_t>* psData,
+            std::shared_ptr<PipelineState>& out)
+            {
+                psoDesc.pRootSignature = m_rootSignature.Get();
+                psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+                psoDesc.AS = { asData.data(), asData.size() };
+                psoDesc.MS = { msData.data(), msData.size() };
+                if (psData != nullptr)
+                {
+                    psoDesc.PS = { psData->data(), psData->size() };
+                }
+
+                out = std::make_unique<PipelineState>(psoDesc);
+                out->Build(device);
+            };
+
+        auto& states = m_meshletPipelineStates;
+
+        build(PipelineState::GetDefaultShadowMeshDesc(), nullptr, states.UnmaskedShadow);
+        build(PipelineState::GetDefaultShadowMeshDesc(), &maskedDepthPSData, states.MaskedShadow);
+
+        build(PipelineState::GetDefaultMeshDesc(), nullptr, states.UnmaskedDepthWriteOnly);
+        build(PipelineState::GetDefaultMeshDesc(), &maskedDepthPSData, states.MaskedDepthWriteOnly);
+
+        build(PipelineState::GetDepthWriteDisableMeshDesc(), &psData, states.UnmaskedPixelDepthRead);
+        build(PipelineState::GetDepthWriteDisableMeshDesc(), &maskedPSData, states.MaskedPixelDepthRead);
+
+        build(PipelineState::GetDefaultMeshDesc(), &psData, states.UnmaskedPixelDepthReadWrite);
+        build(PipelineState::GetDefaultMeshDesc(), &maskedPSData, states.MaskedPixelDepthReadWrite);
     }
 
     void PBRPipeline::ApplyDepthOnlyPipeline(ID3D12GraphicsCommandList* cl,
         bool multisampled,
         DrawType passType)
     {
+        const auto& pipelineStates = GetPipelineStates();
+
         if (passType == DrawType::ShadowPass)
         {
             if (m_material.Masked)
             {
-                m_maskedShadowPipelineState->Set(cl, false);
+                pipelineStates.MaskedShadow->Set(cl, false);
             }
             else
             {
-                m_unmaskedShadowPipelineState->Set(cl, false);
+                pipelineStates.UnmaskedShadow->Set(cl, false);
             }
         }
         else if (passType == DrawType::DepthWriteOnly)
         {
             if (m_material.Masked)
             {
-                m_maskedDepthWriteOnlyPSO->Set(cl, multisampled);
+                pipelineStates.MaskedDepthWriteOnly->Set(cl, multisampled);
             }
             else
             {
-                m_unmaskedDepthWriteOnlyPSO->Set(cl, multisampled);
+                pipelineStates.UnmaskedDepthWriteOnly->Set(cl, multisampled);
             }
         }
 
@@ -178,6 +229,7 @@ namespace Gradient::Pipelines
             m_world * m_view * m_proj);
 
         m_rootSignature.SetCBV(cl, 0, 0, vertexConstants);
+        SetMeshletBuffers(cl, passType);
 
         cl->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
     }
@@ -191,26 +243,29 @@ namespace Gradient::Pipelines
             ApplyDepthOnlyPipeline(cl, multisampled, passType);
             return;
         }
-        else if (passType == DrawType::PixelDepthReadOnly)
+
+        const auto& pipelineStates = GetPipelineStates();
+
+        if (passType == DrawType::PixelDepthReadOnly)
         {
             if (m_material.Masked)
             {
-                m_maskedPixelDepthReadPSO->Set(cl, multisampled);
+                pipelineStates.MaskedPixelDepthRead->Set(cl, multisampled);
             }
             else
             {
-                m_unmaskedPixelDepthReadPSO->Set(cl, multisampled);
+                pipelineStates.UnmaskedPixelDepthRead->Set(cl, multisampled);
             }
         }
         else  // passType == DrawType::PixelDepthReadWrite
         {
             if (m_material.Masked)
             {
-                m_maskedPipelineState->Set(cl, multisampled);
+                pipelineStates.MaskedPixelDepthReadWrite->Set(cl, multisampled);
             }
             else
             {
-                m_unmaskedPipelineState->Set(cl, multisampled);
+                pipelineStates.UnmaskedPixelDepthReadWrite->Set(cl, multisampled);
             }
         }
 
@@ -222,6 +277,7 @@ namespace Gradient::Pipelines
             m_world * m_view * m_proj);
 
         m_rootSignature.SetCBV(cl, 0, 0, vertexConstants);
+        SetMeshletBuffers(cl, passType);
 
         auto lightBufferData = m_dLightCBData;
         lightBufferData.numPointLights = std::min(MAX_POINT_LIGHTS, m_pointLights.size());
@@ -248,7 +304,6 @@ namespace Gradient::Pipelines
         PixelCB pixelConstants;
         pixelConstants.cameraPosition = m_cameraPosition;
         pixelConstants.tiling = m_material.Tiling;
-        pixelConstants.shadowTransform = DirectX::XMMatrixTranspose(m_shadowTransform);
         pixelConstants.emissiveRadiance = m_material.EmissiveRadiance;
 
         m_rootSignature.SetCBV(cl, 1, 1, pixelConstants);
@@ -266,6 +321,59 @@ namespace Gradient::Pipelines
         cl->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
     }
 
+    void PBRPipeline::SetMeshlets(const Rendering::ProceduralMesh::MeshletView* meshlets)
+    {
+        if (meshlets != nullptr)
+        {
+            m_meshlets = *meshlets;
+        }
+        else
+        {
+            m_meshlets.reset();
+        }
+    }
+
+    uint32_t PBRPipeline::GetMeshletGroupCount() const
+    {
+        if (!m_meshlets)
+            return 0;
+
+        return Math::DivRoundUp(m_meshlets->NumMeshlets,
+            Rendering::Meshlets::MeshletsPerGroup);
+    }
+
+    const PBRPipeline::PipelineStates& PBRPipeline::GetPipelineStates() const
+    {
+        return m_meshlets ? m_meshletPipelineStates : m_pipelineStates;
+    }
+
+    void PBRPipeline::SetMeshletBuffers(ID3D12GraphicsCommandList* cl, DrawType passType)
+    {
+        if (!m_meshlets)
+            return;
+
+        DirectX::XMFLOAT4X4 world;
+        DirectX::XMStoreFloat4x4(&world, m_world);
+
+        MeshletCullingCB cullingConstants;
+        std::copy(CullingFrustumPlanes.begin(),
+            CullingFrustumPlanes.end(),
+            cullingConstants.cullingFrustumPlanes);
+        cullingConstants.cameraPosition = m_cameraPosition;
+        cullingConstants.worldScale = Rendering::Meshlets::GetMaxScale(world);
+        cullingConstants.numMeshlets = m_meshlets->NumMeshlets;
+        // A normal cone only bounds the normals under uniform scales
+        cullingConstants.coneCulling = ConeCulling
+            && passType != DrawType::ShadowPass
+            && Rendering::Meshlets::IsUniformScale(world);
+
+        m_rootSignature.SetCBV(cl, 1, 0, cullingConstants);
+        m_rootSignature.SetStructuredBufferSRV(cl, 0, 0, m_meshlets->Vertices);
+        m_rootSignature.SetStructuredBufferSRV(cl, 1, 0, m_meshlets->Meshlets);
+        m_rootSignature.SetStructuredBufferSRV(cl, 2, 0, m_meshlets->MeshletVertices);
+        m_rootSignature.SetStructuredBufferSRV(cl, 3, 0, m_meshlets->MeshletTriangles);
+    }
+
     void PBRPipeline::SetMaterial(const Rendering::PBRMaterial& material)
     {
         m_material = material;
@@ -284,16 +392,13 @@ namespace Gradient::Pipelines
     void PBRPipeline::SetDirectionalLight(Rendering::DirectionalLight* dlight)
     {
         m_shadowMap = dlight->GetShadowMapSRV();
-        m_shadowTransform = dlight->GetShadowTransform();
-
-        m_dLightCBData.directionalLight.colour = static_cast<DirectX::XMFLOAT3>(dlight->GetColour());
-        m_dLightCBData.directionalLight.irradiance = dlight->GetIrradiance();
-        m_dLightCBData.directionalLight.direction = dlight->GetDirection();
+        m_dLightCBData.directionalLight = dlight->GetShaderConstants();
     }
 
-    void PBRPipeline::SetPointLights(std::vector<Params::PointLight> pointLights)
+    void PBRPipeline::SetPointLights(std::span<const Params::PointLight> pointLights)
     {
-        m_pointLights = pointLights;
+        // Reuses the vector's storage from the last frame
+        m_pointLights.assign(pointLights.begin(), pointLights.end());
     }
 
     void PBRPipeline::SetWorld(DirectX::FXMMATRIX value)
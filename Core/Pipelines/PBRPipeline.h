@@ -7,11 +7,15 @@
 #include "Core/Rendering/PointLight.h"
 #include "Core/RootSignature.h"
 #include "Core/PipelineState.h"
+#include "Core/Rendering/ProceduralMesh.h"
 #include <directxtk12/Effects.h>
 #include <directxtk12/VertexTypes.h>
 #include <directxtk12/SimpleMath.h>
 #include <directxtk12/BufferHelpers.h>
 #include <directxtk12/CommonStates.h>
+#include <array>
+#include <optional>
+#include <span>
 
 namespace Gradient::Pipelines
 {
@@ -32,7 +36,6 @@ namespace Gradient::Pipelines
             float tiling;
             DirectX::XMFLOAT3 emissiveRadiance;
             float pad2;
-            DirectX::XMMATRIX shadowTransform;
         };
 
         struct __declspec(align(256)) LightCB
@@ -42,6 +45,15 @@ namespace Gradient::Pipelines
             uint32_t numPointLights;
         };
 
+        struct __declspec(align(256)) MeshletCullingCB
+        {
+            DirectX::XMFLOAT4 cullingFrustumPlanes[6];
+            DirectX::XMFLOAT3 cameraPosition;
+            float worldScale;
+            uint32_t numMeshlets;
+            uint32_t coneCulling;
+        };
+
         using VertexType = DirectX::VertexPositionNormalTexture;
 
         explicit PBRPipeline(ID3D12Device2* device);
@@ -60,33 +72,55 @@ namespace Gradient::Pipelines
 
         void SetCameraPosition(DirectX::SimpleMath::Vector3 cameraPosition);
         void SetDirectionalLight(Rendering::DirectionalLight* dlight);
-        void SetPointLights(std::vector<Params::PointLight> pointLights);
+        void SetPointLights(std::span<const Params::PointLight> pointLights);
         void SetEnvironmentMap(GraphicsMemoryManager::DescriptorView index);
         void SetShadowCubeArray(GraphicsMemoryManager::DescriptorView index);
+        // Draws the mesh's meshlets with Meshlet_AS and Meshlet_MS, which
+        // cull them against CullingFrustumPlanes and by their normal cones.
+        // They're drawn with a DispatchMesh of GetMeshletGroupCount groups.
+        // Null goes back to drawing through the input assembler.
+        void SetMeshlets(const Rendering::ProceduralMesh::MeshletView* meshlets);
+        uint32_t GetMeshletGroupCount() const;
+
         GraphicsMemoryManager::DescriptorView GTAOTexture;
+        std::array<DirectX::XMFLOAT4, 6> CullingFrustumPlanes;
+        // Only outside of the shadow pass, whose camera position
+        // isn't where the shadow map is seen from.
+        bool ConeCulling = true;
 
     private:
+        // The PSOs for one way of getting the vertices in
+        struct PipelineStates
+        {
+            std::shared_ptr<PipelineState> UnmaskedShadow;
+            std::shared_ptr<PipelineState> UnmaskedDepthWriteOnly;
+            std::shared_ptr<PipelineState> UnmaskedPixelDepthRead;
+            std::shared_ptr<PipelineState> UnmaskedPixelDepthReadWrite;
+
+            std::shared_ptr<PipelineState> MaskedShadow;
+            std::shared_ptr<PipelineState> MaskedDepthWriteOnly;
+            std::shared_ptr<PipelineState> MaskedPixelDepthRead;
+            std::shared_ptr<PipelineState> MaskedPixelDepthReadWrite;
+        };
+
         void InitializeRootSignature(ID3D12Device* device);
         void InitializeShadowPSO(ID3D12Device2* device);
         void InitializeRenderPSO(ID3D12Device2* device);
         void InitializeDepthWritePSO(ID3D12Device2* device);
         void InitializePixelDepthReadPSO(ID3D12Device2* device);
+        void InitializeMeshletPSOs(ID3D12Device2* device);
         void ApplyDepthOnlyPipeline(ID3D12GraphicsCommandList* cl,
             bool multisampled,
             DrawType passType);
+        const PipelineStates& GetPipelineStates() const;
+        void SetMeshletBuffers(ID3D12GraphicsCommandList* cl, DrawType passType);
 
         RootSignature m_rootSignature;
-        std::unique_ptr<PipelineState> m_unmaskedPipelineState;
-        std::unique_ptr<PipelineState> m_unmaskedShadowPipelineState;
-        std::unique_ptr<PipelineState> m_unmaskedDepthWriteOnlyPSO;
-        std::unique_ptr<PipelineState> m_unmaskedPixelDepthReadPSO;
-
-        std::unique_ptr<PipelineState> m_maskedPipelineState;
-        std::unique_ptr<PipelineState> m_maskedShadowPipelineState;
-        std::unique_ptr<PipelineState> m_maskedDepthWriteOnlyPSO;
-        std::unique_ptr<PipelineState> m_maskedPixelDepthReadPSO;
+        PipelineStates m_pipelineStates;
+        PipelineStates m_meshletPipelineStates;
 
         Rendering::PBRMaterial m_material;
+        std::optional<Rendering::ProceduralMesh::MeshletView> m_meshlets;
 
         GraphicsMemoryManager::DescriptorView m_shadowMap;
         GraphicsMemoryManager::DescriptorView m_environmentMap;
@@ -95,7 +129,6 @@ namespace Gradient::Pipelines
         DirectX::SimpleMath::Matrix m_world;
         DirectX::SimpleMath::Matrix m_view;
         DirectX::SimpleMath::Matrix m_proj;
-        DirectX::SimpleMath::Matrix m_shadowTransform;
 
         DirectX::SimpleMath::Vector3 m_cameraPosition;
 
@@ -103,6 +103,9 @@ namespace Gradient::Pipelines
 
             amplitudeFactor *= 0.9;
         }
+
+        // Each wave raises the water by up to twice its amplitude
+        assert(2.f * m_maxAmplitude <= MaxWaveHeight);
     }
 
     void WaterPipeline::Apply(ID3D12GraphicsCommandList* cl,
@@ -145,9 +148,7 @@ namespace Gradient::Pipelines
         m_rootSignature.SetCBV(cl, 1, 2, waveConstants);
 
         LightCB lightConstants;
-        lightConstants.directionalLight.colour = static_cast<DirectX::XMFLOAT3>(m_directionalLightColour);
-        lightConstants.directionalLight.irradiance = m_lightIrradiance;
-        lightConstants.directionalLight.direction = m_lightDirection;
+        lightConstants.directionalLight = m_directionalLight;
         lightConstants.numPointLights = std::min(MAX_POINT_LIGHTS, m_pointLights.size());
         for (int i = 0; i < lightConstants.numPointLights; i++)
         {
@@ -172,7 +173,6 @@ namespace Gradient::Pipelines
         PixelParamCB pixelConstants;
         pixelConstants.cameraPosition = m_cameraPosition;
         pixelConstants.maxAmplitude = m_maxAmplitude;
-        pixelConstants.shadowTransform = DirectX::XMMatrixTranspose(m_shadowTransform);
         pixelConstants.thicknessPower = m_waterParams.Scattering.ThicknessPower;
         pixelConstants.sharpness = m_waterParams.Scattering.Sharpness;
         pixelConstants.refractiveIndex = m_waterParams.Scattering.RefractiveIndex;
@@ -223,16 +223,14 @@ namespace Gradient::Pipelines
 
     void WaterPipeline::SetDirectionalLight(Rendering::DirectionalLight* dlight)
     {
-        m_directionalLightColour = dlight->GetColour();
-        m_lightDirection = dlight->GetDirection();
-        m_lightIrradiance = dlight->GetIrradiance();
+        m_directionalLight = dlight->GetShaderConstants();
         m_shadowMap = dlight->GetShadowMapSRV();
-        m_shadowTransform = dlight->GetShadowTransform();
     }
 
-    void WaterPipeline::SetPointLights(std::vector<Params::PointLight> pointLights)
+    void WaterPipeline::SetPointLights(std::span<const Params::PointLight> pointLights)
     {
-        m_pointLights = pointLights;
+        // Reuses the vector's storage from the last frame
+        m_pointLights.assign(pointLights.begin(), pointLights.end());
     }
 
     void WaterPipeline::SetEnvironmentMap(GraphicsMemoryManager::DescriptorView index)
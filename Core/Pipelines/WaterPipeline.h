@@ -12,6 +12,7 @@
 #include <directxtk12/SimpleMath.h>
 #include <directxtk12/BufferHelpers.h>
 #include <directxtk12/CommonStates.h>
+#include <span>
 #include <array>
 
 namespace Gradient::Pipelines
@@ -21,6 +22,8 @@ namespace Gradient::Pipelines
     public:
         static const size_t MAX_POINT_LIGHTS = 8;
         static constexpr int MAX_WAVES = 32;
+        // The waves only ever raise the water, and never by more than this
+        static constexpr float MaxWaveHeight = 2.f;
 
         struct __declspec(align(256)) MatrixCB
         {
@@ -51,7 +54,6 @@ namespace Gradient::Pipelines
         {
             DirectX::XMFLOAT3 cameraPosition;
             float maxAmplitude;
-            DirectX::XMMATRIX shadowTransform;
             float thicknessPower;
             float sharpness;
             float refractiveIndex;
@@ -82,7 +84,7 @@ namespace Gradient::Pipelines
         void SetCameraPosition(DirectX::SimpleMath::Vector3 cameraPosition);
         void SetCameraDirection(DirectX::SimpleMath::Vector3 cameraDirection);
         void SetDirectionalLight(Rendering::DirectionalLight* dlight);
-        void SetPointLights(std::vector<Params::PointLight> pointLights);
+        void SetPointLights(std::span<const Params::PointLight> pointLights);
         void SetEnvironmentMap(GraphicsMemoryManager::DescriptorView index);
         void SetShadowCubeArray(GraphicsMemoryManager::DescriptorView index);
         void SetTotalTime(float totalTimeSeconds);
@@ -94,7 +96,7 @@ namespace Gradient::Pipelines
         void GenerateWaves();
 
         RootSignature m_rootSignature;
-        std::unique_ptr<PipelineState> m_pso;
+        std::shared_ptr<PipelineState> m_pso;
 
         GraphicsMemoryManager::DescriptorView m_shadowMap;
         GraphicsMemoryManager::DescriptorView m_environmentMap;
@@ -103,15 +105,11 @@ namespace Gradient::Pipelines
         DirectX::SimpleMath::Matrix m_world;
         DirectX::SimpleMath::Matrix m_view;
         DirectX::SimpleMath::Matrix m_proj;
-        DirectX::SimpleMath::Matrix m_shadowTransform;
 
         DirectX::SimpleMath::Vector3 m_cameraPosition;
         DirectX::SimpleMath::Vector3 m_cameraDirection;
 
-        // TODO: Store a Params::DirectionalLight instead.
-        DirectX::SimpleMath::Color   m_directionalLightColour;
-        DirectX::SimpleMath::Vector3 m_lightDirection;
-        float m_lightIrradiance;
+        AlignedDirectionalLight m_directionalLight;
 
         std::vector<Params::PointLight> m_pointLights;
 
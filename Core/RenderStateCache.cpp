@@ -0,0 +1,103 @@
+#include "pch.h"
+
+#include "Core/RenderStateCache.h"
+
+#include <atomic>
+
+namespace Gradient
+{
+    namespace
+    {
+        thread_local RenderStateCache t_cache;
+
+        std::atomic<uint32_t> s_pipelineStates = 0;
+        std::atomic<uint32_t> s_rootSignatures = 0;
+        std::atomic<uint32_t> s_descriptors = 0;
+        std::atomic<uint32_t> s_skipped = 0;
+    }
+
+    RenderStateCache& RenderStateCache::Get()
+    {
+        return t_cache;
+    }
+
+    void RenderStateCache::Begin()
+    {
+        // Anything could have been bound since the last time
+        m_active = true;
+        m_pso = nullptr;
+        m_rootSignature = nullptr;
+        ForgetRootParameters();
+    }
+
+    void RenderStateCache::End()
+    {
+        m_active = false;
+    }
+
+    bool RenderStateCache::SetPipelineState(ID3D12PipelineState* pso)
+    {
+        if (m_active && pso == m_pso)
+        {
+            s_skipped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        m_pso = pso;
+        s_pipelineStates.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    bool RenderStateCache::SetRootSignature(ID3D12RootSignature* rootSignature)
+    {
+        if (m_active && rootSignature == m_rootSignature)
+        {
+            s_skipped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        // Changing the root signature unbinds every root parameter
+        m_rootSignature = rootSignature;
+        ForgetRootParameters();
+        s_rootSignatures.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    bool RenderStateCache::SetRootParameter(UINT index, uint64_t value)
+    {
+        assert(index < MaxRootParameters);
+
+        if (m_active && value != 0 && m_rootParameters[index] == value)
+        {
+            s_skipped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        m_rootParameters[index] = value;
+        s_descriptors.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    RenderStateCache::Counters RenderStateCache::GetFrameCounters()
+    {
+        Counters out;
+        out.PipelineStates = s_pipelineStates.load(std::memory_order_relaxed);
+        out.RootSignatures = s_rootSignatures.load(std::memory_order_relaxed);
+        out.Descriptors = s_descriptors.load(std::memory_order_relaxed);
+        out.Skipped = s_skipped.load(std::memory_order_relaxed);
+        return out;
+    }
+
+    void RenderStateCache::ResetFrameCounters()
+    {
+        s_pipelineStates.store(0, std::memory_order_relaxed);
+        s_rootSignatures.store(0, std::memory_order_relaxed);
+        s_descriptors.store(0, std::memory_order_relaxed);
+        s_skipped.store(0, std::memory_order_relaxed);
+    }
+
+    void RenderStateCache::ForgetRootParameters()
+    {
+        m_rootParameters.fill(0);
+    }
+}
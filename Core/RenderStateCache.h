@@ -0,0 +1,55 @@
+#pragma once
+
+#include "pch.h"
+
+#include <array>
+
+namespace Gradient
+{
+    // Remembers what the current thread last bound on its command list,
+    // so that binding the same PSO, root signature or descriptor again
+    // can be skipped. PipelineState and RootSignature go through this.
+    //
+    // Binds are only skipped between Begin and End, where everything 
+    // is bound through those two classes. Outside of that, other code
+    // sets state on the command list directly, so binds always go 
+    // through. Either way, the binds that go through are counted.
+    class RenderStateCache
+    {
+    public:
+        struct Counters
+        {
+            uint32_t PipelineStates = 0;
+            uint32_t RootSignatures = 0;
+            uint32_t Descriptors = 0;
+            uint32_t Skipped = 0;
+        };
+
+        static RenderStateCache& Get();
+
+        void Begin();
+        void End();
+
+        // These return false if the state is already bound, 
+        // and the bind can be skipped.
+        bool SetPipelineState(ID3D12PipelineState* pso);
+        bool SetRootSignature(ID3D12RootSignature* rootSignature);
+        // Descriptor tables, and root CBVs and SRVs, by root parameter
+        bool SetRootParameter(UINT index, uint64_t value);
+
+        // Totals across all threads since the last reset
+        static Counters GetFrameCounters();
+        static void ResetFrameCounters();
+
+    private:
+        static constexpr size_t MaxRootParameters = 64;
+
+        void ForgetRootParameters();
+
+        bool m_active = false;
+        ID3D12PipelineState* m_pso = nullptr;
+        ID3D12RootSignature* m_rootSignature = nullptr;
+        // Zero means unknown
+        std::array<uint64_t, MaxRootParameters> m_rootParameters = {};
+    };
+}
@@ -0,0 +1,501 @@
+#include "pch.h"
+
+#include "Core/Rendering/BoundingVolumeHierarchy.h"
+#include "Core/FrameArena.h"
+#include "Core/Jobs/JobSystem.h"
+#include "Core/Math.h"
+
+#include <numeric>
+#include <optional>
+
+using namespace DirectX;
+
+namespace Gradient::Rendering
+{
+    namespace
+    {
+        BoundingBox Merge(const BoundingBox& a, const BoundingBox& b)
+        {
+            BoundingBox out;
+            BoundingBox::CreateMerged(out, a, b);
+            return out;
+        }
+
+        float GetAxis(const XMFLOAT3& v, int axis)
+        {
+            return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+        }
+
+        constexpr uint32_t AllPlanes = (1 << 6) - 1;
+
+        // Enough subtrees that the workers can balance uneven ones
+        constexpr size_t ParallelSubtrees = 64;
+
+        // Returns the planes the box still straddles, or nullopt if
+        // it's entirely behind one of them.
+        std::optional<uint32_t> TestBox(const std::array<XMFLOAT4, 6>& planes,
+            const BoundingBox& box,
+            uint32_t planeMask)
+        {
+            for (uint32_t p = 0; p < planes.size(); p++)
+            {
+                if (!(planeMask & (1 << p))) continue;
+
+                const auto& plane = planes[p];
+                float distance = plane.x * box.Center.x
+                    + plane.y * box.Center.y
+                    + plane.z * box.Center.z
+                    + plane.w;
+                float radius = std::abs(plane.x) * box.Extents.x
+                    + std::abs(plane.y) * box.Extents.y
+                    + std::abs(plane.z) * box.Extents.z;
+
+                if (distance + radius < 0)
+                    return std::nullopt;
+
+                if (distance - radius >= 0)
+                    planeMask &= ~(1 << p);
+            }
+
+            return planeMask;
+        }
+
+        XMVECTOR XM_CALLCONV LoadFour(const std::vector<float>& values, size_t index)
+        {
+            return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&values[index]));
+        }
+
+        // Writes into space set aside for a subtree, which never
+        // holds more than the subtree's items.
+        struct RangeWriter
+        {
+            uint32_t* Data;
+            uint32_t Count;
+
+            void push_back(uint32_t id)
+            {
+                Data[Count++] = id;
+            }
+        };
+    }
+
+    void BoundingVolumeHierarchy::Build(std::vector<Item> items)
+    {
+        Clear();
+
+        if (items.empty())
+            return;
+
+        // Building reorders the items, so sort indices to them
+        // and remember where each one came from.
+        std::vector<uint32_t> order(items.size());
+        std::iota(order.begin(), order.end(), 0);
+
+        m_nodes.reserve(2 * Math::DivRoundUp(items.size(), size_t(MaxItemsPerLeaf)));
+        BuildNode(items, order, 0, static_cast<uint32_t>(items.size()));
+
+        m_items.resize(items.size());
+        m_itemSlots.resize(items.size());
+
+        // Leaves can start at any slot, and always load four
+        const size_t packedSize = items.size() + 3;
+        m_centerX.assign(packedSize, 0.f);
+        m_centerY.assign(packedSize, 0.f);
+        m_centerZ.assign(packedSize, 0.f);
+        m_extentX.assign(packedSize, 0.f);
+        m_extentY.assign(packedSize, 0.f);
+        m_extentZ.assign(packedSize, 0.f);
+
+        for (uint32_t slot = 0; slot < order.size(); slot++)
+        {
+            m_items[slot] = items[order[slot]];
+            m_itemSlots[order[slot]] = slot;
+            SetPackedBounds(slot, m_items[slot].Bounds);
+        }
+
+        m_slotLeaves.resize(items.size());
+        for (uint32_t n = 0; n < m_nodes.size(); n++)
+        {
+            const auto& node = m_nodes[n];
+            if (!node.IsLeaf) continue;
+
+            for (uint32_t i = node.FirstItem; i < node.FirstItem + node.ItemCount; i++)
+            {
+                m_slotLeaves[i] = n;
+            }
+        }
+
+        m_dirtyNodes.assign(m_nodes.size(), 0);
+    }
+
+    uint32_t BoundingVolumeHierarchy::BuildNode(const std::vector<Item>& items,
+        std::vector<uint32_t>& order,
+        uint32_t firstItem,
+        uint32_t itemCount)
+    {
+        uint32_t nodeIndex = static_cast<uint32_t>(m_nodes.size());
+        m_nodes.push_back({});
+
+        const auto& first = items[order[firstItem]].Bounds;
+        BoundingBox bounds = first;
+        BoundingBox centres(first.Center, { 0, 0, 0 });
+        for (uint32_t i = firstItem + 1; i < firstItem + itemCount; i++)
+        {
+            const auto& itemBounds = items[order[i]].Bounds;
+            bounds = Merge(bounds, itemBounds);
+            centres = Merge(centres, BoundingBox(itemBounds.Center, { 0, 0, 0 }));
+        }
+
+        Node node;
+        node.Bounds = bounds;
+        node.RightChild = 0;
+        node.FirstItem = firstItem;
+        node.ItemCount = itemCount;
+        node.IsLeaf = itemCount <= MaxItemsPerLeaf;
+
+        if (!node.IsLeaf)
+        {
+            // Split at the median along the longest axis of the centres
+            int axis = 0;
+            if (centres.Extents.y > GetAxis(centres.Extents, axis)) axis = 1;
+            if (centres.Extents.z > GetAxis(centres.Extents, axis)) axis = 2;
+
+            uint32_t half = itemCount / 2;
+            std::nth_element(order.begin() + firstItem,
+                order.begin() + firstItem + half,
+                order.begin() + firstItem + itemCount,
+                [&items, axis](uint32_t a, uint32_t b)
+                {
+                    return GetAxis(items[a].Bounds.Center, axis)
+                        < GetAxis(items[b].Bounds.Center, axis);
+                });
+
+            BuildNode(items, order, firstItem, half);
+            node.RightChild = BuildNode(items, order, firstItem + half, itemCount - half);
+        }
+
+        m_nodes[nodeIndex] = node;
+        return nodeIndex;
+    }
+
+    void BoundingVolumeHierarchy::Clear()
+    {
+        m_nodes.clear();
+        m_items.clear();
+        m_centerX.clear();
+        m_centerY.clear();
+        m_centerZ.clear();
+        m_extentX.clear();
+        m_extentY.clear();
+        m_extentZ.clear();
+        m_itemSlots.clear();
+        m_slotLeaves.clear();
+        m_dirtyNodes.clear();
+        m_needsRefit = false;
+    }
+
+    size_t BoundingVolumeHierarchy::Size() const
+    {
+        return m_items.size();
+    }
+
+    void BoundingVolumeHierarchy::SetBounds(size_t buildIndex, const BoundingBox& bounds)
+    {
+        auto slot = m_itemSlots[buildIndex];
+        m_items[slot].Bounds = bounds;
+        SetPackedBounds(slot, bounds);
+        m_dirtyNodes[m_slotLeaves[slot]] = 1;
+        m_needsRefit = true;
+    }
+
+    void BoundingVolumeHierarchy::SetPackedBounds(uint32_t slot, const BoundingBox& bounds)
+    {
+        m_centerX[slot] = bounds.Center.x;
+        m_centerY[slot] = bounds.Center.y;
+        m_centerZ[slot] = bounds.Center.z;
+        m_extentX[slot] = bounds.Extents.x;
+        m_extentY[slot] = bounds.Extents.y;
+        m_extentZ[slot] = bounds.Extents.z;
+    }
+
+    void BoundingVolumeHierarchy::Refit()
+    {
+        if (!m_needsRefit)
+            return;
+
+        // Children always come after their parents, so going backwards
+        // visits every child before its parent.
+        for (size_t n = m_nodes.size(); n-- > 0;)
+        {
+            auto& node = m_nodes[n];
+
+            if (node.IsLeaf)
+            {
+                if (!m_dirtyNodes[n]) continue;
+
+                node.Bounds = m_items[node.FirstItem].Bounds;
+                for (uint32_t i = node.FirstItem + 1; i < node.FirstItem + node.ItemCount; i++)
+                {
+                    node.Bounds = Merge(node.Bounds, m_items[i].Bounds);
+                }
+            }
+            else
+            {
+                auto left = n + 1;
+                auto right = node.RightChild;
+                if (!m_dirtyNodes[left] && !m_dirtyNodes[right]) continue;
+
+                node.Bounds = Merge(m_nodes[left].Bounds, m_nodes[right].Bounds);
+                m_dirtyNodes[n] = 1;
+                m_dirtyNodes[left] = 0;
+                m_dirtyNodes[right] = 0;
+            }
+        }
+
+        m_dirtyNodes[0] = 0;
+        m_needsRefit = false;
+    }
+
+    template <typename Output>
+    void BoundingVolumeHierarchy::AppendItems(const Node& node, Output& ids) const
+    {
+        for (uint32_t i = node.FirstItem; i < node.FirstItem + node.ItemCount; i++)
+        {
+            ids.push_back(m_items[i].Id);
+        }
+    }
+
+    template <typename Output>
+    void BoundingVolumeHierarchy::QueryLeaf(const std::array<XMFLOAT4, 6>& planes,
+        const Node& leaf,
+        uint32_t planeMask,
+        Output& ids) const
+    {
+        // The lanes past the leaf's items belong to the next leaf
+        // or the padding, and are never read back.
+        const size_t first = leaf.FirstItem;
+        XMVECTOR centerX = LoadFour(m_centerX, first);
+        XMVECTOR centerY = LoadFour(m_centerY, first);
+        XMVECTOR centerZ = LoadFour(m_centerZ, first);
+        XMVECTOR extentX = LoadFour(m_extentX, first);
+        XMVECTOR extentY = LoadFour(m_extentY, first);
+        XMVECTOR extentZ = LoadFour(m_extentZ, first);
+
+        const XMVECTOR zero = XMVectorZero();
+        XMVECTOR inside = XMVectorTrueInt();
+
+        for (uint32_t p = 0; p < planes.size(); p++)
+        {
+            if (!(planeMask & (1 << p))) continue;
+
+            // In the same order as TestBox, so both agree on boxes
+            // that just touch a plane.
+            const auto& plane = planes[p];
+            XMVECTOR distance = XMVectorAdd(
+                XMVectorAdd(
+                    XMVectorAdd(
+                        XMVectorScale(centerX, plane.x),
+                        XMVectorScale(centerY, plane.y)),
+                    XMVectorScale(centerZ, plane.z)),
+                XMVectorReplicate(plane.w));
+            XMVECTOR radius = XMVectorAdd(
+                XMVectorAdd(
+                    XMVectorScale(extentX, std::abs(plane.x)),
+                    XMVectorScale(extentY, std::abs(plane.y))),
+                XMVectorScale(extentZ, std::abs(plane.z)));
+
+            inside = XMVectorAndInt(inside,
+                XMVectorGreaterOrEqual(XMVectorAdd(distance, radius), zero));
+        }
+
+        XMUINT4 lanes;
+        XMStoreUInt4(&lanes, inside);
+        const uint32_t laneValues[4] = { lanes.x, lanes.y, lanes.z, lanes.w };
+
+        for (uint32_t i = 0; i < leaf.ItemCount; i++)
+        {
+            if (laneValues[i])
+            {
+                ids.push_back(m_items[first + i].Id);
+            }
+        }
+    }
+
+    template <typename Output>
+    void BoundingVolumeHierarchy::QuerySubtree(const std::array<XMFLOAT4, 6>& planes,
+        StackEntry subtree,
+        Output& ids) const
+    {
+        FrameVector<StackEntry> stack;
+        stack.reserve(64);
+        stack.push_back(subtree);
+
+        while (!stack.empty())
+        {
+            auto [nodeIndex, planeMask] = stack.back();
+            stack.pop_back();
+
+            const auto& node = m_nodes[nodeIndex];
+
+            if (planeMask == 0)
+            {
+                // Entirely inside, so everything below is too.
+                AppendItems(node, ids);
+            }
+            else if (node.IsLeaf)
+            {
+                QueryLeaf(planes, node, planeMask, ids);
+            }
+            else
+            {
+                // Children are tested before they're pushed, so
+                // culled ones never reach the stack.
+                if (auto rightMask = TestBox(planes, m_nodes[node.RightChild].Bounds, planeMask))
+                {
+                    stack.push_back({ node.RightChild, rightMask.value() });
+                }
+                if (auto leftMask = TestBox(planes, m_nodes[nodeIndex + 1].Bounds, planeMask))
+                {
+                    stack.push_back({ nodeIndex + 1, leftMask.value() });
+                }
+            }
+        }
+    }
+
+    void BoundingVolumeHierarchy::Query(const std::array<XMFLOAT4, 6>& planes,
+        std::vector<uint32_t>& ids) const
+    {
+        if (m_nodes.empty())
+            return;
+
+        auto rootMask = TestBox(planes, m_nodes[0].Bounds, AllPlanes);
+        if (!rootMask)
+            return;
+
+        QuerySubtree(planes, { 0, rootMask.value() }, ids);
+    }
+
+    void BoundingVolumeHierarchy::Query(const std::array<XMFLOAT4, 6>& planes,
+        std::vector<uint32_t>& ids,
+        Jobs::JobSystem& jobSystem) const
+    {
+        if (m_nodes.empty())
+            return;
+
+        auto rootMask = TestBox(planes, m_nodes[0].Bounds, AllPlanes);
+        if (!rootMask)
+            return;
+
+        // Splits the tree a level at a time, dropping whatever's culled,
+        // until there are enough subtrees to share out.
+        FrameVector<StackEntry> subtrees;
+        FrameVector<StackEntry> nextSubtrees;
+        subtrees.push_back({ 0, rootMask.value() });
+
+        bool split = true;
+        while (split && subtrees.size() < ParallelSubtrees)
+        {
+            split = false;
+            nextSubtrees.clear();
+
+            for (auto subtree : subtrees)
+            {
+                const auto& node = m_nodes[subtree.Node];
+                if (node.IsLeaf || subtree.PlaneMask == 0)
+                {
+                    nextSubtrees.push_back(subtree);
+                    continue;
+                }
+
+                for (auto child : { subtree.Node + 1, node.RightChild })
+                {
+                    if (auto childMask = TestBox(planes, m_nodes[child].Bounds, subtree.PlaneMask))
+                    {
+                        nextSubtrees.push_back({ child, childMask.value() });
+                    }
+                }
+                split = true;
+            }
+
+            std::swap(subtrees, nextSubtrees);
+        }
+
+        // Each subtree writes over the slots of its own items, which no
+        // other subtree shares, so the jobs never touch the same memory.
+        FrameVector<uint32_t> found(m_items.size());
+        FrameVector<uint32_t> foundCounts(subtrees.size());
+
+        jobSystem.ParallelFor(subtrees.size(), 1,
+            [&](size_t begin, size_t end)
+            {
+                for (size_t i = begin; i < end; i++)
+                {
+                    RangeWriter writer{ found.data() + m_nodes[subtrees[i].Node].FirstItem, 0 };
+                    QuerySubtree(planes, subtrees[i], writer);
+                    foundCounts[i] = writer.Count;
+                }
+            },
+            Jobs::JobPriority::High);
+
+        for (size_t i = 0; i < subtrees.size(); i++)
+        {
+            const auto first = found.begin() + m_nodes[subtrees[i].Node].FirstItem;
+            ids.insert(ids.end(), first, first + foundCounts[i]);
+        }
+    }
+
+    void BoundingVolumeHierarchy::Query(const BoundingFrustum& frustum,
+        std::vector<uint32_t>& ids) const
+    {
+        Query(Math::GetPlanes(frustum), ids);
+    }
+
+    void BoundingVolumeHierarchy::Query(const BoundingOrientedBox& box,
+        std::vector<uint32_t>& ids) const
+    {
+        Query(Math::GetPlanes(box), ids);
+    }
+
+    void BoundingVolumeHierarchy::Query(const BoundingSphere& sphere,
+        std::vector<uint32_t>& ids) const
+    {
+        if (m_nodes.empty())
+            return;
+
+        FrameVector<uint32_t> stack;
+        stack.reserve(64);
+        stack.push_back(0);
+
+        while (!stack.empty())
+        {
+            auto nodeIndex = stack.back();
+            stack.pop_back();
+
+            const auto& node = m_nodes[nodeIndex];
+            auto containment = sphere.Contains(node.Bounds);
+
+            if (containment == DISJOINT)
+                continue;
+
+            if (containment == CONTAINS)
+            {
+                AppendItems(node, ids);
+            }
+            else if (node.IsLeaf)
+            {
+                for (uint32_t i = node.FirstItem; i < node.FirstItem + node.ItemCount; i++)
+                {
+                    if (sphere.Intersects(m_items[i].Bounds))
+                    {
+                        ids.push_back(m_items[i].Id);
+                    }
+                }
+            }
+            else
+            {
+                stack.push_back(node.RightChild);
+                stack.push_back(nodeIndex + 1);
+            }
+        }
+    }
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "pch.h"
+
+#include <array>
+#include <vector>
+
+namespace Gradient::Jobs
+{
+    class JobSystem;
+}
+
+namespace Gradient::Rendering
+{
+    // A binary tree of axis-aligned boxes over a set of items, for 
+    // culling queries that skip whole groups of items at a time.
+    // 
+    // Items keep the IDs they were built with. Their bounds can be 
+    // updated in place and the tree refitted, which is cheap but lets 
+    // the tree degrade if items move far, so it suits either items that 
+    // never move or a small number that move a little every frame.
+    //
+    // The items in a leaf are also kept as arrays of centres and
+    // extents, so a leaf's items are tested against a plane together.
+    class BoundingVolumeHierarchy
+    {
+    public:
+        struct Item
+        {
+            DirectX::BoundingBox Bounds;
+            uint32_t Id;
+        };
+
+        // Builds the tree from scratch. Items are referred to by
+        // their position in this vector in SetBounds.
+        void Build(std::vector<Item> items);
+        void Clear();
+
+        size_t Size() const;
+
+        // Moves an item. Call Refit once all items have been moved.
+        void SetBounds(size_t buildIndex, const DirectX::BoundingBox& bounds);
+        // Recomputes the bounds of the nodes above moved items.
+        void Refit();
+
+        // Each query appends the IDs of items that might 
+        // intersect the volume, in no particular order.
+
+        // The planes face inwards, as made by Math::GetPlanes.
+        void Query(const std::array<DirectX::XMFLOAT4, 6>& planes, std::vector<uint32_t>& ids) const;
+        // The same, with the subtrees that reach the planes shared out
+        // across the job system. Only worth it for large trees that
+        // the planes see a lot of, like the camera's view of the scene.
+        void Query(const std::array<DirectX::XMFLOAT4, 6>& planes,
+            std::vector<uint32_t>& ids,
+            Jobs::JobSystem& jobSystem) const;
+        void Query(const DirectX::BoundingFrustum& frustum, std::vector<uint32_t>& ids) const;
+        void Query(const DirectX::BoundingOrientedBox& box, std::vector<uint32_t>& ids) const;
+        void Query(const DirectX::BoundingSphere& sphere, std::vector<uint32_t>& ids) const;
+
+    private:
+        static constexpr uint32_t MaxItemsPerLeaf = 4;
+
+        // Nodes are stored depth first, so a node's left child comes
+        // straight after it and its items are a contiguous range.
+        struct Node
+        {
+            DirectX::BoundingBox Bounds;
+            uint32_t RightChild;
+            uint32_t FirstItem;
+            uint32_t ItemCount;
+            bool IsLeaf;
+        };
+
+        struct StackEntry
+        {
+            uint32_t Node;
+            // The planes the node straddles. Zero means it's inside all of them.
+            uint32_t PlaneMask;
+        };
+
+        // Appends what's below a node that's already been tested
+        template <typename Output>
+        void QuerySubtree(const std::array<DirectX::XMFLOAT4, 6>& planes,
+            StackEntry subtree,
+            Output& ids) const;
+        template <typename Output>
+        void QueryLeaf(const std::array<DirectX::XMFLOAT4, 6>& planes,
+            const Node& leaf,
+            uint32_t planeMask,
+            Output& ids) const;
+        void SetPackedBounds(uint32_t slot, const DirectX::BoundingBox& bounds);
+
+        uint32_t BuildNode(const std::vector<Item>& items,
+            std::vector<uint32_t>& order,
+            uint32_t firstItem,
+            uint32_t itemCount);
+        template <typename Output>
+        void AppendItems(const Node& node, Output& ids) const;
+
+        std::vector<Node> m_nodes;
+        std::vector<Item> m_items;
+        // The bounds of m_items, by slot, padded so that four
+        // can be loaded from the start of any leaf.
+        std::vector<float> m_centerX;
+        std::vector<float> m_centerY;
+        std::vector<float> m_centerZ;
+        std::vector<float> m_extentX;
+        std::vector<float> m_extentY;
+        std::vector<float> m_extentZ;
+        // The slot in m_items of each item, by build index
+        std::vector<uint32_t> m_itemSlots;
+        // The leaf each slot in m_items is in
+        std::vector<uint32_t> m_slotLeaves;
+        std::vector<uint8_t> m_dirtyNodes;
+        bool m_needsRefit = false;
+    };
+}
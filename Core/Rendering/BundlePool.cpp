@@ -0,0 +1,85 @@
+#include "pch.h"
+
+#include "Core/Rendering/BundlePool.h"
+
+namespace Gradient::Rendering
+{
+    BundlePool::BundlePool(ID3D12Device* device)
+        : m_device(device)
+    {
+    }
+
+    void BundlePool::BeginFrame(UINT frameIndex)
+    {
+        std::lock_guard lock(m_mutex);
+
+        if (frameIndex >= m_frames.size())
+        {
+            m_frames.resize(frameIndex + 1);
+        }
+
+        m_frameIndex = frameIndex;
+        m_frames[frameIndex].NumUsed = 0;
+    }
+
+    void BundlePool::SetTarget(ID3D12GraphicsCommandList* cl)
+    {
+        m_target = cl;
+    }
+
+    ID3D12GraphicsCommandList6* BundlePool::Get(ListHandle list)
+    {
+        std::lock_guard lock(m_mutex);
+        return GetBundle(list).List.Get();
+    }
+
+    ICommandListPool::ListHandle BundlePool::Acquire()
+    {
+        std::lock_guard lock(m_mutex);
+
+        auto& frame = m_frames[m_frameIndex];
+        ListHandle handle = frame.NumUsed++;
+
+        if (handle < frame.Bundles.size())
+        {
+            auto& bundle = frame.Bundles[handle];
+            DX::ThrowIfFailed(bundle.Allocator->Reset());
+            DX::ThrowIfFailed(bundle.List->Reset(bundle.Allocator.Get(), nullptr));
+            return handle;
+        }
+
+        // Created open, ready to record
+        auto& bundle = frame.Bundles.emplace_back();
+        DX::ThrowIfFailed(m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_BUNDLE,
+            IID_PPV_ARGS(bundle.Allocator.ReleaseAndGetAddressOf())));
+        DX::ThrowIfFailed(m_device->CreateCommandList(0,
+            D3D12_COMMAND_LIST_TYPE_BUNDLE,
+            bundle.Allocator.Get(),
+            nullptr,
+            IID_PPV_ARGS(bundle.List.ReleaseAndGetAddressOf())));
+
+        return handle;
+    }
+
+    void BundlePool::Close(ListHandle list)
+    {
+        DX::ThrowIfFailed(Get(list)->Close());
+    }
+
+    void BundlePool::Submit(std::span<const ListHandle> lists)
+    {
+        assert(m_target != nullptr);
+
+        for (auto list : lists)
+        {
+            m_target->ExecuteBundle(Get(list));
+        }
+    }
+
+    BundlePool::Bundle& BundlePool::GetBundle(ListHandle list)
+    {
+        auto& frame = m_frames[m_frameIndex];
+        assert(list < frame.NumUsed);
+        return frame.Bundles[list];
+    }
+}
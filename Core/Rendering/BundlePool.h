@@ -0,0 +1,58 @@
+#pragma once
+
+#include "pch.h"
+
+#include "Core/Rendering/ParallelRecorder.h"
+
+#include <deque>
+#include <mutex>
+
+namespace Gradient::Rendering
+{
+    // Bundles for ParallelRecorder, each with an allocator of its own,
+    // kept per frame in flight and reused once that frame comes around
+    // again. Submitted bundles are executed on a target command list.
+    //
+    // Bundles inherit the render targets, viewport and resource states
+    // of the list they're executed on, so chunks of a pass can be 
+    // recorded without knowing how the pass was set up.
+    class BundlePool : public ICommandListPool
+    {
+    public:
+        explicit BundlePool(ID3D12Device* device);
+
+        // The bundles used the last time this frame index came 
+        // around are reset, so the GPU must be done with them.
+        void BeginFrame(UINT frameIndex);
+        void SetTarget(ID3D12GraphicsCommandList* cl);
+
+        ID3D12GraphicsCommandList6* Get(ListHandle list);
+
+        ListHandle Acquire() override;
+        void Close(ListHandle list) override;
+        void Submit(std::span<const ListHandle> lists) override;
+
+    private:
+        struct Bundle
+        {
+            Microsoft::WRL::ComPtr<ID3D12CommandAllocator> Allocator;
+            Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList6> List;
+        };
+
+        struct Frame
+        {
+            // A deque, so that bundles stay put as more are added
+            std::deque<Bundle> Bundles;
+            uint32_t NumUsed = 0;
+        };
+
+        Bundle& GetBundle(ListHandle list);
+
+        Microsoft::WRL::ComPtr<ID3D12Device> m_device;
+        ID3D12GraphicsCommandList* m_target = nullptr;
+
+        std::mutex m_mutex;
+        std::vector<Frame> m_frames;
+        UINT m_frameIndex = 0;
+    };
+}
@@ -1,6 +1,7 @@
 #include "pch.h"
 
 #include "Core/Rendering/DepthCubeArray.h"
+#include "Core/Math.h"
 
 namespace Gradient::Rendering
 {
@@ -8,6 +9,8 @@ namespace Gradient::Rendering
         int width,
         int numCubes)
     {
+        m_numCubes = numCubes;
+
         m_viewport.TopLeftX = 0.f;
         m_viewport.TopLeftY = 0.f;
         m_viewport.Width = (float)width;
@@ -33,6 +36,10 @@ namespace Gradient::Rendering
             &depthStencilDesc,
             D3D12_RESOURCE_STATE_DEPTH_WRITE,
             &depthClearValue);
+        m_staticCubemapArray.Create(device,
+            &depthStencilDesc,
+            D3D12_RESOURCE_STATE_DEPTH_WRITE,
+            &depthClearValue);
 
         auto dsvDesc = D3D12_DEPTH_STENCIL_VIEW_DESC();
         dsvDesc.Format = DXGI_FORMAT_D32_FLOAT;
@@ -50,6 +57,9 @@ namespace Gradient::Rendering
                 m_dsvs.push_back(gmm->CreateDSV(device,
                     m_cubemapArray.Get(),
                     dsvDesc));
+                m_staticDsvs.push_back(gmm->CreateDSV(device,
+                    m_staticCubemapArray.Get(),
+                    dsvDesc));
             }
         }
 
@@ -67,15 +77,9 @@ namespace Gradient::Rendering
             &srvDesc);
     }
 
-    void DepthCubeArray::Render(ID3D12GraphicsCommandList* cl,
-        int cubeMapIndex,
-        DirectX::SimpleMath::Vector3 origin,
-        float nearPlane,
-        float farPlane,
-        DrawFn fn)
+    namespace
     {
-        using namespace DirectX::SimpleMath;
-        cl->RSSetViewports(1, &m_viewport);
+        using DirectX::SimpleMath::Vector3;
 
         // +X
         // -X
@@ -83,7 +87,7 @@ namespace Gradient::Rendering
         // -Y
         // +Z
         // -Z
-        Vector3 lookAt[6] = {
+        const Vector3 FaceLookAt[DepthCubeArray::NumFaces] = {
             Vector3::UnitX,
             -Vector3::UnitX,
             Vector3::UnitY,
@@ -96,7 +100,7 @@ namespace Gradient::Rendering
             -Vector3::UnitZ,
             Vector3::UnitZ
         };
-        Vector3 up[6] = {
+        const Vector3 FaceUp[DepthCubeArray::NumFaces] = {
            Vector3::UnitY,
            Vector3::UnitY,
            Vector3::UnitZ,
@@ -104,34 +108,192 @@ namespace Gradient::Rendering
            Vector3::UnitY,
            Vector3::UnitY
         };
+    }
 
-        m_cubemapArray.Transition(cl, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+    void DepthCubeArray::Render(ID3D12GraphicsCommandList* cl,
+        int cubeMapIndex,
+        DirectX::SimpleMath::Vector3 origin,
+        float nearPlane,
+        float farPlane,
+        DrawFn fn,
+        uint32_t faceMask)
+    {
+        using namespace DirectX::SimpleMath;
+        cl->RSSetViewports(1, &m_viewport);
 
-        auto projectionMatrix = Matrix::CreatePerspectiveFieldOfView(
-            DirectX::XM_PIDIV2,
-            1.f, nearPlane, farPlane);
+        m_cubemapArray.Transition(cl, D3D12_RESOURCE_STATE_DEPTH_WRITE);
 
-        auto gmm = GraphicsMemoryManager::Get();
+        auto projectionMatrix = GetProjection(nearPlane, farPlane);
 
-        for (int i = 0; i < 6; i++)
+        for (uint32_t i = 0; i < NumFaces; i++)
         {
-            auto dsvIndex = cubeMapIndex * 6 + i;
+            auto dsvIndex = cubeMapIndex * NumFaces + i;
 
             auto dsvHandle = m_dsvs[dsvIndex]->GetCPUHandle();
 
+            // Skipped faces are still cleared, so 
+            // they never hold stale shadows.
             cl->ClearDepthStencilView(dsvHandle,
                 D3D12_CLEAR_FLAG_DEPTH,
                 1.0f,
                 0, 0, nullptr);
 
+            if (!(faceMask & (1 << i))) continue;
+
             cl->OMSetRenderTargets(0, nullptr, FALSE, &dsvHandle);
 
-            auto look = lookAt[i];
+            fn(GetFaceView(origin, i), projectionMatrix, FaceLookAt[i]);
+        }
+    }
+
+    void DepthCubeArray::RenderCached(ID3D12GraphicsCommandList* cl,
+        int cubeMapIndex,
+        DirectX::SimpleMath::Vector3 origin,
+        float nearPlane,
+        float farPlane,
+        DrawFn drawStatic,
+        DrawFn drawDynamic,
+        uint32_t faceMask,
+        uint32_t staleFaceMask)
+    {
+        cl->RSSetViewports(1, &m_viewport);
+
+        auto projectionMatrix = GetProjection(nearPlane, farPlane);
+        staleFaceMask &= faceMask;
+
+        if (staleFaceMask != 0)
+        {
+            m_staticCubemapArray.Transition(cl, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+
+            for (uint32_t i = 0; i < NumFaces; i++)
+            {
+                if (!(staleFaceMask & (1 << i))) continue;
+
+                auto dsvHandle = m_staticDsvs[cubeMapIndex * NumFaces + i]->GetCPUHandle();
 
-            auto viewMatrix = Matrix::CreateLookAt(origin,
-                origin + look, up[i]);
-            fn(viewMatrix, projectionMatrix, look);
+                cl->ClearDepthStencilView(dsvHandle,
+                    D3D12_CLEAR_FLAG_DEPTH,
+                    1.0f,
+                    0, 0, nullptr);
+
+                cl->OMSetRenderTargets(0, nullptr, FALSE, &dsvHandle);
+
+                drawStatic(GetFaceView(origin, i), projectionMatrix, FaceLookAt[i]);
+            }
         }
+
+        m_staticCubemapArray.Transition(cl, D3D12_RESOURCE_STATE_COPY_SOURCE);
+        m_cubemapArray.Transition(cl, D3D12_RESOURCE_STATE_COPY_DEST);
+
+        for (uint32_t i = 0; i < NumFaces; i++)
+        {
+            if (!(faceMask & (1 << i))) continue;
+
+            // One mip, so the subresource is the array slice
+            auto subresource = cubeMapIndex * NumFaces + i;
+            CD3DX12_TEXTURE_COPY_LOCATION dest(m_cubemapArray.Get(), subresource);
+            CD3DX12_TEXTURE_COPY_LOCATION source(m_staticCubemapArray.Get(), subresource);
+
+            cl->CopyTextureRegion(&dest, 0, 0, 0, &source, nullptr);
+        }
+
+        m_cubemapArray.Transition(cl, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+
+        for (uint32_t i = 0; i < NumFaces; i++)
+        {
+            auto dsvHandle = m_dsvs[cubeMapIndex * NumFaces + i]->GetCPUHandle();
+
+            if (!(faceMask & (1 << i)))
+            {
+                cl->ClearDepthStencilView(dsvHandle,
+                    D3D12_CLEAR_FLAG_DEPTH,
+                    1.0f,
+                    0, 0, nullptr);
+                continue;
+            }
+
+            cl->OMSetRenderTargets(0, nullptr, FALSE, &dsvHandle);
+
+            drawDynamic(GetFaceView(origin, i), projectionMatrix, FaceLookAt[i]);
+        }
+    }
+
+    DirectX::SimpleMath::Matrix DepthCubeArray::GetFaceView(
+        const DirectX::SimpleMath::Vector3& origin,
+        uint32_t face)
+    {
+        return DirectX::SimpleMath::Matrix::CreateLookAt(origin,
+            origin + FaceLookAt[face], FaceUp[face]);
+    }
+
+    DirectX::SimpleMath::Matrix DepthCubeArray::GetProjection(float nearPlane, float farPlane)
+    {
+        return DirectX::SimpleMath::Matrix::CreatePerspectiveFieldOfView(
+            DirectX::XM_PIDIV2,
+            1.f, nearPlane, farPlane);
+    }
+
+    DirectX::BoundingFrustum DepthCubeArray::GetFaceFrustum(
+        const DirectX::SimpleMath::Vector3& origin,
+        uint32_t face,
+        float nearPlane,
+        float farPlane)
+    {
+        return Math::MakeFrustum(GetFaceView(origin, face),
+            GetProjection(nearPlane, farPlane));
+    }
+
+    DirectX::BoundingOrientedBox DepthCubeArray::GetFaceBounds(
+        const DirectX::SimpleMath::Vector3& origin,
+        uint32_t face,
+        float farPlane)
+    {
+        using namespace DirectX::SimpleMath;
+
+        // The face's pyramid reaches farPlane along the face's axis,
+        // and as far to either side at the far end.
+        auto axis = FaceLookAt[face];
+        Vector3 absAxis(std::abs(axis.x), std::abs(axis.y), std::abs(axis.z));
+
+        return DirectX::BoundingOrientedBox(origin + axis * farPlane * 0.5f,
+            Vector3(farPlane) - absAxis * farPlane * 0.5f,
+            Quaternion::Identity);
+    }
+
+    uint32_t DepthCubeArray::GetReceivingFaces(const DirectX::BoundingSphere& lightRange,
+        float nearPlane,
+        const DirectX::BoundingFrustum& cameraFrustum,
+        std::span<const DirectX::BoundingBox> receivers)
+    {
+        if (receivers.empty())
+            return 0;
+
+        uint32_t faceMask = 0;
+        for (uint32_t face = 0; face < NumFaces; face++)
+        {
+            auto faceFrustum = GetFaceFrustum(lightRange.Center,
+                face,
+                nearPlane,
+                lightRange.Radius);
+
+            if (!faceFrustum.Intersects(cameraFrustum)) continue;
+
+            for (const auto& receiver : receivers)
+            {
+                if (faceFrustum.Intersects(receiver))
+                {
+                    faceMask |= 1 << face;
+                    break;
+                }
+            }
+        }
+
+        return faceMask;
+    }
+
+    int DepthCubeArray::GetNumCubes() const
+    {
+        return m_numCubes;
     }
 
     GraphicsMemoryManager::DescriptorView DepthCubeArray::GetSRV() const
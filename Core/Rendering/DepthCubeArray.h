@@ -3,6 +3,7 @@
 #include "pch.h"
 #include <directxtk12/SimpleMath.h>
 #include <functional>
+#include <span>
 
 #include "Core/GraphicsMemoryManager.h"
 #include "Core/BarrierResource.h"
@@ -19,13 +20,60 @@ namespace Gradient::Rendering
             int width,
             int numCubes);
 
+        static constexpr uint32_t NumFaces = 6;
+        static constexpr uint32_t AllFaces = (1 << NumFaces) - 1;
+
+        // One for every face, and one for the face's static copy
+        static constexpr uint32_t GetDsvCount(uint32_t numCubes)
+        {
+            return numCubes * NumFaces * 2;
+        }
+
+        // Faces not in faceMask are cleared but not drawn into.
         void Render(ID3D12GraphicsCommandList* cl,
             int cubeMapIndex,
             DirectX::SimpleMath::Vector3 origin,
             float nearPlane,
             float farPlane,
-            DrawFn fn);
+            DrawFn fn,
+            uint32_t faceMask = AllFaces);
+
+        // Like Render, but keeps a copy of each face with only the 
+        // static casters in it. drawStatic redraws that copy for the 
+        // faces in staleFaceMask, and every face in faceMask then 
+        // starts from the copy and has drawDynamic drawn on top.
+        void RenderCached(ID3D12GraphicsCommandList* cl,
+            int cubeMapIndex,
+            DirectX::SimpleMath::Vector3 origin,
+            float nearPlane,
+            float farPlane,
+            DrawFn drawStatic,
+            DrawFn drawDynamic,
+            uint32_t faceMask,
+            uint32_t staleFaceMask);
+
+        static DirectX::SimpleMath::Matrix GetFaceView(
+            const DirectX::SimpleMath::Vector3& origin,
+            uint32_t face);
+        static DirectX::SimpleMath::Matrix GetProjection(float nearPlane, float farPlane);
+        static DirectX::BoundingFrustum GetFaceFrustum(
+            const DirectX::SimpleMath::Vector3& origin,
+            uint32_t face,
+            float nearPlane,
+            float farPlane);
+        // A box around everything the face can see
+        static DirectX::BoundingOrientedBox GetFaceBounds(
+            const DirectX::SimpleMath::Vector3& origin,
+            uint32_t face,
+            float farPlane);
+        // The faces of a light that the camera can see into, and that
+        // hold some of the receivers, so their shadows can be seen.
+        static uint32_t GetReceivingFaces(const DirectX::BoundingSphere& lightRange,
+            float nearPlane,
+            const DirectX::BoundingFrustum& cameraFrustum,
+            std::span<const DirectX::BoundingBox> receivers);
 
+        int GetNumCubes() const;
         GraphicsMemoryManager::DescriptorView GetSRV() const;
         void TransitionToShaderResource(ID3D12GraphicsCommandList* cl);
 
@@ -33,7 +81,10 @@ namespace Gradient::Rendering
         BarrierResource m_cubemapArray;
         GraphicsMemoryManager::DescriptorView m_srv;
         std::vector<GraphicsMemoryManager::DescriptorView> m_dsvs;
+        BarrierResource m_staticCubemapArray;
+        std::vector<GraphicsMemoryManager::DescriptorView> m_staticDsvs;
 
         D3D12_VIEWPORT m_viewport;
+        int m_numCubes;
     };
 }
\ No newline at end of file
@@ -0,0 +1,229 @@
+#include "pch.h"
+
+#include "Core/Rendering/DepthPyramid.h"
+#include "Core/ReadData.h"
+#include "Core/Math.h"
+
+namespace Gradient::Rendering
+{
+    DepthPyramid::DepthPyramid(ID3D12Device* device, RECT windowSize)
+        : m_device(device)
+    {
+        auto gmm = GraphicsMemoryManager::Get();
+
+        m_sourceWidth = static_cast<uint32_t>(windowSize.right);
+        m_sourceHeight = static_cast<uint32_t>(windowSize.bottom);
+        m_width = HiZ::GetBaseSize(m_sourceWidth);
+        m_height = HiZ::GetBaseSize(m_sourceHeight);
+        m_levelCount = HiZ::GetLevelCount(m_sourceWidth, m_sourceHeight);
+
+        auto pyramidDesc = CD3DX12_RESOURCE_DESC::Tex2D(
+            DXGI_FORMAT_R32_FLOAT,
+            m_width,
+            m_height,
+            1, m_levelCount
+        );
+        pyramidDesc.Flags |= D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+
+        m_pyramid.Create(device,
+            &pyramidDesc,
+            D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+            nullptr);
+        m_pyramid.Get()->SetName(L"Depth pyramid");
+
+        m_srv = gmm->CreateSRV(device, m_pyramid.Get());
+        for (uint32_t i = 0; i < m_levelCount; i++)
+        {
+            m_uavs.push_back(gmm->CreateUAV(device, m_pyramid.Get(), i));
+        }
+
+        m_rootSignature.AddCBV(0, 0);
+        m_rootSignature.AddSRV(0, 0); // resolved depth
+        m_rootSignature.AddUAV(0, 0); // level before
+        m_rootSignature.AddUAV(1, 0); // level being built
+        m_rootSignature.Build(device, true);
+
+        auto csData = DX::ReadData(L"DepthPyramid_CS.cso");
+        D3D12_COMPUTE_PIPELINE_STATE_DESC psoDesc = {};
+        psoDesc.pRootSignature = m_rootSignature.Get();
+        psoDesc.CS = { csData.data(), csData.size() };
+        DX::ThrowIfFailed(
+            device->CreateComputePipelineState(&psoDesc, IID_PPV_ARGS(m_pso.ReleaseAndGetAddressOf())));
+
+        // The largest level that's small enough to read back every frame
+        m_readbackLevel = 0;
+        while (m_readbackLevel + 1 < m_levelCount
+            && (std::max(m_width >> m_readbackLevel, 1u) > MaxReadbackSize
+                || std::max(m_height >> m_readbackLevel, 1u) > MaxReadbackSize))
+        {
+            m_readbackLevel++;
+        }
+
+        device->GetCopyableFootprints(&pyramidDesc,
+            m_readbackLevel, 1, 0,
+            &m_readbackFootprint,
+            nullptr, nullptr,
+            &m_readbackSize);
+        m_readbackFootprint.Offset = 0;
+    }
+
+    void DepthPyramid::BeginFrame(UINT frameIndex)
+    {
+        if (frameIndex >= m_readbacks.size())
+        {
+            m_readbacks.resize(frameIndex + 1);
+        }
+
+        m_frameIndex = frameIndex;
+
+        auto& readback = m_readbacks[frameIndex];
+        if (readback.Buffer == nullptr)
+        {
+            auto heapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK);
+            auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(m_readbackSize);
+
+            DX::ThrowIfFailed(
+                m_device->CreateCommittedResource(
+                    &heapProperties,
+                    D3D12_HEAP_FLAG_NONE,
+                    &bufferDesc,
+                    D3D12_RESOURCE_STATE_COPY_DEST,
+                    nullptr,
+                    IID_PPV_ARGS(readback.Buffer.ReleaseAndGetAddressOf())));
+            readback.Buffer->SetName(L"Depth pyramid readback");
+        }
+
+        if (!readback.Pending) return;
+        readback.Pending = false;
+
+        const uint32_t width = m_readbackFootprint.Footprint.Width;
+        const uint32_t height = m_readbackFootprint.Footprint.Height;
+        const uint32_t rowPitch = m_readbackFootprint.Footprint.RowPitch;
+
+        m_readbackDepths.resize(static_cast<size_t>(width) * height);
+
+        void* mapped = nullptr;
+        CD3DX12_RANGE readRange(0, static_cast<SIZE_T>(m_readbackSize));
+        DX::ThrowIfFailed(readback.Buffer->Map(0, &readRange, &mapped));
+
+        // Rows are padded out to the copy's pitch
+        for (uint32_t y = 0; y < height; y++)
+        {
+            const auto row = static_cast<const uint8_t*>(mapped) + static_cast<size_t>(y) * rowPitch;
+            std::memcpy(m_readbackDepths.data() + static_cast<size_t>(y) * width,
+                row,
+                width * sizeof(float));
+        }
+
+        CD3DX12_RANGE writeRange(0, 0);
+        readback.Buffer->Unmap(0, &writeRange);
+
+        if (!m_readbackPyramid)
+        {
+            m_readbackPyramid.emplace();
+        }
+        HiZ::Build(m_readbackDepths, width, height, readback.ViewProj, *m_readbackPyramid);
+    }
+
+    void DepthPyramid::Build(ID3D12GraphicsCommandList* cl,
+        GraphicsMemoryManager::DescriptorView depthSRV,
+        const DirectX::SimpleMath::Matrix& viewProj)
+    {
+        m_viewProj = viewProj;
+        m_isBuilt = true;
+
+        cl->SetPipelineState(m_pso.Get());
+        m_rootSignature.SetOnCommandList(cl);
+
+        m_pyramid.Transition(cl, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+        m_rootSignature.SetSRV(cl, 0, 0, depthSRV);
+
+        uint32_t sourceWidth = m_sourceWidth;
+        uint32_t sourceHeight = m_sourceHeight;
+
+        for (uint32_t level = 0; level < m_levelCount; level++)
+        {
+            const uint32_t destWidth = std::max(m_width >> level, 1u);
+            const uint32_t destHeight = std::max(m_height >> level, 1u);
+
+            PyramidCB constants;
+            constants.SourceWidth = sourceWidth;
+            constants.SourceHeight = sourceHeight;
+            constants.DestWidth = destWidth;
+            constants.DestHeight = destHeight;
+            constants.FromDepth = level == 0 ? 1 : 0;
+
+            m_rootSignature.SetCBV(cl, 0, 0, constants);
+            // Level 0 reads from the depth buffer, so the source is left unread
+            m_rootSignature.SetUAV(cl, 0, 0, m_uavs[level == 0 ? 0 : level - 1]);
+            m_rootSignature.SetUAV(cl, 1, 0, m_uavs[level]);
+
+            cl->Dispatch(Math::DivRoundUp(destWidth, 8u),
+                Math::DivRoundUp(destHeight, 8u),
+                1);
+
+            // The next level reads what this one wrote
+            auto barrier = CD3DX12_RESOURCE_BARRIER::UAV(m_pyramid.Get());
+            cl->ResourceBarrier(1, &barrier);
+
+            sourceWidth = destWidth;
+            sourceHeight = destHeight;
+        }
+
+        // Nothing to copy into until BeginFrame has been called
+        if (m_frameIndex >= m_readbacks.size())
+        {
+            m_pyramid.Transition(cl, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+            return;
+        }
+
+        auto& readback = m_readbacks[m_frameIndex];
+
+        m_pyramid.Transition(cl, D3D12_RESOURCE_STATE_COPY_SOURCE);
+
+        CD3DX12_TEXTURE_COPY_LOCATION destination(readback.Buffer.Get(), m_readbackFootprint);
+        CD3DX12_TEXTURE_COPY_LOCATION source(m_pyramid.Get(), m_readbackLevel);
+        cl->CopyTextureRegion(&destination, 0, 0, 0, &source, nullptr);
+
+        readback.ViewProj = viewProj;
+        readback.Pending = true;
+
+        m_pyramid.Transition(cl, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    }
+
+    GraphicsMemoryManager::DescriptorView DepthPyramid::GetSRV() const
+    {
+        return m_srv;
+    }
+
+    uint32_t DepthPyramid::GetWidth() const
+    {
+        return m_width;
+    }
+
+    uint32_t DepthPyramid::GetHeight() const
+    {
+        return m_height;
+    }
+
+    uint32_t DepthPyramid::GetLevelCount() const
+    {
+        return m_levelCount;
+    }
+
+    const DirectX::SimpleMath::Matrix& DepthPyramid::GetViewProj() const
+    {
+        return m_viewProj;
+    }
+
+    bool DepthPyramid::IsBuilt() const
+    {
+        return m_isBuilt;
+    }
+
+    const HiZ::Pyramid* DepthPyramid::GetReadback() const
+    {
+        return m_readbackPyramid ? &*m_readbackPyramid : nullptr;
+    }
+}
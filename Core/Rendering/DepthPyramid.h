@@ -0,0 +1,98 @@
+#pragma once
+
+#include "pch.h"
+
+#include "Core/BarrierResource.h"
+#include "Core/GraphicsMemoryManager.h"
+#include "Core/RootSignature.h"
+#include "Core/Rendering/HiZ.h"
+
+#include <directxtk12/SimpleMath.h>
+#include <optional>
+#include <vector>
+
+namespace Gradient::Rendering
+{
+    // A Hi-Z pyramid of the farthest depths in the resolved depth buffer,
+    // built with DepthPyramid_CS, for testing bounds against on the GPU.
+    //
+    // A small level is also copied back to the CPU every frame. It arrives
+    // a few frames later, along with the view and projection it was drawn
+    // with, so the CPU can cull entities against it before recording draws.
+    class DepthPyramid
+    {
+    public:
+        // The largest level that's read back, in texels across
+        static constexpr uint32_t MaxReadbackSize = 256;
+
+        struct __declspec(align(256)) PyramidCB
+        {
+            uint32_t SourceWidth;
+            uint32_t SourceHeight;
+            uint32_t DestWidth;
+            uint32_t DestHeight;
+            uint32_t FromDepth;
+        };
+
+        DepthPyramid(ID3D12Device* device, RECT windowSize);
+
+        // Picks up the readback from the last time this frame index came
+        // around, so the GPU must be done with the frame that last used it.
+        void BeginFrame(UINT frameIndex);
+
+        // The depth buffer is read at its full size,
+        // and must be in a shader resource state.
+        void Build(ID3D12GraphicsCommandList* cl,
+            GraphicsMemoryManager::DescriptorView depthSRV,
+            const DirectX::SimpleMath::Matrix& viewProj);
+
+        // All of the levels, in a non-pixel shader resource state
+        GraphicsMemoryManager::DescriptorView GetSRV() const;
+        uint32_t GetWidth() const;
+        uint32_t GetHeight() const;
+        uint32_t GetLevelCount() const;
+        // What the last Build was drawn with
+        const DirectX::SimpleMath::Matrix& GetViewProj() const;
+        // Nothing is in the pyramid until it has been built once
+        bool IsBuilt() const;
+
+        // The latest level to have been read back, as a pyramid of its own,
+        // or null if nothing has been read back since it was created.
+        const HiZ::Pyramid* GetReadback() const;
+
+    private:
+        struct Readback
+        {
+            Microsoft::WRL::ComPtr<ID3D12Resource> Buffer;
+            DirectX::SimpleMath::Matrix ViewProj;
+            bool Pending = false;
+        };
+
+        Microsoft::WRL::ComPtr<ID3D12Device> m_device;
+
+        uint32_t m_sourceWidth;
+        uint32_t m_sourceHeight;
+        uint32_t m_width;
+        uint32_t m_height;
+        uint32_t m_levelCount;
+
+        BarrierResource m_pyramid;
+        GraphicsMemoryManager::DescriptorView m_srv;
+        std::vector<GraphicsMemoryManager::DescriptorView> m_uavs;
+
+        RootSignature m_rootSignature;
+        Microsoft::WRL::ComPtr<ID3D12PipelineState> m_pso;
+
+        DirectX::SimpleMath::Matrix m_viewProj;
+        bool m_isBuilt = false;
+
+        uint32_t m_readbackLevel;
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT m_readbackFootprint;
+        UINT64 m_readbackSize;
+        std::vector<Readback> m_readbacks;
+        UINT m_frameIndex = 0;
+
+        std::vector<float> m_readbackDepths;
+        std::optional<HiZ::Pyramid> m_readbackPyramid;
+    };
+}
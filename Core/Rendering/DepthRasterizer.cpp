@@ -0,0 +1,429 @@
+#include "pch.h"
+
+#include "Core/Rendering/DepthRasterizer.h"
+
+#include <meshoptimizer.h>
+
+#include <array>
+#include <cassert>
+
+namespace Gradient::Rendering
+{
+    namespace
+    {
+        DirectX::XMFLOAT4 Lerp(const DirectX::XMFLOAT4& a, const DirectX::XMFLOAT4& b, float t)
+        {
+            return DirectX::XMFLOAT4(a.x + (b.x - a.x) * t,
+                a.y + (b.y - a.y) * t,
+                a.z + (b.z - a.z) * t,
+                a.w + (b.w - a.w) * t);
+        }
+
+        float Edge(float ax, float ay, float bx, float by, float px, float py)
+        {
+            return (bx - ax) * (py - ay) - (by - ay) * (px - ax);
+        }
+    }
+
+    DepthRasterizer::DepthRasterizer(uint32_t width, uint32_t height)
+        : m_width(width),
+        m_height(height),
+        m_depths(static_cast<size_t>(width) * height, 1.f),
+        m_bands((height + BandHeight - 1) / BandHeight)
+    {
+        assert(width % 4 == 0);
+    }
+
+    void DepthRasterizer::Clear()
+    {
+        std::fill(m_depths.begin(), m_depths.end(), 1.f);
+        ClearTriangles();
+    }
+
+    void DepthRasterizer::AddTriangles(std::span<const DirectX::XMFLOAT3> positions,
+        std::span<const uint32_t> indices,
+        const DirectX::XMFLOAT4X4& viewProj)
+    {
+        using namespace DirectX;
+
+        const XMMATRIX m = XMLoadFloat4x4(&viewProj);
+
+        m_clipPositions.resize(positions.size());
+        for (size_t i = 0; i < positions.size(); i++)
+        {
+            XMStoreFloat4(&m_clipPositions[i], XMVector3Transform(XMLoadFloat3(&positions[i]), m));
+        }
+
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            const std::array<XMFLOAT4, 3> triangle = {
+                m_clipPositions[indices[i]],
+                m_clipPositions[indices[i + 1]],
+                m_clipPositions[indices[i + 2]]
+            };
+
+            // Entirely off one side of the view
+            if ((triangle[0].x > triangle[0].w && triangle[1].x > triangle[1].w && triangle[2].x > triangle[2].w)
+                || (triangle[0].x < -triangle[0].w && triangle[1].x < -triangle[1].w && triangle[2].x < -triangle[2].w)
+                || (triangle[0].y > triangle[0].w && triangle[1].y > triangle[1].w && triangle[2].y > triangle[2].w)
+                || (triangle[0].y < -triangle[0].w && triangle[1].y < -triangle[1].w && triangle[2].y < -triangle[2].w)
+                || (triangle[0].z > triangle[0].w && triangle[1].z > triangle[1].w && triangle[2].z > triangle[2].w))
+            {
+                continue;
+            }
+
+            // Clipped against the near plane, where z is 0, into up to two triangles
+            std::array<XMFLOAT4, 4> polygon;
+            size_t numVertices = 0;
+            for (size_t v = 0; v < 3; v++)
+            {
+                const auto& current = triangle[v];
+                const auto& next = triangle[(v + 1) % 3];
+
+                if (current.z >= 0.f)
+                {
+                    polygon[numVertices++] = current;
+                }
+
+                if ((current.z >= 0.f) != (next.z >= 0.f))
+                {
+                    polygon[numVertices++] = Lerp(current, next, current.z / (current.z - next.z));
+                }
+            }
+
+            for (size_t v = 2; v < numVertices; v++)
+            {
+                AddClippedTriangle(polygon[0], polygon[v - 1], polygon[v]);
+            }
+        }
+    }
+
+    void DepthRasterizer::AddClippedTriangle(const DirectX::XMFLOAT4& a,
+        const DirectX::XMFLOAT4& b,
+        const DirectX::XMFLOAT4& c)
+    {
+        const float width = static_cast<float>(m_width);
+        const float height = static_cast<float>(m_height);
+
+        auto toScreen = [&](const DirectX::XMFLOAT4& clip)
+            {
+                return DirectX::XMFLOAT3(
+                    (clip.x / clip.w * 0.5f + 0.5f) * width,
+                    (0.5f - clip.y / clip.w * 0.5f) * height,
+                    clip.z / clip.w);
+            };
+
+        ScreenTriangle triangle;
+        triangle.V0 = toScreen(a);
+        triangle.V1 = toScreen(b);
+        triangle.V2 = toScreen(c);
+
+        const auto& v0 = triangle.V0;
+        float area = Edge(v0.x, v0.y, triangle.V1.x, triangle.V1.y, triangle.V2.x, triangle.V2.y);
+        if (area == 0.f)
+            return;
+
+        // Either way round, so that the edge functions are positive inside
+        if (area < 0.f)
+        {
+            std::swap(triangle.V1, triangle.V2);
+            area = -area;
+        }
+
+        const auto& v1 = triangle.V1;
+        const auto& v2 = triangle.V2;
+
+        const float minX = std::max(std::min({ v0.x, v1.x, v2.x }), 0.f);
+        const float minY = std::max(std::min({ v0.y, v1.y, v2.y }), 0.f);
+        const float maxX = std::min(std::max({ v0.x, v1.x, v2.x }), width - 1.f);
+        const float maxY = std::min(std::max({ v0.y, v1.y, v2.y }), height - 1.f);
+
+        if (minX > maxX || minY > maxY)
+            return;
+
+        triangle.FirstX = static_cast<uint32_t>(minX);
+        triangle.FirstY = static_cast<uint32_t>(minY);
+        triangle.LastX = static_cast<uint32_t>(maxX);
+        triangle.LastY = static_cast<uint32_t>(maxY);
+        triangle.InverseArea = 1.f / area;
+
+        const auto index = static_cast<uint32_t>(m_triangles.size());
+        m_triangles.push_back(triangle);
+
+        for (uint32_t band = triangle.FirstY / BandHeight; band <= triangle.LastY / BandHeight; band++)
+        {
+            m_bands[band].push_back(index);
+        }
+    }
+
+    uint32_t DepthRasterizer::GetBandCount() const
+    {
+        return static_cast<uint32_t>(m_bands.size());
+    }
+
+    void DepthRasterizer::DrawBand(uint32_t band)
+    {
+        using namespace DirectX;
+
+        const uint32_t bandFirstY = band * BandHeight;
+        const uint32_t bandLastY = std::min(bandFirstY + BandHeight, m_height) - 1;
+
+        const XMVECTOR pixelCenters = XMVectorSet(0.5f, 1.5f, 2.5f, 3.5f);
+        const XMVECTOR zero = XMVectorZero();
+        const XMVECTOR one = XMVectorSplatOne();
+
+        for (auto index : m_bands[band])
+        {
+            const auto& triangle = m_triangles[index];
+            const auto& v0 = triangle.V0;
+            const auto& v1 = triangle.V1;
+            const auto& v2 = triangle.V2;
+
+            const uint32_t firstY = std::max(triangle.FirstY, bandFirstY);
+            const uint32_t lastY = std::min(triangle.LastY, bandLastY);
+            // Pixels to the left of the triangle fail the edge tests
+            const uint32_t firstX = triangle.FirstX & ~3u;
+
+            const XMVECTOR slope0 = XMVectorReplicate(v2.y - v1.y);
+            const XMVECTOR slope1 = XMVectorReplicate(v0.y - v2.y);
+            const XMVECTOR slope2 = XMVectorReplicate(v1.y - v0.y);
+            const XMVECTOR x0 = XMVectorReplicate(v0.x);
+            const XMVECTOR x1 = XMVectorReplicate(v1.x);
+            const XMVECTOR x2 = XMVectorReplicate(v2.x);
+            const XMVECTOR z0 = XMVectorReplicate(v0.z);
+            const XMVECTOR z1 = XMVectorReplicate(v1.z);
+            const XMVECTOR z2 = XMVectorReplicate(v2.z);
+            const XMVECTOR inverseArea = XMVectorReplicate(triangle.InverseArea);
+
+            for (uint32_t y = firstY; y <= lastY; y++)
+            {
+                const float py = static_cast<float>(y) + 0.5f;
+                float* row = m_depths.data() + static_cast<size_t>(y) * m_width;
+
+                // The parts of the edge functions that only change per row
+                const XMVECTOR rowTerm0 = XMVectorReplicate((v2.x - v1.x) * (py - v1.y));
+                const XMVECTOR rowTerm1 = XMVectorReplicate((v0.x - v2.x) * (py - v2.y));
+                const XMVECTOR rowTerm2 = XMVectorReplicate((v1.x - v0.x) * (py - v0.y));
+
+                for (uint32_t x = firstX; x <= triangle.LastX; x += 4)
+                {
+                    const XMVECTOR px = XMVectorAdd(XMVectorReplicate(static_cast<float>(x)), pixelCenters);
+
+                    // Separate multiplies and adds, in the same order as Edge
+                    const XMVECTOR w0 = XMVectorSubtract(rowTerm0, XMVectorMultiply(slope0, XMVectorSubtract(px, x1)));
+                    const XMVECTOR w1 = XMVectorSubtract(rowTerm1, XMVectorMultiply(slope1, XMVectorSubtract(px, x2)));
+                    const XMVECTOR w2 = XMVectorSubtract(rowTerm2, XMVectorMultiply(slope2, XMVectorSubtract(px, x0)));
+
+                    const XMVECTOR depth = XMVectorMultiply(
+                        XMVectorAdd(XMVectorAdd(XMVectorMultiply(w0, z0), XMVectorMultiply(w1, z1)),
+                            XMVectorMultiply(w2, z2)),
+                        inverseArea);
+
+                    const XMVECTOR current = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(row + x));
+
+                    XMVECTOR write = XMVectorAndInt(XMVectorGreaterOrEqual(w0, zero),
+                        XMVectorGreaterOrEqual(w1, zero));
+                    write = XMVectorAndInt(write, XMVectorGreaterOrEqual(w2, zero));
+                    write = XMVectorAndInt(write, XMVectorLessOrEqual(depth, one));
+                    write = XMVectorAndInt(write, XMVectorLess(depth, current));
+
+                    XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(row + x), XMVectorSelect(current, depth, write));
+                }
+            }
+        }
+    }
+
+    // /fp:fast would be free to reorder or fuse these,
+    // which the vector arithmetic in DrawBand doesn't do.
+#pragma float_control(precise, on, push)
+#pragma fp_contract(off)
+
+    void DepthRasterizer::DrawBandReference(uint32_t band)
+    {
+        const uint32_t bandFirstY = band * BandHeight;
+        const uint32_t bandLastY = std::min(bandFirstY + BandHeight, m_height) - 1;
+
+        for (auto index : m_bands[band])
+        {
+            const auto& triangle = m_triangles[index];
+            const auto& v0 = triangle.V0;
+            const auto& v1 = triangle.V1;
+            const auto& v2 = triangle.V2;
+
+            const uint32_t firstY = std::max(triangle.FirstY, bandFirstY);
+            const uint32_t lastY = std::min(triangle.LastY, bandLastY);
+
+            for (uint32_t y = firstY; y <= lastY; y++)
+            {
+                const float py = static_cast<float>(y) + 0.5f;
+                float* row = m_depths.data() + static_cast<size_t>(y) * m_width;
+
+                for (uint32_t x = triangle.FirstX; x <= triangle.LastX; x++)
+                {
+                    const float px = static_cast<float>(x) + 0.5f;
+
+                    const float w0 = Edge(v1.x, v1.y, v2.x, v2.y, px, py);
+                    const float w1 = Edge(v2.x, v2.y, v0.x, v0.y, px, py);
+                    const float w2 = Edge(v0.x, v0.y, v1.x, v1.y, px, py);
+
+                    if (w0 < 0.f || w1 < 0.f || w2 < 0.f)
+                        continue;
+
+                    // Depth is linear in screen space after the divide
+                    const float depth = (w0 * v0.z + w1 * v1.z + w2 * v2.z) * triangle.InverseArea;
+                    if (depth <= 1.f && depth < row[x])
+                    {
+                        row[x] = depth;
+                    }
+                }
+            }
+        }
+    }
+
+#pragma fp_contract(on)
+#pragma float_control(pop)
+
+    void DepthRasterizer::ClearTriangles()
+    {
+        m_triangles.clear();
+        for (auto& band : m_bands)
+        {
+            band.clear();
+        }
+    }
+
+    void DepthRasterizer::DrawTriangles(std::span<const DirectX::XMFLOAT3> positions,
+        std::span<const uint32_t> indices,
+        const DirectX::XMFLOAT4X4& viewProj)
+    {
+        AddTriangles(positions, indices, viewProj);
+        for (uint32_t band = 0; band < GetBandCount(); band++)
+        {
+            DrawBand(band);
+        }
+        ClearTriangles();
+    }
+
+    uint32_t DepthRasterizer::GetWidth() const
+    {
+        return m_width;
+    }
+
+    uint32_t DepthRasterizer::GetHeight() const
+    {
+        return m_height;
+    }
+
+    std::span<const float> DepthRasterizer::GetDepths() const
+    {
+        return m_depths;
+    }
+
+    DepthRasterizer::OccluderMesh DepthRasterizer::CreateHeightfieldOccluder(
+        std::span<const float> heights,
+        uint32_t sampleCount,
+        float gridWidth,
+        float height,
+        const DirectX::XMFLOAT3& origin,
+        uint32_t step)
+    {
+        OccluderMesh out;
+
+        const float scale = gridWidth / static_cast<float>(sampleCount - 1);
+        const uint32_t numCells = (sampleCount - 1 + step - 1) / step;
+        const uint32_t numVertices = numCells + 1;
+
+        out.Positions.reserve(static_cast<size_t>(numVertices) * numVertices);
+
+        for (uint32_t j = 0; j < numVertices; j++)
+        {
+            const uint32_t sampleZ = std::min(j * step, sampleCount - 1);
+
+            for (uint32_t i = 0; i < numVertices; i++)
+            {
+                const uint32_t sampleX = std::min(i * step, sampleCount - 1);
+
+                // Lowest over every cell that touches the vertex
+                float lowest = std::numeric_limits<float>::max();
+                const uint32_t firstZ = sampleZ > step ? sampleZ - step : 0;
+                const uint32_t lastZ = std::min(sampleZ + step, sampleCount - 1);
+                const uint32_t firstX = sampleX > step ? sampleX - step : 0;
+                const uint32_t lastX = std::min(sampleX + step, sampleCount - 1);
+
+                for (uint32_t z = firstZ; z <= lastZ; z++)
+                {
+                    for (uint32_t x = firstX; x <= lastX; x++)
+                    {
+                        lowest = std::min(lowest, heights[static_cast<size_t>(z) * sampleCount + x]);
+                    }
+                }
+
+                out.Positions.emplace_back(
+                    origin.x - gridWidth / 2.f + sampleX * scale,
+                    origin.y + lowest * height,
+                    origin.z - gridWidth / 2.f + sampleZ * scale);
+            }
+        }
+
+        out.Indices.reserve(static_cast<size_t>(numCells) * numCells * 6);
+
+        for (uint32_t j = 0; j < numCells; j++)
+        {
+            for (uint32_t i = 0; i < numCells; i++)
+            {
+                const uint32_t topLeft = j * numVertices + i;
+                const uint32_t topRight = topLeft + 1;
+                const uint32_t bottomLeft = topLeft + numVertices;
+                const uint32_t bottomRight = bottomLeft + 1;
+
+                out.Indices.insert(out.Indices.end(), {
+                    topLeft, bottomLeft, topRight,
+                    topRight, bottomLeft, bottomRight });
+            }
+        }
+
+        return out;
+    }
+
+    DepthRasterizer::OccluderMesh DepthRasterizer::SimplifyOccluder(const OccluderMesh& mesh,
+        size_t targetTriangles)
+    {
+        OccluderMesh out;
+        out.Positions = mesh.Positions;
+        out.Indices.resize(mesh.Indices.size());
+
+        // The border is kept where it is, so the edges of the
+        // heightfield don't pull in and open up gaps at the sides.
+        float error = 0.f;
+        const size_t numIndices = meshopt_simplify(out.Indices.data(),
+            mesh.Indices.data(),
+            mesh.Indices.size(),
+            &mesh.Positions[0].x,
+            mesh.Positions.size(),
+            sizeof(DirectX::XMFLOAT3),
+            targetTriangles * 3,
+            1.f,
+            meshopt_SimplifyLockBorder,
+            &error);
+        out.Indices.resize(numIndices);
+
+        const float drop = error * meshopt_simplifyScale(&mesh.Positions[0].x,
+            mesh.Positions.size(),
+            sizeof(DirectX::XMFLOAT3));
+
+        const size_t numVertices = meshopt_optimizeVertexFetch(out.Positions.data(),
+            out.Indices.data(),
+            out.Indices.size(),
+            mesh.Positions.data(),
+            mesh.Positions.size(),
+            sizeof(DirectX::XMFLOAT3));
+        out.Positions.resize(numVertices);
+
+        for (auto& position : out.Positions)
+        {
+            position.y -= drop;
+        }
+
+        return out;
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace Gradient::Rendering
+{
+    // Draws occluders into a depth buffer on the CPU, the way the GPU
+    // would, so that occlusion can be tested without waiting on the GPU.
+    // Like the rest of the renderer, nearer depths are smaller, and
+    // triangles are drawn whichever way they face.
+    //
+    // Triangles are set up and sorted into bands of rows first. Bands
+    // don't share any pixels, so they can be drawn on separate threads,
+    // and each band is drawn four pixels at a time.
+    class DepthRasterizer
+    {
+    public:
+        static constexpr uint32_t BandHeight = 16;
+
+        struct OccluderMesh
+        {
+            std::vector<DirectX::XMFLOAT3> Positions;
+            std::vector<uint32_t> Indices;
+        };
+
+        // The width has to be a multiple of four
+        DepthRasterizer(uint32_t width, uint32_t height);
+
+        // Clears the depths, along with any triangles that haven't been drawn
+        void Clear();
+
+        // Transforms, clips and sorts the triangles into bands, ready for DrawBand
+        void AddTriangles(std::span<const DirectX::XMFLOAT3> positions,
+            std::span<const uint32_t> indices,
+            const DirectX::XMFLOAT4X4& viewProj);
+        uint32_t GetBandCount() const;
+        void DrawBand(uint32_t band);
+        // Draws a band one pixel at a time, for checking DrawBand against.
+        // The depths come out exactly the same.
+        void DrawBandReference(uint32_t band);
+        // Forgets the triangles once every band has been drawn
+        void ClearTriangles();
+
+        // All of the above on this thread
+        void DrawTriangles(std::span<const DirectX::XMFLOAT3> positions,
+            std::span<const uint32_t> indices,
+            const DirectX::XMFLOAT4X4& viewProj);
+
+        uint32_t GetWidth() const;
+        uint32_t GetHeight() const;
+        std::span<const float> GetDepths() const;
+
+        // A grid over a heightfield laid out like RigidBodyComponent::CreateHeightField's,
+        // with a vertex every step samples. Each vertex takes the lowest height
+        // around it, so the grid stays under the heightfield and never hides
+        // anything the heightfield itself wouldn't.
+        static OccluderMesh CreateHeightfieldOccluder(std::span<const float> heights,
+            uint32_t sampleCount,
+            float gridWidth,
+            float height,
+            const DirectX::XMFLOAT3& origin,
+            uint32_t step);
+
+        // Simplifies an occluder down towards a number of triangles, then
+        // lowers it by however far the simplification moved the surface,
+        // so that it stays under the occluder it was made from.
+        static OccluderMesh SimplifyOccluder(const OccluderMesh& mesh,
+            size_t targetTriangles);
+
+    private:
+        // In pixels, wound so that the edge functions are positive inside
+        struct ScreenTriangle
+        {
+            DirectX::XMFLOAT3 V0;
+            DirectX::XMFLOAT3 V1;
+            DirectX::XMFLOAT3 V2;
+            float InverseArea;
+            uint32_t FirstX;
+            uint32_t FirstY;
+            uint32_t LastX;
+            uint32_t LastY;
+        };
+
+        void AddClippedTriangle(const DirectX::XMFLOAT4& a,
+            const DirectX::XMFLOAT4& b,
+            const DirectX::XMFLOAT4& c);
+
+        uint32_t m_width;
+        uint32_t m_height;
+        std::vector<float> m_depths;
+        std::vector<DirectX::XMFLOAT4> m_clipPositions;
+
+        std::vector<ScreenTriangle> m_triangles;
+        // Indices into m_triangles, per band
+        std::vector<std::vector<uint32_t>> m_bands;
+    };
+}
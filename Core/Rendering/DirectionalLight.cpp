@@ -1,9 +1,11 @@
 #include "pch.h"
 
 #include "Core/Rendering/DirectionalLight.h"
+#include "Core/Rendering/ShadowCascades.h"
 #include <directxtk12/DirectXHelpers.h>
 
-#include <array>
+#include <algorithm>
+#include <cmath>
 
 namespace Gradient::Rendering
 {
@@ -13,8 +15,12 @@ namespace Gradient::Rendering
     DirectionalLight::DirectionalLight(ID3D12Device* device,
         Vector3 lightDirection,
         float sceneRadius,
-        Vector3 sceneCentre)
+        Vector3 sceneCentre,
+        uint32_t numCascades,
+        uint32_t cascadeResolution)
     {
+        assert(numCascades > 0 && numCascades <= Pipelines::MaxShadowCascades);
+
         m_sceneRadius = sceneRadius;
         m_sceneCentre = sceneCentre;
         SetLightDirection(lightDirection);
@@ -22,7 +28,8 @@ namespace Gradient::Rendering
         m_colour = Color(0.8f, 0.8f, 0.7f, 1.f);
         m_irradiance = 10.f;
 
-        m_shadowMapProj = SimpleMath::Matrix::CreateOrthographicOffCenter(
+        // Covers the whole scene until the camera frustum is set
+        auto sceneProj = SimpleMath::Matrix::CreateOrthographicOffCenter(
             -sceneRadius,
             sceneRadius,
             -sceneRadius,
@@ -31,7 +38,13 @@ namespace Gradient::Rendering
             10 * sceneRadius
         );
 
-        const float shadowMapWidth = 4096.f;
+        m_cascades.resize(numCascades);
+        for (auto& cascade : m_cascades)
+        {
+            cascade.Projection = sceneProj;
+        }
+
+        const float shadowMapWidth = static_cast<float>(cascadeResolution);
         m_width = shadowMapWidth;
 
         m_shadowMapViewport = {
@@ -46,7 +59,9 @@ namespace Gradient::Rendering
         auto depthStencilDesc = CD3DX12_RESOURCE_DESC::Tex2D(
             DXGI_FORMAT_R32_TYPELESS,
             (UINT64)shadowMapWidth,
-            (UINT64)shadowMapWidth
+            (UINT64)shadowMapWidth,
+            numCascades,
+            1
         );
         depthStencilDesc.Flags |= D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL;
 
@@ -60,21 +75,35 @@ namespace Gradient::Rendering
             D3D12_RESOURCE_STATE_DEPTH_WRITE,
             &depthClearValue);
 
+        m_staticShadowMapDS.Create(device,
+            &depthStencilDesc,
+            D3D12_RESOURCE_STATE_DEPTH_WRITE,
+            &depthClearValue);
+
         auto gmm = GraphicsMemoryManager::Get();
 
-        D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
+        for (uint32_t i = 0; i < numCascades; i++)
+        {
+            D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
 
-        dsvDesc.Format = DXGI_FORMAT_D32_FLOAT;
-        dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
-        dsvDesc.Flags = D3D12_DSV_FLAG_NONE;
+            dsvDesc.Format = DXGI_FORMAT_D32_FLOAT;
+            dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2DARRAY;
+            dsvDesc.Flags = D3D12_DSV_FLAG_NONE;
+            dsvDesc.Texture2DArray.MipSlice = 0;
+            dsvDesc.Texture2DArray.FirstArraySlice = i;
+            dsvDesc.Texture2DArray.ArraySize = 1;
 
-        m_shadowMapDSV = gmm->CreateDSV(device, m_shadowMapDS.Get(), dsvDesc);
+            m_cascades[i].DSV = gmm->CreateDSV(device, m_shadowMapDS.Get(), dsvDesc);
+            m_cascades[i].StaticDSV = gmm->CreateDSV(device, m_staticShadowMapDS.Get(), dsvDesc);
+        }
 
         D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
         srvDesc.Format = DXGI_FORMAT_R32_FLOAT;
-        srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-        srvDesc.Texture2D.MipLevels = 1;
-        srvDesc.Texture2D.MostDetailedMip = 0;
+        srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
+        srvDesc.Texture2DArray.MipLevels = 1;
+        srvDesc.Texture2DArray.MostDetailedMip = 0;
+        srvDesc.Texture2DArray.FirstArraySlice = 0;
+        srvDesc.Texture2DArray.ArraySize = numCascades;
         srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
 
         m_shadowMapSRV = gmm->CreateSRV(device, m_shadowMapDS.Get(), &srvDesc);
@@ -103,112 +132,57 @@ namespace Gradient::Rendering
         m_irradiance = irradiance;
     }
 
+    void DirectionalLight::SetSplitLambda(float lambda)
+    {
+        m_splitLambda = std::clamp(lambda, 0.f, 1.f);
+    }
+
     void DirectionalLight::SetCameraFrustum(
         const DirectX::BoundingFrustum& cameraFrustum)
     {
-        DirectX::BoundingFrustum lightSpaceFrustum;
-        cameraFrustum.Transform(lightSpaceFrustum, m_shadowMapView);
-
-        std::array<DirectX::XMFLOAT3, lightSpaceFrustum.CORNER_COUNT> corners;
-        lightSpaceFrustum.GetCorners(corners.data());
-
-        DirectX::BoundingBox lightAABB;
-        DirectX::BoundingBox::CreateFromPoints(lightAABB,
-            corners.size(),
-            corners.data(),
-            sizeof(DirectX::XMFLOAT3));
-
-        // Round the orthographic projection bounds to 
-        // texel-size extents, as described in 
-        // https://learn.microsoft.com/en-us/windows/win32/dxtecharts/common-techniques-to-improve-shadow-depth-maps#techniques-to-improve-shadow-maps
-        // TODO: This doesn't seem to be working, figure out why
-        /*float worldUnitsPerTexelX = lightAABB.Extents.x / (m_width + 1);
-        float worldUnitsPerTexelY = lightAABB.Extents.y / (m_width + 1);
-
-        auto vxBounds = DirectX::XMVectorSet(lightAABB.Center.x - lightAABB.Extents.x,
-            lightAABB.Center.x + lightAABB.Extents.x, 0, 0);
-        vxBounds /= worldUnitsPerTexelX;
-        vxBounds = DirectX::XMVectorFloor(vxBounds);
-
-        DirectX::XMFLOAT2 foo;
-        DirectX::XMStoreFloat2(&foo, vxBounds);
-
-        vxBounds *= worldUnitsPerTexelX;
-
-        DirectX::XMFLOAT2 xBounds;
-        DirectX::XMStoreFloat2(&xBounds, vxBounds);
-
-        auto vyBounds = DirectX::XMVectorSet(lightAABB.Center.y - lightAABB.Extents.y,
-            lightAABB.Center.y + lightAABB.Extents.y, 0, 0);
-        vyBounds /= worldUnitsPerTexelY;
-        vyBounds = DirectX::XMVectorFloor(vyBounds);
-        vyBounds *= worldUnitsPerTexelY;
-
-        DirectX::XMFLOAT2 yBounds;
-        DirectX::XMStoreFloat2(&yBounds, vyBounds);
-
-        m_shadowMapProj = SimpleMath::Matrix::CreateOrthographicOffCenter(
-            xBounds.x,
-            xBounds.y,
-            yBounds.x,
-            yBounds.y,
-            m_sceneRadius,
-            -lightAABB.Center.z + lightAABB.Extents.z
-        );*/
-
-        float leftBound = lightAABB.Center.x - lightAABB.Extents.x;
-        float rightBound = lightAABB.Center.x + lightAABB.Extents.x;
-        float bottomBound = lightAABB.Center.y - lightAABB.Extents.y;
-        float topBound = lightAABB.Center.y + lightAABB.Extents.y;
-
-        float jitter = rand() % 1000 / 2000.f;
-        jitter = 0;
-
-        m_shadowMapProj = SimpleMath::Matrix::CreateOrthographicOffCenter(
-            leftBound - jitter,
-            rightBound + jitter,
-            bottomBound - jitter,
-            topBound + jitter,
-            m_sceneRadius,
-            -lightAABB.Center.z + lightAABB.Extents.z
-        );
-
-        {
-            // Stretch the bounding box out to include the light's 
-            // near plane. Add a bit of padding on the sides to prevent 
-            // false positives.
+        // Right-handed frustums have negative planes
+        float nearPlane = std::min(std::abs(cameraFrustum.Near), std::abs(cameraFrustum.Far));
+        float farPlane = std::max(std::abs(cameraFrustum.Near), std::abs(cameraFrustum.Far));
 
-            DirectX::BoundingBox temp;
-            DirectX::BoundingBox::CreateFromPoints(temp,
-                Vector3{ leftBound - 1, bottomBound - 1, -m_sceneRadius },
-                Vector3{ rightBound + 1, topBound + 1, -m_sceneRadius + 1 });
+        auto splits = ShadowCascades::ComputeSplitDistances(nearPlane,
+            farPlane,
+            static_cast<uint32_t>(m_cascades.size()),
+            m_splitLambda);
 
-            DirectX::BoundingBox::CreateMerged(lightAABB, lightAABB, temp);
+        for (size_t i = 0; i < m_cascades.size(); i++)
+        {
+            auto slice = ShadowCascades::GetSlice(cameraFrustum,
+                splits[i],
+                splits[i + 1]);
+
+            // The light's near plane is at the edge of the scene,
+            // so every caster in the scene is in front of it.
+            auto fitted = ShadowCascades::FitCascade(slice,
+                m_shadowMapView,
+                m_sceneRadius,
+                static_cast<uint32_t>(m_width));
+
+            auto& cascade = m_cascades[i];
+            cascade.Projection = fitted.Projection;
+            cascade.ShadowBB = fitted.Bounds;
+            cascade.Position = Vector3(fitted.Bounds.Center)
+                - fitted.Bounds.Extents.z * m_lightDirection;
         }
+    }
 
-        DirectX::BoundingOrientedBox lightOBB;
-        DirectX::BoundingOrientedBox::CreateFromBoundingBox(lightOBB,
-            lightAABB);
-
-        DirectX::BoundingOrientedBox worldSpaceLightOBB;
-        lightOBB.Transform(worldSpaceLightOBB, m_shadowMapViewInverse);
-
-        Vector3 lightSpacePosition{ lightAABB.Center.x,
-            lightAABB.Center.y,
-            lightAABB.Center.z + lightAABB.Extents.z };
-
-        m_shadowBB = worldSpaceLightOBB;
-        m_lightPosition = Vector3::Transform(lightSpacePosition, m_shadowMapViewInverse);
+    uint32_t DirectionalLight::GetNumCascades() const
+    {
+        return static_cast<uint32_t>(m_cascades.size());
     }
 
-    DirectX::SimpleMath::Vector3 DirectionalLight::GetPosition() const
+    DirectX::SimpleMath::Vector3 DirectionalLight::GetPosition(uint32_t cascade) const
     {
-        return m_lightPosition;
+        return m_cascades[cascade].Position;
     }
 
-    DirectX::BoundingOrientedBox DirectionalLight::GetShadowBB() const
+    DirectX::BoundingOrientedBox DirectionalLight::GetShadowBB(uint32_t cascade) const
     {
-        return m_shadowBB;
+        return m_cascades[cascade].ShadowBB;
     }
 
     Color DirectionalLight::GetColour() const
@@ -228,7 +202,7 @@ namespace Gradient::Rendering
 
     // Transforms a world space point into shadow map space.
     // X and Y become texcoords and Z becomes the depth.
-    Matrix DirectionalLight::GetShadowTransform() const
+    Matrix DirectionalLight::GetShadowTransform(uint32_t cascade) const
     {
         const static auto t = DirectX::SimpleMath::Matrix(
             0.5f, 0.f, 0.f, 0.f,
@@ -237,7 +211,7 @@ namespace Gradient::Rendering
             0.5f, 0.5f, 0.f, 1.f
         );
 
-        return m_shadowMapView * m_shadowMapProj * t;
+        return m_shadowMapView * m_cascades[cascade].Projection * t;
     }
 
     Matrix DirectionalLight::GetView() const
@@ -245,24 +219,32 @@ namespace Gradient::Rendering
         return m_shadowMapView;
     }
 
-    Matrix DirectionalLight::GetProjection() const
+    Matrix DirectionalLight::GetProjection(uint32_t cascade) const
     {
-        return m_shadowMapProj;
+        return m_cascades[cascade].Projection;
     }
 
-    void DirectionalLight::ClearAndSetDSV(ID3D12GraphicsCommandList* cl)
+    Pipelines::AlignedDirectionalLight DirectionalLight::GetShaderConstants() const
     {
-        auto gmm = GraphicsMemoryManager::Get();
-
-        auto cpuHandle = m_shadowMapDSV->GetCPUHandle();
+        Pipelines::AlignedDirectionalLight out = {};
+        out.colour = static_cast<DirectX::XMFLOAT3>(m_colour);
+        out.irradiance = m_irradiance;
+        out.direction = m_lightDirection;
+        out.numCascades = GetNumCascades();
+        out.shadowMapTexelSize = 1.f / m_width;
+
+        for (uint32_t i = 0; i < GetNumCascades(); i++)
+        {
+            out.shadowTransforms[i] = DirectX::XMMatrixTranspose(GetShadowTransform(i));
+        }
 
-        m_shadowMapDS.Transition(cl, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+        return out;
+    }
 
-        cl->ClearDepthStencilView(
-            cpuHandle,
-            D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL,
-            1.f,
-            0, 0, nullptr);
+    void DirectionalLight::SetDSV(ID3D12GraphicsCommandList* cl,
+        GraphicsMemoryManager::DescriptorView dsv)
+    {
+        auto cpuHandle = dsv->GetCPUHandle();
 
         cl->OMSetRenderTargets(
             0,
@@ -274,6 +256,52 @@ namespace Gradient::Rendering
         cl->RSSetViewports(1, &m_shadowMapViewport);
     }
 
+    void DirectionalLight::ClearAndSetDSV(ID3D12GraphicsCommandList* cl, uint32_t cascade)
+    {
+        auto dsv = m_cascades[cascade].DSV;
+
+        m_shadowMapDS.Transition(cl, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+
+        cl->ClearDepthStencilView(
+            dsv->GetCPUHandle(),
+            D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL,
+            1.f,
+            0, 0, nullptr);
+
+        SetDSV(cl, dsv);
+    }
+
+    void DirectionalLight::ClearAndSetStaticDSV(ID3D12GraphicsCommandList* cl, uint32_t cascade)
+    {
+        auto dsv = m_cascades[cascade].StaticDSV;
+
+        m_staticShadowMapDS.Transition(cl, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+
+        cl->ClearDepthStencilView(
+            dsv->GetCPUHandle(),
+            D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL,
+            1.f,
+            0, 0, nullptr);
+
+        SetDSV(cl, dsv);
+    }
+
+    void DirectionalLight::CopyStaticAndSetDSV(ID3D12GraphicsCommandList* cl, uint32_t cascade)
+    {
+        m_staticShadowMapDS.Transition(cl, D3D12_RESOURCE_STATE_COPY_SOURCE);
+        m_shadowMapDS.Transition(cl, D3D12_RESOURCE_STATE_COPY_DEST);
+
+        // One mip, so the subresource is the array slice
+        CD3DX12_TEXTURE_COPY_LOCATION dest(m_shadowMapDS.Get(), cascade);
+        CD3DX12_TEXTURE_COPY_LOCATION source(m_staticShadowMapDS.Get(), cascade);
+
+        cl->CopyTextureRegion(&dest, 0, 0, 0, &source, nullptr);
+
+        m_shadowMapDS.Transition(cl, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+
+        SetDSV(cl, m_cascades[cascade].DSV);
+    }
+
     GraphicsMemoryManager::DescriptorView DirectionalLight::GetShadowMapSRV() const
     {
         return m_shadowMapSRV;
@@ -3,48 +3,85 @@
 #include "pch.h"
 #include "Core/BarrierResource.h"
 #include "Core/GraphicsMemoryManager.h"
+#include "Core/Pipelines/BufferStructs.h"
 #include <directxtk12/SimpleMath.h>
+#include <vector>
 
 namespace Gradient::Rendering
 {
     // A directional light that casts shadows.
+    // The camera's shadow frustum is split into cascades, each with 
+    // its own slice of a shadow map array. Near cascades cover less 
+    // of the scene, so they get more texels per world unit.
     class DirectionalLight
     {
     public:
         DirectionalLight(ID3D12Device* device,
             DirectX::SimpleMath::Vector3 lightDirection,
             float sceneRadius,
-            DirectX::SimpleMath::Vector3 sceneCentre = DirectX::SimpleMath::Vector3::Zero);
+            DirectX::SimpleMath::Vector3 sceneCentre = DirectX::SimpleMath::Vector3::Zero,
+            uint32_t numCascades = Pipelines::MaxShadowCascades,
+            uint32_t cascadeResolution = 2048);
 
-        DirectX::SimpleMath::Matrix GetShadowTransform() const;
-        DirectX::BoundingOrientedBox GetShadowBB() const;
+        // One for every cascade, and one for the cascade's static copy
+        static constexpr uint32_t GetDsvCount(uint32_t numCascades)
+        {
+            return numCascades * 2;
+        }
+
+        uint32_t GetNumCascades() const;
+        DirectX::SimpleMath::Matrix GetShadowTransform(uint32_t cascade) const;
+        DirectX::BoundingOrientedBox GetShadowBB(uint32_t cascade) const;
         
         // Colour must be in linear space.
         void SetColour(DirectX::SimpleMath::Color colour);
         void SetLightDirection(const DirectX::SimpleMath::Vector3& direction);
         void SetIrradiance(float irradiance);
-        // WIP
+        // 0 spaces the cascades evenly, and 1 spaces them 
+        // logarithmically.
+        void SetSplitLambda(float lambda);
         void SetCameraFrustum( 
             const DirectX::BoundingFrustum& cameraFrustum);
 
-        void ClearAndSetDSV(ID3D12GraphicsCommandList* cl);
+        void ClearAndSetDSV(ID3D12GraphicsCommandList* cl, uint32_t cascade);
+
+        // Static casters can be drawn once into a separate map, which 
+        // is then copied into the shadow map every frame before the
+        // moving casters are drawn on top.
+        void ClearAndSetStaticDSV(ID3D12GraphicsCommandList* cl, uint32_t cascade);
+        void CopyStaticAndSetDSV(ID3D12GraphicsCommandList* cl, uint32_t cascade);
         void TransitionToShaderResource(ID3D12GraphicsCommandList* cl);
 
         DirectX::SimpleMath::Color GetColour() const;
         float GetIrradiance() const;
         DirectX::SimpleMath::Vector3 GetDirection() const;
-        DirectX::SimpleMath::Vector3 GetPosition() const;
+        DirectX::SimpleMath::Vector3 GetPosition(uint32_t cascade) const;
 
         DirectX::SimpleMath::Matrix GetView() const;
-        DirectX::SimpleMath::Matrix GetProjection() const;
+        DirectX::SimpleMath::Matrix GetProjection(uint32_t cascade) const;
+
+        Pipelines::AlignedDirectionalLight GetShaderConstants() const;
 
         GraphicsMemoryManager::DescriptorView GetShadowMapSRV() const;
 
     private:
+        struct Cascade
+        {
+            DirectX::SimpleMath::Matrix Projection;
+            DirectX::BoundingOrientedBox ShadowBB;
+            DirectX::SimpleMath::Vector3 Position; // the effective position that the shadow is cast from
+            GraphicsMemoryManager::DescriptorView DSV;
+            GraphicsMemoryManager::DescriptorView StaticDSV;
+        };
+
+        void SetDSV(ID3D12GraphicsCommandList* cl, 
+            GraphicsMemoryManager::DescriptorView dsv);
+
         D3D12_VIEWPORT m_shadowMapViewport;
         GraphicsMemoryManager::DescriptorView m_shadowMapSRV;
         BarrierResource m_shadowMapDS;
-        GraphicsMemoryManager::DescriptorView m_shadowMapDSV;
+        BarrierResource m_staticShadowMapDS;
+        std::vector<Cascade> m_cascades;
 
         DirectX::SimpleMath::Color m_colour;
         float m_irradiance = 10.f;
@@ -52,13 +89,9 @@ namespace Gradient::Rendering
         DirectX::SimpleMath::Vector3 m_sceneCentre;
         float m_sceneRadius;
         float m_width;
+        float m_splitLambda = 0.75f;
         DirectX::SimpleMath::Vector3 m_lightDirection;
         DirectX::SimpleMath::Matrix m_shadowMapView;
         DirectX::SimpleMath::Matrix m_shadowMapViewInverse;
-        DirectX::SimpleMath::Matrix m_shadowMapProj;
-
-        DirectX::BoundingOrientedBox m_shadowBB;
-        DirectX::SimpleMath::Vector3 m_lightPosition; // the effective position that the shadow is cast from
-
     };
 }
\ No newline at end of file
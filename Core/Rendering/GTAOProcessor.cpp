@@ -381,4 +381,9 @@ namespace Gradient::Rendering
         m_workingAOTerm.Transition(cl, D3D12_RESOURCE_STATE_ALL_SHADER_RESOURCE);
         return m_workingAOTermSRV;
     }
+
+    GraphicsMemoryManager::DescriptorView GTAOProcessor::GetResolvedDepthSRV() const
+    {
+        return m_inputDepthBufferSRV;
+    }
 }
\ No newline at end of file
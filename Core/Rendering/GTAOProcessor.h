@@ -22,6 +22,9 @@ namespace Gradient::Rendering
             RECT windowSize);
 
         GraphicsMemoryManager::DescriptorView GetSRV(ID3D12GraphicsCommandList* cl);
+        // The single sampled depth buffer resolved by the last
+        // Process, which leaves it in a shader resource state.
+        GraphicsMemoryManager::DescriptorView GetResolvedDepthSRV() const;
 
     private:
 
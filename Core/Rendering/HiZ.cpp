@@ -0,0 +1,194 @@
+#include "pch.h"
+
+#include "Core/Rendering/HiZ.h"
+
+#include <bit>
+#include <cfloat>
+
+namespace Gradient::Rendering::HiZ
+{
+    uint32_t Pyramid::GetLevelCount() const
+    {
+        return static_cast<uint32_t>(LevelOffsets.size());
+    }
+
+    uint32_t Pyramid::GetWidth(uint32_t level) const
+    {
+        return std::max(Width >> level, 1u);
+    }
+
+    uint32_t Pyramid::GetHeight(uint32_t level) const
+    {
+        return std::max(Height >> level, 1u);
+    }
+
+    float Pyramid::GetDepth(uint32_t level, uint32_t x, uint32_t y) const
+    {
+        return Depths[LevelOffsets[level] + y * GetWidth(level) + x];
+    }
+
+    uint32_t GetBaseSize(uint32_t size)
+    {
+        return std::max(std::bit_floor(size), 1u);
+    }
+
+    uint32_t GetLevelCount(uint32_t width, uint32_t height)
+    {
+        return std::bit_width(std::max(GetBaseSize(width), GetBaseSize(height)));
+    }
+
+    void GetFootprint(uint32_t destIndex,
+        uint32_t sourceSize,
+        uint32_t destSize,
+        uint32_t& first,
+        uint32_t& last)
+    {
+        first = destIndex * sourceSize / destSize;
+        last = ((destIndex + 1) * sourceSize + destSize - 1) / destSize - 1;
+        last = std::min(last, sourceSize - 1);
+    }
+
+    void Build(std::span<const float> depths,
+        uint32_t width,
+        uint32_t height,
+        const DirectX::XMFLOAT4X4& viewProj,
+        Pyramid& pyramid)
+    {
+        pyramid.Width = GetBaseSize(width);
+        pyramid.Height = GetBaseSize(height);
+        pyramid.ViewProj = viewProj;
+
+        const uint32_t numLevels = GetLevelCount(width, height);
+        pyramid.LevelOffsets.resize(numLevels);
+
+        uint32_t size = 0;
+        for (uint32_t level = 0; level < numLevels; level++)
+        {
+            pyramid.LevelOffsets[level] = size;
+            size += pyramid.GetWidth(level) * pyramid.GetHeight(level);
+        }
+        pyramid.Depths.resize(size);
+
+        const float* source = depths.data();
+        uint32_t sourceWidth = width;
+        uint32_t sourceHeight = height;
+
+        for (uint32_t level = 0; level < numLevels; level++)
+        {
+            const uint32_t destWidth = pyramid.GetWidth(level);
+            const uint32_t destHeight = pyramid.GetHeight(level);
+            float* dest = pyramid.Depths.data() + pyramid.LevelOffsets[level];
+
+            for (uint32_t y = 0; y < destHeight; y++)
+            {
+                uint32_t firstY, lastY;
+                GetFootprint(y, sourceHeight, destHeight, firstY, lastY);
+
+                for (uint32_t x = 0; x < destWidth; x++)
+                {
+                    uint32_t firstX, lastX;
+                    GetFootprint(x, sourceWidth, destWidth, firstX, lastX);
+
+                    float farthest = 0.f;
+                    for (uint32_t sy = firstY; sy <= lastY; sy++)
+                    {
+                        for (uint32_t sx = firstX; sx <= lastX; sx++)
+                        {
+                            farthest = std::max(farthest, source[sy * sourceWidth + sx]);
+                        }
+                    }
+
+                    dest[y * destWidth + x] = farthest;
+                }
+            }
+
+            source = dest;
+            sourceWidth = destWidth;
+            sourceHeight = destHeight;
+        }
+    }
+
+    // /fp:fast would be free to reorder or fuse these,
+    // which the shader's precise arithmetic doesn't do.
+#pragma float_control(precise, on, push)
+#pragma fp_contract(off)
+
+    bool IsOccluded(const Pyramid& pyramid,
+        const DirectX::XMFLOAT3& center,
+        const DirectX::XMFLOAT3& extents)
+    {
+        if (pyramid.LevelOffsets.empty())
+            return false;
+
+        const auto& m = pyramid.ViewProj;
+
+        float minX = FLT_MAX;
+        float minY = FLT_MAX;
+        float maxX = -FLT_MAX;
+        float maxY = -FLT_MAX;
+        float minDepth = 1.f;
+
+        for (int i = 0; i < 8; i++)
+        {
+            const float x = (i & 1) ? center.x + extents.x : center.x - extents.x;
+            const float y = (i & 2) ? center.y + extents.y : center.y - extents.y;
+            const float z = (i & 4) ? center.z + extents.z : center.z - extents.z;
+
+            const float clipX = x * m._11 + y * m._21 + z * m._31 + m._41;
+            const float clipY = x * m._12 + y * m._22 + z * m._32 + m._42;
+            const float clipZ = x * m._13 + y * m._23 + z * m._33 + m._43;
+            const float clipW = x * m._14 + y * m._24 + z * m._34 + m._44;
+
+            // Past the near plane, where the rectangle can't be trusted
+            if (clipW <= 0.f || clipZ < 0.f)
+                return false;
+
+            const float u = clipX / clipW * 0.5f + 0.5f;
+            const float v = 0.5f - clipY / clipW * 0.5f;
+
+            minX = std::min(minX, u);
+            minY = std::min(minY, v);
+            maxX = std::max(maxX, u);
+            maxY = std::max(maxY, v);
+            minDepth = std::min(minDepth, clipZ / clipW);
+        }
+
+        // Frustum culling deals with anything off the screen
+        if (maxX < 0.f || maxY < 0.f || minX > 1.f || minY > 1.f)
+            return false;
+
+        minX = std::max(minX, 0.f);
+        minY = std::max(minY, 0.f);
+        maxX = std::min(maxX, 1.f);
+        maxY = std::min(maxY, 1.f);
+
+        const uint32_t lastLevel = pyramid.GetLevelCount() - 1;
+        const uint32_t firstX = std::min(static_cast<uint32_t>(minX * pyramid.Width), pyramid.Width - 1);
+        const uint32_t firstY = std::min(static_cast<uint32_t>(minY * pyramid.Height), pyramid.Height - 1);
+        const uint32_t lastX = std::min(static_cast<uint32_t>(maxX * pyramid.Width), pyramid.Width - 1);
+        const uint32_t lastY = std::min(static_cast<uint32_t>(maxY * pyramid.Height), pyramid.Height - 1);
+
+        // The finest level where the rectangle covers two by two texels at most
+        uint32_t level = 0;
+        while (level < lastLevel
+            && ((lastX >> level) - (firstX >> level) > 1
+                || (lastY >> level) - (firstY >> level) > 1))
+        {
+            level++;
+        }
+
+        float farthest = 0.f;
+        for (uint32_t y = firstY >> level; y <= (lastY >> level); y++)
+        {
+            for (uint32_t x = firstX >> level; x <= (lastX >> level); x++)
+            {
+                farthest = std::max(farthest, pyramid.GetDepth(level, x, y));
+            }
+        }
+
+        return minDepth > farthest;
+    }
+
+#pragma fp_contract(on)
+#pragma float_control(pop)
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Nothing here touches D3D12, so the occlusion tests
+// can be built and checked on any platform.
+namespace Gradient::Rendering::HiZ
+{
+    // A depth pyramid that keeps the farthest depth under each texel.
+    // Level 0 is the largest power of two that fits in the depth buffer,
+    // and each level after it halves until the last one is a single texel.
+    struct Pyramid
+    {
+        uint32_t Width = 0;
+        uint32_t Height = 0;
+        std::vector<uint32_t> LevelOffsets;
+        std::vector<float> Depths;
+        // The view and projection the depths were drawn with
+        DirectX::XMFLOAT4X4 ViewProj;
+
+        uint32_t GetLevelCount() const;
+        uint32_t GetWidth(uint32_t level) const;
+        uint32_t GetHeight(uint32_t level) const;
+        float GetDepth(uint32_t level, uint32_t x, uint32_t y) const;
+    };
+
+    // The size of level 0 for a depth buffer of the given size
+    uint32_t GetBaseSize(uint32_t size);
+    // Including level 0
+    uint32_t GetLevelCount(uint32_t width, uint32_t height);
+
+    // The texels of the level above that a texel covers, inclusive.
+    // DepthPyramid_CS uses the same integer arithmetic.
+    void GetFootprint(uint32_t destIndex,
+        uint32_t sourceSize,
+        uint32_t destSize,
+        uint32_t& first,
+        uint32_t& last);
+
+    // Reduces a depth buffer into a pyramid the same way DepthPyramid_CS does
+    void Build(std::span<const float> depths,
+        uint32_t width,
+        uint32_t height,
+        const DirectX::XMFLOAT4X4& viewProj,
+        Pyramid& pyramid);
+
+    // Does what IsBoxOccluded in HiZ.hlsli does, with the same arithmetic
+    // in the same order. A box is only occluded if it's nearer than none
+    // of the depths over the rectangle it covers on screen, so anything
+    // crossing the near plane or outside of the screen counts as visible.
+    // The box is projected with the pyramid's own view and projection, so
+    // an older pyramid can still be tested against after the camera moves.
+    bool IsOccluded(const Pyramid& pyramid,
+        const DirectX::XMFLOAT3& center,
+        const DirectX::XMFLOAT3& extents);
+}
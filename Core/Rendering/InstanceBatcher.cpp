@@ -0,0 +1,224 @@
+#include "pch.h"
+
+#include "Core/Rendering/InstanceBatcher.h"
+#include "Core/SceneCache.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <numeric>
+
+namespace Gradient::Rendering
+{
+    using namespace DirectX::SimpleMath;
+
+    namespace
+    {
+        // How far a world matrix can be from its decomposed 
+        // scale, rotation and translation to still be batched.
+        constexpr float DecomposeTolerance = 1e-4f;
+
+        bool NearlyEqual(const Matrix& a, const Matrix& b, float scale)
+        {
+            const float* lhs = &a._11;
+            const float* rhs = &b._11;
+            for (int i = 0; i < 16; i++)
+            {
+                if (std::abs(lhs[i] - rhs[i]) > DecomposeTolerance * scale)
+                    return false;
+            }
+            return true;
+        }
+
+        uint64_t HashMaterial(const PBRMaterial& material)
+        {
+            Fnv1a hash;
+            hash.Add(material.Texture.get());
+            hash.Add(material.NormalMap.get());
+            hash.Add(material.AOMap.get());
+            hash.Add(material.MetalnessMap.get());
+            hash.Add(material.RoughnessMap.get());
+            hash.Add(material.EmissiveRadiance);
+            hash.Add(material.Tiling);
+            hash.Add(material.Masked);
+            return hash.Get();
+        }
+    }
+
+    void InstanceBatcher::Clear()
+    {
+        m_draws.clear();
+        m_materials.clear();
+        m_materialIndices.clear();
+        m_batches.clear();
+        m_instances.clear();
+        m_unbatched.clear();
+    }
+
+    bool InstanceBatcher::Add(entt::entity entity,
+        DrawType drawType,
+        BufferManager::MeshHandle mesh,
+        const PBRMaterial& material,
+        const Matrix& world)
+    {
+        Vector3 scale;
+        Quaternion rotation;
+        Vector3 translation;
+
+        Matrix decomposed = world;
+        if (!decomposed.Decompose(scale, rotation, translation))
+            return false;
+
+        const float magnitude = std::max({ scale.x, translation.Length(), 1.f });
+
+        if (std::abs(scale.y - scale.x) > DecomposeTolerance * scale.x
+            || std::abs(scale.z - scale.x) > DecomposeTolerance * scale.x)
+            return false;
+
+        // Sheared matrices decompose too, but not into anything 
+        // that can be put back together.
+        auto rebuilt = Matrix::CreateScale(scale.x)
+            * Matrix::CreateFromQuaternion(rotation)
+            * Matrix::CreateTranslation(translation);
+        if (!NearlyEqual(rebuilt, world, magnitude))
+            return false;
+
+        m_draws.push_back(Draw{
+            entity,
+            drawType,
+            mesh,
+            GetMaterialIndex(material),
+            scale.x,
+            translation,
+            rotation
+            });
+
+        return true;
+    }
+
+    void InstanceBatcher::Build()
+    {
+        m_batches.clear();
+        m_instances.clear();
+        m_unbatched.clear();
+        m_unbatchedDraws.clear();
+
+        m_order.resize(m_draws.size());
+        std::iota(m_order.begin(), m_order.end(), 0);
+
+        auto groupKey = [this](uint32_t index)
+            {
+                const auto& draw = m_draws[index];
+                return std::make_tuple(draw.Type,
+                    draw.Mesh,
+                    draw.MaterialIndex,
+                    std::bit_cast<uint32_t>(draw.Scale));
+            };
+
+        // Ties are left in the order they were added
+        std::sort(m_order.begin(), m_order.end(),
+            [&](uint32_t a, uint32_t b)
+            {
+                auto keyA = groupKey(a);
+                auto keyB = groupKey(b);
+                return keyA < keyB || (keyA == keyB && a < b);
+            });
+
+        size_t groupBegin = 0;
+        while (groupBegin < m_order.size())
+        {
+            size_t groupEnd = groupBegin + 1;
+            while (groupEnd < m_order.size()
+                && groupKey(m_order[groupEnd]) == groupKey(m_order[groupBegin]))
+            {
+                groupEnd++;
+            }
+
+            const auto& first = m_draws[m_order[groupBegin]];
+            const uint32_t count = static_cast<uint32_t>(groupEnd - groupBegin);
+
+            if (count < MinInstances)
+            {
+                m_unbatchedDraws.insert(m_unbatchedDraws.end(),
+                    m_order.begin() + groupBegin,
+                    m_order.begin() + groupEnd);
+            }
+            else
+            {
+                m_batches.push_back(Batch{
+                    first.Mesh,
+                    m_materials[first.MaterialIndex],
+                    first.Type,
+                    Matrix::CreateScale(first.Scale),
+                    static_cast<uint32_t>(m_instances.size()),
+                    count,
+                    first.Entity
+                    });
+
+                for (size_t i = groupBegin; i < groupEnd; i++)
+                {
+                    const auto& draw = m_draws[m_order[i]];
+
+                    // The batch's world matrix scales the translation
+                    // along with everything else, so it's undone here.
+                    BufferManager::InstanceData instance;
+                    instance.Position = draw.Translation / draw.Scale;
+                    instance.pad = 0.f;
+                    instance.RotationQuat = draw.Rotation;
+                    instance.TexcoordURange = { 0.f, 1.f };
+                    instance.TexcoordVRange = { 0.f, 1.f };
+
+                    m_instances.push_back(instance);
+                }
+            }
+
+            groupBegin = groupEnd;
+        }
+
+        std::sort(m_unbatchedDraws.begin(), m_unbatchedDraws.end());
+        for (auto index : m_unbatchedDraws)
+        {
+            m_unbatched.push_back(m_draws[index].Entity);
+        }
+    }
+
+    std::span<const InstanceBatcher::Batch> InstanceBatcher::GetBatches() const
+    {
+        return m_batches;
+    }
+
+    std::span<const BufferManager::InstanceData> InstanceBatcher::GetInstances() const
+    {
+        return m_instances;
+    }
+
+    std::span<const entt::entity> InstanceBatcher::GetUnbatched() const
+    {
+        return m_unbatched;
+    }
+
+    uint32_t InstanceBatcher::GetMaterialIndex(const PBRMaterial& material)
+    {
+        auto hash = HashMaterial(material);
+
+        auto [it, inserted] = m_materialIndices.try_emplace(hash,
+            static_cast<uint32_t>(m_materials.size()));
+
+        if (inserted)
+        {
+            m_materials.push_back(&material);
+            return it->second;
+        }
+
+        // Materials are copied into each entity, so equal ones
+        // are found by value rather than by address.
+        for (uint32_t i = it->second; i < m_materials.size(); i++)
+        {
+            if (*m_materials[i] == material)
+                return i;
+        }
+
+        m_materials.push_back(&material);
+        return static_cast<uint32_t>(m_materials.size() - 1);
+    }
+}
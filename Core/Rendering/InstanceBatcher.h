@@ -0,0 +1,92 @@
+#pragma once
+
+#include "pch.h"
+
+#include "Core/BufferManager.h"
+#include "Core/Pipelines/IRenderPipeline.h"
+#include "Core/Rendering/PBRMaterial.h"
+
+#include <directxtk12/SimpleMath.h>
+#include <entt/entt.hpp>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace Gradient::Rendering
+{
+    // Gathers draws of the same mesh and material into instanced 
+    // batches. Each batch gets a range of instance data, so one
+    // buffer can be uploaded for all of them and drawn with the
+    // instanced pipeline. Doesn't touch the device.
+    //
+    // Instance data can't hold scale, so draws are only batched 
+    // with others of the same uniform scale, which goes into the
+    // batch's world matrix instead. 
+    class InstanceBatcher
+    {
+    public:
+        using DrawType = Pipelines::IRenderPipeline::DrawType;
+
+        struct Batch
+        {
+            BufferManager::MeshHandle Mesh;
+            // Points to the material passed in for the first draw
+            const PBRMaterial* Material;
+            DrawType Type;
+            DirectX::SimpleMath::Matrix World;
+            uint32_t FirstInstance;
+            uint32_t InstanceCount;
+            entt::entity FirstEntity;
+        };
+
+        // Fewer draws than this are left alone
+        static constexpr uint32_t MinInstances = 2;
+
+        void Clear();
+
+        // Returns false if the draw can't be instanced, 
+        // in which case it should be drawn by itself.
+        // The material must outlive the batches.
+        bool Add(entt::entity entity,
+            DrawType drawType,
+            BufferManager::MeshHandle mesh,
+            const PBRMaterial& material,
+            const DirectX::SimpleMath::Matrix& world);
+
+        // Groups the draws added since the last Clear into batches.
+        // Draws left in groups that were too small are returned by 
+        // GetUnbatched, in the order they were added.
+        void Build();
+
+        std::span<const Batch> GetBatches() const;
+        // Indexed by each batch's instance range
+        std::span<const BufferManager::InstanceData> GetInstances() const;
+        std::span<const entt::entity> GetUnbatched() const;
+
+    private:
+        struct Draw
+        {
+            entt::entity Entity;
+            DrawType Type;
+            BufferManager::MeshHandle Mesh;
+            uint32_t MaterialIndex;
+            float Scale;
+            DirectX::SimpleMath::Vector3 Translation;
+            DirectX::SimpleMath::Quaternion Rotation;
+        };
+
+        uint32_t GetMaterialIndex(const PBRMaterial& material);
+
+        std::vector<Draw> m_draws;
+        std::vector<uint32_t> m_order;
+        std::vector<uint32_t> m_unbatchedDraws;
+        std::vector<const PBRMaterial*> m_materials;
+        // From a hash of each material to its first index in 
+        // m_materials, with collisions searched linearly.
+        std::unordered_map<uint64_t, uint32_t> m_materialIndices;
+
+        std::vector<Batch> m_batches;
+        std::vector<BufferManager::InstanceData> m_instances;
+        std::vector<entt::entity> m_unbatched;
+    };
+}
@@ -0,0 +1,325 @@
+#include "pch.h"
+
+#include "Core/Rendering/InstanceCuller.h"
+#include "Core/GraphicsMemoryManager.h"
+#include "Core/ReadData.h"
+
+#include <bit>
+
+namespace Gradient::Rendering
+{
+    namespace
+    {
+        constexpr uint32_t InitialInstanceCapacity = 1 << 16;
+        constexpr uint32_t InitialDrawCapacity = 256;
+    }
+
+    InstanceCuller::InstanceCuller(ID3D12Device* device)
+        : m_device(device)
+    {
+        m_rootSignature.AddCBV(0, 0);
+        m_rootSignature.AddRootSRV(0, 0); // draws
+        m_rootSignature.AddRootSRV(2, 0); // passes
+        m_rootSignature.AddRootUAV(0, 0); // visible instance indices
+        m_rootSignature.AddRootUAV(1, 0); // draw arguments
+        m_rootSignature.AddSRV(1, 0); // depth pyramid
+        // Each draw reads its own instance buffer
+        m_rootSignature.AllowDescriptorHeapIndexing();
+        m_rootSignature.Build(device, true);
+
+        auto csData = DX::ReadData(L"InstanceCulling_CS.cso");
+        D3D12_COMPUTE_PIPELINE_STATE_DESC psoDesc = {};
+        psoDesc.pRootSignature = m_rootSignature.Get();
+        psoDesc.CS = { csData.data(), csData.size() };
+        DX::ThrowIfFailed(
+            device->CreateComputePipelineState(&psoDesc, IID_PPV_ARGS(m_pso.ReleaseAndGetAddressOf())));
+
+        // Nothing but the draw arguments, so no root signature is needed
+        D3D12_INDIRECT_ARGUMENT_DESC argumentDesc = {};
+        argumentDesc.Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED;
+
+        D3D12_COMMAND_SIGNATURE_DESC signatureDesc = {};
+        signatureDesc.ByteStride = sizeof(D3D12_DRAW_INDEXED_ARGUMENTS);
+        signatureDesc.NumArgumentDescs = 1;
+        signatureDesc.pArgumentDescs = &argumentDesc;
+
+        DX::ThrowIfFailed(
+            device->CreateCommandSignature(&signatureDesc,
+                nullptr,
+                IID_PPV_ARGS(m_commandSignature.ReleaseAndGetAddressOf())));
+
+        m_maxInstancesRequested = InitialInstanceCapacity;
+        m_maxDrawsRequested = InitialDrawCapacity;
+    }
+
+    void InstanceCuller::BeginFrame(UINT frameIndex)
+    {
+        if (frameIndex >= m_frames.size())
+        {
+            m_frames.resize(frameIndex + 1);
+        }
+
+        m_frameIndex = frameIndex;
+        m_hasOccluders = false;
+        m_passes.clear();
+        m_draws.clear();
+        m_numInstancesUsed = 0;
+        m_numInstancesRequested = 0;
+        m_numDrawsRequested = 0;
+
+        auto& buffers = m_frames[frameIndex];
+        if (buffers.CommandAllocator == nullptr)
+        {
+            DX::ThrowIfFailed(
+                m_device->CreateCommandAllocator(
+                    D3D12_COMMAND_LIST_TYPE_DIRECT,
+                    IID_PPV_ARGS(buffers.CommandAllocator.ReleaseAndGetAddressOf())));
+        }
+
+        if (m_commandList == nullptr)
+        {
+            DX::ThrowIfFailed(
+                m_device->CreateCommandList(
+                    0,
+                    D3D12_COMMAND_LIST_TYPE_DIRECT,
+                    buffers.CommandAllocator.Get(),
+                    nullptr,
+                    IID_PPV_ARGS(m_commandList.ReleaseAndGetAddressOf())));
+            m_commandList->Close();
+            m_commandList->SetName(L"Instance culling");
+        }
+
+        if (buffers.InstanceCapacity < m_maxInstancesRequested
+            || buffers.DrawCapacity < m_maxDrawsRequested)
+        {
+            CreateBuffers(buffers,
+                std::bit_ceil(std::max(buffers.InstanceCapacity, m_maxInstancesRequested)),
+                std::min(std::bit_ceil(std::max(buffers.DrawCapacity, m_maxDrawsRequested)),
+                    MaxDrawsPerFrame));
+        }
+    }
+
+    void InstanceCuller::SetOccluders(const DepthPyramid& depthPyramid)
+    {
+        m_hiZSRV = depthPyramid.GetSRV();
+        m_occlusionViewProj = depthPyramid.GetViewProj();
+        m_hiZWidth = depthPyramid.GetWidth();
+        m_hiZHeight = depthPyramid.GetHeight();
+        m_hiZLevels = depthPyramid.GetLevelCount();
+        m_hasOccluders = depthPyramid.IsBuilt();
+    }
+
+    void InstanceCuller::BeginPass(const std::array<DirectX::XMFLOAT4, 6>& planes,
+        bool occlusionCulling)
+    {
+        PassData pass = {};
+        std::copy(planes.begin(), planes.end(), pass.FrustumPlanes);
+        pass.OcclusionCulling = occlusionCulling && m_hasOccluders ? 1 : 0;
+
+        m_passes.push_back(pass);
+    }
+
+    std::optional<InstanceCuller::CulledDraw> InstanceCuller::Cull(
+        const BufferManager::InstanceBufferEntry& instances,
+        const DirectX::SimpleMath::Matrix& world,
+        float instanceRadius,
+        uint32_t indexCount)
+    {
+        assert(!m_passes.empty());
+
+        auto& buffers = m_frames[m_frameIndex];
+        const uint32_t numInstances = instances.InstanceCount;
+        const uint32_t drawIndex = static_cast<uint32_t>(m_draws.size());
+
+        m_numInstancesRequested += numInstances;
+        m_numDrawsRequested++;
+        m_maxInstancesRequested = std::max(m_maxInstancesRequested, m_numInstancesRequested);
+        m_maxDrawsRequested = std::max(m_maxDrawsRequested, std::min(m_numDrawsRequested, MaxDrawsPerFrame));
+
+        if (m_numInstancesUsed + numInstances > buffers.InstanceCapacity
+            || drawIndex + 1 > buffers.DrawCapacity)
+        {
+            return std::nullopt;
+        }
+
+        DrawData draw = {};
+        DirectX::XMStoreFloat4x4(&draw.ParentWorld, DirectX::XMMatrixTranspose(world));
+        draw.InstanceRadius = instanceRadius;
+        draw.NumInstances = numInstances;
+        draw.FirstVisible = m_numInstancesUsed;
+        draw.IndexCount = indexCount;
+        draw.InstanceBuffer = static_cast<uint32_t>(instances.SRV->m_index);
+        draw.PassIndex = static_cast<uint32_t>(m_passes.size() - 1);
+
+        m_draws.push_back(draw);
+
+        CulledDraw culledDraw{
+            buffers.VisibleInstances.GetGpuAddress() + m_numInstancesUsed * sizeof(uint32_t),
+            buffers.Arguments.Get(),
+            drawIndex * sizeof(D3D12_DRAW_INDEXED_ARGUMENTS)
+        };
+
+        m_numInstancesUsed += numInstances;
+
+        return culledDraw;
+    }
+
+    void InstanceCuller::Submit(ID3D12CommandQueue* cq)
+    {
+        if (m_draws.empty()) return;
+
+        auto gmm = GraphicsMemoryManager::Get();
+        auto& buffers = m_frames[m_frameIndex];
+        auto cl = m_commandList.Get();
+
+        DX::ThrowIfFailed(buffers.CommandAllocator->Reset());
+        DX::ThrowIfFailed(cl->Reset(buffers.CommandAllocator.Get(), m_pso.Get()));
+
+        auto heap = gmm->GetSrvUavDescriptorHeap();
+        cl->SetDescriptorHeaps(1, &heap);
+        m_rootSignature.SetOnCommandList(cl);
+
+        CullingCB constants;
+        constants.OcclusionViewProj = DirectX::XMMatrixTranspose(m_occlusionViewProj);
+        constants.HiZWidth = m_hiZWidth;
+        constants.HiZHeight = m_hiZHeight;
+        constants.HiZLevels = m_hiZLevels;
+
+        m_rootSignature.SetCBV(cl, 0, 0, constants);
+        m_rootSignature.SetStructuredBufferSRV(cl, 0, 0,
+            gmm->AllocateArray(std::span<const DrawData>(m_draws)));
+        m_rootSignature.SetStructuredBufferSRV(cl, 2, 0,
+            gmm->AllocateArray(std::span<const PassData>(m_passes)));
+        m_rootSignature.SetStructuredBufferUAV(cl, 0, 0, buffers.VisibleInstances.GetGpuAddress());
+        m_rootSignature.SetStructuredBufferUAV(cl, 1, 0, buffers.Arguments.GetGpuAddress());
+        // Bound even when it isn't read, so the table is always valid
+        m_rootSignature.SetSRV(cl, 1, 0, m_hiZSRV);
+
+        // Buffers decay to the common state at the end of every
+        // command list, and the draws promote them out of it again.
+        buffers.VisibleInstances.SetState(D3D12_RESOURCE_STATE_COMMON);
+        buffers.Arguments.SetState(D3D12_RESOURCE_STATE_COMMON);
+        buffers.VisibleInstances.Transition(cl, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+        buffers.Arguments.Transition(cl, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+        // Draws write to separate parts of the buffers,
+        // so there's no need for barriers between them.
+        cl->Dispatch(static_cast<UINT>(m_draws.size()), 1, 1);
+
+        DX::ThrowIfFailed(cl->Close());
+        ID3D12CommandList* lists[] = { cl };
+        cq->ExecuteCommandLists(1, lists);
+    }
+
+    ID3D12CommandSignature* InstanceCuller::GetCommandSignature() const
+    {
+        return m_commandSignature.Get();
+    }
+
+    float InstanceCuller::GetInstanceRadius(const DirectX::BoundingBox& meshBounds,
+        const DirectX::SimpleMath::Matrix& world)
+    {
+        using namespace DirectX::SimpleMath;
+
+        float localRadius = Vector3(meshBounds.Center).Length()
+            + Vector3(meshBounds.Extents).Length();
+
+        float maxScale = std::max({
+            Vector3(world._11, world._12, world._13).Length(),
+            Vector3(world._21, world._22, world._23).Length(),
+            Vector3(world._31, world._32, world._33).Length() });
+
+        return localRadius * maxScale;
+    }
+
+    // /fp:fast would be free to reorder or fuse these,
+    // which the shader's precise arithmetic doesn't do.
+#pragma float_control(precise, on, push)
+#pragma fp_contract(off)
+
+    uint32_t InstanceCuller::CullOnCpu(std::span<const BufferManager::InstanceData> instances,
+        const DirectX::SimpleMath::Matrix& world,
+        float instanceRadius,
+        const std::array<DirectX::XMFLOAT4, 6>& planes,
+        std::vector<uint32_t>& visibleInstances,
+        const HiZ::Pyramid* occluders)
+    {
+        visibleInstances.clear();
+
+        for (uint32_t i = 0; i < instances.size(); i++)
+        {
+            const auto& position = instances[i].Position;
+
+            const float centerX = position.x * world._11
+                + position.y * world._21
+                + position.z * world._31
+                + world._41;
+            const float centerY = position.x * world._12
+                + position.y * world._22
+                + position.z * world._32
+                + world._42;
+            const float centerZ = position.x * world._13
+                + position.y * world._23
+                + position.z * world._33
+                + world._43;
+
+            bool visible = true;
+            for (const auto& plane : planes)
+            {
+                const float planeDistance = centerX * plane.x
+                    + centerY * plane.y
+                    + centerZ * plane.z
+                    + plane.w;
+
+                if (planeDistance < -instanceRadius)
+                {
+                    visible = false;
+                    break;
+                }
+            }
+
+            if (visible && occluders != nullptr)
+            {
+                visible = !HiZ::IsOccluded(*occluders,
+                    DirectX::XMFLOAT3(centerX, centerY, centerZ),
+                    DirectX::XMFLOAT3(instanceRadius, instanceRadius, instanceRadius));
+            }
+
+            if (visible)
+            {
+                visibleInstances.push_back(i);
+            }
+        }
+
+        return static_cast<uint32_t>(visibleInstances.size());
+    }
+
+#pragma fp_contract(on)
+#pragma float_control(pop)
+
+    void InstanceCuller::CreateBuffers(FrameBuffers& buffers,
+        uint32_t instanceCapacity,
+        uint32_t drawCapacity)
+    {
+        auto visibleDesc = CD3DX12_RESOURCE_DESC::Buffer(
+            instanceCapacity * sizeof(uint32_t),
+            D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+        buffers.VisibleInstances.Create(m_device.Get(),
+            &visibleDesc,
+            D3D12_RESOURCE_STATE_COMMON,
+            nullptr);
+        buffers.VisibleInstances.Get()->SetName(L"Visible instance indices");
+
+        auto argumentsDesc = CD3DX12_RESOURCE_DESC::Buffer(
+            drawCapacity * sizeof(D3D12_DRAW_INDEXED_ARGUMENTS),
+            D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+        buffers.Arguments.Create(m_device.Get(),
+            &argumentsDesc,
+            D3D12_RESOURCE_STATE_COMMON,
+            nullptr);
+        buffers.Arguments.Get()->SetName(L"Culled draw arguments");
+
+        buffers.InstanceCapacity = instanceCapacity;
+        buffers.DrawCapacity = drawCapacity;
+    }
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include "pch.h"
+
+#include "Core/BarrierResource.h"
+#include "Core/BufferManager.h"
+#include "Core/GraphicsMemoryManager.h"
+#include "Core/RootSignature.h"
+#include "Core/Rendering/DepthPyramid.h"
+#include "Core/Rendering/HiZ.h"
+
+#include <directxtk12/SimpleMath.h>
+#include <array>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace Gradient::Rendering
+{
+    // Culls the instances of instanced draws one by one on the GPU.
+    // A compute shader compacts the indices of the visible instances
+    // and writes the arguments for an ExecuteIndirect that draws them,
+    // so entities with thousands of instances aren't all or nothing.
+    //
+    // The draws of every pass in a frame are gathered on the CPU and
+    // culled in one dispatch, one group per draw, on a command list of
+    // the culler's own that runs before the frame's. That way the
+    // buffers are only transitioned once a frame, rather than around
+    // every pass. It also means the depth pyramid is the one the last
+    // frame built, reprojected with the view it was built with.
+    //
+    // The buffers are kept per frame in flight, and grow when a frame
+    // runs out of room.
+    class InstanceCuller
+    {
+    public:
+        // Smaller instanced draws aren't worth culling
+        static constexpr uint32_t MinInstances = 64;
+        // A group per draw, all in one dispatch
+        static constexpr uint32_t MaxDrawsPerFrame = D3D12_CS_DISPATCH_MAX_THREAD_GROUPS_PER_DIMENSION;
+
+        struct __declspec(align(256)) CullingCB
+        {
+            DirectX::XMMATRIX OcclusionViewProj;
+            uint32_t HiZWidth;
+            uint32_t HiZHeight;
+            uint32_t HiZLevels;
+        };
+
+        struct PassData
+        {
+            DirectX::XMFLOAT4 FrustumPlanes[6];
+            uint32_t OcclusionCulling;
+            uint32_t Pad[3];
+        };
+
+        struct DrawData
+        {
+            DirectX::XMFLOAT4X4 ParentWorld;
+            float InstanceRadius;
+            uint32_t NumInstances;
+            uint32_t FirstVisible;
+            uint32_t IndexCount;
+            // The instance buffer's SRV, read through the descriptor heap
+            uint32_t InstanceBuffer;
+            uint32_t PassIndex;
+            uint32_t Pad[2];
+        };
+
+        struct CulledDraw
+        {
+            // Indices of the visible instances, starting from this draw's
+            D3D12_GPU_VIRTUAL_ADDRESS VisibleInstances;
+            ID3D12Resource* Arguments;
+            UINT64 ArgumentsOffset;
+        };
+
+        explicit InstanceCuller(ID3D12Device* device);
+
+        // The buffers used the last time this frame index came
+        // around are reused, so the GPU must be done with them.
+        void BeginFrame(UINT frameIndex);
+
+        // Passes that cull against occluders test against the pyramid
+        // as it is when this is called, which has to be before it's
+        // built again this frame, since that's what the dispatch sees.
+        void SetOccluders(const DepthPyramid& depthPyramid);
+
+        // The draws culled after this use these planes. Occlusion
+        // culling is skipped if the pyramid has never been built.
+        void BeginPass(const std::array<DirectX::XMFLOAT4, 6>& planes,
+            bool occlusionCulling);
+        // Returns nothing if this frame's buffers are full,
+        // in which case all of the instances should be drawn.
+        std::optional<CulledDraw> Cull(const BufferManager::InstanceBufferEntry& instances,
+            const DirectX::SimpleMath::Matrix& world,
+            float instanceRadius,
+            uint32_t indexCount);
+
+        // Records the dispatch for every draw culled this frame and
+        // executes it, so it has to be called before the command list
+        // with the draws is executed.
+        void Submit(ID3D12CommandQueue* cq);
+
+        ID3D12CommandSignature* GetCommandSignature() const;
+
+        // The radius of a sphere around an instance's origin that
+        // covers its mesh however the instance is rotated.
+        static float GetInstanceRadius(const DirectX::BoundingBox& meshBounds,
+            const DirectX::SimpleMath::Matrix& world);
+
+        // Does what InstanceCulling_CS does, with the same arithmetic in
+        // the same order, so the visible instances are exactly the same.
+        // Returns the instance count the shader writes to the arguments.
+        // Passing a pyramid does what the shader does with occlusion culling on.
+        static uint32_t CullOnCpu(std::span<const BufferManager::InstanceData> instances,
+            const DirectX::SimpleMath::Matrix& world,
+            float instanceRadius,
+            const std::array<DirectX::XMFLOAT4, 6>& planes,
+            std::vector<uint32_t>& visibleInstances,
+            const HiZ::Pyramid* occluders = nullptr);
+
+    private:
+        struct FrameBuffers
+        {
+            Microsoft::WRL::ComPtr<ID3D12CommandAllocator> CommandAllocator;
+            BarrierResource VisibleInstances;
+            BarrierResource Arguments;
+            uint32_t InstanceCapacity = 0;
+            uint32_t DrawCapacity = 0;
+        };
+
+        void CreateBuffers(FrameBuffers& buffers,
+            uint32_t instanceCapacity,
+            uint32_t drawCapacity);
+
+        Microsoft::WRL::ComPtr<ID3D12Device> m_device;
+        RootSignature m_rootSignature;
+        Microsoft::WRL::ComPtr<ID3D12PipelineState> m_pso;
+        Microsoft::WRL::ComPtr<ID3D12CommandSignature> m_commandSignature;
+        Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> m_commandList;
+
+        std::vector<FrameBuffers> m_frames;
+        UINT m_frameIndex = 0;
+
+        GraphicsMemoryManager::DescriptorView m_hiZSRV;
+        DirectX::SimpleMath::Matrix m_occlusionViewProj;
+        uint32_t m_hiZWidth = 0;
+        uint32_t m_hiZHeight = 0;
+        uint32_t m_hiZLevels = 0;
+        bool m_hasOccluders = false;
+
+        std::vector<PassData> m_passes;
+        std::vector<DrawData> m_draws;
+        uint32_t m_numInstancesUsed = 0;
+
+        // Including what didn't fit, which the 
+        // buffers grow to the next time around.
+        uint32_t m_numInstancesRequested = 0;
+        uint32_t m_numDrawsRequested = 0;
+        uint32_t m_maxInstancesRequested = 0;
+        uint32_t m_maxDrawsRequested = 0;
+    };
+}
@@ -0,0 +1,196 @@
+#include "pch.h"
+
+#include "Core/Rendering/InstanceLodSelector.h"
+#include "Core/Rendering/InstanceCuller.h"
+
+namespace Gradient::Rendering
+{
+    std::vector<InstanceLodSelector::Cluster> InstanceLodSelector::BuildClusters(
+        std::span<const BufferManager::InstanceData> instances,
+        const DirectX::BoundingBox& meshBounds,
+        uint32_t clusterSize)
+    {
+        using namespace DirectX::SimpleMath;
+
+        assert(clusterSize > 0);
+
+        const float instanceRadius = InstanceCuller::GetInstanceRadius(meshBounds,
+            Matrix::Identity);
+
+        std::vector<Cluster> clusters;
+        clusters.reserve((instances.size() + clusterSize - 1) / clusterSize);
+
+        for (size_t first = 0; first < instances.size(); first += clusterSize)
+        {
+            const size_t count = std::min<size_t>(clusterSize, instances.size() - first);
+
+            Vector3 center = Vector3::Zero;
+            for (size_t i = first; i < first + count; i++)
+            {
+                center += Vector3(instances[i].Position);
+            }
+            center /= static_cast<float>(count);
+
+            float radius = 0.f;
+            for (size_t i = first; i < first + count; i++)
+            {
+                radius = std::max(radius, Vector3::Distance(center, instances[i].Position));
+            }
+
+            clusters.push_back(Cluster{
+                center,
+                radius + instanceRadius,
+                static_cast<uint32_t>(first),
+                static_cast<uint32_t>(count) });
+        }
+
+        return clusters;
+    }
+
+    // Kept precise so that a shader doing the same with
+    // precise arithmetic picks exactly the same levels.
+#pragma float_control(precise, on, push)
+#pragma fp_contract(off)
+
+    uint32_t InstanceLodSelector::SelectLod(std::span<const ProceduralMesh::Lod> lods,
+        float distance,
+        float worldScale,
+        const View& view)
+    {
+        // error * scale * projectionScale / distance <= maxPixelError,
+        // without the divide so that it holds up right next to the camera.
+        const float allowedError = view.MaxPixelError * distance;
+
+        uint32_t lod = 0;
+        for (uint32_t i = 1; i < lods.size(); i++)
+        {
+            // The errors only grow along the chain
+            if (lods[i].Error * worldScale * view.ProjectionScale > allowedError) break;
+
+            lod = i;
+        }
+
+        return lod;
+    }
+
+    void InstanceLodSelector::Select(std::span<const Cluster> clusters,
+        std::span<const ProceduralMesh::Lod> lods,
+        const DirectX::SimpleMath::Matrix& world,
+        const View& view,
+        const std::array<DirectX::XMFLOAT4, 6>& planes,
+        std::span<const HiZ::Pyramid* const> occluders)
+    {
+        using namespace DirectX::SimpleMath;
+
+        const float worldScale = std::max({
+            Vector3(world._11, world._12, world._13).Length(),
+            Vector3(world._21, world._22, world._23).Length(),
+            Vector3(world._31, world._32, world._33).Length() });
+
+        m_clusterLods.resize(clusters.size());
+        m_ranges.assign(lods.size(), LodRange{ 0, 0 });
+
+        for (size_t i = 0; i < clusters.size(); i++)
+        {
+            const auto& cluster = clusters[i];
+            const auto& position = cluster.Center;
+
+            const float centerX = position.x * world._11
+                + position.y * world._21
+                + position.z * world._31
+                + world._41;
+            const float centerY = position.x * world._12
+                + position.y * world._22
+                + position.z * world._32
+                + world._42;
+            const float centerZ = position.x * world._13
+                + position.y * world._23
+                + position.z * world._33
+                + world._43;
+
+            const float radius = cluster.Radius * worldScale;
+
+            bool visible = true;
+            for (const auto& plane : planes)
+            {
+                const float planeDistance = centerX * plane.x
+                    + centerY * plane.y
+                    + centerZ * plane.z
+                    + plane.w;
+
+                if (planeDistance < -radius)
+                {
+                    visible = false;
+                    break;
+                }
+            }
+
+            for (auto occluder : occluders)
+            {
+                if (!visible) break;
+
+                visible = !HiZ::IsOccluded(*occluder,
+                    DirectX::XMFLOAT3(centerX, centerY, centerZ),
+                    DirectX::XMFLOAT3(radius, radius, radius));
+            }
+
+            if (!visible)
+            {
+                m_clusterLods[i] = Culled;
+                continue;
+            }
+
+            // To the nearest point of the cluster
+            const float dx = centerX - view.CameraPosition.x;
+            const float dy = centerY - view.CameraPosition.y;
+            const float dz = centerZ - view.CameraPosition.z;
+            const float distance = std::max(std::sqrt(dx * dx + dy * dy + dz * dz) - radius, 0.f);
+
+            const uint32_t lod = SelectLod(lods, distance, worldScale, view);
+            m_clusterLods[i] = lod;
+            m_ranges[lod].InstanceCount += cluster.InstanceCount;
+        }
+
+        // A counting sort, one bucket per level
+        uint32_t numVisible = 0;
+        m_cursors.resize(m_ranges.size());
+        for (size_t lod = 0; lod < m_ranges.size(); lod++)
+        {
+            m_ranges[lod].FirstInstance = numVisible;
+            m_cursors[lod] = numVisible;
+            numVisible += m_ranges[lod].InstanceCount;
+        }
+
+        m_instances.resize(numVisible);
+        for (size_t i = 0; i < clusters.size(); i++)
+        {
+            const uint32_t lod = m_clusterLods[i];
+            if (lod == Culled) continue;
+
+            const auto& cluster = clusters[i];
+            uint32_t& cursor = m_cursors[lod];
+            for (uint32_t j = 0; j < cluster.InstanceCount; j++)
+            {
+                m_instances[cursor++] = cluster.FirstInstance + j;
+            }
+        }
+    }
+
+#pragma fp_contract(on)
+#pragma float_control(pop)
+
+    std::span<const uint32_t> InstanceLodSelector::GetInstances() const
+    {
+        return m_instances;
+    }
+
+    std::span<const InstanceLodSelector::LodRange> InstanceLodSelector::GetRanges() const
+    {
+        return m_ranges;
+    }
+
+    std::span<const uint32_t> InstanceLodSelector::GetClusterLods() const
+    {
+        return m_clusterLods;
+    }
+}
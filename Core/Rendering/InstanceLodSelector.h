@@ -0,0 +1,94 @@
+#pragma once
+
+#include "pch.h"
+
+#include "Core/BufferManager.h"
+#include "Core/Rendering/ProceduralMesh.h"
+#include "Core/Rendering/HiZ.h"
+
+#include <directxtk12/SimpleMath.h>
+#include <array>
+#include <span>
+#include <vector>
+
+namespace Gradient::Rendering
+{
+    // Picks a level of detail for the instances of an instanced mesh
+    // by how many pixels its simplification error covers on screen.
+    // Nearby instances are grouped into clusters, which are culled
+    // and given a level together, and the instances are then bucketed
+    // by level so that each level is a single draw.
+    //
+    // Everything is plain arithmetic over flat arrays of clusters and
+    // levels, so a compute shader can mirror it and get the same levels.
+    class InstanceLodSelector
+    {
+    public:
+        static constexpr uint32_t DefaultClusterSize = 32;
+        static constexpr uint32_t Culled = UINT32_MAX;
+
+        struct Cluster
+        {
+            // In the space the instances are in, before the world matrix
+            DirectX::XMFLOAT3 Center;
+            float Radius;
+            uint32_t FirstInstance;
+            uint32_t InstanceCount;
+        };
+
+        struct View
+        {
+            DirectX::SimpleMath::Vector3 CameraPosition;
+            // Pixels covered by a unit at a distance of one unit,
+            // which is half the viewport height times the projection's _22.
+            float ProjectionScale;
+            // Levels are only used when their error covers fewer pixels than this
+            float MaxPixelError;
+        };
+
+        // A run of GetInstances() that's drawn with one level
+        struct LodRange
+        {
+            uint32_t FirstInstance;
+            uint32_t InstanceCount;
+        };
+
+        // Groups runs of clusterSize consecutive instances, which the scene
+        // places near each other. A cluster size of one selects per instance.
+        static std::vector<Cluster> BuildClusters(
+            std::span<const BufferManager::InstanceData> instances,
+            const DirectX::BoundingBox& meshBounds,
+            uint32_t clusterSize = DefaultClusterSize);
+
+        // The coarsest level whose error would cover no more than the allowed
+        // pixels at this distance. The errors are in the mesh's units, so
+        // they're scaled by the largest scale of the world matrix.
+        static uint32_t SelectLod(std::span<const ProceduralMesh::Lod> lods,
+            float distance,
+            float worldScale,
+            const View& view);
+
+        // Culls the clusters against the planes and any occluders, picks
+        // their levels and buckets the visible instances by level. The
+        // buckets stay in cluster order, so the result doesn't depend on timing.
+        void Select(std::span<const Cluster> clusters,
+            std::span<const ProceduralMesh::Lod> lods,
+            const DirectX::SimpleMath::Matrix& world,
+            const View& view,
+            const std::array<DirectX::XMFLOAT4, 6>& planes,
+            std::span<const HiZ::Pyramid* const> occluders = {});
+
+        // Indices of the visible instances, grouped by level
+        std::span<const uint32_t> GetInstances() const;
+        // One per level, including the levels nothing uses
+        std::span<const LodRange> GetRanges() const;
+        // The level picked for each cluster, or Culled
+        std::span<const uint32_t> GetClusterLods() const;
+
+    private:
+        std::vector<uint32_t> m_clusterLods;
+        std::vector<uint32_t> m_instances;
+        std::vector<LodRange> m_ranges;
+        std::vector<uint32_t> m_cursors;
+    };
+}
@@ -1,24 +1,20 @@
 #include "pch.h"
 
 #include "Core/Rendering/LSystem.h"
+#include "Core/Rendering/TurtleProgram.h"
+#include "Core/Math.h"
+#include "Core/Jobs/JobSystem.h"
 
 #include <stack>
-#include <sstream>
+#include <numeric>
+#include <string_view>
+#include <cstring>
+#include <chrono>
 
 using namespace DirectX::SimpleMath;
 
 namespace Gradient::Rendering
 {
-    struct PartParameters
-    {
-        Vector3 BottomTranslation;
-        Quaternion BottomRotation;
-        float BottomRadius;
-        float TopRadius;
-        Vector3 TopRelativeTranslation;
-        Quaternion TopRelativeRotation;
-    };
-
     struct TurtleState
     {
         Vector3 Location = { 0, 0, 0 };
@@ -100,144 +96,32 @@ namespace Gradient::Rendering
         }
     };
 
-    void LSystem::AddRule(char lhs, const std::string& rhs)
-    {
-        m_productionRules[lhs] = rhs;
-    }
-
-    void LSystem::Build(std::string startingRule,
-        int numGenerations,
-        int numVerticalSections)
-    {
-        if (m_isBuilt) return;
-
-        std::string rule = ExpandRule(startingRule,
-            m_productionRules,
-            numGenerations);
-
-        m_trunkPart = InterpretRule(rule, numVerticalSections);
-        m_isBuilt = true;
-    }
-
-    const ProceduralMesh::MeshPart& LSystem::GetTrunk() const
+    // Interprets an expanded rule one symbol at a time, so that it
+    // can be fed straight from LSystem::ForEachExpandedSymbol.
+    // This is the reference for TurtleProgram, which does the same
+    // thing much faster.
+    class TurtleInterpreter
     {
-        assert(m_isBuilt);
-        return m_trunkPart;
-    }
-
-    void LSystem::Combine(const LSystem& subsystem)
-    {
-        std::vector<LSystem::LeafTransform> newLeafTransforms;
-
-        for (const auto& trunkTransform : m_leafTransforms)
+    public:
+        TurtleInterpreter(const LSystem& lsystem,
+            std::vector<LSystem::LeafTransform>& leafTransforms)
+            : m_leafTransforms(leafTransforms)
         {
-            m_trunkPart.AppendInPlace(subsystem.GetTrunk(),
-                trunkTransform.Translation,
-                trunkTransform.Rotation);
+            m_turtle.Radius = lsystem.StartingRadius;
+            m_turtle.RadiusFactor = lsystem.RadiusFactor;
+            m_turtle.AngleDegrees = lsystem.AngleDegrees;
+            m_turtle.MoveDistance = lsystem.MoveDistance;
 
-            for (const auto& subsystemLeaf : subsystem.GetLeafTransforms())
-            {
-                newLeafTransforms.push_back(
-                    {
-                        trunkTransform.Translation
-                            + Vector3::Transform(subsystemLeaf.Translation,
-                                trunkTransform.Rotation),
-                        Quaternion::Concatenate(trunkTransform.Rotation,
-                            subsystemLeaf.Rotation)
-                    });
-            }
+            m_branches.push_back({});
         }
 
-        m_leafTransforms = newLeafTransforms;
-    }
-
-    std::vector<LSystem::LeafTransform> LSystem::GetCombinedLeaves(const LSystem& subsystem) const
-    {
-        std::vector<LSystem::LeafTransform> newLeafTransforms;
-
-        for (const auto& trunkTransform : m_leafTransforms)
+        void Consume(char c)
         {
-            for (const auto& subsystemLeaf : subsystem.GetLeafTransforms())
-            {
-                newLeafTransforms.push_back(
-                    {
-                        trunkTransform.Translation
-                            + Vector3::Transform(subsystemLeaf.Translation,
-                                trunkTransform.Rotation),
-                        Quaternion::Concatenate(trunkTransform.Rotation,
-                            subsystemLeaf.Rotation)
-                    });
-            }
-        }
-
-        return newLeafTransforms;
-    }
-
-    std::string LSystem::ExpandRule(const std::string& startingRule,
-        const std::unordered_map<char, std::string>& productionRules,
-        int numGenerations)
-    {
-        std::string previousRule = startingRule;
-
-        for (int i = 0; i < numGenerations; i++)
-        {
-            std::stringstream stream(previousRule);
-            std::ostringstream nextRule;
-
-            for (int j = 0; j < previousRule.size(); j++)
-            {
-                char c;
-                stream >> c;
-
-                auto entry = productionRules.find(c);
-
-                if (entry != productionRules.end())
-                {
-                    nextRule << entry->second;
-                }
-                else
-                {
-                    nextRule << c;
-                }
-            }
-
-            previousRule = nextRule.str();
-        }
-
-        return previousRule;
-    }
-
-    ProceduralMesh::MeshPart LSystem::InterpretRule(const std::string& rule,
-        int numVerticalSections)
-    {
-
-        std::vector<char> ruleCharacters(rule.begin(), rule.end());
-
-        TurtleState turtle;
-
-        turtle.Radius = StartingRadius;
-        turtle.RadiusFactor = RadiusFactor;
-        turtle.AngleDegrees = AngleDegrees;
-        turtle.MoveDistance = MoveDistance;
-
-        std::vector<std::vector<PartParameters>> branches;
-        branches.push_back({});
-        int branchIndex = 0;
-
-        struct StackState {
-            TurtleState Turtle;
-            int BranchIndex;
-        };
-
-        std::stack<StackState> branchStack;
-
-        for (const auto& c : ruleCharacters)
-        {
-            auto& currentBranch = branches[branchIndex];
+            auto& currentBranch = m_branches[m_branchIndex];
 
             if (c == 'F')
             {
-                //if (turtle.MoveDistance < 0.3f) continue;
+                //if (m_turtle.MoveDistance < 0.3f) return;
 
                 if (currentBranch.size() > 0)
                 {
@@ -248,109 +132,384 @@ namespace Gradient::Rendering
                     currentBranch[lastIndex].BottomRotation.Inverse(inverseRotation);
 
                     currentBranch[lastIndex].TopRelativeRotation =
-                        Quaternion::Concatenate(inverseRotation, turtle.ForwardRotation);
+                        Quaternion::Concatenate(inverseRotation, m_turtle.ForwardRotation);
                 }
 
-                auto bottomTranslation = turtle.Location;
-                auto bottomRotation = turtle.ForwardRotation;
+                auto bottomTranslation = m_turtle.Location;
+                auto bottomRotation = m_turtle.ForwardRotation;
                 Quaternion bottomRotationInverse;
                 bottomRotation.Inverse(bottomRotationInverse);
 
-                turtle.MoveForward();
+                m_turtle.MoveForward();
 
                 currentBranch.push_back(
                     {
                         bottomTranslation,
                         bottomRotation,
-                        turtle.Radius,
-                        turtle.Radius,
-                        Vector3::Transform(turtle.Location - bottomTranslation,
+                        m_turtle.Radius,
+                        m_turtle.Radius,
+                        Vector3::Transform(m_turtle.Location - bottomTranslation,
                             bottomRotationInverse),
                         Quaternion::Concatenate(bottomRotationInverse,
-                            turtle.ForwardRotation)
+                            m_turtle.ForwardRotation)
                     }
                 );
             }
             else if (c == 'L')
             {
-                m_leafTransforms.push_back({turtle.Location, turtle.ForwardRotation});
+                m_leafTransforms.push_back({ m_turtle.Location, m_turtle.ForwardRotation });
             }
             else if (c == '[')
             {
-                branchStack.push({ turtle, branchIndex });
-                branchIndex = branches.size();
-                branches.push_back({});
-                turtle.Radius *= turtle.RadiusFactor;
+                m_branchStack.push({ m_turtle, m_branchIndex });
+                m_branchIndex = m_branches.size();
+                m_branches.push_back({});
+                m_turtle.Radius *= m_turtle.RadiusFactor;
             }
             else if (c == ']')
             {
-                auto state = branchStack.top();
-                turtle = state.Turtle;
-                //turtle.MoveDistance *= 0.8;
-                branchIndex = state.BranchIndex;
-                branchStack.pop();
+                auto state = m_branchStack.top();
+                m_turtle = state.Turtle;
+                //m_turtle.MoveDistance *= 0.8;
+                m_branchIndex = state.BranchIndex;
+                m_branchStack.pop();
             }
             else if (c == '+')
             {
-                turtle.YawLeft();
+                m_turtle.YawLeft();
             }
             else if (c == '-')
             {
-                turtle.YawRight();
+                m_turtle.YawRight();
             }
             else if (c == '/')
             {
-                turtle.RollRight();
+                m_turtle.RollRight();
             }
             else if (c == '\\')
             {
-                turtle.RollLeft();
+                m_turtle.RollLeft();
             }
             else if (c == '^')
             {
-                turtle.PitchUp();
+                m_turtle.PitchUp();
             }
             else if (c == '&')
             {
-                turtle.PitchDown();
+                m_turtle.PitchDown();
+            }
+        }
+
+        // Writes out the segments of every branch in order
+        void Finish(std::vector<PartParameters>& segments)
+        {
+            if (m_branches[0].size() > 0)
+            {
+                // Update the previous part's top
+                auto lastIndex = m_branches[0].size() - 1;
+
+                Quaternion inverseRotation;
+                m_branches[0][lastIndex].BottomRotation.Inverse(inverseRotation);
+
+                m_branches[0][lastIndex].TopRelativeRotation =
+                    Quaternion::Concatenate(inverseRotation, m_turtle.ForwardRotation);
+            }
+
+            for (const auto& branch : m_branches)
+            {
+                segments.insert(segments.end(), branch.begin(), branch.end());
+            }
+        }
+
+    private:
+        struct StackState {
+            TurtleState Turtle;
+            int BranchIndex;
+        };
+
+        TurtleState m_turtle;
+        std::vector<std::vector<PartParameters>> m_branches;
+        int m_branchIndex = 0;
+        std::stack<StackState> m_branchStack;
+        std::vector<LSystem::LeafTransform>& m_leafTransforms;
+    };
+
+    namespace
+    {
+        double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+        {
+            return std::chrono::duration<double, std::milli>(
+                std::chrono::high_resolution_clock::now() - start).count();
+        }
+    }
+
+    void LSystem::AddRule(char lhs, const std::string& rhs)
+    {
+        m_productionRules[static_cast<unsigned char>(lhs)] = rhs;
+    }
+
+    const std::optional<std::string>& LSystem::GetRule(char lhs) const
+    {
+        return m_productionRules[static_cast<unsigned char>(lhs)];
+    }
+
+    std::vector<uint64_t> LSystem::GenerationLengths(const std::string& startingRule,
+        int numGenerations) const
+    {
+        // symbolLengths[c] is the length that c expands to
+        // after the current number of generations.
+        std::array<uint64_t, 256> symbolLengths;
+        symbolLengths.fill(1);
+
+        auto totalLength = [&symbolLengths](const std::string& rule)
+            {
+                uint64_t length = 0;
+                for (char c : rule)
+                {
+                    length += symbolLengths[static_cast<unsigned char>(c)];
+                }
+                return length;
+            };
+
+        std::vector<uint64_t> out;
+        out.reserve(numGenerations + 1);
+        out.push_back(startingRule.size());
+
+        for (int i = 0; i < numGenerations; i++)
+        {
+            std::array<uint64_t, 256> nextLengths;
+
+            for (int c = 0; c < 256; c++)
+            {
+                const auto& rule = m_productionRules[c];
+                nextLengths[c] = rule ? totalLength(*rule) : 1;
             }
+
+            symbolLengths = nextLengths;
+            out.push_back(totalLength(startingRule));
+        }
+
+        return out;
+    }
+
+    uint64_t LSystem::ExpandedLength(const std::string& startingRule,
+        int numGenerations) const
+    {
+        return GenerationLengths(startingRule, numGenerations).back();
+    }
+
+    std::string LSystem::Expand(const std::string& startingRule,
+        int numGenerations) const
+    {
+        // Terminals expand to themselves, so point their
+        // productions into this table.
+        static const auto s_identity = []()
+            {
+                std::array<char, 256> out;
+                for (int c = 0; c < 256; c++)
+                {
+                    out[c] = static_cast<char>(c);
+                }
+                return out;
+            }();
+
+        std::array<std::string_view, 256> productions;
+        for (int c = 0; c < 256; c++)
+        {
+            const auto& rule = m_productionRules[c];
+            productions[c] = rule ? std::string_view(*rule)
+                : std::string_view(&s_identity[c], 1);
         }
 
-        if (branches[0].size() > 0)
+        // Size both buffers for the longest generation up front,
+        // so that resizing them later never reallocates.
+        auto lengths = GenerationLengths(startingRule, numGenerations);
+        auto maxLength = *std::max_element(lengths.begin(), lengths.end());
+
+        std::string current;
+        std::string next;
+        current.reserve(maxLength);
+        next.reserve(maxLength);
+        current = startingRule;
+
+        // Small strings aren't worth splitting across threads.
+        constexpr size_t minChunkSize = 16 * 1024;
+        auto jobSystem = Jobs::JobSystem::Get();
+        const size_t maxChunks = jobSystem->GetMaxConcurrency() * 4;
+
+        std::vector<uint64_t> chunkOffsets(maxChunks + 1);
+
+        for (int i = 0; i < numGenerations; i++)
         {
-            // Update the previous part's top
-            auto lastIndex = branches[0].size() - 1;
+            const size_t numChunks = std::clamp<size_t>(
+                Math::DivRoundUp(current.size(), minChunkSize), 1, maxChunks);
+            const size_t chunkSize = Math::DivRoundUp(current.size(), numChunks);
+
+            // First pass: measure the output of each chunk
+            jobSystem->ParallelFor(numChunks, 1,
+                [&](size_t firstChunk, size_t lastChunk)
+                {
+                    for (size_t chunk = firstChunk; chunk < lastChunk; chunk++)
+                    {
+                        auto begin = std::min(chunk * chunkSize, current.size());
+                        auto end = std::min(begin + chunkSize, current.size());
+
+                        uint64_t length = 0;
+                        for (size_t j = begin; j < end; j++)
+                        {
+                            length += productions[static_cast<unsigned char>(current[j])].size();
+                        }
+                        chunkOffsets[chunk + 1] = length;
+                    }
+                });
+
+            chunkOffsets[0] = 0;
+            std::inclusive_scan(chunkOffsets.begin(),
+                chunkOffsets.begin() + numChunks + 1,
+                chunkOffsets.begin());
+
+            assert(chunkOffsets[numChunks] == lengths[i + 1]);
+            next.resize(chunkOffsets[numChunks]);
 
-            Quaternion inverseRotation;
-            branches[0][lastIndex].BottomRotation.Inverse(inverseRotation);
+            // Second pass: each chunk writes its productions at its own offset
+            jobSystem->ParallelFor(numChunks, 1,
+                [&](size_t firstChunk, size_t lastChunk)
+                {
+                    for (size_t chunk = firstChunk; chunk < lastChunk; chunk++)
+                    {
+                        auto begin = std::min(chunk * chunkSize, current.size());
+                        auto end = std::min(begin + chunkSize, current.size());
+
+                        char* out = next.data() + chunkOffsets[chunk];
+                        for (size_t j = begin; j < end; j++)
+                        {
+                            const auto& production = productions[static_cast<unsigned char>(current[j])];
+                            std::memcpy(out, production.data(), production.size());
+                            out += production.size();
+                        }
+                    }
+                });
 
-            branches[0][lastIndex].TopRelativeRotation =
-                Quaternion::Concatenate(inverseRotation, turtle.ForwardRotation);
+            std::swap(current, next);
         }
 
-        ProceduralMesh::MeshPart tree;
+        return current;
+    }
 
-        for (const auto& branch : branches)
+    void LSystem::Build(std::string startingRule,
+        int numGenerations,
+        int numVerticalSections)
+    {
+        if (m_isBuilt) return;
+
+        m_buildStatistics = {};
+        std::vector<PartParameters> segments;
+
+        auto start = std::chrono::high_resolution_clock::now();
+
+        // The expanded rule is streamed into the interpreter
+        // or compiler instead of being materialized.
+        if (UseReferenceInterpreter)
         {
-            for (const auto& params : branch)
+            TurtleInterpreter interpreter(*this, m_leafTransforms);
+
+            ForEachExpandedSymbol(startingRule, numGenerations,
+                [&interpreter](char c)
+                {
+                    interpreter.Consume(c);
+                });
+
+            interpreter.Finish(segments);
+            m_buildStatistics.InterpretMilliseconds = MillisecondsSince(start);
+        }
+        else
+        {
+            auto program = TurtleProgram::Compile(*this, startingRule, numGenerations);
+            m_buildStatistics.CompileMilliseconds = MillisecondsSince(start);
+            m_buildStatistics.NumBlocks = program.GetBlockCount();
+            m_buildStatistics.NumInstructions = program.GetInstructionCount();
+            m_buildStatistics.NumExecutedInstructions = program.GetExecutedInstructionCount();
+            m_buildStatistics.ProgramSizeInBytes = program.GetSizeInBytes();
+
+            start = std::chrono::high_resolution_clock::now();
+            program.Execute(*this, segments, m_leafTransforms);
+            m_buildStatistics.InterpretMilliseconds = MillisecondsSince(start);
+        }
+
+        start = std::chrono::high_resolution_clock::now();
+        m_trunkPart = ProceduralMesh::CreateAngledFrustumParts(segments, numVerticalSections);
+        m_buildStatistics.GeometryMilliseconds = MillisecondsSince(start);
+
+        m_buildStatistics.NumSegments = segments.size();
+        m_isBuilt = true;
+    }
+
+    const LSystem::BuildStatistics& LSystem::GetBuildStatistics() const
+    {
+        return m_buildStatistics;
+    }
+
+    const ProceduralMesh::MeshPart& LSystem::GetTrunk() const
+    {
+        assert(m_isBuilt);
+        return m_trunkPart;
+    }
+
+    void LSystem::Combine(const LSystem& subsystem)
+    {
+        std::vector<LSystem::LeafTransform> newLeafTransforms;
+        newLeafTransforms.reserve(m_leafTransforms.size() * subsystem.GetLeafTransforms().size());
+
+        m_trunkPart.Reserve(m_leafTransforms.size() * subsystem.GetTrunk().Vertices.size(),
+            m_leafTransforms.size() * subsystem.GetTrunk().Indices.size());
+
+        for (const auto& trunkTransform : m_leafTransforms)
+        {
+            m_trunkPart.AppendInPlace(subsystem.GetTrunk(),
+                trunkTransform.Translation,
+                trunkTransform.Rotation);
+
+            for (const auto& subsystemLeaf : subsystem.GetLeafTransforms())
             {
-                auto part = ProceduralMesh::CreateAngledFrustumPart(
-                    params.BottomRadius,
-                    params.TopRadius,
-                    params.TopRelativeTranslation,
-                    params.TopRelativeRotation,
-                    numVerticalSections
-                );
+                newLeafTransforms.push_back(
+                    {
+                        trunkTransform.Translation
+                            + Vector3::Transform(subsystemLeaf.Translation,
+                                trunkTransform.Rotation),
+                        Quaternion::Concatenate(trunkTransform.Rotation,
+                            subsystemLeaf.Rotation)
+                    });
+            }
+        }
+
+        m_leafTransforms = std::move(newLeafTransforms);
+    }
 
-                tree.AppendInPlace(part, params.BottomTranslation, params.BottomRotation);
+    std::vector<LSystem::LeafTransform> LSystem::GetCombinedLeaves(const LSystem& subsystem) const
+    {
+        std::vector<LSystem::LeafTransform> newLeafTransforms;
+        newLeafTransforms.reserve(m_leafTransforms.size() * subsystem.GetLeafTransforms().size());
+
+        for (const auto& trunkTransform : m_leafTransforms)
+        {
+            for (const auto& subsystemLeaf : subsystem.GetLeafTransforms())
+            {
+                newLeafTransforms.push_back(
+                    {
+                        trunkTransform.Translation
+                            + Vector3::Transform(subsystemLeaf.Translation,
+                                trunkTransform.Rotation),
+                        Quaternion::Concatenate(trunkTransform.Rotation,
+                            subsystemLeaf.Rotation)
+                    });
             }
         }
 
-        return tree;
+        return newLeafTransforms;
     }
 
     const std::vector<LSystem::LeafTransform>& LSystem::GetLeafTransforms() const
     {
         return m_leafTransforms;
     }
-}
\ No newline at end of file
+}
@@ -3,7 +3,10 @@
 #include "pch.h"
 
 #include "Core/Rendering/ProceduralMesh.h"
-                        
+
+#include <array>
+#include <optional>
+
 namespace Gradient::Rendering
 {
     class LSystem
@@ -15,7 +18,39 @@ namespace Gradient::Rendering
             DirectX::SimpleMath::Quaternion Rotation;
         };
 
+        // Timings and sizes from the last call to Build
+        struct BuildStatistics
+        {
+            double CompileMilliseconds = 0;
+            double InterpretMilliseconds = 0;
+            double GeometryMilliseconds = 0;
+            size_t NumBlocks = 0;
+            size_t NumInstructions = 0;
+            uint64_t NumExecutedInstructions = 0;
+            size_t ProgramSizeInBytes = 0;
+            size_t NumSegments = 0;
+        };
+
         void AddRule(char lhs, const std::string& rhs);
+        const std::optional<std::string>& GetRule(char lhs) const;
+
+        // Expands the starting rule into a single string. Each generation
+        // is written in parallel chunks into a buffer that is sized up front,
+        // so no allocations happen between generations.
+        std::string Expand(const std::string& startingRule,
+            int numGenerations) const;
+
+        // The length of the string that Expand would produce,
+        // computed without expanding anything.
+        uint64_t ExpandedLength(const std::string& startingRule,
+            int numGenerations) const;
+
+        // Calls fn with each symbol of the expanded string in order,
+        // without ever materializing the string.
+        template <typename Fn>
+        void ForEachExpandedSymbol(const std::string& startingRule,
+            int numGenerations,
+            Fn&& fn) const;
 
         void Build(std::string startingRule,
             int numGenerations,
@@ -27,23 +62,61 @@ namespace Gradient::Rendering
         std::vector<LeafTransform> GetCombinedLeaves(const LSystem& subsystem) const;
 
         const std::vector<LeafTransform>& GetLeafTransforms() const;
+        const BuildStatistics& GetBuildStatistics() const;
 
         float StartingRadius = 0.3f;
         float RadiusFactor = 0.7f;
         float AngleDegrees = 25.7f;
         float MoveDistance = 1.f;
 
+        // Interpret the rule symbol by symbol instead of compiling it
+        // to a TurtleProgram first. Only useful for comparing the two.
+        bool UseReferenceInterpreter = false;
+
     private:
         bool m_isBuilt = false;
 
-        ProceduralMesh::MeshPart InterpretRule(const std::string& rule, int numVerticalSections);
-        std::string ExpandRule(const std::string& startingRule,
-            const std::unordered_map<char, std::string>& productionRules,
-            int numGenerations);
+        // The total length of the rule after each generation,
+        // from the starting rule up to numGenerations.
+        std::vector<uint64_t> GenerationLengths(const std::string& startingRule,
+            int numGenerations) const;
 
-        std::unordered_map<char, std::string> m_productionRules;
+        template <typename Fn>
+        void ExpandSymbol(char symbol, int remainingGenerations, Fn& fn) const;
+
+        // Indexed by symbol. An empty optional means the symbol is a terminal.
+        std::array<std::optional<std::string>, 256> m_productionRules;
 
         ProceduralMesh::MeshPart m_trunkPart;
         std::vector<LeafTransform> m_leafTransforms;
+        BuildStatistics m_buildStatistics;
     };
-}
\ No newline at end of file
+
+    template <typename Fn>
+    void LSystem::ForEachExpandedSymbol(const std::string& startingRule,
+        int numGenerations,
+        Fn&& fn) const
+    {
+        for (char c : startingRule)
+        {
+            ExpandSymbol(c, numGenerations, fn);
+        }
+    }
+
+    template <typename Fn>
+    void LSystem::ExpandSymbol(char symbol, int remainingGenerations, Fn& fn) const
+    {
+        const auto& rule = m_productionRules[static_cast<unsigned char>(symbol)];
+
+        if (remainingGenerations == 0 || !rule)
+        {
+            fn(symbol);
+            return;
+        }
+
+        for (char c : *rule)
+        {
+            ExpandSymbol(c, remainingGenerations - 1, fn);
+        }
+    }
+}
@@ -0,0 +1,206 @@
+#pragma once
+
+#include "pch.h"
+
+#include "Core/Rendering/LSystem.h"
+
+namespace Gradient::Rendering
+{
+    // The rules and parameters for an L-system, along with
+    // the arguments it gets built with.
+    struct LSystemDefinition
+    {
+        std::vector<std::pair<char, std::string>> Rules;
+        std::string StartingRule;
+        int NumGenerations;
+        int NumVerticalSections = 6;
+        float StartingRadius = 0.3f;
+        float RadiusFactor = 0.7f;
+        float AngleDegrees = 25.7f;
+        float MoveDistance = 1.f;
+
+        // Adds the rules and parameters without building.
+        void Configure(LSystem& lsystem) const
+        {
+            for (const auto& [lhs, rhs] : Rules)
+            {
+                lsystem.AddRule(lhs, rhs);
+            }
+
+            lsystem.StartingRadius = StartingRadius;
+            lsystem.RadiusFactor = RadiusFactor;
+            lsystem.AngleDegrees = AngleDegrees;
+            lsystem.MoveDistance = MoveDistance;
+        }
+
+        LSystem Create() const
+        {
+            LSystem lsystem;
+            Configure(lsystem);
+            lsystem.Build(StartingRule, NumGenerations, NumVerticalSections);
+            return lsystem;
+        }
+    };
+
+    // The rule sets used by the scene. Each tree is a trunk with
+    // branches instanced onto its leaves.
+    namespace LSystemDefinitions
+    {
+        inline const LSystemDefinition TreeTrunk1 = {
+            .Rules = {
+                { 'T', "FFF[/+FX[--G]][////+FX[++G]]/////////+FX[-G]" },
+                { 'X', "F[/+FX[--G]][////+FX[++G]]/////////+FX[-G]" },
+                { 'G', "[//--L][//---L][\\^++L][\\\\&&++L]" },
+                { 'L', "L///+^L" }
+            },
+            .StartingRule = "T",
+            .NumGenerations = 3,
+            .StartingRadius = 0.3f,
+            .RadiusFactor = 0.5f,
+            .AngleDegrees = 25.7f,
+            .MoveDistance = 1.f
+        };
+
+        inline const LSystemDefinition TreeBranch1 = {
+            .Rules = {
+                { 'X', "FF/-F+F[--B]//F[^^B]//-FB" },
+                { 'B', "F[//^^B]F[\\\\&L]G[+B]-BG" },
+                { 'G', "F[//--L][//---L][\\^++L][\\\\&&++L][\\\\&&+++L]" },
+                //{ 'L', "L///+^L" }
+            },
+            .StartingRule = "X",
+            .NumGenerations = 5,
+            .NumVerticalSections = 3,
+            .StartingRadius = 0.02f,
+            .RadiusFactor = 1.f,
+            .AngleDegrees = 20.f,
+            .MoveDistance = 0.2f
+        };
+
+        inline const LSystemDefinition TreeTrunk2 = {
+            .Rules = {
+                { 'T', "F^F&F[/+FX[-G]][///+F^X[++G]]//////w/+F&X[-G][//^-L]" },
+                { 'X', "F[^/+FX[-G][//^-L]][///+&FX[++G][//^-L]]///////+F^X[-G][//^-L]" },
+                { 'G', "[//-L][/+L]" },
+                //{ 'L', "L///+^L" }
+            },
+            .StartingRule = "T",
+            .NumGenerations = 3,
+            .StartingRadius = 0.2f,
+            .RadiusFactor = 0.5f,
+            .AngleDegrees = 30.f,
+            .MoveDistance = 1.5f
+        };
+
+        inline const LSystemDefinition TreeBranch2 = {
+            .Rules = {
+                { 'X', "F^F/-F+F[--B]//F[^^B]//-FB" },
+                { 'B', "F^[//^^B]F&[\\\\&L]G[+B]-BG" },
+                { 'G', "F[//--L][//---L][\\^++L]" }
+            },
+            .StartingRule = "X",
+            .NumGenerations = 5,
+            .NumVerticalSections = 3,
+            .StartingRadius = 0.04f,
+            .RadiusFactor = 0.95f,
+            .AngleDegrees = 30.f,
+            .MoveDistance = 0.2f
+        };
+
+        inline const LSystemDefinition TreeTrunk3 = {
+            .Rules = {
+                { 'T', "FFF&F[/+FX[-G]][///+FX[--B]]///////+F^X[-B][//^-L]" },
+                { 'X', "F[^//+BX][///-BX]////--BX[//^-L]" },
+                { 'B', "FG" },
+                { 'G', "[//&&&-L][/^^^+L]" }
+            },
+            .StartingRule = "T",
+            .NumGenerations = 4,
+            .StartingRadius = 0.25f,
+            .RadiusFactor = 0.7f,
+            .AngleDegrees = 20.f,
+            .MoveDistance = 0.8f
+        };
+
+        inline const LSystemDefinition TreeBranch3 = {
+            .Rules = {
+                { 'X', "F^^F//-F+F[--B]///F[^^B]//-FB" },
+                { 'B', "F^[//^^B]F&G[+B]-BG" },
+                { 'G', "F[///--L][//---L][\\\\&&+++L]" }
+            },
+            .StartingRule = "X",
+            .NumGenerations = 5,
+            .NumVerticalSections = 3,
+            .StartingRadius = 0.03f,
+            .RadiusFactor = 0.95f,
+            .AngleDegrees = 40.f,
+            .MoveDistance = 0.2f
+        };
+
+        inline const LSystemDefinition Bush1 = {
+            .Rules = {
+                { 'T', "FFFX" },
+                { 'X', "F[/+FB[--L]][////+FB[++L]]/////////+FB[-L]" },
+                { 'B', "FF[/+FB[-L-L]][////+F[+L+L]B[+L+L]]/////////+F[+L+L]B" },
+                //{ 'L', "+^L/&--L/&&+L" },
+                //{ 'L', "+^L/&--L" }
+            },
+            .StartingRule = "T",
+            .NumGenerations = 6,
+            .NumVerticalSections = 3,
+            .StartingRadius = 0.01f,
+            .RadiusFactor = 1.f,
+            .AngleDegrees = 25.7f,
+            .MoveDistance = 0.05f
+        };
+
+        inline const LSystemDefinition Bush2 = {
+            .Rules = {
+                { 'T', "FF\\FX" },
+                { 'X', "F[/+FB[--L]][//&//+FB[++L]]//&/+FB[-L]" },
+                { 'B', "FF[/+FB[-L-L]][//&//+F[+L+L]B[+L+L]]/^//^/+F[+L+L]B" }
+            },
+            .StartingRule = "T",
+            .NumGenerations = 5,
+            .NumVerticalSections = 3,
+            .StartingRadius = 0.01f,
+            .RadiusFactor = 1.f,
+            .AngleDegrees = 20.f,
+            .MoveDistance = 0.07f
+        };
+
+        inline const LSystemDefinition Bush3 = {
+            .Rules = {
+                { 'T', "FX" },
+                { 'X', "F[/+FB[--L]][////+FB[++L]]/////////+FB[-L]" },
+                { 'B', "FF[/+FB[-L]][////+F[+L+L]B[+L]]/////////+F[+L]B" }
+            },
+            .StartingRule = "T",
+            .NumGenerations = 8,
+            .NumVerticalSections = 3,
+            .StartingRadius = 0.015f,
+            .RadiusFactor = 1.f,
+            .AngleDegrees = 30.f,
+            .MoveDistance = 0.05f
+        };
+
+        struct NamedDefinition
+        {
+            const char* Name;
+            const LSystemDefinition& Definition;
+        };
+
+        // Every rule set above, for the tests and benchmarks
+        inline const std::vector<NamedDefinition> All = {
+            { "TreeTrunk1", TreeTrunk1 },
+            { "TreeBranch1", TreeBranch1 },
+            { "TreeTrunk2", TreeTrunk2 },
+            { "TreeBranch2", TreeBranch2 },
+            { "TreeTrunk3", TreeTrunk3 },
+            { "TreeBranch3", TreeBranch3 },
+            { "Bush1", Bush1 },
+            { "Bush2", Bush2 },
+            { "Bush3", Bush3 },
+        };
+    }
+}
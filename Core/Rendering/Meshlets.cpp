@@ -0,0 +1,247 @@
+#include "Core/Rendering/Meshlets.h"
+
+#include <meshoptimizer.h>
+#include <algorithm>
+#include <cmath>
+
+namespace Gradient::Rendering::Meshlets
+{
+    namespace
+    {
+        uint32_t PackCone(const meshopt_Bounds& bounds)
+        {
+            return static_cast<uint8_t>(bounds.cone_axis_s8[0])
+                | static_cast<uint8_t>(bounds.cone_axis_s8[1]) << 8
+                | static_cast<uint8_t>(bounds.cone_axis_s8[2]) << 16
+                | static_cast<uint32_t>(static_cast<uint8_t>(bounds.cone_cutoff_s8)) << 24;
+        }
+
+        float UnpackSnorm8(uint32_t packed, uint32_t shift)
+        {
+            return static_cast<float>(static_cast<int8_t>((packed >> shift) & 0xff)) / 127.f;
+        }
+
+        float AxisLength(const DirectX::XMFLOAT4X4& world, int row)
+        {
+            return std::sqrt(world.m[row][0] * world.m[row][0]
+                + world.m[row][1] * world.m[row][1]
+                + world.m[row][2] * world.m[row][2]);
+        }
+    }
+
+    MeshletData Build(const float* positions,
+        size_t vertexCount,
+        size_t vertexStride,
+        std::span<const uint32_t> indices)
+    {
+        MeshletData out;
+
+        if (indices.empty()) return out;
+
+        const size_t maxMeshlets = meshopt_buildMeshletsBound(indices.size(),
+            MaxVertices,
+            MaxTriangles);
+
+        std::vector<meshopt_Meshlet> meshlets(maxMeshlets);
+        std::vector<unsigned int> meshletVertices(maxMeshlets * MaxVertices);
+        std::vector<unsigned char> meshletTriangles(maxMeshlets * MaxTriangles * 3);
+
+        // Weighs keeping triangles that face the same way together,
+        // so that more meshlets can be rejected by their cones.
+        constexpr float coneWeight = 0.25f;
+
+        const size_t numMeshlets = meshopt_buildMeshlets(meshlets.data(),
+            meshletVertices.data(),
+            meshletTriangles.data(),
+            indices.data(),
+            indices.size(),
+            positions,
+            vertexCount,
+            vertexStride,
+            MaxVertices,
+            MaxTriangles,
+            coneWeight);
+
+        meshlets.resize(numMeshlets);
+
+        out.Meshlets.reserve(numMeshlets);
+        out.Triangles.reserve(indices.size() / 3);
+
+        for (const auto& meshlet : meshlets)
+        {
+            meshopt_optimizeMeshlet(&meshletVertices[meshlet.vertex_offset],
+                &meshletTriangles[meshlet.triangle_offset],
+                meshlet.triangle_count,
+                meshlet.vertex_count);
+
+            auto bounds = meshopt_computeMeshletBounds(&meshletVertices[meshlet.vertex_offset],
+                &meshletTriangles[meshlet.triangle_offset],
+                meshlet.triangle_count,
+                positions,
+                vertexCount,
+                vertexStride);
+
+            out.Meshlets.push_back(Meshlet{
+                DirectX::XMFLOAT3(bounds.center),
+                bounds.radius,
+                PackCone(bounds),
+                static_cast<uint32_t>(out.Vertices.size()),
+                static_cast<uint32_t>(out.Triangles.size()),
+                meshlet.vertex_count | meshlet.triangle_count << 8 });
+
+            out.Vertices.insert(out.Vertices.end(),
+                meshletVertices.begin() + meshlet.vertex_offset,
+                meshletVertices.begin() + meshlet.vertex_offset + meshlet.vertex_count);
+
+            for (uint32_t i = 0; i < meshlet.triangle_count; i++)
+            {
+                const auto triangle = &meshletTriangles[meshlet.triangle_offset + i * 3];
+                out.Triangles.push_back(triangle[0]
+                    | triangle[1] << 8
+                    | triangle[2] << 16);
+            }
+        }
+
+        return out;
+    }
+
+    uint32_t GetVertexCount(const Meshlet& meshlet)
+    {
+        return meshlet.Counts & 0xff;
+    }
+
+    uint32_t GetTriangleCount(const Meshlet& meshlet)
+    {
+        return (meshlet.Counts >> 8) & 0xff;
+    }
+
+    float GetMaxScale(const DirectX::XMFLOAT4X4& world)
+    {
+        return std::max({ AxisLength(world, 0), AxisLength(world, 1), AxisLength(world, 2) });
+    }
+
+    bool IsUniformScale(const DirectX::XMFLOAT4X4& world)
+    {
+        const float x = AxisLength(world, 0);
+        const float y = AxisLength(world, 1);
+        const float z = AxisLength(world, 2);
+
+        const float tolerance = 1e-3f * std::max({ x, y, z });
+        return std::abs(x - y) <= tolerance && std::abs(x - z) <= tolerance;
+    }
+
+    // /fp:fast would be free to reorder or fuse these,
+    // which the shader's precise arithmetic doesn't do.
+#pragma float_control(precise, on, push)
+#pragma fp_contract(off)
+
+    CullResult Cull(const Meshlet& meshlet,
+        const DirectX::XMFLOAT4X4& world,
+        float worldScale,
+        const DirectX::XMFLOAT3& cameraPosition,
+        const std::array<DirectX::XMFLOAT4, 6>& planes,
+        bool coneCulling)
+    {
+        const auto& position = meshlet.Center;
+
+        const float centerX = position.x * world._11
+            + position.y * world._21
+            + position.z * world._31
+            + world._41;
+        const float centerY = position.x * world._12
+            + position.y * world._22
+            + position.z * world._32
+            + world._42;
+        const float centerZ = position.x * world._13
+            + position.y * world._23
+            + position.z * world._33
+            + world._43;
+
+        const float radius = meshlet.Radius * worldScale;
+
+        for (const auto& plane : planes)
+        {
+            const float planeDistance = centerX * plane.x
+                + centerY * plane.y
+                + centerZ * plane.z
+                + plane.w;
+
+            if (planeDistance < -radius)
+            {
+                return CullResult::OutsideFrustum;
+            }
+        }
+
+        if (!coneCulling) return CullResult::Visible;
+
+        // A uniform scale doesn't change the cone's angle, so the
+        // axis only needs rotating and the cutoff stays as it is.
+        const float axisX = UnpackSnorm8(meshlet.Cone, 0);
+        const float axisY = UnpackSnorm8(meshlet.Cone, 8);
+        const float axisZ = UnpackSnorm8(meshlet.Cone, 16);
+        const float cutoff = UnpackSnorm8(meshlet.Cone, 24);
+
+        const float worldAxisX = (axisX * world._11 + axisY * world._21 + axisZ * world._31) / worldScale;
+        const float worldAxisY = (axisX * world._12 + axisY * world._22 + axisZ * world._32) / worldScale;
+        const float worldAxisZ = (axisX * world._13 + axisY * world._23 + axisZ * world._33) / worldScale;
+
+        const float viewX = centerX - cameraPosition.x;
+        const float viewY = centerY - cameraPosition.y;
+        const float viewZ = centerZ - cameraPosition.z;
+        const float viewDistance = std::sqrt(viewX * viewX + viewY * viewY + viewZ * viewZ);
+
+        // Every triangle faces away from anywhere
+        // within the sphere, as seen from the camera.
+        if (viewX * worldAxisX + viewY * worldAxisY + viewZ * worldAxisZ
+            >= cutoff * viewDistance + radius)
+        {
+            return CullResult::BackFacing;
+        }
+
+        return CullResult::Visible;
+    }
+
+#pragma fp_contract(on)
+#pragma float_control(pop)
+
+    CullStats CullAll(std::span<const Meshlet> meshlets,
+        const DirectX::XMFLOAT4X4& world,
+        const DirectX::XMFLOAT3& cameraPosition,
+        const std::array<DirectX::XMFLOAT4, 6>& planes,
+        bool coneCulling,
+        std::vector<uint32_t>& visibleMeshlets)
+    {
+        visibleMeshlets.clear();
+
+        const float worldScale = GetMaxScale(world);
+        coneCulling = coneCulling && IsUniformScale(world);
+
+        CullStats stats;
+        stats.NumMeshlets = static_cast<uint32_t>(meshlets.size());
+
+        for (uint32_t i = 0; i < meshlets.size(); i++)
+        {
+            const uint32_t numTriangles = GetTriangleCount(meshlets[i]);
+            stats.NumTriangles += numTriangles;
+
+            switch (Cull(meshlets[i], world, worldScale, cameraPosition, planes, coneCulling))
+            {
+            case CullResult::Visible:
+                visibleMeshlets.push_back(i);
+                break;
+
+            case CullResult::OutsideFrustum:
+                stats.NumOutsideFrustum++;
+                stats.NumTrianglesRejected += numTriangles;
+                break;
+
+            case CullResult::BackFacing:
+                stats.NumBackFacing++;
+                stats.NumTrianglesRejected += numTriangles;
+                break;
+            }
+        }
+
+        return stats;
+    }
+}
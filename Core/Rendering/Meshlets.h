@@ -0,0 +1,94 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Nothing here touches D3D12, so the meshlet build and the
+// culling reference can be built and checked on any platform.
+namespace Gradient::Rendering::Meshlets
+{
+    // What Meshlet_MS can output for a meshlet
+    constexpr uint32_t MaxVertices = 64;
+    constexpr uint32_t MaxTriangles = 124;
+    // Meshlets handled by one Meshlet_AS thread group
+    constexpr uint32_t MeshletsPerGroup = 32;
+
+    // As Meshlet_AS and Meshlet_MS read it, in 32 bytes
+    struct Meshlet
+    {
+        // Bounds of the meshlet, in the mesh's space
+        DirectX::XMFLOAT3 Center;
+        float Radius;
+        // The normal cone's axis in the low three bytes and
+        // its cutoff in the top byte, each as an snorm8.
+        uint32_t Cone;
+        // Into MeshletData::Vertices
+        uint32_t VertexOffset;
+        // Into MeshletData::Triangles
+        uint32_t TriangleOffset;
+        // The vertex count in the low byte, the triangle count in the next
+        uint32_t Counts;
+    };
+
+    struct MeshletData
+    {
+        std::vector<Meshlet> Meshlets;
+        // Indices into the mesh's vertex buffer
+        std::vector<uint32_t> Vertices;
+        // One per triangle, with three indices into the meshlet's
+        // vertices packed into the low three bytes.
+        std::vector<uint32_t> Triangles;
+    };
+
+    enum class CullResult
+    {
+        Visible,
+        OutsideFrustum,
+        BackFacing
+    };
+
+    struct CullStats
+    {
+        uint32_t NumMeshlets = 0;
+        uint32_t NumOutsideFrustum = 0;
+        uint32_t NumBackFacing = 0;
+        uint64_t NumTriangles = 0;
+        uint64_t NumTrianglesRejected = 0;
+    };
+
+    // Splits an indexed triangle list into meshlets, keeping
+    // triangles that face the same way together for the cone test.
+    MeshletData Build(const float* positions,
+        size_t vertexCount,
+        size_t vertexStride,
+        std::span<const uint32_t> indices);
+
+    uint32_t GetVertexCount(const Meshlet& meshlet);
+    uint32_t GetTriangleCount(const Meshlet& meshlet);
+
+    // Does what Meshlet_AS does for a meshlet, with the same arithmetic
+    // in the same order. The cone test assumes the world matrix scales
+    // uniformly, and is skipped without coneCulling.
+    CullResult Cull(const Meshlet& meshlet,
+        const DirectX::XMFLOAT4X4& world,
+        float worldScale,
+        const DirectX::XMFLOAT3& cameraPosition,
+        const std::array<DirectX::XMFLOAT4, 6>& planes,
+        bool coneCulling);
+
+    // Culls every meshlet, and writes the indices of the visible ones in order
+    CullStats CullAll(std::span<const Meshlet> meshlets,
+        const DirectX::XMFLOAT4X4& world,
+        const DirectX::XMFLOAT3& cameraPosition,
+        const std::array<DirectX::XMFLOAT4, 6>& planes,
+        bool coneCulling,
+        std::vector<uint32_t>& visibleMeshlets);
+
+    // The largest scale along any of the world matrix's axes
+    float GetMaxScale(const DirectX::XMFLOAT4X4& world);
+    // Whether the cone test holds up under the world matrix
+    bool IsUniformScale(const DirectX::XMFLOAT4X4& world);
+}
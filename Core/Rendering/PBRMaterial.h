@@ -33,6 +33,9 @@ namespace Gradient::Rendering
             float tiling = 1.f,
             bool masked = false);
 
+        // Equal if they use the same textures and values
+        bool operator==(const PBRMaterial&) const = default;
+
         static PBRMaterial Default();
         static PBRMaterial Light(float irradiance,
             DirectX::SimpleMath::Vector3 color);
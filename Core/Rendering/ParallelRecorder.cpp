@@ -0,0 +1,49 @@
+#include "pch.h"
+
+#include "Core/Rendering/ParallelRecorder.h"
+
+namespace Gradient::Rendering
+{
+    ParallelRecorder::ParallelRecorder(size_t minChunkSize, size_t maxChunks)
+        : m_minChunkSize(std::max<size_t>(minChunkSize, 1)),
+        m_maxChunks(maxChunks)
+    {
+    }
+
+    void ParallelRecorder::Partition(size_t count,
+        size_t minChunkSize,
+        size_t maxChunks,
+        std::vector<Chunk>& chunks)
+    {
+        chunks.clear();
+
+        const size_t numChunks = std::clamp<size_t>(count / std::max<size_t>(minChunkSize, 1),
+            1,
+            std::max<size_t>(maxChunks, 1));
+
+        // Spreads the remainder over the chunks, 
+        // rather than leaving it all in the last.
+        for (size_t i = 0; i < numChunks; i++)
+        {
+            chunks.push_back({ i * count / numChunks, (i + 1) * count / numChunks });
+        }
+    }
+
+    size_t ParallelRecorder::GetChunkCount(size_t count) const
+    {
+        return std::clamp<size_t>(count / m_minChunkSize, 1, GetMaxChunks());
+    }
+
+    void ParallelRecorder::SetMaxChunks(size_t maxChunks)
+    {
+        m_maxChunks = maxChunks;
+    }
+
+    size_t ParallelRecorder::GetMaxChunks() const
+    {
+        if (m_maxChunks != 0)
+            return m_maxChunks;
+
+        return Jobs::JobSystem::Get()->GetMaxConcurrency();
+    }
+}
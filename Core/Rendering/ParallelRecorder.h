@@ -0,0 +1,97 @@
+#pragma once
+
+#include "pch.h"
+
+#include "Core/Jobs/JobSystem.h"
+
+#include <span>
+#include <vector>
+
+namespace Gradient::Rendering
+{
+    // Where ParallelRecorder gets the lists it records chunks into, 
+    // and what it hands them back to. Lists are only referred to by
+    // handle, so the recording can be driven without a device.
+    class ICommandListPool
+    {
+    public:
+        using ListHandle = uint32_t;
+
+        virtual ~ICommandListPool() = default;
+
+        // Called from any thread. Returns an open, empty list.
+        virtual ListHandle Acquire() = 0;
+        // Called from the thread that recorded the list.
+        virtual void Close(ListHandle list) = 0;
+        // Called once every list has been closed, 
+        // in the order they have to run in.
+        virtual void Submit(std::span<const ListHandle> lists) = 0;
+    };
+
+    // Splits a pass's draws into contiguous chunks and records each
+    // one into a list of its own on the job system. The lists are
+    // submitted in order, so the draws run in the same order as they
+    // would have if they were recorded on one thread.
+    class ParallelRecorder
+    {
+    public:
+        struct Chunk
+        {
+            size_t Begin;
+            size_t End;
+        };
+
+        // Passes with fewer than two chunks' worth of draws aren't split.
+        // With no maximum, there's a chunk per thread the job system has.
+        explicit ParallelRecorder(size_t minChunkSize, size_t maxChunks = 0);
+
+        // Fills chunks with count draws split as evenly as possible 
+        // into as many chunks of at least minChunkSize as there can 
+        // be, up to maxChunks. There's always at least one chunk.
+        static void Partition(size_t count,
+            size_t minChunkSize,
+            size_t maxChunks,
+            std::vector<Chunk>& chunks);
+
+        size_t GetChunkCount(size_t count) const;
+        void SetMaxChunks(size_t maxChunks);
+
+        // Calls record(list, chunkIndex, begin, end) for each chunk, 
+        // across the job system, and then submits the lists to the 
+        // pool. Returns once they've been submitted.
+        template <typename Fn>
+        void Record(ICommandListPool& pool, size_t count, Fn&& record);
+
+    private:
+        size_t GetMaxChunks() const;
+
+        size_t m_minChunkSize;
+        size_t m_maxChunks;
+
+        std::vector<Chunk> m_chunks;
+        std::vector<ICommandListPool::ListHandle> m_lists;
+    };
+
+    template <typename Fn>
+    void ParallelRecorder::Record(ICommandListPool& pool, size_t count, Fn&& record)
+    {
+        Partition(count, m_minChunkSize, GetMaxChunks(), m_chunks);
+        m_lists.resize(m_chunks.size());
+
+        Jobs::JobSystem::Get()->ParallelFor(m_chunks.size(), 1,
+            [&](size_t beginChunk, size_t endChunk)
+            {
+                for (size_t chunk = beginChunk; chunk < endChunk; chunk++)
+                {
+                    auto list = pool.Acquire();
+                    record(list, chunk, m_chunks[chunk].Begin, m_chunks[chunk].End);
+                    pool.Close(list);
+
+                    m_lists[chunk] = list;
+                }
+            },
+            Jobs::JobPriority::High);
+
+        pool.Submit(m_lists);
+    }
+}
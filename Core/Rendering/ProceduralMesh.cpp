@@ -4,6 +4,9 @@
 #include <directxtk12/ResourceUploadBatch.h>
 #include <map>
 #include <meshoptimizer.h>
+#include "Core/Math.h"
+#include "Core/Jobs/JobSystem.h"
+#include "Core/Rendering/Meshlets.h"
 
 using namespace DirectX::SimpleMath;
 
@@ -792,178 +795,173 @@ namespace Gradient::Rendering
         ReverseWinding(indices, vertices);
     }
 
-    void ComputeAngledFrustum(
-        ProceduralMesh::VertexCollection& vertices,
-        ProceduralMesh::IndexCollection& indices,
-        float bottomRadius,
-        float topRadius,
-        Vector3 topCentre,
-        const DirectX::SimpleMath::Quaternion& topRotation,
-        int numVerticalSections)
+    // Rotates then translates vertex positions in place. Normals are left as they are.
+    void TransformPositions(ProceduralMesh::VertexType* vertices,
+        size_t numVertices,
+        const Vector3& translation,
+        const Quaternion& rotation)
     {
-        int numSlices = 2;
-        int verticesPerSlice = numVerticalSections + 1;
-        int numVertices = verticesPerSlice * numSlices;
-        int numIndices = 6 * numVerticalSections;
-
-        float dTheta = DirectX::XM_2PI / numVerticalSections;
+        using namespace DirectX;
 
-        // Bottom ring
-        // The first and last vertex are duplicated because 
-        // they have different texcoords.
-        {
-            Vector3 r = Vector3::UnitX;
-            r *= bottomRadius;
+        XMMATRIX transform = XMMatrixMultiply(
+            XMMatrixRotationQuaternion(rotation),
+            XMMatrixTranslationFromVector(translation));
 
-            for (int j = 0; j <= numVerticalSections; j++)
-            {
-                float theta = dTheta * j;
-                auto rotationMatrix = Matrix::CreateFromAxisAngle(Vector3::UnitY, theta);
-                auto centreOffset = Vector3::Transform(r, rotationMatrix);
+        XMVector3TransformCoordStream(&vertices->position,
+            sizeof(ProceduralMesh::VertexType),
+            &vertices->position,
+            sizeof(ProceduralMesh::VertexType),
+            numVertices,
+            transform);
+    }
 
-                ProceduralMesh::VertexType vertex;
-                vertex.position = centreOffset;
-                auto normal = centreOffset;
-                normal.Normalize();
-                vertex.normal = normal;
-                vertex.textureCoordinate.x = static_cast<float>(j) / numVerticalSections;
-                vertex.textureCoordinate.y = 1.f;
+    // The cosine and sine of each angle around the rings of an angled frustum.
+    // The first and last entries are the same angle, as the first and last
+    // vertex of each ring are duplicated with different texcoords.
+    std::vector<DirectX::XMFLOAT2> ComputeUnitRing(int numVerticalSections)
+    {
+        std::vector<DirectX::XMFLOAT2> out(numVerticalSections + 1);
 
-                vertices.push_back(vertex);
-            }
-        }
+        float dTheta = DirectX::XM_2PI / numVerticalSections;
 
-        // Top ring
+        for (int j = 0; j <= numVerticalSections; j++)
         {
-            Vector3 r = { topRadius, 0, 0 };
-
-            for (int j = 0; j <= numVerticalSections; j++)
-            {
-                float theta = dTheta * j;
-                auto rotationMatrix = Matrix::CreateFromAxisAngle(Vector3::UnitY, theta);
-                auto centreOffset = Vector3::Transform(r, rotationMatrix);
-                centreOffset = Vector3::Transform(centreOffset, topRotation);
-
-                ProceduralMesh::VertexType vertex;
-                vertex.position = topCentre + centreOffset;
-                auto normal = centreOffset;
-                normal.Normalize();
-                vertex.normal = normal;
-                vertex.textureCoordinate.x = static_cast<float>(j) / numVerticalSections;
-                vertex.textureCoordinate.y = 0.f;
-
-                vertices.push_back(vertex);
-            }
+            DirectX::XMScalarSinCos(&out[j].y, &out[j].x, dTheta * j);
         }
 
-        //Index generation
-        for (int i = 0; i < numVerticalSections; i++)
-        {
-            indices.push_back(i);
-            indices.push_back(i + numVerticalSections + 1);
-            indices.push_back(i + 1);
+        return out;
+    }
 
-            indices.push_back(i + 1);
-            indices.push_back(i + numVerticalSections + 1);
-            indices.push_back(i + 1 + numVerticalSections + 1);
-        }
+    // Writes an angled frustum with its bottom centre at the origin
+    // into preallocated buffers. Writes AngledFrustumVertexCount vertices
+    // and AngledFrustumIndexCount indices.
+    void WriteAngledFrustum(
+        ProceduralMesh::VertexType* vertices,
+        uint32_t* indices,
+        uint32_t baseVertex,
+        const std::vector<DirectX::XMFLOAT2>& unitRing,
+        float bottomRadius,
+        float topRadius,
+        DirectX::FXMVECTOR topCentre,
+        DirectX::FXMVECTOR topRotation)
+    {
+        using namespace DirectX;
 
-        int lastVertex = vertices.size() - 1;
+        const uint32_t numVerticalSections = static_cast<uint32_t>(unitRing.size()) - 1;
+        const uint32_t verticesPerSlice = numVerticalSections + 1;
 
-        {
-            //Bottom cap
+        auto bottomRing = vertices;
+        auto topRing = bottomRing + verticesPerSlice;
+        auto bottomCentre = topRing + verticesPerSlice;
+        auto bottomCap = bottomCentre + 1;
+        auto topCentreVertex = bottomCap + verticesPerSlice;
+        auto topCap = topCentreVertex + 1;
 
-            //Center vertex.
-            ProceduralMesh::VertexType center;
-            center.position = { 0, 0, 0 };
-            center.normal = { 0, -1, 0 };
-            center.textureCoordinate = { 0.5, 0.5 };
+        const XMFLOAT3 bottomNormal = { 0, -1, 0 };
+        XMFLOAT3 topNormal;
+        XMStoreFloat3(&topNormal, XMVector3Rotate(g_XMIdentityR1, topRotation));
 
-            vertices.push_back(center);
+        const XMVECTOR bottomRadiusV = XMVectorReplicate(bottomRadius);
+        const XMVECTOR topRadiusV = XMVectorReplicate(topRadius);
 
-            int centerIndex = vertices.size() - 1;
+        for (uint32_t j = 0; j < verticesPerSlice; j++)
+        {
+            // A rotation of UnitX about the Y axis
+            XMVECTOR direction = XMVectorSet(unitRing[j].x, 0, -unitRing[j].y, 0);
+            XMVECTOR topDirection = XMVector3Rotate(direction, topRotation);
+
+            // Both caps map the ring onto [0, 1] in their own plane
+            XMFLOAT2 capTexcoord = {
+                (unitRing[j].x + 1) / 2.f,
+                (-unitRing[j].y + 1) / 2.f
+            };
 
-            //Copy the bottom ring of vertices.
-            ProceduralMesh::VertexCollection bottomVertices;
-            for (int i = 0; i < verticesPerSlice; i++)
-            {
-                bottomVertices.push_back(vertices[i]);
-            }
+            float u = static_cast<float>(j) / numVerticalSections;
 
-            for (auto& x : bottomVertices)
-            {
-                x.normal = { 0, -1, 0 };
+            XMStoreFloat3(&bottomRing[j].position, XMVectorMultiply(bottomRadiusV, direction));
+            XMStoreFloat3(&bottomRing[j].normal, direction);
+            bottomRing[j].textureCoordinate = { u, 1.f };
 
-                // x and z belong to [-bottomRadius, bottomRadius].
-                // Map this to [0, 1]
-                float u = ((x.position.x / bottomRadius) + 1) / 2.f;
-                float v = ((x.position.z / bottomRadius) + 1) / 2.f;
-                x.textureCoordinate = { u, v };
-            }
+            XMStoreFloat3(&topRing[j].position, XMVectorMultiplyAdd(topRadiusV, topDirection, topCentre));
+            XMStoreFloat3(&topRing[j].normal, topDirection);
+            topRing[j].textureCoordinate = { u, 0.f };
 
-            vertices.insert(vertices.end(), bottomVertices.begin(), bottomVertices.end());
+            bottomCap[j].position = bottomRing[j].position;
+            bottomCap[j].normal = bottomNormal;
+            bottomCap[j].textureCoordinate = capTexcoord;
 
-            for (int i = centerIndex + 1; i < centerIndex + verticesPerSlice; i++)
-            {
-                indices.push_back(i + 1);
-                indices.push_back(centerIndex);
-                indices.push_back(i);
-            }
+            topCap[j].position = topRing[j].position;
+            topCap[j].normal = topNormal;
+            topCap[j].textureCoordinate = capTexcoord;
         }
 
-        Vector3 topNormal = Vector3::Transform({ 0, 1, 0 }, topRotation);
-
-        {
-            // Top cap
+        bottomCentre->position = { 0, 0, 0 };
+        bottomCentre->normal = bottomNormal;
+        bottomCentre->textureCoordinate = { 0.5, 0.5 };
 
-            //Center vertex
-            ProceduralMesh::VertexType center;
-            center.position = topCentre;
-            center.normal = topNormal;
-            center.textureCoordinate = { 0.5, 0.5 };
+        XMStoreFloat3(&topCentreVertex->position, topCentre);
+        topCentreVertex->normal = topNormal;
+        topCentreVertex->textureCoordinate = { 0.5, 0.5 };
 
-            vertices.push_back(center);
-            auto centerIndex = vertices.size() - 1;
+        // Sides
+        for (uint32_t i = 0; i < numVerticalSections; i++)
+        {
+            uint32_t bottom = baseVertex + i;
+            uint32_t top = bottom + verticesPerSlice;
 
-            //Copy the top ring of vertices.
-            ProceduralMesh::VertexCollection topVertices;
-            int base = lastVertex - verticesPerSlice + 1;
+            *indices++ = bottom;
+            *indices++ = top;
+            *indices++ = bottom + 1;
 
-            for (int i = base; i < base + verticesPerSlice; i++)
-            {
-                topVertices.push_back(vertices[i]);
-            }
+            *indices++ = bottom + 1;
+            *indices++ = top;
+            *indices++ = top + 1;
+        }
 
-            // To construct UVs, we map into a space 
-            // with the top normal as the Y axis.
-            Quaternion unRotate;
-            topRotation.Inverse(unRotate);
-            Matrix toNewBasis
-                = Matrix::CreateTranslation(-topCentre)
-                * Matrix::CreateFromQuaternion(unRotate);
+        // Bottom cap
+        uint32_t bottomCentreIndex = baseVertex + 2 * verticesPerSlice;
+        for (uint32_t i = bottomCentreIndex + 1; i < bottomCentreIndex + verticesPerSlice; i++)
+        {
+            *indices++ = i + 1;
+            *indices++ = bottomCentreIndex;
+            *indices++ = i;
+        }
 
-            for (auto& x : topVertices)
-            {
-                x.normal = topNormal;
+        // Top cap
+        uint32_t topCentreIndex = baseVertex + 3 * verticesPerSlice + 1;
+        for (uint32_t i = topCentreIndex + 1; i < topCentreIndex + verticesPerSlice; i++)
+        {
+            *indices++ = i;
+            *indices++ = topCentreIndex;
+            *indices++ = i + 1;
+        }
+    }
 
-                Vector3 transformedPosition =
-                    Vector3::Transform(x.position,
-                        toNewBasis);
+    void ComputeAngledFrustum(
+        ProceduralMesh::VertexCollection& vertices,
+        ProceduralMesh::IndexCollection& indices,
+        float bottomRadius,
+        float topRadius,
+        Vector3 topCentre,
+        const DirectX::SimpleMath::Quaternion& topRotation,
+        int numVerticalSections)
+    {
+        auto baseVertex = vertices.size();
+        auto baseIndex = indices.size();
 
-                float u = ((transformedPosition.x / topRadius) + 1) / 2.f;
-                float v = ((transformedPosition.z / topRadius) + 1) / 2.f;
-                x.textureCoordinate = { u, v };
-            }
+        CheckIndexOverflow(baseVertex + ProceduralMesh::AngledFrustumVertexCount(numVerticalSections));
 
-            vertices.insert(vertices.end(), topVertices.begin(), topVertices.end());
+        vertices.resize(baseVertex + ProceduralMesh::AngledFrustumVertexCount(numVerticalSections));
+        indices.resize(baseIndex + ProceduralMesh::AngledFrustumIndexCount(numVerticalSections));
 
-            for (int i = centerIndex + 1; i < centerIndex + verticesPerSlice; i++)
-            {
-                indices.push_back(i);
-                indices.push_back(centerIndex);
-                indices.push_back(i + 1);
-            }
-        }
+        WriteAngledFrustum(vertices.data() + baseVertex,
+            indices.data() + baseIndex,
+            static_cast<uint32_t>(baseVertex),
+            ComputeUnitRing(numVerticalSections),
+            bottomRadius,
+            topRadius,
+            topCentre,
+            topRotation);
     }
 
     // A two-sided quad in the XZ plane centred at the origin.
@@ -1070,6 +1068,62 @@ namespace Gradient::Rendering
             0);
     }
 
+    void ProceduralMesh::DrawIndirect(ID3D12GraphicsCommandList* cl,
+        ID3D12CommandSignature* commandSignature,
+        ID3D12Resource* arguments,
+        UINT64 argumentsOffset)
+    {
+        cl->IASetVertexBuffers(0,
+            1,
+            &m_vbv);
+        cl->IASetIndexBuffer(&m_ibv);
+
+        cl->ExecuteIndirect(commandSignature,
+            1,
+            arguments,
+            argumentsOffset,
+            nullptr,
+            0);
+    }
+
+    UINT ProceduralMesh::GetIndexCount() const
+    {
+        return m_indexCount;
+    }
+
+    void ProceduralMesh::DrawLod(ID3D12GraphicsCommandList* cl,
+        uint32_t lodIndex,
+        uint32_t numInstances)
+    {
+        const auto& lod = m_lods[lodIndex];
+
+        cl->IASetVertexBuffers(0,
+            1,
+            &m_vbv);
+        cl->IASetIndexBuffer(&m_ibv);
+
+        cl->DrawIndexedInstanced(lod.IndexCount,
+            numInstances,
+            lod.FirstIndex,
+            0,
+            0);
+    }
+
+    std::span<const ProceduralMesh::Lod> ProceduralMesh::GetLods() const
+    {
+        return m_lods;
+    }
+
+    bool ProceduralMesh::HasMeshlets() const
+    {
+        return m_meshletView.NumMeshlets > 0;
+    }
+
+    const ProceduralMesh::MeshletView& ProceduralMesh::GetMeshletView() const
+    {
+        return m_meshletView;
+    }
+
     std::tuple<ProceduralMesh::VertexCollection, ProceduralMesh::IndexCollection>
         OptimizeMesh(const ProceduralMesh::VertexCollection& vertices,
             const ProceduralMesh::IndexCollection& indices,
@@ -1142,32 +1196,54 @@ namespace Gradient::Rendering
         const VertexCollection& vertices,
         const IndexCollection& indices,
         float simplificationRate, 
-        float errorRate)
+        float errorRate,
+        bool buildMeshlets)
     {
         auto [optimizedVertices, optimizedIndices] = OptimizeMesh(vertices, indices, simplificationRate, errorRate);
 
+        DirectX::ResourceUploadBatch uploadBatch(device);
+
+        uploadBatch.Begin();
+
+        Upload(device, uploadBatch, optimizedVertices, optimizedIndices,
+            ComputeBoundingBox(optimizedVertices), {}, buildMeshlets);
+
+        auto uploadFinished = uploadBatch.End(cq);
+        uploadFinished.wait();
+    }
+
+    void ProceduralMesh::Upload(ID3D12Device* device,
+        DirectX::ResourceUploadBatch& uploadBatch,
+        std::span<const VertexType> vertices,
+        std::span<const uint32_t> indices,
+        const DirectX::BoundingBox& boundingBox,
+        std::span<const Lod> lods,
+        bool buildMeshlets)
+    {
         NarrowIndexCollection narrowIndices;
 
         // Use 16 bit indices if the vertex count allows for it.
-        const bool use16bit = optimizedVertices.size() < UINT16_MAX;
+        const bool use16bit = vertices.size() < UINT16_MAX;
 
         if (use16bit)
         {
-            for (const auto& index : optimizedIndices)
+            narrowIndices.reserve(indices.size());
+            for (const auto& index : indices)
             {
-                narrowIndices.push_back(static_cast<uint32_t>(index));
+                narrowIndices.push_back(static_cast<uint16_t>(index));
             }
         }
 
-
-        DirectX::ResourceUploadBatch uploadBatch(device);
-
-        uploadBatch.Begin();
+        // Meshlets read the vertices as a structured buffer
+        const auto vertexBufferState = buildMeshlets
+            ? D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE
+            : D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER;
 
         DX::ThrowIfFailed(
             DirectX::CreateStaticBuffer(device, uploadBatch,
-                optimizedVertices,
-                D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER,
+                vertices.data(),
+                vertices.size(),
+                vertexBufferState,
                 m_vertexBuffer.ReleaseAndGetAddressOf()));
 
         if (use16bit)
@@ -1184,35 +1260,20 @@ namespace Gradient::Rendering
             DX::ThrowIfFailed(
                 DirectX::CreateStaticBuffer(device,
                     uploadBatch,
-                    optimizedIndices,
+                    indices.data(),
+                    indices.size(),
                     D3D12_RESOURCE_STATE_INDEX_BUFFER,
                     m_indexBuffer.ReleaseAndGetAddressOf()));
         }
 
-        auto uploadFinished = uploadBatch.End(cq);
-
-        // Create the bounding box while waiting for the upload.
-        {
-            std::vector<DirectX::XMFLOAT3> points;
-
-            for (const auto& vertex : optimizedVertices)
-            {
-                points.push_back(vertex.position);
-            }
-
-            DirectX::BoundingBox::CreateFromPoints(m_boundingBox,
-                points.size(),
-                points.data(),
-                sizeof(DirectX::XMFLOAT3)
-            );
-        }
-
-        uploadFinished.wait();
+        // The upload batch copies the data when it's queued, so
+        // everything below can be done before the batch finishes.
+        m_boundingBox = boundingBox;
 
         m_vbv.BufferLocation = m_vertexBuffer->GetGPUVirtualAddress();
         m_vbv.StrideInBytes = sizeof(VertexType);
-        m_vbv.SizeInBytes = m_vbv.StrideInBytes * optimizedVertices.size();
-        m_vertexCount = optimizedVertices.size();
+        m_vbv.SizeInBytes = m_vbv.StrideInBytes * vertices.size();
+        m_vertexCount = vertices.size();
 
         m_ibv.BufferLocation = m_indexBuffer->GetGPUVirtualAddress();
         if (use16bit)
@@ -1224,11 +1285,80 @@ namespace Gradient::Rendering
         else
         {
             m_ibv.Format = DXGI_FORMAT_R32_UINT;
-            m_ibv.SizeInBytes = sizeof(uint32_t) * optimizedIndices.size();
-            m_indexCount = optimizedIndices.size();
+            m_ibv.SizeInBytes = sizeof(uint32_t) * indices.size();
+            m_indexCount = indices.size();
+        }
+
+        if (lods.empty())
+        {
+            m_lods = { Lod{ 0, m_indexCount, 0.f } };
+        }
+        else
+        {
+            // A plain draw only draws the full mesh
+            m_lods.assign(lods.begin(), lods.end());
+            m_indexCount = m_lods[0].IndexCount;
+        }
+
+        if (buildMeshlets)
+        {
+            UploadMeshlets(device, uploadBatch, vertices, indices.first(m_indexCount));
         }
     }
 
+    void ProceduralMesh::UploadMeshlets(ID3D12Device* device,
+        DirectX::ResourceUploadBatch& uploadBatch,
+        std::span<const VertexType> vertices,
+        std::span<const uint32_t> indices)
+    {
+        auto meshlets = Meshlets::Build(&vertices[0].position.x,
+            vertices.size(),
+            sizeof(VertexType),
+            indices);
+
+        if (meshlets.Meshlets.empty()) return;
+
+        DX::ThrowIfFailed(
+            DirectX::CreateStaticBuffer(device,
+                uploadBatch,
+                meshlets.Meshlets,
+                D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+                m_meshletBuffer.ReleaseAndGetAddressOf()));
+
+        DX::ThrowIfFailed(
+            DirectX::CreateStaticBuffer(device,
+                uploadBatch,
+                meshlets.Vertices,
+                D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+                m_meshletVertexBuffer.ReleaseAndGetAddressOf()));
+
+        DX::ThrowIfFailed(
+            DirectX::CreateStaticBuffer(device,
+                uploadBatch,
+                meshlets.Triangles,
+                D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+                m_meshletTriangleBuffer.ReleaseAndGetAddressOf()));
+
+        m_meshletView.Vertices = m_vertexBuffer->GetGPUVirtualAddress();
+        m_meshletView.Meshlets = m_meshletBuffer->GetGPUVirtualAddress();
+        m_meshletView.MeshletVertices = m_meshletVertexBuffer->GetGPUVirtualAddress();
+        m_meshletView.MeshletTriangles = m_meshletTriangleBuffer->GetGPUVirtualAddress();
+        m_meshletView.NumMeshlets = static_cast<uint32_t>(meshlets.Meshlets.size());
+    }
+
+    DirectX::BoundingBox ProceduralMesh::ComputeBoundingBox(std::span<const VertexType> vertices)
+    {
+        DirectX::BoundingBox out;
+
+        DirectX::BoundingBox::CreateFromPoints(out,
+            vertices.size(),
+            &vertices[0].position,
+            sizeof(VertexType)
+        );
+
+        return out;
+    }
+
     const DirectX::BoundingBox& ProceduralMesh::GetBoundingBox() const
     {
         return m_boundingBox;
@@ -1341,6 +1471,52 @@ namespace Gradient::Rendering
         return part;
     }
 
+    ProceduralMesh::MeshPart ProceduralMesh::CreateAngledFrustumParts(
+        const std::vector<AngledFrustumParameters>& frusta,
+        int numVerticalSections)
+    {
+        const size_t verticesPerFrustum = AngledFrustumVertexCount(numVerticalSections);
+        const size_t indicesPerFrustum = AngledFrustumIndexCount(numVerticalSections);
+
+        CheckIndexOverflow(frusta.size() * verticesPerFrustum);
+
+        MeshPart out;
+        out.Vertices.resize(frusta.size() * verticesPerFrustum);
+        out.Indices.resize(frusta.size() * indicesPerFrustum);
+
+        const auto unitRing = ComputeUnitRing(numVerticalSections);
+
+        // Every frustum has the same budget, so where each one goes
+        // is known up front and chunks can be written independently.
+        constexpr size_t frustaPerChunk = 256;
+
+        Jobs::JobSystem::Get()->ParallelFor(frusta.size(), frustaPerChunk,
+            [&](size_t begin, size_t end)
+            {
+                for (size_t i = begin; i < end; i++)
+                {
+                    const auto& frustum = frusta[i];
+                    auto vertices = out.Vertices.data() + i * verticesPerFrustum;
+
+                    WriteAngledFrustum(vertices,
+                        out.Indices.data() + i * indicesPerFrustum,
+                        static_cast<uint32_t>(i * verticesPerFrustum),
+                        unitRing,
+                        frustum.BottomRadius,
+                        frustum.TopRadius,
+                        frustum.TopRelativeTranslation,
+                        frustum.TopRelativeRotation);
+
+                    TransformPositions(vertices,
+                        verticesPerFrustum,
+                        frustum.BottomTranslation,
+                        frustum.BottomRotation);
+                }
+            });
+
+        return out;
+    }
+
     ProceduralMesh ProceduralMesh::CreateAngledFrustum(
         ID3D12Device* device,
         ID3D12CommandQueue* cq,
@@ -1367,7 +1543,8 @@ namespace Gradient::Rendering
         const VertexCollection& vertices,
         const IndexCollection& indices,
         float simplificationRate,
-        float errorRate
+        float errorRate,
+        bool buildMeshlets
     )
     {
         // Indices are 32 bit, can't have more vertices 
@@ -1375,7 +1552,7 @@ namespace Gradient::Rendering
         assert(vertices.size() < UINT32_MAX);
 
         ProceduralMesh primitive;
-        primitive.Initialize(device, cq, vertices, indices, simplificationRate, errorRate);
+        primitive.Initialize(device, cq, vertices, indices, simplificationRate, errorRate, buildMeshlets);
 
         return primitive;
     }
@@ -1385,7 +1562,8 @@ namespace Gradient::Rendering
         ID3D12CommandQueue* cq,
         const MeshPart& part,
         float simplificationRate,
-        float errorRate
+        float errorRate,
+        bool buildMeshlets
     )
     {
         return ProceduralMesh::CreateFromVertices(
@@ -1394,59 +1572,181 @@ namespace Gradient::Rendering
             part.Vertices,
             part.Indices,
             simplificationRate,
-            errorRate
+            errorRate,
+            buildMeshlets
         );
     }
 
-    ProceduralMesh::MeshPart ProceduralMesh::MeshPart::Append(
-        const ProceduralMesh::MeshPart& appendage,
-        Vector3 translation,
-        Quaternion rotation
+    ProceduralMesh::MeshPart ProceduralMesh::Optimize(const MeshPart& part,
+        float simplificationRate,
+        float errorRate)
+    {
+        auto [vertices, indices] = OptimizeMesh(part.Vertices,
+            part.Indices,
+            simplificationRate,
+            errorRate);
+
+        return MeshPart{ std::move(vertices), std::move(indices) };
+    }
+
+    ProceduralMesh ProceduralMesh::CreateFromOptimizedPart(
+        ID3D12Device* device,
+        DirectX::ResourceUploadBatch& uploadBatch,
+        const MeshPart& part
     )
     {
-        Matrix transform = Matrix::CreateFromQuaternion(rotation)
-            * Matrix::CreateTranslation(translation);
+        return CreateFromOptimizedPart(device,
+            uploadBatch,
+            part.Vertices,
+            part.Indices,
+            ComputeBoundingBox(part.Vertices));
+    }
 
-        ProceduralMesh::MeshPart out(*this);
+    ProceduralMesh ProceduralMesh::CreateFromOptimizedPart(
+        ID3D12Device* device,
+        DirectX::ResourceUploadBatch& uploadBatch,
+        std::span<const VertexType> vertices,
+        std::span<const uint32_t> indices,
+        const DirectX::BoundingBox& boundingBox,
+        bool buildMeshlets
+    )
+    {
+        assert(vertices.size() < UINT32_MAX);
 
-        auto baseIndex = out.Vertices.size();
+        ProceduralMesh primitive;
+        primitive.Upload(device, uploadBatch, vertices, indices, boundingBox, {}, buildMeshlets);
 
-        for (const auto& vertex : appendage.Vertices)
-        {
-            auto newVertex = vertex;
-            newVertex.position = Vector3::Transform(vertex.position, transform);
-            out.Vertices.push_back(newVertex);
-        }
+        return primitive;
+    }
+
+    ProceduralMesh ProceduralMesh::CreateFromOptimizedPart(
+        ID3D12Device* device,
+        DirectX::ResourceUploadBatch& uploadBatch,
+        std::span<const VertexType> vertices,
+        const LodChain& lodChain,
+        const DirectX::BoundingBox& boundingBox
+    )
+    {
+        assert(vertices.size() < UINT32_MAX);
 
-        for (const auto& index : appendage.Indices)
+        ProceduralMesh primitive;
+        primitive.Upload(device,
+            uploadBatch,
+            vertices,
+            lodChain.Indices,
+            boundingBox,
+            lodChain.Lods);
+
+        return primitive;
+    }
+
+    ProceduralMesh::LodChain ProceduralMesh::BuildLodChain(std::span<const VertexType> vertices,
+        std::span<const uint32_t> indices,
+        uint32_t maxLods,
+        float lodReduction)
+    {
+        LodChain out;
+        out.Indices.assign(indices.begin(), indices.end());
+        out.Lods.push_back(Lod{ 0, static_cast<uint32_t>(indices.size()), 0.f });
+
+        if (vertices.empty() || indices.empty()) return out;
+
+        // meshopt reports errors relative to the size of the mesh
+        const float errorScale = meshopt_simplifyScale(&vertices[0].position.x,
+            vertices.size(),
+            sizeof(VertexType));
+
+        IndexCollection source(indices.begin(), indices.end());
+        IndexCollection simplified(indices.size());
+        float totalError = 0.f;
+
+        while (out.Lods.size() < maxLods)
         {
-            out.Indices.push_back(index + baseIndex);
+            const size_t targetIndexCount
+                = static_cast<size_t>(source.size() * lodReduction) / 3 * 3;
+
+            float error = 0.f;
+            simplified.resize(source.size());
+            size_t newIndexCount = meshopt_simplify(simplified.data(),
+                source.data(),
+                source.size(),
+                &vertices[0].position.x,
+                vertices.size(),
+                sizeof(VertexType),
+                targetIndexCount,
+                1.f,
+                meshopt_SimplifyPrune,
+                &error);
+
+            // Not enough of a saving to be worth its own level
+            if (newIndexCount == 0 || newIndexCount > source.size() * 9 / 10) break;
+
+            simplified.resize(newIndexCount);
+            meshopt_optimizeVertexCache(simplified.data(),
+                simplified.data(),
+                simplified.size(),
+                vertices.size());
+
+            // Each level is simplified from the last one, so the errors add up
+            totalError += error * errorScale;
+
+            out.Lods.push_back(Lod{
+                static_cast<uint32_t>(out.Indices.size()),
+                static_cast<uint32_t>(newIndexCount),
+                totalError });
+            out.Indices.insert(out.Indices.end(), simplified.begin(), simplified.end());
+
+            std::swap(source, simplified);
         }
 
         return out;
     }
 
+    ProceduralMesh::MeshPart ProceduralMesh::MeshPart::Append(
+        const ProceduralMesh::MeshPart& appendage,
+        Vector3 translation,
+        Quaternion rotation
+    )
+    {
+        ProceduralMesh::MeshPart out;
+        out.Vertices.reserve(Vertices.size() + appendage.Vertices.size());
+        out.Indices.reserve(Indices.size() + appendage.Indices.size());
+        out.Vertices = Vertices;
+        out.Indices = Indices;
+
+        out.AppendInPlace(appendage, translation, rotation);
+
+        return out;
+    }
+
     void ProceduralMesh::MeshPart::AppendInPlace(
         const ProceduralMesh::MeshPart& appendage,
         Vector3 translation,
         Quaternion rotation
     )
     {
-        Matrix transform = Matrix::CreateFromQuaternion(rotation)
-            * Matrix::CreateTranslation(translation);
+        auto baseVertex = Vertices.size();
+        auto baseIndex = Indices.size();
 
-        auto baseIndex = Vertices.size();
+        CheckIndexOverflow(baseVertex + appendage.Vertices.size());
 
-        for (const auto& vertex : appendage.Vertices)
-        {
-            auto newVertex = vertex;
-            newVertex.position = Vector3::Transform(vertex.position, transform);
-            Vertices.push_back(newVertex);
-        }
+        Vertices.insert(Vertices.end(), appendage.Vertices.begin(), appendage.Vertices.end());
+        Indices.resize(baseIndex + appendage.Indices.size());
+
+        TransformPositions(Vertices.data() + baseVertex,
+            appendage.Vertices.size(),
+            translation,
+            rotation);
 
-        for (const auto& index : appendage.Indices)
+        for (size_t i = 0; i < appendage.Indices.size(); i++)
         {
-            Indices.push_back(index + baseIndex);
+            Indices[baseIndex + i] = appendage.Indices[i] + static_cast<uint32_t>(baseVertex);
         }
     }
-}
\ No newline at end of file
+
+    void ProceduralMesh::MeshPart::Reserve(size_t numVertices, size_t numIndices)
+    {
+        Vertices.reserve(Vertices.size() + numVertices);
+        Indices.reserve(Indices.size() + numIndices);
+    }
+}
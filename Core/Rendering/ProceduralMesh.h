@@ -2,9 +2,11 @@
 
 #include "pch.h"
 #include <memory>
+#include <span>
 #include "Core/Rendering/IDrawable.h"
 #include <directxtk12/VertexTypes.h>
 #include <directxtk12/SimpleMath.h>
+#include <directxtk12/ResourceUploadBatch.h>
 
 namespace Gradient::Rendering
 {
@@ -16,10 +18,51 @@ namespace Gradient::Rendering
         using IndexCollection = std::vector<uint32_t>;
         using NarrowIndexCollection = std::vector<uint16_t>;
 
+        // A range of the index buffer that draws the mesh in less detail
+        struct Lod
+        {
+            uint32_t FirstIndex;
+            uint32_t IndexCount;
+            // How far the surface moved from the full mesh, in
+            // the mesh's own units. Zero for the full mesh.
+            float Error;
+        };
+
+        // Every level shares the vertices, and the full mesh comes first
+        struct LodChain
+        {
+            IndexCollection Indices;
+            std::vector<Lod> Lods;
+        };
+
+        // What Meshlet_AS and Meshlet_MS read to draw the full mesh
+        struct MeshletView
+        {
+            D3D12_GPU_VIRTUAL_ADDRESS Vertices;
+            D3D12_GPU_VIRTUAL_ADDRESS Meshlets;
+            D3D12_GPU_VIRTUAL_ADDRESS MeshletVertices;
+            D3D12_GPU_VIRTUAL_ADDRESS MeshletTriangles;
+            uint32_t NumMeshlets;
+        };
 
         virtual ~ProceduralMesh() = default;
 
         virtual void Draw(ID3D12GraphicsCommandList* cl, uint32_t numInstances=1) override;
+        // Draws with a D3D12_DRAW_INDEXED_ARGUMENTS that the GPU has 
+        // written, such as one with the count of instances left after culling.
+        void DrawIndirect(ID3D12GraphicsCommandList* cl,
+            ID3D12CommandSignature* commandSignature,
+            ID3D12Resource* arguments,
+            UINT64 argumentsOffset);
+        UINT GetIndexCount() const;
+        void DrawLod(ID3D12GraphicsCommandList* cl,
+            uint32_t lodIndex,
+            uint32_t numInstances = 1);
+        // Always has the full mesh, at least
+        std::span<const Lod> GetLods() const;
+        // Only meshes uploaded with meshlets have them
+        bool HasMeshlets() const;
+        const MeshletView& GetMeshletView() const;
 
         const DirectX::BoundingBox& GetBoundingBox() const;
 
@@ -35,8 +78,34 @@ namespace Gradient::Rendering
             void AppendInPlace(const MeshPart& appendage,
                 DirectX::SimpleMath::Vector3 translation,
                 DirectX::SimpleMath::Quaternion rotation);
+
+            // Reserves room for this many more vertices and indices
+            void Reserve(size_t numVertices, size_t numIndices);
         };
 
+        // An angled frustum, with the bottom centre placed at
+        // BottomTranslation and the top relative to that.
+        struct AngledFrustumParameters
+        {
+            DirectX::SimpleMath::Vector3 BottomTranslation;
+            DirectX::SimpleMath::Quaternion BottomRotation;
+            float BottomRadius;
+            float TopRadius;
+            DirectX::SimpleMath::Vector3 TopRelativeTranslation;
+            DirectX::SimpleMath::Quaternion TopRelativeRotation;
+        };
+
+        static constexpr size_t AngledFrustumVertexCount(int numVerticalSections)
+        {
+            // Two rings for the sides and two for the caps, plus the cap centres
+            return 4 * (numVerticalSections + 1) + 2;
+        }
+
+        static constexpr size_t AngledFrustumIndexCount(int numVerticalSections)
+        {
+            return 12 * numVerticalSections;
+        }
+
         static ProceduralMesh CreateBox(
             ID3D12Device* device,
             ID3D12CommandQueue* cq,
@@ -88,6 +157,13 @@ namespace Gradient::Rendering
             int numVerticalSections
         );
 
+        // Writes many angled frusta straight into a single part, in parallel.
+        // The vertex and index buffers are allocated once, up front.
+        static MeshPart CreateAngledFrustumParts(
+            const std::vector<AngledFrustumParameters>& frusta,
+            int numVerticalSections
+        );
+
         static ProceduralMesh CreateAngledFrustum(
             ID3D12Device* device,
             ID3D12CommandQueue* cq,
@@ -102,7 +178,8 @@ namespace Gradient::Rendering
             const VertexCollection& vertices,
             const IndexCollection& indices,
             float simplificationRate = 0.f,
-            float errorRate = 0.1f
+            float errorRate = 0.1f,
+            bool buildMeshlets = false
         );
 
         static ProceduralMesh CreateFromPart(
@@ -110,9 +187,56 @@ namespace Gradient::Rendering
             ID3D12CommandQueue* cq,
             const MeshPart& part,
             float simplificationRate = 0.f,
-            float errorRate = 0.1f
+            float errorRate = 0.1f,
+            bool buildMeshlets = false
+        );
+
+        // Runs the meshoptimizer passes that CreateFromPart does.
+        // This only touches the CPU, so it's safe to call from any thread.
+        static MeshPart Optimize(const MeshPart& part,
+            float simplificationRate = 0.f,
+            float errorRate = 0.1f);
+
+        // Queues the upload of a part that has already been through
+        // Optimize. The mesh can't be drawn until the batch has finished,
+        // but its bounding box is ready straight away.
+        static ProceduralMesh CreateFromOptimizedPart(
+            ID3D12Device* device,
+            DirectX::ResourceUploadBatch& uploadBatch,
+            const MeshPart& part
+        );
+
+        // As above, for vertices and indices that live somewhere
+        // else, such as a mapped scene cache.
+        static ProceduralMesh CreateFromOptimizedPart(
+            ID3D12Device* device,
+            DirectX::ResourceUploadBatch& uploadBatch,
+            std::span<const VertexType> vertices,
+            std::span<const uint32_t> indices,
+            const DirectX::BoundingBox& boundingBox,
+            bool buildMeshlets = false
         );
 
+        // As above, with levels of detail from BuildLodChain
+        static ProceduralMesh CreateFromOptimizedPart(
+            ID3D12Device* device,
+            DirectX::ResourceUploadBatch& uploadBatch,
+            std::span<const VertexType> vertices,
+            const LodChain& lodChain,
+            const DirectX::BoundingBox& boundingBox
+        );
+
+        // Simplifies an optimized mesh over and over, each level keeping
+        // about lodReduction of the triangles of the one before it, until
+        // there are maxLods levels or simplifying stops getting anywhere.
+        // This only touches the CPU, so it's safe to call from any thread.
+        static LodChain BuildLodChain(std::span<const VertexType> vertices,
+            std::span<const uint32_t> indices,
+            uint32_t maxLods = 4,
+            float lodReduction = 0.5f);
+
+        static DirectX::BoundingBox ComputeBoundingBox(std::span<const VertexType> vertices);
+
     private:
         ProceduralMesh() = default;
 
@@ -121,7 +245,21 @@ namespace Gradient::Rendering
             const VertexCollection& vertices,
             const IndexCollection& indices,
             float simplificationRate = 0.f,
-            float errorRate = 0.1f);
+            float errorRate = 0.1f,
+            bool buildMeshlets = false);
+
+        void Upload(ID3D12Device* device,
+            DirectX::ResourceUploadBatch& uploadBatch,
+            std::span<const VertexType> vertices,
+            std::span<const uint32_t> indices,
+            const DirectX::BoundingBox& boundingBox,
+            std::span<const Lod> lods = {},
+            bool buildMeshlets = false);
+        // Splits the full mesh into meshlets for Meshlet_AS and Meshlet_MS
+        void UploadMeshlets(ID3D12Device* device,
+            DirectX::ResourceUploadBatch& uploadBatch,
+            std::span<const VertexType> vertices,
+            std::span<const uint32_t> indices);
 
         Microsoft::WRL::ComPtr<ID3D12Resource> m_vertexBuffer;
         Microsoft::WRL::ComPtr<ID3D12Resource> m_indexBuffer;
@@ -131,5 +269,11 @@ namespace Gradient::Rendering
         D3D12_VERTEX_BUFFER_VIEW m_vbv;
         D3D12_INDEX_BUFFER_VIEW m_ibv;
         DirectX::BoundingBox m_boundingBox;
+        std::vector<Lod> m_lods;
+
+        Microsoft::WRL::ComPtr<ID3D12Resource> m_meshletBuffer;
+        Microsoft::WRL::ComPtr<ID3D12Resource> m_meshletVertexBuffer;
+        Microsoft::WRL::ComPtr<ID3D12Resource> m_meshletTriangleBuffer;
+        MeshletView m_meshletView = {};
     };
 }
\ No newline at end of file
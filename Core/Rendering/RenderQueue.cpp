@@ -0,0 +1,249 @@
+#include "pch.h"
+
+#include "Core/Rendering/RenderQueue.h"
+#include "Core/Jobs/JobSystem.h"
+#include "Core/Math.h"
+
+#include <algorithm>
+#include <bit>
+
+namespace Gradient::Rendering
+{
+    namespace
+    {
+        constexpr uint64_t PipelineBits = 3;
+        constexpr uint64_t DrawTypeBits = 2;
+        constexpr uint64_t MaskedBits = 1;
+        constexpr uint64_t MaterialBits = 15;
+        constexpr uint64_t MeshBits = 16;
+        constexpr uint64_t DepthBits = 27;
+
+        static_assert(PipelineBits + DrawTypeBits + MaskedBits
+            + MaterialBits + MeshBits + DepthBits == 64);
+
+        constexpr uint64_t MeshShift = DepthBits;
+        constexpr uint64_t MaterialShift = MeshShift + MeshBits;
+        constexpr uint64_t MaskedShift = MaterialShift + MaterialBits;
+        constexpr uint64_t DrawTypeShift = MaskedShift + MaskedBits;
+        constexpr uint64_t PipelineShift = DrawTypeShift + DrawTypeBits;
+
+        constexpr uint64_t Mask(uint64_t bits)
+        {
+            return (1ull << bits) - 1;
+        }
+
+        constexpr size_t RadixBits = 8;
+        constexpr size_t NumPasses = 64 / RadixBits;
+
+        // Below this, handing out the work costs more than it saves
+        constexpr size_t MinParallelCount = 16384;
+        constexpr size_t MinChunkSize = 4096;
+    }
+
+    uint64_t RenderQueue::MakeKey(Pipeline pipeline,
+        DrawType drawType,
+        bool masked,
+        uint64_t material,
+        uint64_t mesh,
+        float depth)
+    {
+        assert(depth >= 0.f);
+
+        // Non-negative floats sort the same way as their bits, so
+        // the top bits of the float stand in for the depth.
+        uint64_t depthBits = std::bit_cast<uint32_t>(std::max(depth, 0.f)) >> (32 - DepthBits);
+
+        return (static_cast<uint64_t>(pipeline) & Mask(PipelineBits)) << PipelineShift
+            | (static_cast<uint64_t>(drawType) & Mask(DrawTypeBits)) << DrawTypeShift
+            | (masked ? 1ull : 0ull) << MaskedShift
+            | (material & Mask(MaterialBits)) << MaterialShift
+            | (mesh & Mask(MeshBits)) << MeshShift
+            | (depthBits & Mask(DepthBits));
+    }
+
+    RenderQueue::Pipeline RenderQueue::GetPipeline(uint64_t key)
+    {
+        return static_cast<Pipeline>((key >> PipelineShift) & Mask(PipelineBits));
+    }
+
+    RenderQueue::DrawType RenderQueue::GetDrawType(uint64_t key)
+    {
+        return static_cast<DrawType>((key >> DrawTypeShift) & Mask(DrawTypeBits));
+    }
+
+    void RenderQueue::Clear()
+    {
+        m_items.clear();
+    }
+
+    void RenderQueue::Reserve(size_t count)
+    {
+        m_items.reserve(count);
+        m_scratch.reserve(count);
+    }
+
+    void RenderQueue::Add(uint64_t key, entt::entity entity, uint32_t batchIndex)
+    {
+        m_items.push_back({ key, entity, batchIndex });
+    }
+
+    void RenderQueue::Sort(bool parallel)
+    {
+        if (m_items.size() < 2)
+            return;
+
+        m_scratch.resize(m_items.size());
+
+        if (parallel && m_items.size() >= MinParallelCount)
+        {
+            SortParallel();
+        }
+        else
+        {
+            SortSerial();
+        }
+    }
+
+    std::span<const RenderQueue::Item> RenderQueue::GetItems() const
+    {
+        return m_items;
+    }
+
+    size_t RenderQueue::Size() const
+    {
+        return m_items.size();
+    }
+
+    void RenderQueue::SortSerial()
+    {
+        const size_t count = m_items.size();
+
+        // Every digit's histogram can be counted in a single read,
+        // since the counts don't depend on the order.
+        m_histograms.resize(NumPasses);
+        for (auto& histogram : m_histograms)
+        {
+            histogram.fill(0);
+        }
+
+        for (const auto& item : m_items)
+        {
+            for (size_t pass = 0; pass < NumPasses; pass++)
+            {
+                m_histograms[pass][(item.Key >> (pass * RadixBits)) & (NumBuckets - 1)]++;
+            }
+        }
+
+        Item* src = m_items.data();
+        Item* dst = m_scratch.data();
+
+        for (size_t pass = 0; pass < NumPasses; pass++)
+        {
+            auto& histogram = m_histograms[pass];
+            const size_t shift = pass * RadixBits;
+
+            if (histogram[(src[0].Key >> shift) & (NumBuckets - 1)] == count)
+                continue;
+
+            uint32_t offset = 0;
+            for (auto& bucket : histogram)
+            {
+                auto bucketCount = bucket;
+                bucket = offset;
+                offset += bucketCount;
+            }
+
+            for (size_t i = 0; i < count; i++)
+            {
+                dst[histogram[(src[i].Key >> shift) & (NumBuckets - 1)]++] = src[i];
+            }
+
+            std::swap(src, dst);
+        }
+
+        if (src != m_items.data())
+        {
+            std::swap(m_items, m_scratch);
+        }
+    }
+
+    void RenderQueue::SortParallel()
+    {
+        const size_t count = m_items.size();
+        auto jobSystem = Jobs::JobSystem::Get();
+
+        const size_t numChunks = std::min<size_t>(jobSystem->GetMaxConcurrency(),
+            Math::DivRoundUp(count, MinChunkSize));
+        const size_t chunkSize = Math::DivRoundUp(count, numChunks);
+
+        m_histograms.resize(numChunks);
+
+        Item* src = m_items.data();
+        Item* dst = m_scratch.data();
+
+        for (size_t pass = 0; pass < NumPasses; pass++)
+        {
+            const size_t shift = pass * RadixBits;
+
+            jobSystem->ParallelFor(numChunks, 1,
+                [&](size_t beginChunk, size_t endChunk)
+                {
+                    for (size_t chunk = beginChunk; chunk < endChunk; chunk++)
+                    {
+                        auto& histogram = m_histograms[chunk];
+                        histogram.fill(0);
+
+                        const size_t end = std::min(count, (chunk + 1) * chunkSize);
+                        for (size_t i = chunk * chunkSize; i < end; i++)
+                        {
+                            histogram[(src[i].Key >> shift) & (NumBuckets - 1)]++;
+                        }
+                    }
+                },
+                Jobs::JobPriority::High);
+
+            // Each chunk scatters its share of a bucket after the
+            // chunks before it, which keeps the sort stable.
+            uint32_t offset = 0;
+            bool isUniform = false;
+            for (size_t bucket = 0; bucket < NumBuckets && !isUniform; bucket++)
+            {
+                const uint32_t bucketStart = offset;
+                for (auto& histogram : m_histograms)
+                {
+                    auto chunkCount = histogram[bucket];
+                    histogram[bucket] = offset;
+                    offset += chunkCount;
+                }
+
+                isUniform = offset - bucketStart == count;
+            }
+
+            if (isUniform)
+                continue;
+
+            jobSystem->ParallelFor(numChunks, 1,
+                [&](size_t beginChunk, size_t endChunk)
+                {
+                    for (size_t chunk = beginChunk; chunk < endChunk; chunk++)
+                    {
+                        auto& histogram = m_histograms[chunk];
+
+                        const size_t end = std::min(count, (chunk + 1) * chunkSize);
+                        for (size_t i = chunk * chunkSize; i < end; i++)
+                        {
+                            dst[histogram[(src[i].Key >> shift) & (NumBuckets - 1)]++] = src[i];
+                        }
+                    }
+                },
+                Jobs::JobPriority::High);
+
+            std::swap(src, dst);
+        }
+
+        if (src != m_items.data())
+        {
+            std::swap(m_items, m_scratch);
+        }
+    }
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "pch.h"
+
+#include "Core/Pipelines/IRenderPipeline.h"
+
+#include <array>
+#include <span>
+#include <vector>
+#include <entt/entt.hpp>
+
+namespace Gradient::Rendering
+{
+    // The draws for one pass, sorted by a 64-bit key so that draws
+    // sharing a PSO, material and mesh end up next to each other,
+    // and consecutive draws bind as little as possible.
+    //
+    // From the most significant bits down, the key holds:
+    //   pipeline (3), draw type (2), masked (1), material (15),
+    //   mesh (16), depth (27)
+    // The pipeline, draw type and masked bits decide the PSO, and
+    // depth orders otherwise identical draws from front to back.
+    class RenderQueue
+    {
+    public:
+        using DrawType = Pipelines::IRenderPipeline::DrawType;
+
+        // Also the order the pipelines are drawn in
+        enum class Pipeline : uint8_t
+        {
+            Heightmap,
+            Pbr,
+            Instanced,
+            // Draws gathered up by the instance batcher
+            Batched,
+            Billboard,
+            // Last, so it's drawn over everything else
+            Water
+        };
+
+        struct Item
+        {
+            uint64_t Key;
+            entt::entity Entity;
+            // Which batch a batched draw is for
+            uint32_t BatchIndex = 0;
+        };
+
+        // material and mesh only need to be equal for draws that 
+        // share them, and are truncated to fit. 
+        // depth must not be negative.
+        static uint64_t MakeKey(Pipeline pipeline,
+            DrawType drawType,
+            bool masked,
+            uint64_t material,
+            uint64_t mesh,
+            float depth);
+        static Pipeline GetPipeline(uint64_t key);
+        static DrawType GetDrawType(uint64_t key);
+
+        void Clear();
+        void Reserve(size_t count);
+        void Add(uint64_t key, entt::entity entity, uint32_t batchIndex = 0);
+
+        // A stable LSD radix sort over the keys, eight bits at a time.
+        // Passes over digits that every key shares are skipped, and 
+        // large queues are split across the job system.
+        void Sort(bool parallel = true);
+
+        std::span<const Item> GetItems() const;
+        size_t Size() const;
+
+    private:
+        static constexpr size_t NumBuckets = 256;
+        using Histogram = std::array<uint32_t, NumBuckets>;
+
+        void SortSerial();
+        void SortParallel();
+
+        std::vector<Item> m_items;
+        std::vector<Item> m_scratch;
+        std::vector<Histogram> m_histograms;
+    };
+}
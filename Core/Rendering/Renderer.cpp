@@ -6,11 +6,18 @@
 #include "Core/ECS/Components/DrawableComponent.h"
 #include "Core/ECS/Components/MaterialComponent.h"
 #include "Core/ECS/Components/TransformComponent.h"
+#include "Core/ECS/Components/WorldMatrixComponent.h"
 #include "Core/ECS/Components/PointLightComponent.h"
 #include "Core/ECS/Components/InstanceDataComponent.h"
+#include "Core/ECS/Components/InstanceClusterComponent.h"
 #include "Core/ECS/Components/RelationshipComponent.h"
+#include "Core/ECS/Components/RigidBodyComponent.h"
+#include "Core/ECS/Components/HeightMapComponent.h"
+#include "Core/ECS/Components/OccluderComponent.h"
 #include "Core/TextureManager.h"
+#include "Core/RenderStateCache.h"
 #include "Core/Physics/PhysicsEngine.h"
+#include "Core/Jobs/JobSystem.h"
 #include "Core/Math.h"
 
 #include <imgui.h>
@@ -19,6 +26,21 @@
 
 namespace Gradient::Rendering
 {
+    namespace
+    {
+        // TODO: Don't hardcode the size
+        constexpr int NumShadowCubes = 8;
+        constexpr int ShadowCubeResolution = 256;
+
+        // The environment map and the render textures each have one,
+        // and resizing makes the new ones before the old ones go.
+        constexpr uint32_t OtherDsvCount = 16;
+
+        static_assert(DepthCubeArray::GetDsvCount(NumShadowCubes)
+            + DirectionalLight::GetDsvCount(Pipelines::MaxShadowCascades)
+            + OtherDsvCount <= GraphicsMemoryManager::DsvCapacity,
+            "The shadow maps need more DSVs than the heap has");
+    }
 
     void Renderer::CreateWindowSizeIndependentResources(ID3D12Device2* device,
         ID3D12CommandQueue* cq)
@@ -26,6 +48,9 @@ namespace Gradient::Rendering
         auto bm = BufferManager::Get();
 
         m_states = std::make_unique<DirectX::CommonStates>(device);
+        m_bundlePool = std::make_unique<BundlePool>(device);
+        m_instanceCuller = std::make_unique<InstanceCuller>(device);
+        m_softwareOcclusion = std::make_unique<SoftwareOcclusionCuller>();
         PbrPipeline = std::make_unique<Pipelines::PBRPipeline>(device);
         InstancePipeline = std::make_unique<Pipelines::InstancedPBRPipeline>(device);
         WaterPipeline = std::make_unique<Pipelines::WaterPipeline>(device);
@@ -62,9 +87,12 @@ namespace Gradient::Rendering
         };
         WaterPipeline->SetWaterParams(waterParams);
 
-        // TODO: Don't hardcode the size
         ShadowCubeArray = std::make_unique<Rendering::DepthCubeArray>(device,
-            256, 8);
+            ShadowCubeResolution,
+            NumShadowCubes);
+
+        m_directionalShadowCache.Resize(DirectionalLight->GetNumCascades());
+        m_pointShadowCache.Resize(ShadowCubeArray->GetNumCubes() * DepthCubeArray::NumFaces);
     }
 
     void Renderer::CreateWindowSizeDependentResources(ID3D12Device* device,
@@ -96,18 +124,22 @@ namespace Gradient::Rendering
         AOProcessor = std::make_unique<Gradient::Rendering::GTAOProcessor>(device,
             windowSize);
 
+        m_depthPyramid = std::make_unique<DepthPyramid>(device, windowSize);
+
         auto physicsEngine = Physics::PhysicsEngine::Get();
         physicsEngine->InitializeDebugRenderer(device, DXGI_FORMAT_R16G16B16A16_FLOAT);
     }
 
-    std::vector<Gradient::Params::PointLight> Renderer::PointLightParams()
+    FrameVector<Gradient::Params::PointLight> Renderer::PointLightParams()
     {
         using namespace Gradient::ECS::Components;
 
-        std::vector<Gradient::Params::PointLight> out;
         auto em = Gradient::EntityManager::Get();
         auto view = em->Registry.view<TransformComponent, PointLightComponent>();
 
+        FrameVector<Gradient::Params::PointLight> out;
+        out.reserve(view.size_hint());
+
         for (auto entity : view)
         {
             auto [transform, light] = view.get(entity);
@@ -147,6 +179,8 @@ namespace Gradient::Rendering
         HeightmapPipeline->SetCameraPosition(cameraPosition);
         HeightmapPipeline->SetCameraDirection(cameraDirection);
 
+        m_sortOrigin = cameraPosition;
+
         BillboardPipeline->CameraPosition = cameraPosition;
         BillboardPipeline->CameraDirection = cameraDirection;
         BillboardPipeline->UsingOrthographic = isOrthographic;
@@ -163,12 +197,15 @@ namespace Gradient::Rendering
 
     void Renderer::SetFrameParameters(const Camera* viewingCamera)
     {
+        auto pointLights = PointLightParams();
+        m_sortOrigin = viewingCamera->GetPosition();
+
         PbrPipeline->SetCameraPosition(viewingCamera->GetPosition());
         PbrPipeline->SetDirectionalLight(DirectionalLight.get());
         PbrPipeline->SetView(viewingCamera->GetViewMatrix());
         PbrPipeline->SetProjection(viewingCamera->GetProjectionMatrix());
         PbrPipeline->SetEnvironmentMap(EnvironmentMap->GetSRV());
-        PbrPipeline->SetPointLights(PointLightParams());
+        PbrPipeline->SetPointLights(pointLights);
         PbrPipeline->SetShadowCubeArray(ShadowCubeArray->GetSRV());
 
         InstancePipeline->SetCameraPosition(viewingCamera->GetPosition());
@@ -176,7 +213,7 @@ namespace Gradient::Rendering
         InstancePipeline->SetView(viewingCamera->GetViewMatrix());
         InstancePipeline->SetProjection(viewingCamera->GetProjectionMatrix());
         InstancePipeline->SetEnvironmentMap(EnvironmentMap->GetSRV());
-        InstancePipeline->SetPointLights(PointLightParams());
+        InstancePipeline->SetPointLights(pointLights);
         InstancePipeline->SetShadowCubeArray(ShadowCubeArray->GetSRV());
 
         BillboardPipeline->CameraPosition = viewingCamera->GetPosition();
@@ -186,7 +223,7 @@ namespace Gradient::Rendering
         BillboardPipeline->SetDirectionalLight(DirectionalLight.get());
         BillboardPipeline->EnvironmentMap = EnvironmentMap->GetSRV();
         BillboardPipeline->ShadowCubeArray = ShadowCubeArray->GetSRV();
-        BillboardPipeline->PointLights = PointLightParams();
+        BillboardPipeline->PointLights.assign(pointLights.begin(), pointLights.end());
         BillboardPipeline->UsingOrthographic = false;
 
         HeightmapPipeline->SetCameraPosition(viewingCamera->GetPosition());
@@ -195,7 +232,7 @@ namespace Gradient::Rendering
         HeightmapPipeline->SetView(viewingCamera->GetViewMatrix());
         HeightmapPipeline->SetProjection(viewingCamera->GetProjectionMatrix());
         HeightmapPipeline->SetEnvironmentMap(EnvironmentMap->GetSRV());
-        HeightmapPipeline->SetPointLights(PointLightParams());
+        HeightmapPipeline->SetPointLights(pointLights);
         HeightmapPipeline->SetShadowCubeArray(ShadowCubeArray->GetSRV());
 
         WaterPipeline->SetCameraPosition(viewingCamera->GetPosition());
@@ -204,7 +241,7 @@ namespace Gradient::Rendering
         WaterPipeline->SetView(viewingCamera->GetViewMatrix());
         WaterPipeline->SetProjection(viewingCamera->GetProjectionMatrix());
         WaterPipeline->SetEnvironmentMap(EnvironmentMap->GetSRV());
-        WaterPipeline->SetPointLights(PointLightParams());
+        WaterPipeline->SetPointLights(pointLights);
         WaterPipeline->SetShadowCubeArray(ShadowCubeArray->GetSRV());
     }
 
@@ -236,12 +273,11 @@ namespace Gradient::Rendering
         using namespace DirectX;
         using namespace Gradient::ECS::Components;
 
-        auto entityManager = Gradient::EntityManager::Get();
         auto gmm = Gradient::GraphicsMemoryManager::Get();
         auto bm = BufferManager::Get();
 
-        ID3D12DescriptorHeap* heaps[] = { gmm->GetSrvUavDescriptorHeap(), m_states->Heap() };
-        cl->SetDescriptorHeaps(static_cast<UINT>(std::size(heaps)), heaps);
+        auto heaps = GetDescriptorHeaps();
+        cl->SetDescriptorHeaps(static_cast<UINT>(heaps.size()), heaps.data());
 
         D3D12_RECT scissorRect;
         scissorRect.left = 0;
@@ -251,49 +287,65 @@ namespace Gradient::Rendering
 
         cl->RSSetScissorRects(1, &scissorRect);
 
-        PIXBeginEvent(cl, PIX_COLOR_DEFAULT, L"Shadow Pass");
+        UpdateSpatialIndex();
 
-        DirectionalLight->SetCameraFrustum(cullingCamera->GetShadowFrustum());
-        DirectionalLight->ClearAndSetDSV(cl);
+        auto projection = viewingCamera->GetProjectionMatrix();
+        m_lodView = InstanceLodSelector::View{
+            viewingCamera->GetPosition(),
+            0.5f * screenViewport.Height * projection._22,
+            LodPixelError
+        };
 
-        // Position should be ignored here since projection is orthographic
-        SetShadowViewProj(DirectionalLight->GetPosition(),
-            DirectionalLight->GetDirection(),
-            DirectionalLight->GetView(),
-            DirectionalLight->GetProjection(),
-            true);
+        // The Z-prepass and the forward pass share a view, so they share
+        // a visible list too. It's culled up front since the point
+        // lights only draw the faces that can see part of it.
+        auto cameraFrustum = cullingCamera->GetFrustum();
+        auto cameraPlanes = Math::GetPlanes(cameraFrustum);
+        // It's the biggest query of the frame, so it's shared out.
+        QueryDrawOrder(cameraPlanes, m_cameraVisibleIds, Mobility::Any, Jobs::JobSystem::Get());
 
-        BillboardPipeline->CullingFrustumPlanes = Math::GetPlanes(DirectionalLight->GetShadowBB());
+        if (SoftwareOcclusionCulling)
+        {
+            auto em = EntityManager::Get();
+            m_occluders.clear();
+            em->Registry.view<OccluderComponent, WorldMatrixComponent>().each(
+                [&](const OccluderComponent& occluder, const WorldMatrixComponent& world)
+                {
+                    m_occluders.push_back({ occluder.Mesh.get(), world.World });
+                });
 
-        DrawAllEntities(cl, PassType::ShadowPass, cullingCamera->GetFrustum(), DirectionalLight->GetShadowBB());
+            m_softwareOcclusion->Render(m_occluders,
+                cullingCamera->GetViewMatrix() * cullingCamera->GetProjectionMatrix());
+        }
 
-        auto pointLightsView = entityManager->Registry.view<TransformComponent, PointLightComponent>();
-        for (auto& entity : pointLightsView)
+        if (ReprojectedOcclusionCulling || SoftwareOcclusionCulling)
         {
-            auto [transform, light] = pointLightsView.get(entity);
-            // TODO: Cull lights whose range doesn't intersect 
-            // with the camera frustum.
-            ShadowCubeArray->Render(cl,
-                light.PointLight.ShadowCubeIndex,
-                transform.GetTranslation(),
-                light.PointLight.MinRange,
-                light.PointLight.MaxRange,
-                [=](SimpleMath::Matrix view, SimpleMath::Matrix proj, SimpleMath::Vector3 lookDir)
-                {
-                    SetShadowViewProj(transform.GetTranslation(),
-                        lookDir,
-                        view, 
-                        proj,
-                        false);
+            CullOccluded(m_cameraVisibleIds, m_cameraUnoccludedIds);
+            GetEntities(m_cameraUnoccludedIds, m_cameraVisibleEntities);
+        }
+        else
+        {
+            GetEntities(m_cameraVisibleIds, m_cameraVisibleEntities);
+        }
 
-                    auto frustum = Math::MakeFrustum(view, proj);
+        // Before this frame's pyramid is built, since the instance
+        // culling for every pass runs ahead of this command list
+        m_instanceCuller->SetOccluders(*m_depthPyramid);
 
-                    BillboardPipeline->CullingFrustumPlanes = Math::GetPlanes(frustum);
+        PIXBeginEvent(cl, PIX_COLOR_DEFAULT, L"Shadow Pass");
 
-                    DrawAllEntities(cl, PassType::ShadowPass, frustum);
-                });
+        DirectionalLight->SetCameraFrustum(cullingCamera->GetShadowFrustum());
+
+        if (CacheStaticShadows != m_cachingStaticShadows)
+        {
+            // Nothing was kept up to date while caching was off
+            InvalidateShadowCaches();
+            m_cachingStaticShadows = CacheStaticShadows;
         }
 
+        DrawDirectionalShadows(cl);
+        DrawPointLightShadows(cl, cameraFrustum);
+
         PIXEndEvent(cl);
 
         SkyDomePipeline->SetDirectionalLight(DirectionalLight.get());
@@ -331,11 +383,11 @@ namespace Gradient::Rendering
         PIXBeginEvent(cl, PIX_COLOR_DEFAULT, L"Z-prepass");
 
         MultisampledRT->SetDepthOnly(cl);
-        m_prepassedEntities.clear();
+        m_prepassedEntities.Clear();
 
         // TODO: Need to disable mesh shader culling in the Z prepass if using a shorter draw distance
-        BillboardPipeline->CullingFrustumPlanes = Math::GetPlanes(cullingCamera->GetFrustum());
-        DrawAllEntities(cl, PassType::ZPrepass, cullingCamera->GetFrustum());
+        SetCullingPlanes(cameraPlanes);
+        DrawAllEntities(cl, PassType::ZPrepass, m_cameraVisibleEntities);
 
         PIXEndEvent(cl);
 
@@ -345,6 +397,14 @@ namespace Gradient::Rendering
 
         PIXEndEvent(cl);
 
+        PIXBeginEvent(cl, PIX_COLOR_DEFAULT, L"Depth pyramid");
+
+        m_depthPyramid->Build(cl,
+            AOProcessor->GetResolvedDepthSRV(),
+            viewingCamera->GetViewMatrix() * viewingCamera->GetProjectionMatrix());
+
+        PIXEndEvent(cl);
+
         SetGTAOTexture(cl);
 
         PIXBeginEvent(cl, PIX_COLOR_DEFAULT, L"Forward pass");
@@ -353,9 +413,9 @@ namespace Gradient::Rendering
         SkyDomePipeline->Apply(cl);
         bm->GetMesh(SkyGeometry)->Draw(cl);
 
-        BillboardPipeline->CullingFrustumPlanes = Math::GetPlanes(cullingCamera->GetFrustum());
+        SetCullingPlanes(cameraPlanes);
 
-        DrawAllEntities(cl, PassType::ForwardPass, cullingCamera->GetFrustum());
+        DrawAllEntities(cl, PassType::ForwardPass, m_cameraVisibleEntities);
 
         auto physicsEngine = Physics::PhysicsEngine::Get();
         // This is too slow for now and is hence commented out
@@ -381,322 +441,1067 @@ namespace Gradient::Rendering
             screenViewport);
     }
 
-    void Renderer::DrawAllEntities(ID3D12GraphicsCommandList6* cl,
-        PassType passType,
-        std::optional<DirectX::BoundingFrustum> viewFrustum,
-        std::optional<DirectX::BoundingOrientedBox> shadowBB)
+    void Renderer::UpdateSpatialIndex()
     {
-        using namespace ECS::Components;
         auto em = EntityManager::Get();
-        auto bm = BufferManager::Get();
 
-        // Heightmap shading model
-        auto heightmapView = em->Registry.view<DrawableComponent,
-            TransformComponent,
-            HeightMapComponent,
-            MaterialComponent>();
-        for (auto entity : heightmapView)
+        if (!m_spatialIndexBuilt
+            || m_spatialIndexVersion != em->GetDrawableLayoutVersion())
         {
-            auto [drawable, transform, heightMap, material] = heightmapView.get(entity);
-            auto mesh = bm->GetMesh(drawable.MeshHandle);
+            BuildSpatialIndex();
+            InvalidateShadowCaches();
+            return;
+        }
 
-            if (mesh == nullptr) continue;
-            if (passType == PassType::ShadowPass
-                && !drawable.CastsShadows) continue;
+        bool staticItemsMoved = false;
+        bool unindexedMoved = false;
 
-            if (drawable.ShadingModel
-                != DrawableComponent::ShadingModel::Heightmap)
+        for (auto entity : em->GetChangedEntities())
+        {
+            auto it = m_indexedEntities.find(entity);
+            if (it == m_indexedEntities.end())
+            {
+                // The terrain isn't indexed, but is cached as a static caster
+                if (em->Registry.all_of<ECS::Components::HeightMapComponent>(entity))
+                {
+                    InvalidateShadowCaches();
+                }
+                unindexedMoved = unindexedMoved
+                    || em->Registry.all_of<ECS::Components::DrawableComponent>(entity);
                 continue;
+            }
 
-            DrawType drawType;
+            auto& world = em->Registry.get<ECS::Components::WorldMatrixComponent>(entity);
+            auto bb = em->GetBoundingBox(entity, world.World);
+            if (!bb) continue;
 
-            switch (passType)
+            auto [isStatic, buildIndex, drawOrderIndex] = it->second;
+            m_drawOrderBounds[drawOrderIndex] = bb;
+
+            if (isStatic)
             {
-            case PassType::ShadowPass:
-                drawType = DrawType::ShadowPass;
-                break;
+                // Redraw the cached shadows it left and the ones it entered
+                InvalidateShadowCaches(m_staticItems[buildIndex].Bounds);
+                InvalidateShadowCaches(bb.value());
 
-            case PassType::ZPrepass:
-                drawType = DrawType::DepthWriteOnly;
-                m_prepassedEntities.insert(entity);
-                break;
+                m_staticItems[buildIndex].Bounds = bb.value();
+                staticItemsMoved = true;
+            }
+            else
+            {
+                m_dynamicTree.SetBounds(buildIndex, bb.value());
+            }
+        }
 
-            case PassType::ForwardPass:
-                if (m_prepassedEntities.contains(entity))
-                {
-                    drawType = DrawType::PixelDepthReadOnly;
-                }
-                else
+        // Only happens when scenery is moved by hand
+        if (staticItemsMoved)
+        {
+            m_staticTree.Build(m_staticItems);
+        }
+
+        if (unindexedMoved)
+        {
+            UpdateUnindexedReceivers();
+        }
+
+        m_dynamicTree.Refit();
+    }
+
+    void Renderer::BuildSpatialIndex()
+    {
+        using namespace ECS::Components;
+        auto em = EntityManager::Get();
+
+        m_drawOrder.clear();
+        m_drawOrderBounds.clear();
+        m_indexedEntities.clear();
+        m_unboundedIds.clear();
+        m_staticItems.clear();
+
+        std::vector<BoundingVolumeHierarchy::Item> dynamicItems;
+
+        auto add = [&](entt::entity entity, const WorldMatrixComponent& world)
+            {
+                auto id = static_cast<uint32_t>(m_drawOrder.size());
+                auto bb = em->GetBoundingBox(entity, world.World);
+                m_drawOrder.push_back(entity);
+                m_drawOrderBounds.push_back(bb);
+
+                if (!bb)
                 {
-                    drawType = DrawType::PixelDepthReadWrite;
+                    m_unboundedIds.push_back(id);
+                    return;
                 }
-                break;
 
-            default:
-                drawType = DrawType::PixelDepthReadWrite;
-                break;
-            }
+                bool isStatic = IsStatic(entity);
+                auto& items = isStatic ? m_staticItems : dynamicItems;
 
-            HeightmapPipeline->SetMaterial(material.Material);
-            HeightmapPipeline->SetHeightMapComponent(heightMap);
-            HeightmapPipeline->SetWorld(em->GetWorldMatrix(entity));
-            HeightmapPipeline->Apply(cl, true, drawType);
+                m_indexedEntities[entity] = { isStatic, static_cast<uint32_t>(items.size()), id };
+                items.push_back({ bb.value(), id });
+            };
 
-            mesh->Draw(cl);
-        }
+        // Added in the order they're drawn in, which culling preserves.
 
         // Default shading model without instancing
         auto defaultView = em->Registry.view<DrawableComponent,
-            TransformComponent,
+            WorldMatrixComponent,
             MaterialComponent>(entt::exclude<InstanceDataComponent>);
         for (auto entity : defaultView)
         {
-            auto [drawable, transform, material] = defaultView.get(entity);
+            auto [drawable, world, material] = defaultView.get(entity);
+            if (drawable.ShadingModel == DrawableComponent::ShadingModel::Default)
+            {
+                add(entity, world);
+            }
+        }
 
-            auto mesh = bm->GetMesh(drawable.MeshHandle);
+        // Billboard shading model with instancing
+        auto billboardView = em->Registry.view<DrawableComponent,
+            WorldMatrixComponent,
+            MaterialComponent,
+            InstanceDataComponent>();
+        for (auto entity : billboardView)
+        {
+            auto [drawable, world, material, instances] = billboardView.get(entity);
+            if (drawable.ShadingModel == DrawableComponent::ShadingModel::Billboard)
+            {
+                add(entity, world);
+            }
+        }
 
-            if (mesh == nullptr) continue;
+        // Default shading model with instancing
+        for (auto entity : billboardView)
+        {
+            auto [drawable, world, material, instances] = billboardView.get(entity);
+            if (drawable.ShadingModel == DrawableComponent::ShadingModel::Default)
+            {
+                add(entity, world);
+            }
+        }
 
-            if (passType == PassType::ShadowPass
-                && !drawable.CastsShadows) continue;
+        m_staticTree.Build(m_staticItems);
+        m_dynamicTree.Build(std::move(dynamicItems));
+
+        UpdateUnindexedReceivers();
+
+        m_spatialIndexVersion = em->GetDrawableLayoutVersion();
+        m_spatialIndexBuilt = true;
+    }
+
+    void Renderer::UpdateUnindexedReceivers()
+    {
+        using namespace ECS::Components;
+        auto em = EntityManager::Get();
+
+        m_unindexedReceivers.clear();
+        m_hasUnboundedReceivers = !m_unboundedIds.empty();
+
+        auto drawableView = em->Registry.view<DrawableComponent>();
+        for (auto entity : drawableView)
+        {
+            auto shadingModel = drawableView.get<DrawableComponent>(entity).ShadingModel;
+            if (shadingModel != DrawableComponent::ShadingModel::Heightmap
+                && shadingModel != DrawableComponent::ShadingModel::Water) continue;
 
-            if (drawable.ShadingModel
-                != DrawableComponent::ShadingModel::Default)
+            if (auto bb = em->GetBoundingBox(entity))
+            {
+                m_unindexedReceivers.push_back(bb.value());
+            }
+            else
+            {
+                m_hasUnboundedReceivers = true;
+            }
+        }
+    }
+
+    bool Renderer::IsStatic(entt::entity entity) const
+    {
+        using namespace ECS::Components;
+        auto em = EntityManager::Get();
+        auto& bodyInterface = Physics::PhysicsEngine::Get()->GetBodyInterface();
+
+        // Moves if it or anything it's attached to is simulated
+        auto current = entity;
+        while (em->Registry.valid(current))
+        {
+            auto rigidBody = em->Registry.try_get<RigidBodyComponent>(current);
+            if (rigidBody != nullptr
+                && !rigidBody->BodyID.IsInvalid()
+                && bodyInterface.GetMotionType(rigidBody->BodyID) != JPH::EMotionType::Static)
+            {
+                return false;
+            }
+
+            auto relationship = em->Registry.try_get<RelationshipComponent>(current);
+            if (relationship == nullptr) break;
+            current = relationship->Parent;
+        }
+
+        return true;
+    }
+
+    void Renderer::QueryDrawOrder(const std::array<DirectX::XMFLOAT4, 6>& planes,
+        std::vector<uint32_t>& ids,
+        Mobility mobility,
+        Jobs::JobSystem* jobSystem)
+    {
+        auto query = [&](const BoundingVolumeHierarchy& tree)
+            {
+                if (jobSystem)
+                    tree.Query(planes, ids, *jobSystem);
+                else
+                    tree.Query(planes, ids);
+            };
+
+        ids.clear();
+        if (mobility != Mobility::Dynamic)
+        {
+            query(m_staticTree);
+        }
+        if (mobility != Mobility::Static)
+        {
+            query(m_dynamicTree);
+            ids.insert(ids.end(), m_unboundedIds.begin(), m_unboundedIds.end());
+        }
+
+        // IDs are positions in the draw order, so sorting 
+        // them groups entities by shading model again.
+        std::sort(ids.begin(), ids.end());
+    }
+
+    void Renderer::QueryDrawOrder(const DirectX::BoundingSphere& sphere,
+        std::vector<uint32_t>& ids,
+        Mobility mobility)
+    {
+        ids.clear();
+        if (mobility != Mobility::Dynamic)
+        {
+            m_staticTree.Query(sphere, ids);
+        }
+        if (mobility != Mobility::Static)
+        {
+            m_dynamicTree.Query(sphere, ids);
+            ids.insert(ids.end(), m_unboundedIds.begin(), m_unboundedIds.end());
+        }
+        std::sort(ids.begin(), ids.end());
+    }
+
+    void Renderer::GetEntities(const std::vector<uint32_t>& ids,
+        std::vector<entt::entity>& entities) const
+    {
+        entities.clear();
+        entities.reserve(ids.size());
+        for (auto id : ids)
+        {
+            entities.push_back(m_drawOrder[id]);
+        }
+    }
+
+    void Renderer::CullEntities(const std::array<DirectX::XMFLOAT4, 6>& planes,
+        std::vector<entt::entity>& visibleEntities)
+    {
+        QueryDrawOrder(planes, m_visibleIds);
+        GetEntities(m_visibleIds, visibleEntities);
+    }
+
+    void Renderer::CullOccluded(const std::vector<uint32_t>& ids,
+        std::vector<uint32_t>& unoccludedIds) const
+    {
+        unoccludedIds.clear();
+        unoccludedIds.reserve(ids.size());
+
+        auto occluders = ReprojectedOcclusionCulling ? m_depthPyramid->GetReadback() : nullptr;
+        auto software = SoftwareOcclusionCulling ? m_softwareOcclusion.get() : nullptr;
+        if (occluders == nullptr && software == nullptr)
+        {
+            unoccludedIds = ids;
+            return;
+        }
+
+        for (auto id : ids)
+        {
+            const auto& bounds = m_drawOrderBounds[id];
+            if (!bounds
+                || !((occluders && HiZ::IsOccluded(*occluders, bounds->Center, bounds->Extents))
+                    || (software && software->IsOccluded(*bounds))))
+            {
+                unoccludedIds.push_back(id);
+            }
+        }
+    }
+
+    void Renderer::DrawDirectionalShadows(ID3D12GraphicsCommandList6* cl)
+    {
+        for (uint32_t i = 0; i < DirectionalLight->GetNumCascades(); i++)
+        {
+            // Position should be ignored here since projection is orthographic
+            SetShadowViewProj(DirectionalLight->GetPosition(i),
+                DirectionalLight->GetDirection(),
+                DirectionalLight->GetView(),
+                DirectionalLight->GetProjection(i),
+                true);
+
+            // Each cascade only draws the casters that reach its slice
+            auto shadowBB = DirectionalLight->GetShadowBB(i);
+            auto shadowPlanes = Math::GetPlanes(shadowBB);
+            SetCullingPlanes(shadowPlanes);
+
+            if (!m_cachingStaticShadows)
+            {
+                DirectionalLight->ClearAndSetDSV(cl, i);
+                CullEntities(shadowPlanes, m_shadowVisibleEntities);
+                DrawAllEntities(cl, PassType::ShadowPass, m_shadowVisibleEntities);
                 continue;
+            }
 
-            auto bb = em->GetBoundingBox(entity);
-            if (passType == PassType::ShadowPass
-                && shadowBB && bb)
+            // The cascades follow the camera in whole texels, so 
+            // each one is only redrawn when it moves by a texel.
+            ShadowCacheTracker::LightState state{
+                ShadowCacheTracker::MakeKey(DirectionalLight->GetView(), DirectionalLight->GetProjection(i)),
+                shadowBB
+            };
+
+            if (m_directionalShadowCache.Update(i, state))
             {
-                if (!shadowBB.value().Intersects(bb.value()))
-                {
-                    continue;
-                }
+                DirectionalLight->ClearAndSetStaticDSV(cl, i);
+                QueryDrawOrder(shadowPlanes, m_visibleIds, Mobility::Static);
+                GetEntities(m_visibleIds, m_shadowVisibleEntities);
+                DrawAllEntities(cl, PassType::ShadowPass, m_shadowVisibleEntities);
+            }
+
+            DirectionalLight->CopyStaticAndSetDSV(cl, i);
+            QueryDrawOrder(shadowPlanes, m_visibleIds, Mobility::Dynamic);
+            GetEntities(m_visibleIds, m_shadowVisibleEntities);
+            DrawAllEntities(cl, PassType::ShadowPass, m_shadowVisibleEntities, false);
+        }
+    }
+
+    void Renderer::DrawPointLightShadows(ID3D12GraphicsCommandList6* cl,
+        const DirectX::BoundingFrustum& cameraFrustum)
+    {
+        using namespace ECS::Components;
+        using namespace DirectX::SimpleMath;
+        auto em = EntityManager::Get();
+
+        auto pointLightsView = em->Registry.view<TransformComponent, PointLightComponent>();
+        for (auto& entity : pointLightsView)
+        {
+            auto [transform, light] = pointLightsView.get(entity);
+            auto lightPosition = transform.GetTranslation();
+            auto cubeIndex = light.PointLight.ShadowCubeIndex;
+            auto minRange = light.PointLight.MinRange;
+            auto maxRange = light.PointLight.MaxRange;
+
+            // Nothing outside a light's range is lit by it, so lights 
+            // that can't reach the camera frustum can be skipped.
+            DirectX::BoundingSphere lightRange(lightPosition, maxRange);
+            if (!cameraFrustum.Intersects(lightRange)) continue;
+
+            auto faceMask = GetVisibleCubeFaces(lightRange,
+                minRange,
+                cameraFrustum);
+            if (faceMask == 0) continue;
+
+            if (!m_cachingStaticShadows)
+            {
+                // Everything that can cast into any face, 
+                // narrowed down per face by DrawCubeFace.
+                QueryDrawOrder(lightRange, m_pointLightCasterIds);
+
+                ShadowCubeArray->Render(cl,
+                    cubeIndex,
+                    lightPosition,
+                    minRange,
+                    maxRange,
+                    [=](Matrix view, Matrix proj, Vector3 lookDir)
+                    {
+                        DrawCubeFace(cl, m_pointLightCasterIds, lightPosition, view, proj, lookDir, true);
+                    },
+                    faceMask);
+                continue;
             }
-            else  if (viewFrustum && bb)
+
+            // Each face only sees its own part of the light's range, so a
+            // static caster moving in range redraws the faces it overlaps.
+            auto projection = DepthCubeArray::GetProjection(minRange, maxRange);
+
+            uint32_t staleFaceMask = 0;
+            for (uint32_t face = 0; face < DepthCubeArray::NumFaces; face++)
             {
-                if (!viewFrustum.value().Intersects(bb.value()))
+                if (!(faceMask & (1 << face))) continue;
+
+                ShadowCacheTracker::LightState state{
+                    ShadowCacheTracker::MakeKey(DepthCubeArray::GetFaceView(lightPosition, face), projection),
+                    DepthCubeArray::GetFaceBounds(lightPosition, face, maxRange)
+                };
+
+                if (m_pointShadowCache.Update(cubeIndex * DepthCubeArray::NumFaces + face, state))
                 {
-                    continue;
+                    staleFaceMask |= 1 << face;
                 }
             }
 
-            PbrPipeline->SetMaterial(material.Material);
+            if (staleFaceMask != 0)
+            {
+                QueryDrawOrder(lightRange, m_pointLightStaticCasterIds, Mobility::Static);
+            }
+            QueryDrawOrder(lightRange, m_pointLightCasterIds, Mobility::Dynamic);
+
+            ShadowCubeArray->RenderCached(cl,
+                cubeIndex,
+                lightPosition,
+                minRange,
+                maxRange,
+                [=](Matrix view, Matrix proj, Vector3 lookDir)
+                {
+                    DrawCubeFace(cl, m_pointLightStaticCasterIds, lightPosition, view, proj, lookDir, true);
+                },
+                [=](Matrix view, Matrix proj, Vector3 lookDir)
+                {
+                    DrawCubeFace(cl, m_pointLightCasterIds, lightPosition, view, proj, lookDir, false);
+                },
+                faceMask,
+                staleFaceMask);
+        }
+    }
+
+    void Renderer::DrawCubeFace(ID3D12GraphicsCommandList6* cl,
+        const std::vector<uint32_t>& ids,
+        const DirectX::SimpleMath::Vector3& lightPosition,
+        const DirectX::SimpleMath::Matrix& view,
+        const DirectX::SimpleMath::Matrix& proj,
+        const DirectX::SimpleMath::Vector3& lookDir,
+        bool drawTerrain)
+    {
+        SetShadowViewProj(lightPosition,
+            lookDir,
+            view,
+            proj,
+            false);
 
-            auto world = em->GetWorldMatrix(entity);
-            PbrPipeline->SetWorld(world);
+        auto faceFrustum = Math::MakeFrustum(view, proj);
 
-            DrawType drawType;
+        SetCullingPlanes(Math::GetPlanes(faceFrustum));
 
-            switch (passType)
+        m_shadowVisibleEntities.clear();
+        for (auto id : ids)
+        {
+            const auto& bounds = m_drawOrderBounds[id];
+            if (!bounds || faceFrustum.Intersects(bounds.value()))
             {
-            case PassType::ShadowPass:
-                drawType = DrawType::ShadowPass;
-                break;
+                m_shadowVisibleEntities.push_back(m_drawOrder[id]);
+            }
+        }
 
-            case PassType::ZPrepass:
-                drawType = DrawType::DepthWriteOnly;
-                m_prepassedEntities.insert(entity);
-                break;
+        DrawAllEntities(cl, PassType::ShadowPass, m_shadowVisibleEntities, drawTerrain);
+    }
+
+    void Renderer::InvalidateShadowCaches(const DirectX::BoundingBox& bounds)
+    {
+        m_directionalShadowCache.InvalidateIntersecting(bounds);
+        m_pointShadowCache.InvalidateIntersecting(bounds);
+    }
+
+    void Renderer::InvalidateShadowCaches()
+    {
+        m_directionalShadowCache.InvalidateAll();
+        m_pointShadowCache.InvalidateAll();
+    }
 
-            case PassType::ForwardPass:
-                if (m_prepassedEntities.contains(entity))
+    uint32_t Renderer::GetVisibleCubeFaces(const DirectX::BoundingSphere& lightRange,
+        float nearPlane,
+        const DirectX::BoundingFrustum& cameraFrustum)
+    {
+        // Only what the camera sees and the light reaches can
+        // show a shadow, so a face is needed if it contains any of it.
+        m_pointLightReceivers.clear();
+        if (m_hasUnboundedReceivers)
+        {
+            // Anything in range could be receiving
+            m_pointLightReceivers.push_back(DirectX::BoundingBox(lightRange.Center,
+                DirectX::XMFLOAT3(lightRange.Radius, lightRange.Radius, lightRange.Radius)));
+        }
+        else
+        {
+            for (auto id : m_cameraVisibleIds)
+            {
+                const auto& bounds = m_drawOrderBounds[id];
+                if (bounds && lightRange.Intersects(bounds.value()))
                 {
-                    drawType = DrawType::PixelDepthReadOnly;
+                    m_pointLightReceivers.push_back(bounds.value());
                 }
-                else
+            }
+
+            for (const auto& bounds : m_unindexedReceivers)
+            {
+                if (lightRange.Intersects(bounds) && cameraFrustum.Intersects(bounds))
                 {
-                    drawType = DrawType::PixelDepthReadWrite;
+                    m_pointLightReceivers.push_back(bounds);
                 }
-                break;
-
-            default:
-                drawType = DrawType::PixelDepthReadWrite;
-                break;
             }
+        }
 
-            PbrPipeline->Apply(cl, true, drawType);
+        return DepthCubeArray::GetReceivingFaces(lightRange,
+            nearPlane,
+            cameraFrustum,
+            m_pointLightReceivers);
+    }
 
-            mesh->Draw(cl);
+    Renderer::DrawType Renderer::GetDrawType(PassType passType, entt::entity entity)
+    {
+        switch (passType)
+        {
+        case PassType::ShadowPass:
+            return DrawType::ShadowPass;
+
+        case PassType::ZPrepass:
+            m_prepassedEntities.Insert(entt::to_entity(entity));
+            return DrawType::DepthWriteOnly;
+
+        case PassType::ForwardPass:
+            if (m_prepassedEntities.Contains(entt::to_entity(entity)))
+            {
+                return DrawType::PixelDepthReadOnly;
+            }
+            return DrawType::PixelDepthReadWrite;
+
+        default:
+            return DrawType::PixelDepthReadWrite;
         }
+    }
 
-        // Billboard shading model with instancing
-        auto billboardView = em->Registry.view<DrawableComponent,
-            TransformComponent,
-            MaterialComponent,
-            InstanceDataComponent>();
-        for (auto entity : billboardView)
+    void Renderer::DrawAllEntities(ID3D12GraphicsCommandList6* cl,
+        PassType passType,
+        const std::vector<entt::entity>& visibleEntities,
+        bool drawTerrain)
+    {
+        BuildRenderQueue(passType, visibleEntities, drawTerrain);
+        m_renderQueue.Sort();
+
+        // One upload for every batch in the pass
+        auto batchedInstances = m_instanceBatcher.GetInstances();
+        if (!batchedInstances.empty())
         {
-            auto [drawable, transform, material, instances] = billboardView.get(entity);
+            m_batchedInstanceBuffer = GraphicsMemoryManager::Get()->AllocateArray(batchedInstances);
+        }
 
-            if (passType == PassType::ShadowPass
-                && !drawable.CastsShadows) continue;
+        SelectInstanceLods(passType);
+        CullInstances(passType);
 
-            if (drawable.ShadingModel
-                != DrawableComponent::ShadingModel::Billboard)
-                continue;
+        auto items = m_renderQueue.GetItems();
+        const size_t numChunks = ParallelRecording ? m_recorder.GetChunkCount(items.size()) : 1;
 
-            auto bb = em->GetBoundingBox(entity);
-            if (passType == PassType::ShadowPass
-                && shadowBB && bb)
+        if (numChunks <= 1)
+        {
+            // Everything in the queue binds through the pipelines,
+            // so repeated binds between neighbouring draws are skipped.
+            auto& stateCache = RenderStateCache::Get();
+            stateCache.Begin();
+
+            auto pipelines = GetPipelines();
+            for (size_t i = 0; i < items.size(); i++)
             {
-                if (!shadowBB.value().Intersects(bb.value()))
-                {
-                    continue;
-                }
+                DrawQueuedEntity(cl, i, pipelines);
             }
-            else if (viewFrustum && bb)
+
+            stateCache.End();
+            return;
+        }
+
+        // Each chunk sets per-draw state on pipelines of its own
+        while (m_chunkPipelines.size() < numChunks)
+        {
+            m_chunkPipelines.push_back(std::make_unique<ChunkPipelines>());
+        }
+
+        auto heaps = GetDescriptorHeaps();
+        m_bundlePool->SetTarget(cl);
+
+        m_recorder.Record(*m_bundlePool, items.size(),
+            [&](ICommandListPool::ListHandle list, size_t chunk, size_t begin, size_t end)
             {
-                if (!viewFrustum.value().Intersects(bb.value()))
+                auto bundle = m_bundlePool->Get(list);
+                bundle->SetDescriptorHeaps(static_cast<UINT>(heaps.size()), heaps.data());
+
+                auto pipelines = CopyPipelines(*m_chunkPipelines[chunk]);
+
+                auto& stateCache = RenderStateCache::Get();
+                stateCache.Begin();
+
+                for (size_t i = begin; i < end; i++)
                 {
-                    continue;
+                    DrawQueuedEntity(bundle, i, pipelines);
                 }
+
+                stateCache.End();
+            });
+    }
+
+    void Renderer::BeginFrame(UINT frameIndex)
+    {
+        m_bundlePool->BeginFrame(frameIndex);
+        m_instanceCuller->BeginFrame(frameIndex);
+        m_depthPyramid->BeginFrame(frameIndex);
+    }
+
+    void Renderer::SetCullingPlanes(const std::array<DirectX::XMFLOAT4, 6>& planes)
+    {
+        BillboardPipeline->CullingFrustumPlanes = planes;
+        PbrPipeline->CullingFrustumPlanes = planes;
+        m_cullingPlanes = planes;
+    }
+
+    void Renderer::SelectInstanceLods(PassType passType)
+    {
+        using namespace ECS::Components;
+        const auto& registry = EntityManager::Get()->Registry;
+        auto bm = BufferManager::Get();
+
+        auto items = m_renderQueue.GetItems();
+        m_lodDrawRanges.assign(items.size(), std::nullopt);
+        m_lodDraws.clear();
+        m_lodInstances.clear();
+
+        if (!InstanceLod) return;
+
+        // These draws skip the instance culler, so in the camera's passes
+        // their clusters are culled against the same occluders as the
+        // entities. Both passes cull the same way, so the prepass still
+        // covers everything the forward pass draws.
+        std::array<const HiZ::Pyramid*, 2> occluders{};
+        size_t numOccluders = 0;
+        if (passType != PassType::ShadowPass)
+        {
+            auto readback = ReprojectedOcclusionCulling ? m_depthPyramid->GetReadback() : nullptr;
+            if (readback) occluders[numOccluders++] = readback;
+            if (SoftwareOcclusionCulling) occluders[numOccluders++] = &m_softwareOcclusion->GetPyramid();
+        }
+
+        for (size_t i = 0; i < items.size(); i++)
+        {
+            if (RenderQueue::GetPipeline(items[i].Key) != RenderQueue::Pipeline::Instanced) continue;
+
+            auto clusters = registry.try_get<InstanceClusterComponent>(items[i].Entity);
+            if (clusters == nullptr) continue;
+
+            auto [drawable, world] = registry.get<DrawableComponent,
+                WorldMatrixComponent>(items[i].Entity);
+
+            auto mesh = bm->GetMesh(drawable.MeshHandle);
+            if (mesh == nullptr) continue;
+
+            m_lodSelector.Select(clusters->Clusters,
+                mesh->GetLods(),
+                world.World,
+                m_lodView,
+                m_cullingPlanes,
+                std::span<const HiZ::Pyramid* const>(occluders.data(), numOccluders));
+
+            // Every draw of the pass shares one upload
+            const auto firstInstance = static_cast<uint32_t>(m_lodInstances.size());
+            auto instances = m_lodSelector.GetInstances();
+            m_lodInstances.insert(m_lodInstances.end(), instances.begin(), instances.end());
+
+            LodDrawRange range{ static_cast<uint32_t>(m_lodDraws.size()), 0 };
+            auto ranges = m_lodSelector.GetRanges();
+            for (uint32_t lod = 0; lod < ranges.size(); lod++)
+            {
+                if (ranges[lod].InstanceCount == 0) continue;
+
+                m_lodDraws.push_back(LodDraw{
+                    lod,
+                    firstInstance + ranges[lod].FirstInstance,
+                    ranges[lod].InstanceCount });
+                range.NumDraws++;
             }
 
-            BillboardPipeline->Material = material.Material;
-            BillboardPipeline->World = em->GetWorldMatrix(entity);
-            BillboardPipeline->InstanceHandle = instances.BufferHandle;
+            // Set even if every cluster was culled, so nothing is drawn
+            m_lodDrawRanges[i] = range;
+        }
+
+        if (!m_lodInstances.empty())
+        {
+            m_lodInstanceBuffer = GraphicsMemoryManager::Get()->AllocateArray(
+                std::span<const uint32_t>(m_lodInstances));
+        }
+    }
+
+    void Renderer::CullInstances(PassType passType)
+    {
+        using namespace ECS::Components;
+        const auto& registry = EntityManager::Get()->Registry;
+        auto bm = BufferManager::Get();
+
+        auto items = m_renderQueue.GetItems();
+        m_culledDraws.assign(items.size(), std::nullopt);
 
-            DrawType drawType;
+        if (!GpuInstanceCulling) return;
+
+        bool culling = false;
+        for (size_t i = 0; i < items.size(); i++)
+        {
+            if (RenderQueue::GetPipeline(items[i].Key) != RenderQueue::Pipeline::Instanced
+                || m_lodDrawRanges[i]) continue;
+
+            auto [drawable, world, instances] = registry.get<DrawableComponent,
+                WorldMatrixComponent,
+                InstanceDataComponent>(items[i].Entity);
+
+            auto mesh = bm->GetMesh(drawable.MeshHandle);
+            auto bufferEntry = bm->GetInstanceBuffer(instances.BufferHandle);
+            if (mesh == nullptr
+                || bufferEntry == nullptr
+                || bufferEntry->InstanceCount < InstanceCuller::MinInstances) continue;
 
-            switch (passType)
+            if (!culling)
             {
-            case PassType::ShadowPass:
-                drawType = DrawType::ShadowPass;
-                break;
+                // The pyramid is the last frame's, so the Z-prepass and
+                // the forward pass are both culled against it, and
+                // nothing is prepassed that the forward pass skips.
+                m_instanceCuller->BeginPass(m_cullingPlanes,
+                    OcclusionCulling && passType != PassType::ShadowPass);
+                culling = true;
+            }
 
-            case PassType::ZPrepass:
-                drawType = DrawType::DepthWriteOnly;
-                m_prepassedEntities.insert(entity);
-                break;
+            m_culledDraws[i] = m_instanceCuller->Cull(*bufferEntry,
+                world.World,
+                InstanceCuller::GetInstanceRadius(mesh->GetBoundingBox(), world.World),
+                mesh->GetIndexCount());
+        }
+    }
 
-            case PassType::ForwardPass:
-                if (m_prepassedEntities.contains(entity))
-                {
-                    drawType = DrawType::PixelDepthReadOnly;
-                }
-                else
+    void Renderer::SubmitInstanceCulling(ID3D12CommandQueue* cq)
+    {
+        m_instanceCuller->Submit(cq);
+    }
+
+    std::array<ID3D12DescriptorHeap*, 2> Renderer::GetDescriptorHeaps() const
+    {
+        auto gmm = GraphicsMemoryManager::Get();
+        return { gmm->GetSrvUavDescriptorHeap(), m_states->Heap() };
+    }
+
+    Renderer::PipelineSet Renderer::GetPipelines() const
+    {
+        return PipelineSet{
+            PbrPipeline.get(),
+            InstancePipeline.get(),
+            BillboardPipeline.get(),
+            HeightmapPipeline.get(),
+            WaterPipeline.get()
+        };
+    }
+
+    Renderer::PipelineSet Renderer::CopyPipelines(ChunkPipelines& chunkPipelines) const
+    {
+        // Copies reuse their storage from the last pass
+        chunkPipelines.Pbr = *PbrPipeline;
+        chunkPipelines.Instanced = *InstancePipeline;
+        chunkPipelines.Billboard = *BillboardPipeline;
+        chunkPipelines.Heightmap = *HeightmapPipeline;
+        chunkPipelines.Water = *WaterPipeline;
+
+        return PipelineSet{
+            &chunkPipelines.Pbr.value(),
+            &chunkPipelines.Instanced.value(),
+            &chunkPipelines.Billboard.value(),
+            &chunkPipelines.Heightmap.value(),
+            &chunkPipelines.Water.value()
+        };
+    }
+
+    void Renderer::BuildRenderQueue(PassType passType,
+        const std::vector<entt::entity>& visibleEntities,
+        bool drawTerrain)
+    {
+        using namespace ECS::Components;
+        using Pipeline = RenderQueue::Pipeline;
+        auto em = EntityManager::Get();
+
+        m_renderQueue.Clear();
+        m_renderQueue.Reserve(visibleEntities.size());
+        m_instanceBatcher.Clear();
+
+        auto add = [this](entt::entity entity,
+            Pipeline pipeline,
+            DrawType drawType,
+            const PBRMaterial* material,
+            BufferManager::MeshHandle mesh,
+            const DirectX::SimpleMath::Matrix& world,
+            uint32_t batchIndex = 0)
+            {
+                uint64_t materialId = 0;
+                bool masked = false;
+                if (material != nullptr)
                 {
-                    drawType = DrawType::PixelDepthReadWrite;
+                    materialId = material->Texture ? material->Texture->m_index : 0;
+                    masked = material->Masked;
                 }
-                break;
 
-            default:
-                drawType = DrawType::PixelDepthReadWrite;
-                break;
-            }
+                auto depth = DirectX::SimpleMath::Vector3::DistanceSquared(m_sortOrigin,
+                    world.Translation());
 
-            auto bufferEntry = bm->GetInstanceBuffer(instances.BufferHandle);
+                m_renderQueue.Add(RenderQueue::MakeKey(pipeline, drawType, masked, materialId, mesh, depth),
+                    entity,
+                    batchIndex);
+            };
 
-            if (bufferEntry)
+        // Heightmap shading model
+        if (drawTerrain)
+        {
+            auto heightmapView = em->Registry.view<DrawableComponent,
+                WorldMatrixComponent,
+                HeightMapComponent,
+                MaterialComponent>();
+            for (auto entity : heightmapView)
             {
-                BillboardPipeline->CardDimensions = drawable.BillboardDimensions;
-                BillboardPipeline->InstanceCount = bufferEntry->InstanceCount;
-                BillboardPipeline->Apply(cl, true, drawType);
+                auto [drawable, world, heightMap, material] = heightmapView.get(entity);
 
-                cl->DispatchMesh(Math::DivRoundUp(bufferEntry->InstanceCount, 
-                    BillboardPipeline->InstancesPerThreadGroup), 1, 1);
+                if (passType == PassType::ShadowPass
+                    && !drawable.CastsShadows) continue;
+
+                if (drawable.ShadingModel
+                    != DrawableComponent::ShadingModel::Heightmap)
+                    continue;
+
+                add(entity, Pipeline::Heightmap, GetDrawType(passType, entity),
+                    &material.Material, drawable.MeshHandle, world.World);
             }
         }
 
-        // Default shading model with instancing
-        auto instanceView = em->Registry.view<DrawableComponent,
-            TransformComponent,
-            MaterialComponent,
-            InstanceDataComponent>();
-        for (auto entity : instanceView)
+        // Everything that survived culling
+        for (auto entity : visibleEntities)
         {
-            auto [drawable, transform, material, instances] = instanceView.get(entity);
-            auto mesh = bm->GetMesh(drawable.MeshHandle);
-
-            if (mesh == nullptr) continue;
+            auto [drawable, world, material]
+                = em->Registry.get<DrawableComponent, WorldMatrixComponent, MaterialComponent>(entity);
 
             if (passType == PassType::ShadowPass
                 && !drawable.CastsShadows) continue;
 
-            if (drawable.ShadingModel
-                != DrawableComponent::ShadingModel::Default)
+            Pipeline pipeline = Pipeline::Pbr;
+            if (drawable.ShadingModel == DrawableComponent::ShadingModel::Billboard)
+            {
+                pipeline = Pipeline::Billboard;
+            }
+            else if (em->Registry.all_of<InstanceDataComponent>(entity))
+            {
+                pipeline = Pipeline::Instanced;
+            }
+
+            auto drawType = GetDrawType(passType, entity);
+
+            // Left to the batcher, which hands back what it can't batch
+            if (pipeline == Pipeline::Pbr
+                && AutoInstancing
+                && m_instanceBatcher.Add(entity, drawType, drawable.MeshHandle, material.Material, world.World))
                 continue;
 
-            auto bb = em->GetBoundingBox(entity);
-            if (passType == PassType::ShadowPass
-                && shadowBB && bb)
+            add(entity, pipeline, drawType,
+                &material.Material, drawable.MeshHandle, world.World);
+        }
+
+        m_instanceBatcher.Build();
+
+        for (auto entity : m_instanceBatcher.GetUnbatched())
+        {
+            auto [drawable, world, material]
+                = em->Registry.get<DrawableComponent, WorldMatrixComponent, MaterialComponent>(entity);
+
+            add(entity, Pipeline::Pbr, GetDrawType(passType, entity),
+                &material.Material, drawable.MeshHandle, world.World);
+        }
+
+        auto batches = m_instanceBatcher.GetBatches();
+        for (uint32_t i = 0; i < batches.size(); i++)
+        {
+            const auto& batch = batches[i];
+            const auto& world = em->Registry.get<WorldMatrixComponent>(batch.FirstEntity);
+
+            add(batch.FirstEntity, Pipeline::Batched, batch.Type,
+                batch.Material, batch.Mesh, world.World, i);
+        }
+
+        // Water shading model
+        if (passType == PassType::ForwardPass)
+        {
+            auto waterView = em->Registry.view<DrawableComponent,
+                WorldMatrixComponent>();
+            for (auto entity : waterView)
             {
-                if (!shadowBB.value().Intersects(bb.value()))
-                {
+                auto [drawable, world] = waterView.get(entity);
+
+                if (drawable.ShadingModel
+                    != DrawableComponent::ShadingModel::Water)
                     continue;
-                }
+
+                add(entity, Pipeline::Water, DrawType::PixelDepthReadWrite,
+                    nullptr, drawable.MeshHandle, world.World);
             }
-            else if (viewFrustum && bb)
+        }
+    }
+
+    void Renderer::DrawQueuedEntity(ID3D12GraphicsCommandList6* cl,
+        size_t itemIndex,
+        const PipelineSet& pipelines)
+    {
+        using namespace ECS::Components;
+        using Pipeline = RenderQueue::Pipeline;
+        auto bm = BufferManager::Get();
+
+        // Const, since this runs on several threads at once
+        const auto& registry = EntityManager::Get()->Registry;
+
+        const auto& item = m_renderQueue.GetItems()[itemIndex];
+        auto entity = item.Entity;
+        auto drawType = RenderQueue::GetDrawType(item.Key);
+        auto [drawable, world] = registry.get<DrawableComponent, WorldMatrixComponent>(entity);
+
+        switch (RenderQueue::GetPipeline(item.Key))
+        {
+        case Pipeline::Heightmap:
+        {
+            auto mesh = bm->GetMesh(drawable.MeshHandle);
+            if (mesh == nullptr) return;
+
+            auto [heightMap, material] = registry.get<HeightMapComponent, MaterialComponent>(entity);
+
+            pipelines.Heightmap->SetMaterial(material.Material);
+            pipelines.Heightmap->SetHeightMapComponent(heightMap);
+            pipelines.Heightmap->SetWorld(world.World);
+            pipelines.Heightmap->Apply(cl, true, drawType);
+
+            mesh->Draw(cl);
+            break;
+        }
+
+        case Pipeline::Pbr:
+        {
+            auto mesh = bm->GetMesh(drawable.MeshHandle);
+            if (mesh == nullptr) return;
+
+            const auto& material = registry.get<MaterialComponent>(entity);
+
+            pipelines.Pbr->SetMaterial(material.Material);
+            pipelines.Pbr->SetWorld(world.World);
+
+            if (MeshletCulling && mesh->HasMeshlets())
             {
-                if (!viewFrustum.value().Intersects(bb.value()))
-                {
-                    continue;
-                }
+                const auto& meshlets = mesh->GetMeshletView();
+                pipelines.Pbr->SetMeshlets(&meshlets);
+                pipelines.Pbr->Apply(cl, true, drawType);
+
+                cl->DispatchMesh(pipelines.Pbr->GetMeshletGroupCount(), 1, 1);
             }
+            else
+            {
+                pipelines.Pbr->SetMeshlets(nullptr);
+                pipelines.Pbr->Apply(cl, true, drawType);
 
-            InstancePipeline->SetMaterial(material.Material);
-            InstancePipeline->SetWorld(em->GetWorldMatrix(entity));
-            InstancePipeline->SetInstanceData(instances);
+                mesh->Draw(cl);
+            }
+            break;
+        }
 
-            DrawType drawType;
+        case Pipeline::Instanced:
+        {
+            auto mesh = bm->GetMesh(drawable.MeshHandle);
+            if (mesh == nullptr) return;
 
-            switch (passType)
-            {
-            case PassType::ShadowPass:
-                drawType = DrawType::ShadowPass;
-                break;
+            auto [material, instances] = registry.get<MaterialComponent, InstanceDataComponent>(entity);
 
-            case PassType::ZPrepass:
-                drawType = DrawType::DepthWriteOnly;
-                m_prepassedEntities.insert(entity);
-                break;
+            const auto& culledDraw = m_culledDraws[itemIndex];
+            const auto& lodDrawRange = m_lodDrawRanges[itemIndex];
 
-            case PassType::ForwardPass:
-                if (m_prepassedEntities.contains(entity))
-                {
-                    drawType = DrawType::PixelDepthReadOnly;
-                }
-                else
+            pipelines.Instanced->SetMaterial(material.Material);
+            pipelines.Instanced->SetWorld(world.World);
+            pipelines.Instanced->SetInstanceData(instances);
+
+            if (lodDrawRange)
+            {
+                for (uint32_t i = 0; i < lodDrawRange->NumDraws; i++)
                 {
-                    drawType = DrawType::PixelDepthReadWrite;
+                    const auto& lodDraw = m_lodDraws[lodDrawRange->FirstDraw + i];
+
+                    pipelines.Instanced->SetVisibleInstances(m_lodInstanceBuffer
+                        + lodDraw.FirstInstance * sizeof(uint32_t));
+                    pipelines.Instanced->Apply(cl, true, drawType);
+
+                    mesh->DrawLod(cl, lodDraw.Lod, lodDraw.InstanceCount);
                 }
                 break;
+            }
+
+            pipelines.Instanced->SetVisibleInstances(culledDraw ? culledDraw->VisibleInstances : 0);
+            pipelines.Instanced->Apply(cl, true, drawType);
 
-            default:
-                drawType = DrawType::PixelDepthReadWrite;
+            if (culledDraw)
+            {
+                mesh->DrawIndirect(cl,
+                    m_instanceCuller->GetCommandSignature(),
+                    culledDraw->Arguments,
+                    culledDraw->ArgumentsOffset);
                 break;
             }
 
-            InstancePipeline->Apply(cl, true, drawType);
-
             auto bufferEntry = bm->GetInstanceBuffer(instances.BufferHandle);
 
             if (bufferEntry)
             {
                 mesh->Draw(cl, bufferEntry->InstanceCount);
             }
+            break;
         }
 
-        // Water shading model
-        auto waterView = em->Registry.view<DrawableComponent,
-            TransformComponent>();
-        for (auto entity : waterView)
+        case Pipeline::Batched:
         {
-            auto [drawable, transform] = waterView.get(entity);
-            auto mesh = bm->GetMesh(drawable.MeshHandle);
+            const auto& batch = m_instanceBatcher.GetBatches()[item.BatchIndex];
+            auto mesh = bm->GetMesh(batch.Mesh);
+            if (mesh == nullptr) return;
+
+            pipelines.Instanced->SetMaterial(*batch.Material);
+            pipelines.Instanced->SetWorld(batch.World);
+            pipelines.Instanced->SetInstanceBuffer(m_batchedInstanceBuffer
+                + batch.FirstInstance * sizeof(BufferManager::InstanceData));
+            pipelines.Instanced->SetVisibleInstances(0);
+            pipelines.Instanced->Apply(cl, true, drawType);
+
+            mesh->Draw(cl, batch.InstanceCount);
+            break;
+        }
 
-            if (mesh == nullptr) continue;
-            if (passType != PassType::ForwardPass) continue;
+        case Pipeline::Billboard:
+        {
+            auto [material, instances] = registry.get<MaterialComponent, InstanceDataComponent>(entity);
 
-            if (drawable.ShadingModel
-                != DrawableComponent::ShadingModel::Water)
-                continue;
+            pipelines.Billboard->Material = material.Material;
+            pipelines.Billboard->World = world.World;
+            pipelines.Billboard->InstanceHandle = instances.BufferHandle;
 
-            WaterPipeline->SetWorld(em->GetWorldMatrix(entity));
-            WaterPipeline->Apply(cl, true, DrawType::PixelDepthReadWrite);
+            auto bufferEntry = bm->GetInstanceBuffer(instances.BufferHandle);
+
+            if (bufferEntry)
+            {
+                pipelines.Billboard->CardDimensions = drawable.BillboardDimensions;
+                pipelines.Billboard->InstanceCount = bufferEntry->InstanceCount;
+                pipelines.Billboard->Apply(cl, true, drawType);
+
+                cl->DispatchMesh(Math::DivRoundUp(bufferEntry->InstanceCount,
+                    pipelines.Billboard->InstancesPerThreadGroup), 1, 1);
+            }
+            break;
+        }
+
+        case Pipeline::Water:
+        {
+            auto mesh = bm->GetMesh(drawable.MeshHandle);
+            if (mesh == nullptr) return;
+
+            pipelines.Water->SetWorld(world.World);
+            pipelines.Water->Apply(cl, true, drawType);
 
             mesh->Draw(cl);
+            break;
+        }
         }
     }
 }
\ No newline at end of file
@@ -17,12 +17,26 @@
 #include "Core/Rendering/ProceduralMesh.h"
 #include "Core/BufferManager.h"
 #include "Core/Camera.h"
+#include "Core/FrameArena.h"
+#include "Core/GenerationalSet.h"
 #include "Core/Rendering/GTAOProcessor.h"
+#include "Core/Rendering/BoundingVolumeHierarchy.h"
+#include "Core/Rendering/ShadowCacheTracker.h"
+#include "Core/Rendering/RenderQueue.h"
+#include "Core/Rendering/InstanceBatcher.h"
+#include "Core/Rendering/InstanceCuller.h"
+#include "Core/Rendering/DepthPyramid.h"
+#include "Core/Rendering/SoftwareOcclusionCuller.h"
+#include "Core/Rendering/InstanceLodSelector.h"
+#include "Core/Rendering/ParallelRecorder.h"
+#include "Core/Rendering/BundlePool.h"
 #include "Core/Shaders/XeGTAO.h"
 
 #include <entt/entt.hpp>
 
-#include <set>
+#include <array>
+#include <optional>
+#include <unordered_map>
 
 namespace Gradient::Rendering
 {
@@ -46,7 +60,7 @@ namespace Gradient::Rendering
             RECT windowSize);
 
         void Clear(ID3D12GraphicsCommandList* cl, D3D12_VIEWPORT screenViewport);
-        std::vector<Gradient::Params::PointLight> PointLightParams();
+        FrameVector<Gradient::Params::PointLight> PointLightParams();
 
         void Render(ID3D12GraphicsCommandList6* cl,
             D3D12_VIEWPORT screenViewport,
@@ -55,10 +69,12 @@ namespace Gradient::Rendering
             RenderTexture* finalRenderTarget,
             RECT windowSize);
 
+        // Draws the entities that survived culling for this pass,
+        // along with the terrain and water, which aren't culled.
         void DrawAllEntities(ID3D12GraphicsCommandList6* cl,
-            PassType passType = PassType::ForwardPass,
-            std::optional<DirectX::BoundingFrustum> viewFrustum = std::nullopt,
-            std::optional<DirectX::BoundingOrientedBox> shadowBB = std::nullopt);
+            PassType passType,
+            const std::vector<entt::entity>& visibleEntities,
+            bool drawTerrain = true);
 
         void SetShadowViewProj(const DirectX::SimpleMath::Vector3& cameraPosition,
             const DirectX::SimpleMath::Vector3& cameraDirection,
@@ -75,6 +91,14 @@ namespace Gradient::Rendering
 
         void SetGTAOTexture(ID3D12GraphicsCommandList* cl);
 
+        // Must be called before Render, once the GPU is done 
+        // with the frame that last used this frame index.
+        void BeginFrame(UINT frameIndex);
+        // Must be called after Render, and before the command
+        // list it recorded into is executed, since its draws
+        // read what the instance culling writes.
+        void SubmitInstanceCulling(ID3D12CommandQueue* cq);
+
         std::unique_ptr<DirectX::CommonStates> m_states;
 
         std::unique_ptr<Gradient::Pipelines::PBRPipeline> PbrPipeline;
@@ -95,8 +119,226 @@ namespace Gradient::Rendering
         std::unique_ptr<Gradient::Rendering::DirectionalLight> DirectionalLight;
         std::unique_ptr<Gradient::Rendering::DepthCubeArray> ShadowCubeArray;
 
+        // Draw static casters into shadow maps only when they or the
+        // light change, and draw only moving casters every frame.
+        bool CacheStaticShadows = true;
+        // Draw entities that share a mesh and material, and aren't
+        // already instanced, as one instanced draw.
+        bool AutoInstancing = true;
+        // Record large passes in chunks across the job system.
+        bool ParallelRecording = true;
+        // Cull the instances of large instanced draws on the GPU.
+        bool GpuInstanceCulling = true;
+        // Draw instanced meshes with levels of detail in less detail
+        // the smaller they are on screen, and cull them in clusters.
+        // These draws skip GpuInstanceCulling and OcclusionCulling, and
+        // their clusters are culled on the CPU against the frustum and
+        // the occluders that cull entities instead.
+        bool InstanceLod = true;
+        // How many pixels a level of detail's error may cover
+        float LodPixelError = 1.f;
+        // Draw meshes that have meshlets with mesh shaders, culling
+        // the meshlets by the frustum and their normal cones.
+        bool MeshletCulling = true;
+        // Cull the instances of large instanced draws seen from the
+        // camera against the depth pyramid built in the last frame.
+        bool OcclusionCulling = true;
+        // Cull entities on the CPU against a depth pyramid read back
+        // from a few frames ago, seen from where the camera was then.
+        bool ReprojectedOcclusionCulling = true;
+        // Cull entities on the CPU against occluders like the terrain,
+        // drawn into a small depth buffer from this frame's view.
+        bool SoftwareOcclusionCulling = true;
+
     private:
-        std::set<entt::entity> m_prepassedEntities;
+        // Rebuilds the spatial index when drawables are added or
+        // removed, and refits it around anything that moved.
+        void UpdateSpatialIndex();
+        void BuildSpatialIndex();
+        // Gathers the bounds of the terrain and water, which
+        // are drawn without being put in the trees.
+        void UpdateUnindexedReceivers();
+        bool IsStatic(entt::entity entity) const;
+        enum class Mobility
+        {
+            Any,
+            Static,
+            // Unbounded entities count as moving, since 
+            // there's no telling when they change.
+            Dynamic
+        };
+
+        // Fills ids with the draw order positions of what might be
+        // in the volume, sorted, including everything unbounded.
+        // Given a job system, the trees are searched across it.
+        void QueryDrawOrder(const std::array<DirectX::XMFLOAT4, 6>& planes,
+            std::vector<uint32_t>& ids,
+            Mobility mobility = Mobility::Any,
+            Jobs::JobSystem* jobSystem = nullptr);
+        void QueryDrawOrder(const DirectX::BoundingSphere& sphere,
+            std::vector<uint32_t>& ids,
+            Mobility mobility = Mobility::Any);
+        void GetEntities(const std::vector<uint32_t>& ids,
+            std::vector<entt::entity>& entities) const;
+        // Fills visibleEntities in the order they're drawn in.
+        void CullEntities(const std::array<DirectX::XMFLOAT4, 6>& planes,
+            std::vector<entt::entity>& visibleEntities);
+        // Keeps the ids that aren't behind the read back depth pyramid or
+        // the software occluders, whichever are switched on, along with
+        // everything unbounded, in the same order.
+        void CullOccluded(const std::vector<uint32_t>& ids,
+            std::vector<uint32_t>& unoccludedIds) const;
+
+        void DrawDirectionalShadows(ID3D12GraphicsCommandList6* cl);
+        void DrawPointLightShadows(ID3D12GraphicsCommandList6* cl,
+            const DirectX::BoundingFrustum& cameraFrustum);
+        // Draws the casters in ids that intersect a shadow cube face
+        void DrawCubeFace(ID3D12GraphicsCommandList6* cl,
+            const std::vector<uint32_t>& ids,
+            const DirectX::SimpleMath::Vector3& lightPosition,
+            const DirectX::SimpleMath::Matrix& view,
+            const DirectX::SimpleMath::Matrix& proj,
+            const DirectX::SimpleMath::Vector3& lookDir,
+            bool drawTerrain);
+        void InvalidateShadowCaches(const DirectX::BoundingBox& bounds);
+        void InvalidateShadowCaches();
+
+        // Returns a mask of the shadow cube faces that
+        // can see something the camera can see too.
+        uint32_t GetVisibleCubeFaces(const DirectX::BoundingSphere& lightRange,
+            float nearPlane,
+            const DirectX::BoundingFrustum& cameraFrustum);
+        DrawType GetDrawType(PassType passType, entt::entity entity);
+        // Fills the render queue with a keyed draw for each entity 
+        // that DrawAllEntities draws in this pass.
+        void BuildRenderQueue(PassType passType,
+            const std::vector<entt::entity>& visibleEntities,
+            bool drawTerrain);
+
+        // The pipelines a thread recording draws sets per-draw state on
+        struct PipelineSet
+        {
+            Pipelines::PBRPipeline* Pbr;
+            Pipelines::InstancedPBRPipeline* Instanced;
+            Pipelines::BillboardPipeline* Billboard;
+            Pipelines::HeightmapPipeline* Heightmap;
+            Pipelines::WaterPipeline* Water;
+        };
+        // Copies of the pipelines for one chunk of a parallel pass
+        struct ChunkPipelines
+        {
+            std::optional<Pipelines::PBRPipeline> Pbr;
+            std::optional<Pipelines::InstancedPBRPipeline> Instanced;
+            std::optional<Pipelines::BillboardPipeline> Billboard;
+            std::optional<Pipelines::HeightmapPipeline> Heightmap;
+            std::optional<Pipelines::WaterPipeline> Water;
+        };
+
+        PipelineSet GetPipelines() const;
+        // Copies the pipelines as they've been set up for this pass
+        PipelineSet CopyPipelines(ChunkPipelines& chunkPipelines) const;
+        std::array<ID3D12DescriptorHeap*, 2> GetDescriptorHeaps() const;
+
+        // Sets the frustum that the next pass is culled against,
+        // past the culling it's already had on the CPU.
+        void SetCullingPlanes(const std::array<DirectX::XMFLOAT4, 6>& planes);
+        // Picks levels of detail for the queued instanced draws that have
+        // clusters, and uploads the instances of each level for the pass.
+        void SelectInstanceLods(PassType passType);
+        // Queues the instance culling for the queued instanced draws
+        void CullInstances(PassType passType);
+        void DrawQueuedEntity(ID3D12GraphicsCommandList6* cl,
+            size_t itemIndex,
+            const PipelineSet& pipelines);
+
+        // Indexed by entity, and cleared at the start of each Z-prepass
+        GenerationalSet m_prepassedEntities;
+
+        struct IndexedEntity
+        {
+            bool IsStatic;
+            uint32_t BuildIndex;
+            uint32_t DrawOrderIndex;
+        };
+
+        // Everything that can be culled, in the order it's drawn in. 
+        // The trees use indices into this as item IDs.
+        std::vector<entt::entity> m_drawOrder;
+        std::vector<std::optional<DirectX::BoundingBox>> m_drawOrderBounds;
+        std::unordered_map<entt::entity, IndexedEntity> m_indexedEntities;
+        std::vector<uint32_t> m_unboundedIds;
+        uint64_t m_spatialIndexVersion = 0;
+        bool m_spatialIndexBuilt = false;
+
+        // Scenery that isn't simulated is kept apart from what is, so
+        // it's only rebuilt if something changes by hand.
+        std::vector<BoundingVolumeHierarchy::Item> m_staticItems;
+        BoundingVolumeHierarchy m_staticTree;
+        BoundingVolumeHierarchy m_dynamicTree;
+
+        // Set if there's anything drawn without bounds,
+        // which is assumed to cover the whole view.
+        bool m_hasUnboundedReceivers = false;
+        std::vector<DirectX::BoundingBox> m_unindexedReceivers;
+
+        std::vector<uint32_t> m_visibleIds;
+        std::vector<uint32_t> m_cameraVisibleIds;
+        // The camera visible ids that aren't occluded. Shadows and the
+        // point light faces still go by everything in the frustum.
+        std::vector<uint32_t> m_cameraUnoccludedIds;
+        std::vector<uint32_t> m_pointLightCasterIds;
+        std::vector<uint32_t> m_pointLightStaticCasterIds;
+        std::vector<DirectX::BoundingBox> m_pointLightReceivers;
+
+        // One slot for the sun, and one per point light cube face
+        ShadowCacheTracker m_directionalShadowCache;
+        ShadowCacheTracker m_pointShadowCache;
+        bool m_cachingStaticShadows = false;
+        std::vector<entt::entity> m_shadowVisibleEntities;
+        std::vector<entt::entity> m_cameraVisibleEntities;
+
+        RenderQueue m_renderQueue;
+        InstanceBatcher m_instanceBatcher;
+        // Instance data for the batches in the pass being drawn
+        D3D12_GPU_VIRTUAL_ADDRESS m_batchedInstanceBuffer = 0;
+        // Draws in the queue are sorted by their distance from this
+        DirectX::SimpleMath::Vector3 m_sortOrigin;
+
+        std::unique_ptr<BundlePool> m_bundlePool;
+        ParallelRecorder m_recorder{ 128 };
+        std::vector<std::unique_ptr<ChunkPipelines>> m_chunkPipelines;
+
+        std::unique_ptr<InstanceCuller> m_instanceCuller;
+        std::unique_ptr<DepthPyramid> m_depthPyramid;
+        std::unique_ptr<SoftwareOcclusionCuller> m_softwareOcclusion;
+        std::vector<SoftwareOcclusionCuller::Occluder> m_occluders;
+        std::array<DirectX::XMFLOAT4, 6> m_cullingPlanes;
+        // Indexed like the render queue, and set for the draws culled on the GPU
+        std::vector<std::optional<InstanceCuller::CulledDraw>> m_culledDraws;
+
+        struct LodDraw
+        {
+            uint32_t Lod;
+            // Into m_lodInstanceBuffer
+            uint32_t FirstInstance;
+            uint32_t InstanceCount;
+        };
+
+        struct LodDrawRange
+        {
+            uint32_t FirstDraw;
+            uint32_t NumDraws;
+        };
+
+        InstanceLodSelector m_lodSelector;
+        // Levels are picked for the main camera in every pass,
+        // so shadows don't change detail from the things casting them.
+        InstanceLodSelector::View m_lodView;
+        std::vector<LodDraw> m_lodDraws;
+        std::vector<uint32_t> m_lodInstances;
+        D3D12_GPU_VIRTUAL_ADDRESS m_lodInstanceBuffer = 0;
+        // Indexed like the render queue, and set for the draws split by level
+        std::vector<std::optional<LodDrawRange>> m_lodDrawRanges;
 
 
     };
@@ -0,0 +1,77 @@
+#include "pch.h"
+
+#include "Core/Rendering/ShadowCacheTracker.h"
+#include "Core/SceneCache.h"
+
+namespace Gradient::Rendering
+{
+    uint64_t ShadowCacheTracker::MakeKey(const DirectX::SimpleMath::Matrix& view,
+        const DirectX::SimpleMath::Matrix& projection)
+    {
+        // Any change at all redraws the cache, since 
+        // even a tiny one would shift the texels.
+        Fnv1a hash;
+        hash.Add(view);
+        hash.Add(projection);
+        return hash.Get();
+    }
+
+    void ShadowCacheTracker::Resize(size_t numSlots)
+    {
+        m_slots.resize(numSlots);
+    }
+
+    size_t ShadowCacheTracker::Size() const
+    {
+        return m_slots.size();
+    }
+
+    bool ShadowCacheTracker::Update(size_t slot, const LightState& state)
+    {
+        auto& current = m_slots[slot];
+
+        if (current.Valid && current.Key == state.Key)
+            return false;
+
+        current.Valid = true;
+        current.Key = state.Key;
+        current.Volume = state.Volume;
+        m_numRedraws++;
+
+        return true;
+    }
+
+    bool ShadowCacheTracker::IsValid(size_t slot) const
+    {
+        return m_slots[slot].Valid;
+    }
+
+    void ShadowCacheTracker::InvalidateIntersecting(const DirectX::BoundingBox& bounds)
+    {
+        for (auto& slot : m_slots)
+        {
+            if (slot.Valid && slot.Volume.Intersects(bounds))
+            {
+                slot.Valid = false;
+            }
+        }
+    }
+
+    void ShadowCacheTracker::Invalidate(size_t slot)
+    {
+        m_slots[slot].Valid = false;
+    }
+
+    void ShadowCacheTracker::InvalidateAll()
+    {
+        for (auto& slot : m_slots)
+        {
+            slot.Valid = false;
+        }
+    }
+
+    uint64_t ShadowCacheTracker::GetNumRedraws() const
+    {
+        return m_numRedraws;
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "pch.h"
+
+#include <directxtk12/SimpleMath.h>
+#include <vector>
+
+namespace Gradient::Rendering
+{
+    // Tracks whether cached shadow maps of static casters are still 
+    // up to date. Each slot is one shadow map, or one face of a 
+    // shadow cube. Nothing here touches the GPU.
+    class ShadowCacheTracker
+    {
+    public:
+        struct LightState
+        {
+            // Changes whenever the shadow map is drawn from 
+            // somewhere else, as made by MakeKey.
+            uint64_t Key;
+            // Everything the shadow map can see
+            DirectX::BoundingOrientedBox Volume;
+        };
+
+        static uint64_t MakeKey(const DirectX::SimpleMath::Matrix& view,
+            const DirectX::SimpleMath::Matrix& projection);
+
+        void Resize(size_t numSlots);
+        size_t Size() const;
+
+        // Returns true if the slot's static casters need to be 
+        // redrawn, and assumes that they will be. Slots start 
+        // out needing to be drawn.
+        bool Update(size_t slot, const LightState& state);
+        bool IsValid(size_t slot) const;
+
+        // Call with the bounds of a static caster that was added,
+        // removed or moved, before and after it moved.
+        void InvalidateIntersecting(const DirectX::BoundingBox& bounds);
+        void Invalidate(size_t slot);
+        void InvalidateAll();
+
+        // The number of times Update has asked for a redraw
+        uint64_t GetNumRedraws() const;
+
+    private:
+        struct Slot
+        {
+            bool Valid = false;
+            uint64_t Key = 0;
+            DirectX::BoundingOrientedBox Volume;
+        };
+
+        std::vector<Slot> m_slots;
+        uint64_t m_numRedraws = 0;
+    };
+}
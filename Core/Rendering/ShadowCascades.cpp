@@ -0,0 +1,110 @@
+#include "pch.h"
+
+#include "Core/Rendering/ShadowCascades.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Gradient::Rendering::ShadowCascades
+{
+    using namespace DirectX::SimpleMath;
+
+    std::vector<float> ComputeSplitDistances(float nearPlane,
+        float farPlane,
+        uint32_t numCascades,
+        float lambda)
+    {
+        std::vector<float> splits(numCascades + 1);
+
+        for (uint32_t i = 0; i <= numCascades; i++)
+        {
+            float fraction = static_cast<float>(i) / numCascades;
+            float logSplit = nearPlane * std::pow(farPlane / nearPlane, fraction);
+            float uniformSplit = nearPlane + (farPlane - nearPlane) * fraction;
+
+            splits[i] = lambda * logSplit + (1.f - lambda) * uniformSplit;
+        }
+
+        // Exactly, so that consecutive slices line up
+        splits.front() = nearPlane;
+        splits.back() = farPlane;
+
+        return splits;
+    }
+
+    DirectX::BoundingFrustum GetSlice(const DirectX::BoundingFrustum& frustum,
+        float nearDistance,
+        float farDistance)
+    {
+        auto slice = frustum;
+        if (frustum.Far < 0.f)
+        {
+            slice.Near = -farDistance;
+            slice.Far = -nearDistance;
+        }
+        else
+        {
+            slice.Near = nearDistance;
+            slice.Far = farDistance;
+        }
+        return slice;
+    }
+
+    Cascade FitCascade(const DirectX::BoundingFrustum& slice,
+        const Matrix& lightView,
+        float nearPlane,
+        uint32_t resolution)
+    {
+        Vector3 corners[DirectX::BoundingFrustum::CORNER_COUNT];
+        slice.GetCorners(corners);
+
+        Vector3 centre = Vector3::Zero;
+        for (const auto& corner : corners)
+        {
+            centre += corner;
+        }
+        centre /= static_cast<float>(std::size(corners));
+
+        float radius = 0.f;
+        for (const auto& corner : corners)
+        {
+            radius = std::max(radius, Vector3::Distance(centre, corner));
+        }
+
+        // The radius only depends on the slice's shape, but
+        // rounding it keeps float noise from resizing the texels.
+        radius = std::ceil(radius * 16.f) / 16.f;
+
+        auto lightSpaceCentre = Vector3::Transform(centre, lightView);
+
+        // Snapping moves the centre by up to a texel, so leave 
+        // a texel of room on each side.
+        float texelSize = 2.f * radius / (resolution - 2);
+        float halfWidth = radius + texelSize;
+        lightSpaceCentre.x = std::floor(lightSpaceCentre.x / texelSize) * texelSize;
+        lightSpaceCentre.y = std::floor(lightSpaceCentre.y / texelSize) * texelSize;
+
+        // The light looks down -Z. The far plane is moved in large 
+        // steps too, since changing it changes every depth in the map.
+        float farPlane = std::ceil((-lightSpaceCentre.z + radius) / halfWidth) * halfWidth;
+        farPlane = std::max(farPlane, nearPlane + halfWidth);
+
+        Cascade out;
+        out.Projection = Matrix::CreateOrthographicOffCenter(
+            lightSpaceCentre.x - halfWidth,
+            lightSpaceCentre.x + halfWidth,
+            lightSpaceCentre.y - halfWidth,
+            lightSpaceCentre.y + halfWidth,
+            nearPlane,
+            farPlane);
+
+        DirectX::BoundingOrientedBox lightSpaceBounds(
+            Vector3(lightSpaceCentre.x, lightSpaceCentre.y, -0.5f * (nearPlane + farPlane)),
+            Vector3(halfWidth, halfWidth, 0.5f * (farPlane - nearPlane)),
+            Quaternion::Identity);
+
+        lightSpaceBounds.Transform(out.Bounds, lightView.Invert());
+
+        return out;
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "pch.h"
+
+#include <directxtk12/SimpleMath.h>
+#include <vector>
+
+namespace Gradient::Rendering::ShadowCascades
+{
+    // Returns numCascades + 1 distances from nearPlane to farPlane.
+    // lambda blends between evenly spaced splits at 0 and
+    // logarithmic splits at 1.
+    std::vector<float> ComputeSplitDistances(float nearPlane,
+        float farPlane,
+        uint32_t numCascades,
+        float lambda);
+
+    // The part of the frustum between two positive distances along its 
+    // view direction. Frustums made from right-handed projections, 
+    // like Math::MakeFrustum's, have negative Near and Far planes.
+    DirectX::BoundingFrustum GetSlice(const DirectX::BoundingFrustum& frustum,
+        float nearDistance,
+        float farDistance);
+
+    struct Cascade
+    {
+        DirectX::SimpleMath::Matrix Projection;
+        // The world space volume to cull casters against. It reaches 
+        // back to the near plane, since casters between the light and
+        // the slice can still cast shadows into it.
+        DirectX::BoundingOrientedBox Bounds;
+    };
+
+    // Fits an orthographic projection around a frustum slice, as seen
+    // by a light with the given view matrix. The projection covers a 
+    // sphere around the slice, so it's the same size however the 
+    // camera turns, and it's moved in whole texels so that shadow 
+    // edges don't shimmer as the camera moves.
+    Cascade FitCascade(const DirectX::BoundingFrustum& slice,
+        const DirectX::SimpleMath::Matrix& lightView,
+        float nearPlane,
+        uint32_t resolution);
+}
@@ -0,0 +1,55 @@
+#include "pch.h"
+
+#include "Core/Rendering/SoftwareOcclusionCuller.h"
+#include "Core/Jobs/JobSystem.h"
+
+namespace Gradient::Rendering
+{
+    SoftwareOcclusionCuller::SoftwareOcclusionCuller()
+        : m_rasterizer(Width, Height)
+    {
+    }
+
+    void SoftwareOcclusionCuller::Render(std::span<const Occluder> occluders,
+        const DirectX::SimpleMath::Matrix& viewProj)
+    {
+        m_rasterizer.Clear();
+
+        // Setting up is cheap next to drawing, so it's done here
+        for (const auto& occluder : occluders)
+        {
+            m_rasterizer.AddTriangles(occluder.Mesh->Positions,
+                occluder.Mesh->Indices,
+                occluder.World * viewProj);
+        }
+
+        Jobs::JobSystem::Get()->ParallelFor(m_rasterizer.GetBandCount(), 1,
+            [this](size_t begin, size_t end)
+            {
+                for (size_t band = begin; band < end; band++)
+                {
+                    m_rasterizer.DrawBand(static_cast<uint32_t>(band));
+                }
+            },
+            Jobs::JobPriority::High);
+
+        m_rasterizer.ClearTriangles();
+
+        HiZ::Build(m_rasterizer.GetDepths(), Width, Height, viewProj, m_pyramid);
+    }
+
+    bool SoftwareOcclusionCuller::IsOccluded(const DirectX::BoundingBox& bounds) const
+    {
+        return HiZ::IsOccluded(m_pyramid, bounds.Center, bounds.Extents);
+    }
+
+    const DepthRasterizer& SoftwareOcclusionCuller::GetRasterizer() const
+    {
+        return m_rasterizer;
+    }
+
+    const HiZ::Pyramid& SoftwareOcclusionCuller::GetPyramid() const
+    {
+        return m_pyramid;
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "pch.h"
+
+#include "Core/Rendering/DepthRasterizer.h"
+#include "Core/Rendering/HiZ.h"
+
+#include <directxtk12/SimpleMath.h>
+#include <span>
+
+namespace Gradient::Rendering
+{
+    // Draws the big static occluders, like the terrain, into a small
+    // depth buffer on the CPU every frame, and tests bounds against a
+    // pyramid of it. Unlike the pyramid read back from the GPU, it's
+    // drawn from this frame's view, so nothing pops in when the camera
+    // moves, but it only knows about the occluders it's given.
+    class SoftwareOcclusionCuller
+    {
+    public:
+        static constexpr uint32_t Width = 320;
+        static constexpr uint32_t Height = 180;
+
+        struct Occluder
+        {
+            const DepthRasterizer::OccluderMesh* Mesh;
+            DirectX::SimpleMath::Matrix World;
+        };
+
+        SoftwareOcclusionCuller();
+
+        // The bands of the depth buffer are drawn across the job system
+        void Render(std::span<const Occluder> occluders,
+            const DirectX::SimpleMath::Matrix& viewProj);
+
+        // Always false until the first Render
+        bool IsOccluded(const DirectX::BoundingBox& bounds) const;
+
+        const DepthRasterizer& GetRasterizer() const;
+        const HiZ::Pyramid& GetPyramid() const;
+
+    private:
+        DepthRasterizer m_rasterizer;
+        HiZ::Pyramid m_pyramid;
+    };
+}
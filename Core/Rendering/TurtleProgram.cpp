@@ -0,0 +1,453 @@
+#include "pch.h"
+
+#include "Core/Rendering/TurtleProgram.h"
+
+using namespace DirectX;
+
+namespace Gradient::Rendering
+{
+    // Builds a TurtleProgram from an L-system, compiling each
+    // (symbol, remaining generations) subtree into a block only once.
+    class TurtleCompiler
+    {
+    public:
+        TurtleCompiler(const LSystem& lsystem, int numGenerations)
+            : m_lsystem(lsystem),
+            m_blockIndices(256 * (numGenerations + 1), NotCompiled)
+        {
+        }
+
+        TurtleProgram Compile(const std::string& startingRule, int numGenerations)
+        {
+            auto root = CompileBlock(startingRule, numGenerations);
+            m_program.m_blocks.push_back(std::move(root));
+
+            for (const auto& block : m_program.m_blocks)
+            {
+                for (const auto& instruction : block.Instructions)
+                {
+                    if (instruction.Op == TurtleProgram::OpCode::Call) continue;
+
+                    m_program.m_maxCount = std::max(m_program.m_maxCount,
+                        std::abs(static_cast<int>(instruction.Count)));
+                }
+            }
+
+            return std::move(m_program);
+        }
+
+    private:
+        static constexpr int NotCompiled = -1;
+        static constexpr int EmptyBlock = -2;
+
+        // Blocks this small are copied into their callers instead of called
+        static constexpr size_t MaxInlinedInstructions = 2;
+
+        // Compiles a rule where each symbol has remainingGenerations left to expand
+        TurtleProgram::Block CompileBlock(const std::string& rule, int remainingGenerations)
+        {
+            TurtleProgram::Block block;
+
+            for (char c : rule)
+            {
+                if (remainingGenerations == 0 || !m_lsystem.GetRule(c))
+                {
+                    EmitSymbol(block, c);
+                    continue;
+                }
+
+                auto index = GetBlockIndex(c, remainingGenerations);
+                if (index == EmptyBlock) continue;
+
+                const auto& callee = m_program.m_blocks[index];
+                if (callee.Instructions.size() <= MaxInlinedInstructions)
+                {
+                    for (const auto& instruction : callee.Instructions)
+                    {
+                        Emit(block, instruction);
+                    }
+                }
+                else
+                {
+                    Emit(block, { TurtleProgram::OpCode::Call, static_cast<int16_t>(index) });
+                }
+            }
+
+            UpdateTotals(block);
+            return block;
+        }
+
+        int GetBlockIndex(char symbol, int remainingGenerations)
+        {
+            auto key = remainingGenerations * 256 + static_cast<unsigned char>(symbol);
+
+            if (m_blockIndices[key] == NotCompiled)
+            {
+                auto block = CompileBlock(*m_lsystem.GetRule(symbol), remainingGenerations - 1);
+
+                if (block.Instructions.empty())
+                {
+                    m_blockIndices[key] = EmptyBlock;
+                }
+                else
+                {
+                    assert(m_program.m_blocks.size() <= UINT16_MAX);
+                    m_blockIndices[key] = static_cast<int>(m_program.m_blocks.size());
+                    m_program.m_blocks.push_back(std::move(block));
+                }
+            }
+
+            return m_blockIndices[key];
+        }
+
+        void EmitSymbol(TurtleProgram::Block& block, char c)
+        {
+            using OpCode = TurtleProgram::OpCode;
+
+            switch (c)
+            {
+            case 'F':
+                Emit(block, { OpCode::Move, 0 });
+                break;
+            case 'L':
+                Emit(block, { OpCode::Leaf, 0 });
+                break;
+            case '[':
+                Emit(block, { OpCode::Push, 0 });
+                break;
+            case ']':
+                Emit(block, { OpCode::Pop, 0 });
+                break;
+            case '+':
+                Emit(block, { OpCode::Yaw, 1 });
+                break;
+            case '-':
+                Emit(block, { OpCode::Yaw, -1 });
+                break;
+            case '/':
+                Emit(block, { OpCode::Roll, 1 });
+                break;
+            case '\\':
+                Emit(block, { OpCode::Roll, -1 });
+                break;
+            case '^':
+                Emit(block, { OpCode::Pitch, 1 });
+                break;
+            case '&':
+                Emit(block, { OpCode::Pitch, -1 });
+                break;
+            default:
+                // Not a turtle command
+                break;
+            }
+        }
+
+        // Appends an instruction, folding it into the previous one if possible
+        void Emit(TurtleProgram::Block& block, TurtleProgram::Instruction instruction)
+        {
+            using OpCode = TurtleProgram::OpCode;
+
+            auto& instructions = block.Instructions;
+            auto op = instruction.Op;
+
+            bool isRotation = op == OpCode::Yaw || op == OpCode::Roll || op == OpCode::Pitch;
+
+            if (isRotation && !instructions.empty() && instructions.back().Op == op)
+            {
+                auto& last = instructions.back();
+
+                // Pitches can only be folded with pitches in the
+                // same direction, as they're applied one at a time.
+                bool canFold = op != OpCode::Pitch
+                    || (last.Count > 0) == (instruction.Count > 0);
+
+                int count = last.Count + instruction.Count;
+
+                if (canFold && std::abs(count) <= INT16_MAX)
+                {
+                    last.Count = static_cast<int16_t>(count);
+
+                    // Opposite yaws or rolls cancel out exactly,
+                    // as the axis doesn't change between them.
+                    if (last.Count == 0)
+                    {
+                        instructions.pop_back();
+                    }
+                    return;
+                }
+            }
+
+            instructions.push_back(instruction);
+        }
+
+        void UpdateTotals(TurtleProgram::Block& block)
+        {
+            using OpCode = TurtleProgram::OpCode;
+
+            int depth = 0;
+
+            for (const auto& instruction : block.Instructions)
+            {
+                switch (instruction.Op)
+                {
+                case OpCode::Call:
+                {
+                    const auto& callee = m_program.m_blocks[static_cast<uint16_t>(instruction.Count)];
+                    block.NumExecutedInstructions += callee.NumExecutedInstructions;
+                    block.NumSegments += callee.NumSegments;
+                    block.NumLeaves += callee.NumLeaves;
+                    block.MaxDepth = std::max(block.MaxDepth, depth + callee.MaxDepth);
+                    block.MaxCallDepth = std::max(block.MaxCallDepth, callee.MaxCallDepth + 1);
+                    depth += callee.EndDepth;
+                    continue;
+                }
+                case OpCode::Move:
+                    block.NumSegments++;
+                    break;
+                case OpCode::Leaf:
+                    block.NumLeaves++;
+                    break;
+                case OpCode::Push:
+                    depth++;
+                    block.MaxDepth = std::max(block.MaxDepth, depth);
+                    break;
+                case OpCode::Pop:
+                    depth--;
+                    break;
+                default:
+                    break;
+                }
+
+                block.NumExecutedInstructions++;
+            }
+
+            block.EndDepth = depth;
+        }
+
+        const LSystem& m_lsystem;
+        TurtleProgram m_program;
+
+        // Indexed by remaining generations and symbol
+        std::vector<int> m_blockIndices;
+    };
+
+    namespace
+    {
+        // Same as SimpleMath::Quaternion::Concatenate
+        inline XMVECTOR XM_CALLCONV Concatenate(FXMVECTOR q1, FXMVECTOR q2)
+        {
+            return XMQuaternionMultiply(q2, q1);
+        }
+
+        // Same as XMQuaternionRotationAxis, but with the sine and cosine
+        // of the half angle already computed.
+        inline XMVECTOR XM_CALLCONV RotationFromSinCos(FXMVECTOR axis, float sinHalfAngle, float cosHalfAngle)
+        {
+            XMVECTOR normal = XMVector3Normalize(axis);
+            return XMVectorSelect(XMVectorReplicate(cosHalfAngle),
+                XMVectorScale(normal, sinHalfAngle),
+                g_XMSelect1110);
+        }
+    }
+
+    TurtleProgram TurtleProgram::Compile(const LSystem& lsystem,
+        const std::string& startingRule,
+        int numGenerations)
+    {
+        TurtleCompiler compiler(lsystem, numGenerations);
+        return compiler.Compile(startingRule, numGenerations);
+    }
+
+    void TurtleProgram::Execute(const LSystem& lsystem,
+        std::vector<PartParameters>& segments,
+        std::vector<LSystem::LeafTransform>& leaves) const
+    {
+        // The half angle sine and cosine for every step count used by the program
+        std::vector<XMFLOAT2> stepSinCos(2 * m_maxCount + 1);
+        for (int i = -m_maxCount; i <= m_maxCount; i++)
+        {
+            float halfAngle = 0.5f * XMConvertToRadians(i * lsystem.AngleDegrees);
+            XMScalarSinCos(&stepSinCos[i + m_maxCount].x,
+                &stepSinCos[i + m_maxCount].y,
+                halfAngle);
+        }
+
+        auto stepRotation = [&stepSinCos, this](FXMVECTOR axis, int count)
+            {
+                const auto& sinCos = stepSinCos[count + m_maxCount];
+                return RotationFromSinCos(axis, sinCos.x, sinCos.y);
+            };
+
+        struct StackEntry
+        {
+            XMVECTOR Location;
+            XMVECTOR ForwardRotation;
+            XMVECTOR UpRotation;
+            float Radius;
+            int64_t LastSegment;
+        };
+
+        struct CallFrame
+        {
+            const Instruction* Current;
+            const Instruction* End;
+        };
+
+        const auto& root = m_blocks.back();
+
+        std::vector<StackEntry> branchStack(root.MaxDepth);
+        size_t stackTop = 0;
+
+        std::vector<CallFrame> callStack;
+        callStack.reserve(root.MaxCallDepth + 1);
+
+        segments.reserve(segments.size() + root.NumSegments);
+        leaves.reserve(leaves.size() + root.NumLeaves);
+
+        XMVECTOR location = XMVectorZero();
+        XMVECTOR forwardRotation = XMQuaternionIdentity();
+        XMVECTOR upRotation = XMQuaternionIdentity();
+        float radius = lsystem.StartingRadius;
+        // The last segment on the current branch, if there is one
+        int64_t lastSegment = -1;
+
+        const XMVECTOR moveDistance = XMVectorReplicate(lsystem.MoveDistance);
+
+        // Updates the top of the last segment on a branch, so it
+        // joins up with whatever comes next
+        auto updateLastTop = [&segments](int64_t segmentIndex, FXMVECTOR rotation)
+            {
+                if (segmentIndex < 0) return;
+
+                auto& last = segments[segmentIndex];
+                XMVECTOR inverseRotation = XMQuaternionConjugate(
+                    XMLoadFloat4(&last.BottomRotation));
+
+                XMStoreFloat4(&last.TopRelativeRotation,
+                    Concatenate(inverseRotation, rotation));
+            };
+
+        callStack.push_back({ root.Instructions.data(),
+            root.Instructions.data() + root.Instructions.size() });
+
+        while (!callStack.empty())
+        {
+            auto& frame = callStack.back();
+            if (frame.Current == frame.End)
+            {
+                callStack.pop_back();
+                continue;
+            }
+
+            const auto& instruction = *frame.Current++;
+
+            switch (instruction.Op)
+            {
+            case OpCode::Call:
+            {
+                const auto& block = m_blocks[static_cast<uint16_t>(instruction.Count)];
+                callStack.push_back({ block.Instructions.data(),
+                    block.Instructions.data() + block.Instructions.size() });
+                break;
+            }
+            case OpCode::Move:
+            {
+                updateLastTop(lastSegment, forwardRotation);
+                lastSegment = segments.size();
+
+                auto& segment = segments.emplace_back();
+                XMStoreFloat3(&segment.BottomTranslation, location);
+                XMStoreFloat4(&segment.BottomRotation, forwardRotation);
+                segment.BottomRadius = radius;
+                segment.TopRadius = radius;
+                // Relative to the bottom, the turtle always moves straight along Y.
+                segment.TopRelativeTranslation = { 0, lsystem.MoveDistance, 0 };
+                segment.TopRelativeRotation = DirectX::SimpleMath::Quaternion::Identity;
+
+                XMVECTOR forward = XMVector3Rotate(g_XMIdentityR1, forwardRotation);
+                location = XMVectorMultiplyAdd(moveDistance, forward, location);
+                break;
+            }
+            case OpCode::Leaf:
+            {
+                LSystem::LeafTransform leaf;
+                XMStoreFloat3(&leaf.Translation, location);
+                XMStoreFloat4(&leaf.Rotation, forwardRotation);
+                leaves.push_back(leaf);
+                break;
+            }
+            case OpCode::Push:
+                branchStack[stackTop++] = { location, forwardRotation, upRotation, radius, lastSegment };
+                radius *= lsystem.RadiusFactor;
+                lastSegment = -1;
+                break;
+            case OpCode::Pop:
+            {
+                const auto& entry = branchStack[--stackTop];
+                location = entry.Location;
+                forwardRotation = entry.ForwardRotation;
+                upRotation = entry.UpRotation;
+                radius = entry.Radius;
+                lastSegment = entry.LastSegment;
+                break;
+            }
+            case OpCode::Yaw:
+            {
+                XMVECTOR up = XMVector3Rotate(g_XMIdentityR2, upRotation);
+                forwardRotation = Concatenate(forwardRotation,
+                    stepRotation(up, instruction.Count));
+                break;
+            }
+            case OpCode::Roll:
+            {
+                XMVECTOR forward = XMVector3Rotate(g_XMIdentityR1, forwardRotation);
+                upRotation = Concatenate(upRotation,
+                    stepRotation(forward, instruction.Count));
+                break;
+            }
+            case OpCode::Pitch:
+            {
+                int step = instruction.Count > 0 ? 1 : -1;
+                for (int i = 0; i < std::abs(instruction.Count); i++)
+                {
+                    XMVECTOR forward = XMVector3Rotate(g_XMIdentityR1, forwardRotation);
+                    XMVECTOR up = XMVector3Rotate(g_XMIdentityR2, upRotation);
+                    XMVECTOR pitch = stepRotation(XMVector3Cross(forward, up), step);
+
+                    forwardRotation = Concatenate(forwardRotation, pitch);
+                    upRotation = Concatenate(upRotation, pitch);
+                }
+                break;
+            }
+            }
+        }
+
+        updateLastTop(lastSegment, forwardRotation);
+    }
+
+    size_t TurtleProgram::GetBlockCount() const
+    {
+        return m_blocks.size();
+    }
+
+    size_t TurtleProgram::GetInstructionCount() const
+    {
+        size_t count = 0;
+        for (const auto& block : m_blocks)
+        {
+            count += block.Instructions.size();
+        }
+        return count;
+    }
+
+    uint64_t TurtleProgram::GetExecutedInstructionCount() const
+    {
+        return m_blocks.back().NumExecutedInstructions;
+    }
+
+    size_t TurtleProgram::GetSizeInBytes() const
+    {
+        return GetInstructionCount() * sizeof(Instruction)
+            + m_blocks.size() * sizeof(Block);
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "pch.h"
+
+#include "Core/Rendering/LSystem.h"
+#include <directxtk12/SimpleMath.h>
+
+namespace Gradient::Rendering
+{
+    // A single frustum of an L-system's trunk
+    using PartParameters = ProceduralMesh::AngledFrustumParameters;
+
+    // An L-system rule compiled into opcodes for the turtle.
+    // Symbols the turtle doesn't understand are dropped, and runs of
+    // the same rotation are folded into a single instruction.
+    //
+    // Every (symbol, remaining generations) pair expands to the same
+    // symbols wherever it appears, so each one is compiled once into a
+    // block, and later occurrences become a Call to that block. Compiling
+    // and storing the program is linear in the number of unique subtrees
+    // rather than in the length of the expanded rule.
+    class TurtleProgram
+    {
+    public:
+        enum class OpCode : uint8_t
+        {
+            Move,
+            Leaf,
+            Push,
+            Pop,
+            Yaw,
+            Roll,
+            Pitch,
+            Call
+        };
+
+        struct Instruction
+        {
+            OpCode Op;
+            // The signed number of angle steps for rotations.
+            // Yaws and rolls about the same axis are summed into one
+            // rotation, while pitches are still applied one step at a time,
+            // since each pitch changes the axis of the next.
+            // For Call, the index of the block to run, as a uint16_t.
+            int16_t Count;
+        };
+
+        static TurtleProgram Compile(const LSystem& lsystem,
+            const std::string& startingRule,
+            int numGenerations);
+
+        // Runs the program, writing out the trunk segments
+        // and appending the leaves.
+        void Execute(const LSystem& lsystem,
+            std::vector<PartParameters>& segments,
+            std::vector<LSystem::LeafTransform>& leaves) const;
+
+        size_t GetBlockCount() const;
+        // The number of instructions stored across all blocks
+        size_t GetInstructionCount() const;
+        // The number of instructions that Execute runs, with calls expanded
+        uint64_t GetExecutedInstructionCount() const;
+        size_t GetSizeInBytes() const;
+
+    private:
+        friend class TurtleCompiler;
+
+        struct Block
+        {
+            std::vector<Instruction> Instructions;
+
+            // Totals for this block with its calls expanded
+            uint64_t NumExecutedInstructions = 0;
+            uint64_t NumSegments = 0;
+            uint64_t NumLeaves = 0;
+            // The deepest the branch stack goes, and the
+            // depth it's left at, relative to the start.
+            int MaxDepth = 0;
+            int EndDepth = 0;
+            int MaxCallDepth = 0;
+        };
+
+        // The starting rule is always the last block,
+        // as it's finished after everything it calls.
+        std::vector<Block> m_blocks;
+        int m_maxCount = 1;
+    };
+}
@@ -1,6 +1,7 @@
 #include "pch.h"
 
 #include "Core/RootSignature.h"
+#include "Core/RenderStateCache.h"
 
 namespace Gradient
 {
@@ -21,6 +22,14 @@ namespace Gradient
                 slot = UINT_MAX;
             }
         }
+
+        for (auto& space : m_uavSpaceToSlotToRPIndex)
+        {
+            for (auto& slot : space)
+            {
+                slot = UINT_MAX;
+            }
+        }
     }
 
     ID3D12RootSignature* RootSignature::Get()
@@ -85,6 +94,19 @@ namespace Gradient
         m_srvSpaceToSlotToRPIndex[space][slot] = m_descRanges.size() - 1;
     }
 
+    void RootSignature::AddRootUAV(UINT slot, UINT space)
+    {
+        assert(!m_isBuilt);
+
+        m_descRanges.push_back(
+            {
+                ParameterTypes::RootUAV,
+                slot,
+                space
+            });
+        m_uavSpaceToSlotToRPIndex[space][slot] = m_descRanges.size() - 1;
+    }
+
     void RootSignature::AddStaticSampler(CD3DX12_STATIC_SAMPLER_DESC samplerDesc,
         UINT slot,
         UINT space)
@@ -97,6 +119,13 @@ namespace Gradient
         m_staticSamplers.push_back(samplerDesc);
     }
 
+    void RootSignature::AllowDescriptorHeapIndexing()
+    {
+        assert(!m_isBuilt);
+
+        m_allowHeapIndexing = true;
+    }
+
     void RootSignature::Build(ID3D12Device* device, bool compute)
     {
         std::vector<CD3DX12_ROOT_PARAMETER1> rootParameters;
@@ -132,6 +161,12 @@ namespace Gradient
                 rootParameters.push_back(rp);
                 break;
 
+            case ParameterTypes::RootUAV:
+                rp.InitAsUnorderedAccessView(m_descRanges[i].Slot,
+                    m_descRanges[i].Space);
+                rootParameters.push_back(rp);
+                break;
+
             case ParameterTypes::DescriptorTableUAV:
                 descriptorRanges.push_back({});
                 descriptorRanges[descriptorRanges.size() - 1].Init(
@@ -155,6 +190,10 @@ namespace Gradient
             m_staticSamplers.data());
 
         rootSig.Desc_1_0.Flags |= D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT;
+        if (m_allowHeapIndexing)
+        {
+            rootSig.Desc_1_0.Flags |= D3D12_ROOT_SIGNATURE_FLAG_CBV_SRV_UAV_HEAP_DIRECTLY_INDEXED;
+        }
         using Microsoft::WRL::ComPtr;
 
         ComPtr<ID3DBlob> serializedRootSig;
@@ -186,11 +225,12 @@ namespace Gradient
         auto rpIndex = m_srvSpaceToSlotToRPIndex[space][slot];
         assert(rpIndex != UINT32_MAX);
 
+        auto handle = index->GetGPUHandle();
+
         if (m_isCompute)
-            cl->SetComputeRootDescriptorTable(rpIndex, index->GetGPUHandle());
-        else
-            cl->SetGraphicsRootDescriptorTable(rpIndex,
-                index->GetGPUHandle());
+            cl->SetComputeRootDescriptorTable(rpIndex, handle);
+        else if (RenderStateCache::Get().SetRootParameter(rpIndex, handle.ptr))
+            cl->SetGraphicsRootDescriptorTable(rpIndex, handle);
     }
 
     void RootSignature::SetUAV(ID3D12GraphicsCommandList* cl,
@@ -204,12 +244,12 @@ namespace Gradient
         auto rpIndex = m_uavSpaceToSlotToRPIndex[space][slot];
         assert(rpIndex != UINT32_MAX);
 
+        auto handle = index->GetGPUHandle();
+
         if (m_isCompute)
-            cl->SetComputeRootDescriptorTable(rpIndex,
-                index->GetGPUHandle());
-        else
-            cl->SetGraphicsRootDescriptorTable(rpIndex,
-                index->GetGPUHandle());
+            cl->SetComputeRootDescriptorTable(rpIndex, handle);
+        else if (RenderStateCache::Get().SetRootParameter(rpIndex, handle.ptr))
+            cl->SetGraphicsRootDescriptorTable(rpIndex, handle);
     }
 
     void RootSignature::SetOnCommandList(ID3D12GraphicsCommandList* cl)
@@ -217,7 +257,7 @@ namespace Gradient
         assert(m_isBuilt);
         if (m_isCompute)
             cl->SetComputeRootSignature(m_rootSignature.Get());
-        else
+        else if (RenderStateCache::Get().SetRootSignature(m_rootSignature.Get()))
             cl->SetGraphicsRootSignature(m_rootSignature.Get());
     }
 
@@ -228,16 +268,45 @@ namespace Gradient
     {
         assert(m_isBuilt);
 
+        auto bm = BufferManager::Get();
+
+        auto bufferEntry = bm->GetInstanceBuffer(handle);
+
+        assert(bufferEntry);
+        SetStructuredBufferSRV(cl, slot, space, bufferEntry->Resource.GetGpuAddress());
+    }
+
+    void RootSignature::SetStructuredBufferSRV(ID3D12GraphicsCommandList* cl,
+        UINT slot,
+        UINT space,
+        D3D12_GPU_VIRTUAL_ADDRESS address)
+    {
+        assert(m_isBuilt);
+
         auto rpIndex = m_srvSpaceToSlotToRPIndex[space][slot];
 
         assert(rpIndex != UINT32_MAX);
 
-        auto bm = BufferManager::Get();
+        if (m_isCompute)
+            cl->SetComputeRootShaderResourceView(rpIndex, address);
+        else if (RenderStateCache::Get().SetRootParameter(rpIndex, address))
+            cl->SetGraphicsRootShaderResourceView(rpIndex, address);
+    }
 
-        auto bufferEntry = bm->GetInstanceBuffer(handle);
+    void RootSignature::SetStructuredBufferUAV(ID3D12GraphicsCommandList* cl,
+        UINT slot,
+        UINT space,
+        D3D12_GPU_VIRTUAL_ADDRESS address)
+    {
+        assert(m_isBuilt);
 
-        assert(bufferEntry);
-        cl->SetGraphicsRootShaderResourceView(rpIndex,
-            bufferEntry->Resource.GetGpuAddress());
+        auto rpIndex = m_uavSpaceToSlotToRPIndex[space][slot];
+
+        assert(rpIndex != UINT32_MAX);
+
+        if (m_isCompute)
+            cl->SetComputeRootUnorderedAccessView(rpIndex, address);
+        else if (RenderStateCache::Get().SetRootParameter(rpIndex, address))
+            cl->SetGraphicsRootUnorderedAccessView(rpIndex, address);
     }
 }
\ No newline at end of file
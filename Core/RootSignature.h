@@ -4,6 +4,7 @@
 #include <array>
 #include "Core/GraphicsMemoryManager.h"
 #include "Core/BufferManager.h"
+#include "Core/RenderStateCache.h"
 
 namespace Gradient
 {
@@ -16,9 +17,12 @@ namespace Gradient
         void AddSRV(UINT slot, UINT space);
         void AddUAV(UINT slot, UINT space);
         void AddRootSRV(UINT slot, UINT space);
+        void AddRootUAV(UINT slot, UINT space);
         void AddStaticSampler(CD3DX12_STATIC_SAMPLER_DESC samplerDesc,
             UINT slot,
             UINT space);
+        // Lets shaders index ResourceDescriptorHeap directly
+        void AllowDescriptorHeapIndexing();
 
         void Build(ID3D12Device* device, bool compute = false);
         ID3D12RootSignature* Get();
@@ -34,6 +38,15 @@ namespace Gradient
             UINT slot,
             UINT space,
             BufferManager::InstanceBufferHandle handle);
+        void SetStructuredBufferSRV(ID3D12GraphicsCommandList* cl,
+            UINT slot,
+            UINT space,
+            D3D12_GPU_VIRTUAL_ADDRESS address);
+        
+        void SetStructuredBufferUAV(ID3D12GraphicsCommandList* cl,
+            UINT slot,
+            UINT space,
+            D3D12_GPU_VIRTUAL_ADDRESS address);
         
         void SetSRV(ID3D12GraphicsCommandList* cl,
             UINT slot,
@@ -50,11 +63,13 @@ namespace Gradient
     private:
         bool m_isBuilt = false;
         bool m_isCompute = false;
+        bool m_allowHeapIndexing = false;
 
         enum class ParameterTypes
         {
             RootCBV,
             RootSRV,
+            RootUAV,
             DescriptorTableSRV,
             DescriptorTableUAV
         };
@@ -93,7 +108,7 @@ namespace Gradient
 
         if (m_isCompute)
             cl->SetComputeRootConstantBufferView(rpIndex, cbvAddress);
-        else
+        else if (RenderStateCache::Get().SetRootParameter(rpIndex, cbvAddress))
             cl->SetGraphicsRootConstantBufferView(rpIndex, cbvAddress);
     }
 }
\ No newline at end of file
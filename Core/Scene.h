@@ -11,16 +11,28 @@
 #include "Core/ECS/Components/RigidBodyComponent.h"
 #include "Core/ECS/Components/PointLightComponent.h"
 #include "Core/ECS/Components/InstanceDataComponent.h"
+#include "Core/ECS/Components/InstanceClusterComponent.h"
 #include "Core/ECS/Components/RelationshipComponent.h"
 #include "Core/ECS/Components/BoundingBoxComponent.h"
+#include "Core/ECS/Components/OccluderComponent.h"
 #include "Core/Math.h"
 #include "Core/Logger.h"
+#include "Core/Rendering/LSystemDefinitions.h"
+#include "Core/Pipelines/WaterPipeline.h"
+#include "Core/TaskGraph.h"
+#include "Core/SceneCache.h"
 
 #include <Jolt/Physics/Collision/Shape/HeightFieldShape.h>
 #include <Jolt/Core/RTTI.h>
 
 #include "Core/Physics/Conversions.h"
 
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <random>
+#include <span>
+
 
 namespace Gradient::Scene
 {
@@ -29,7 +41,11 @@ namespace Gradient::Scene
     {
         BufferManager::MeshHandle MeshHandle;
         BufferManager::InstanceBufferHandle InstanceBufferHandle;
-        std::vector<BufferManager::InstanceData> Instances;
+        uint32_t InstanceCount;
+        // Encloses every instance, in the entity's local space
+        DirectX::BoundingBox BoundingBox;
+        // Only for instances of a mesh
+        std::vector<Rendering::InstanceLodSelector::Cluster> Clusters;
     };
 
     struct Tree
@@ -78,13 +94,10 @@ namespace Gradient::Scene
     void AttachInstances(entt::entity entity,
         BufferManager::MeshHandle instancedMeshHandle,
         BufferManager::InstanceBufferHandle instanceBufferHandle,
-        const std::vector<BufferManager::InstanceData>& instances)
+        const DirectX::BoundingBox& instancesBoundingBox)
     {
         using namespace Gradient::ECS::Components;
         auto em = EntityManager::Get();
-        auto bm = BufferManager::Get();
-
-        auto instancedMesh = bm->GetMesh(instancedMeshHandle);
 
         auto& leavesInstance
             = em->Registry.emplace<InstanceDataComponent>(
@@ -93,10 +106,7 @@ namespace Gradient::Scene
 
         em->Registry.emplace<BoundingBoxComponent>(
             entity,
-            BoundingBoxComponent::CreateFromInstanceData(
-                instancedMesh->GetBoundingBox(),
-                instances
-            ));
+            instancesBoundingBox);
 
         em->Registry.emplace<DrawableComponent>(entity,
             instancedMeshHandle);
@@ -104,29 +114,20 @@ namespace Gradient::Scene
 
     void AttachBillboards(entt::entity entity,
         BufferManager::InstanceBufferHandle instanceBufferHandle,
-        const std::vector<BufferManager::InstanceData>& instances,
+        const DirectX::BoundingBox& instancesBoundingBox,
         DirectX::XMFLOAT2 dimensions)
     {
         using namespace Gradient::ECS::Components;
         auto em = EntityManager::Get();
-        auto bm = BufferManager::Get();
 
         auto& leavesInstance
             = em->Registry.emplace<InstanceDataComponent>(
                 entity,
                 instanceBufferHandle);
 
-        DirectX::BoundingBox bb;
-        DirectX::BoundingBox::CreateFromPoints(bb,
-            DirectX::SimpleMath::Vector3(-dimensions.x / 2.f, 0, -dimensions.y / 2.f),
-            DirectX::SimpleMath::Vector3(dimensions.x / 2.f, 0, dimensions.y / 2.f));
-
         em->Registry.emplace<BoundingBoxComponent>(
             entity,
-            BoundingBoxComponent::CreateFromInstanceData(
-                bb,
-                instances
-            ));
+            instancesBoundingBox);
 
         em->Registry.emplace<DrawableComponent>(entity,
             BufferManager::MeshHandle(),
@@ -138,21 +139,38 @@ namespace Gradient::Scene
     void AttachInstances(entt::entity entity,
         const InstanceEntityData& data)
     {
-        AttachInstances(entity, data.MeshHandle, data.InstanceBufferHandle, data.Instances);
+        AttachInstances(entity, data.MeshHandle, data.InstanceBufferHandle, data.BoundingBox);
+
+        if (!data.Clusters.empty())
+        {
+            EntityManager::Get()->Registry.emplace<ECS::Components::InstanceClusterComponent>(
+                entity,
+                data.Clusters);
+        }
     }
 
     void AttachBillboards(entt::entity entity,
         const InstanceEntityData& data,
         DirectX::XMFLOAT2 dimensions)
     {
-        AttachBillboards(entity, data.InstanceBufferHandle, data.Instances, dimensions);
+        AttachBillboards(entity, data.InstanceBufferHandle, data.BoundingBox, dimensions);
     }
 
     void AttachBillboards(entt::entity entity,
         const InstanceEntityData& data,
         float width)
     {
-        AttachBillboards(entity, data.InstanceBufferHandle, data.Instances, DirectX::XMFLOAT2(width, width));
+        AttachBillboards(entity, data.InstanceBufferHandle, data.BoundingBox, DirectX::XMFLOAT2(width, width));
+    }
+
+    DirectX::BoundingBox BillboardBoundingBox(DirectX::XMFLOAT2 dimensions)
+    {
+        DirectX::BoundingBox bb;
+        DirectX::BoundingBox::CreateFromPoints(bb,
+            DirectX::SimpleMath::Vector3(-dimensions.x / 2.f, 0, -dimensions.y / 2.f),
+            DirectX::SimpleMath::Vector3(dimensions.x / 2.f, 0, dimensions.y / 2.f));
+
+        return bb;
     }
 
     entt::entity AddSphere(ID3D12Device* device, ID3D12CommandQueue* cq,
@@ -172,7 +190,7 @@ namespace Gradient::Scene
         auto sphere1 = entityManager->AddEntity();
         entityManager->Registry.emplace<NameTagComponent>(sphere1, name);
         auto& sphereTransform = entityManager->Registry.emplace<TransformComponent>(sphere1);
-        sphereTransform.Translation = Matrix::CreateTranslation(position);
+        sphereTransform.Translation = position;
         AttachMeshWithBB(sphere1, bm->CreateSphere(device,
             cq, diameter));
         entityManager->Registry.emplace<MaterialComponent>(sphere1,
@@ -204,7 +222,7 @@ namespace Gradient::Scene
         entityManager->Registry.emplace<NameTagComponent>(floor, name);
         auto& floorTransform =
             entityManager->Registry.emplace<TransformComponent>(floor);
-        floorTransform.Translation = Matrix::CreateTranslation(position);
+        floorTransform.Translation = position;
         AttachMeshWithBB(floor,
             bm->CreateBox(device,
                 cq, dimensions));
@@ -239,28 +257,50 @@ namespace Gradient::Scene
         auto terrain = entityManager->AddEntity();
         entityManager->Registry.emplace<NameTagComponent>(terrain, name);
         auto& terrainTransform = entityManager->Registry.emplace<TransformComponent>(terrain);
-        terrainTransform.Translation = Matrix::CreateTranslation(position);
+        terrainTransform.Translation = position;
+        auto gridHandle = bm->CreateGrid(device,
+            cq,
+            width,
+            width,
+            25,
+            false);
         entityManager->Registry.emplace<DrawableComponent>(terrain,
-            bm->CreateGrid(device,
-                cq,
-                width,
-                width,
-                25,
-                false),
+            gridHandle,
             DrawableComponent::ShadingModel::Heightmap,
             false);
         entityManager->Registry.emplace<HeightMapComponent>(terrain,
             textureManager->GetTexture(textureKey),
             height,
             static_cast<float>(width));
-        // TODO: Make a bounding box
+        uint32_t sampleCount = 0;
+        auto heights = RigidBodyComponent::LoadHeightData(assetPath, sampleCount);
+
+        // The flat grid, raised to cover every height in the map
+        auto [lowest, highest] = std::minmax_element(heights.begin(), heights.end());
+        DirectX::BoundingBox terrainBounds = bm->GetMesh(gridHandle)->GetBoundingBox();
+        terrainBounds.Center.y = (*lowest + *highest) * height / 2.f;
+        terrainBounds.Extents.y = (*highest - *lowest) * height / 2.f;
+        entityManager->Registry.emplace<BoundingBoxComponent>(terrain, terrainBounds);
         entityManager->Registry.emplace<RigidBodyComponent>(terrain,
-            RigidBodyComponent::CreateHeightField(assetPath,
+            RigidBodyComponent::CreateHeightField(heights,
+                sampleCount,
                 static_cast<float>(width),
                 height,
                 position,
                 settingsFn));
 
+        // The occluder is drawn on the CPU every frame, so it's built
+        // from a coarser grid and simplified down a long way.
+        auto occluder = Rendering::DepthRasterizer::CreateHeightfieldOccluder(heights,
+            sampleCount,
+            static_cast<float>(width),
+            height,
+            { 0.f, 0.f, 0.f },
+            std::max(1u, (sampleCount - 1) / 256));
+        entityManager->Registry.emplace<OccluderComponent>(terrain,
+            std::make_shared<const Rendering::DepthRasterizer::OccluderMesh>(
+                Rendering::DepthRasterizer::SimplifyOccluder(occluder, 4096)));
+
         entityManager->Registry.emplace<MaterialComponent>(terrain,
             Rendering::PBRMaterial(
                 "forest_floor_albedo",
@@ -273,60 +313,16 @@ namespace Gradient::Scene
         return terrain;
     }
 
-    InstanceEntityData MakeLeaves(ID3D12Device* device, ID3D12CommandQueue* cq,
-        Rendering::LSystem& lsystem, DirectX::XMFLOAT2 leafDimensions = { 0.5f, 0.5f })
-    {
-        auto bm = BufferManager::Get();
-
-        InstanceEntityData out;
-
-        Matrix billboardTransform = Matrix::Identity;
-
-        // Shift the leaf origin and point it upwards.
-        billboardTransform *= Matrix::CreateTranslation({ 0, 0, -leafDimensions.y / 2.f })
-            * Matrix::CreateRotationX(DirectX::XM_PIDIV2);
-
-        int numRows = 3;
-        int numCols = 4;
-
-        for (const auto& transform : lsystem.GetLeafTransforms())
-        {
-            float colIndex = abs(rand()) % numCols;
-            float rowIndex = abs(rand()) % numRows;
-
-            Matrix netTransform = billboardTransform
-                * Matrix::CreateFromQuaternion(transform.Rotation)
-                * Matrix::CreateTranslation(transform.Translation);
-
-            Vector3 netScale;
-            Quaternion netRotation;
-            Vector3 netTranslation;
-            netTransform.Decompose(netScale, netRotation, netTranslation);
-
-            out.Instances.push_back({
-                    netTranslation,
-                    1.f,
-                    netRotation,
-                    Vector2{colIndex / numCols, (colIndex + 1.f) / numCols},
-                    Vector2{rowIndex / numRows, (rowIndex + 1.f) / numRows}
-                });
-        }
-
-        out.InstanceBufferHandle = bm->CreateInstanceBuffer(device,
-            cq,
-            out.Instances);
-
-        return out;
-    }
-
-    InstanceEntityData MakeLeaves(ID3D12Device* device, ID3D12CommandQueue* cq,
-        Rendering::LSystem& trunk, Rendering::LSystem& branches,
+    // Makes billboard instances for leaves, picking a random
+    // sub-UV from the leaf atlas for each one.
+    std::vector<BufferManager::InstanceData> MakeLeafInstances(
+        const std::vector<Rendering::LSystem::LeafTransform>& leafTransforms,
         uint32_t numRows, uint32_t numCols, uint32_t maxRow, uint32_t maxCol,
-        DirectX::XMFLOAT2 leafDimensions = { 0.5f, 0.5f })
+        DirectX::XMFLOAT2 leafDimensions,
+        std::mt19937& generator)
     {
-        auto bm = BufferManager::Get();
-
-        InstanceEntityData out;
+        std::vector<BufferManager::InstanceData> out;
+        out.reserve(leafTransforms.size());
 
         Matrix billboardTransform = Matrix::Identity;
 
@@ -334,12 +330,13 @@ namespace Gradient::Scene
         billboardTransform *= Matrix::CreateTranslation({ 0, 0, -leafDimensions.y / 2.f })
             * Matrix::CreateRotationX(DirectX::XM_PIDIV2);
 
-        auto leafTransforms = trunk.GetCombinedLeaves(branches);
+        std::uniform_int_distribution<uint32_t> colDistribution(0, maxCol);
+        std::uniform_int_distribution<uint32_t> rowDistribution(0, maxRow);
 
         for (const auto& transform : leafTransforms)
         {
-            float colIndex = abs(rand()) % (maxCol + 1);
-            float rowIndex = abs(rand()) % (maxRow + 1);
+            float colIndex = colDistribution(generator);
+            float rowIndex = rowDistribution(generator);
 
             Matrix netTransform = billboardTransform
                 * Matrix::CreateFromQuaternion(transform.Rotation)
@@ -350,7 +347,7 @@ namespace Gradient::Scene
             Vector3 netTranslation;
             netTransform.Decompose(netScale, netRotation, netTranslation);
 
-            out.Instances.push_back({
+            out.push_back({
                     netTranslation,
                     1.f,
                     netRotation,
@@ -362,23 +359,18 @@ namespace Gradient::Scene
         // TODO: Sort instances by sub-UVs to maximise warp coherence
         // TODO: Make the leaf texture smaller
 
-        out.InstanceBufferHandle = bm->CreateInstanceBuffer(device,
-            cq,
-            out.Instances);
-
         return out;
     }
 
-    InstanceEntityData MakeBranches(ID3D12Device* device, ID3D12CommandQueue* cq,
-        Rendering::LSystem& trunk, Rendering::LSystem& branches)
+    // Places a branch at the end of each of the trunk's branches.
+    std::vector<BufferManager::InstanceData> MakeBranchInstances(const Rendering::LSystem& trunk)
     {
-        auto bm = BufferManager::Get();
-
-        InstanceEntityData out;
+        std::vector<BufferManager::InstanceData> out;
+        out.reserve(trunk.GetLeafTransforms().size());
 
         for (const auto& transform : trunk.GetLeafTransforms())
         {
-            out.Instances.push_back({
+            out.push_back({
                     transform.Translation,
                     1.f,
                     transform.Rotation,
@@ -387,18 +379,13 @@ namespace Gradient::Scene
                 });
         }
 
-        out.InstanceBufferHandle = bm->CreateInstanceBuffer(device,
-            cq,
-            out.Instances);
-
-        out.MeshHandle = bm->CreateFromPart(device, cq, branches.GetTrunk(), 0.4f, 0.1f);
-
         return out;
     }
 
     entt::entity AddBush(ID3D12Device* device, ID3D12CommandQueue* cq,
         const std::string& name,
         const DirectX::SimpleMath::Vector3& position,
+        float yaw,
         BufferManager::MeshHandle trunkMeshHandle,
         const InstanceEntityData& leafData,
         const float leafWidth = 0.5f)
@@ -417,8 +404,8 @@ namespace Gradient::Scene
         entityManager->Registry.emplace<NameTagComponent>(tree, name + "Trunk");
         auto& frustumTransform
             = entityManager->Registry.emplace<TransformComponent>(tree);
-        frustumTransform.Translation = Matrix::CreateTranslation(position);
-        frustumTransform.Rotation = Matrix::CreateFromAxisAngle(Vector3::UnitY, rand() / DirectX::XM_2PI);
+        frustumTransform.Translation = position;
+        frustumTransform.Rotation = Quaternion::CreateFromAxisAngle(Vector3::UnitY, yaw);
 
         AttachMeshWithBB(tree, trunkMeshHandle);
 
@@ -457,6 +444,7 @@ namespace Gradient::Scene
     entt::entity AddTree(ID3D12Device* device, ID3D12CommandQueue* cq,
         const std::string& name,
         const DirectX::SimpleMath::Vector3& position,
+        float yaw,
         BufferManager::MeshHandle trunkMeshHandle,
         const InstanceEntityData& branchData,
         const InstanceEntityData& leafData,
@@ -478,8 +466,8 @@ namespace Gradient::Scene
         entityManager->Registry.emplace<NameTagComponent>(tree, name + "Trunk");
         auto& frustumTransform
             = entityManager->Registry.emplace<TransformComponent>(tree);
-        frustumTransform.Translation = Matrix::CreateTranslation(position);
-        frustumTransform.Rotation = Matrix::CreateFromAxisAngle(Vector3::UnitY, rand() / DirectX::XM_2PI);
+        frustumTransform.Translation = position;
+        frustumTransform.Rotation = Quaternion::CreateFromAxisAngle(Vector3::UnitY, yaw);
 
         AttachMeshWithBB(tree, trunkMeshHandle);
 
@@ -697,9 +685,591 @@ namespace Gradient::Scene
             - Vector3{ 0, offset, 0 };
     }
 
-    void CreateScene(ID3D12Device* device, ID3D12CommandQueue* cq)
+    // Bump this whenever the code that generates the scene changes in a way
+    // the cache key can't see, such as the L-system interpreter or the mesh
+    // optimizer, so that stale scene caches are rebuilt.
+    constexpr uint32_t SceneGeneratorVersion = 1;
+
+    // The parameters that generate one kind of tree.
+    struct TreeRecipe
+    {
+        const Rendering::LSystemDefinition* TrunkDefinition;
+        const Rendering::LSystemDefinition* BranchDefinition;
+        // The layout of the leaf atlas, and the last row and column to pick from
+        uint32_t NumRows;
+        uint32_t NumCols;
+        uint32_t MaxRow;
+        uint32_t MaxCol;
+        // Used to shift each leaf's origin to its base
+        DirectX::XMFLOAT2 LeafOriginDimensions;
+        // The size the leaves are drawn at
+        DirectX::XMFLOAT2 LeafDimensions;
+    };
+
+    struct BushRecipe
+    {
+        const Rendering::LSystemDefinition* Definition;
+        DirectX::XMFLOAT2 LeafOriginDimensions;
+        DirectX::XMFLOAT2 LeafDimensions;
+    };
+
+    // Optimized geometry, ready to be uploaded.
+    struct MeshData
+    {
+        std::span<const Rendering::ProceduralMesh::VertexType> Vertices;
+        std::span<const uint32_t> Indices;
+        DirectX::BoundingBox BoundingBox;
+    };
+
+    struct InstanceSetData
+    {
+        std::span<const BufferManager::InstanceData> Instances;
+        // Encloses every instance
+        DirectX::BoundingBox BoundingBox;
+    };
+
+    struct TreeData
+    {
+        MeshData Trunk;
+        MeshData Branch;
+        InstanceSetData Branches;
+        InstanceSetData Leaves;
+    };
+
+    struct BushData
+    {
+        MeshData Trunk;
+        InstanceSetData Leaves;
+    };
+
+    // Where one tree or bush goes. These are stored in the scene cache
+    // as they are, so the name is kept as the indices it's made from.
+    struct Placement
+    {
+        DirectX::XMFLOAT3 Position;
+        float Yaw;
+        uint32_t TypeIndex;
+        uint32_t Cluster;
+        uint32_t IndexInCluster;
+    };
+
+    // Everything needed to upload the scene and create its entities.
+    // The spans point either into SceneAssets or into a mapped scene cache.
+    struct SceneData
+    {
+        std::array<TreeData, 3> Trees;
+        std::array<BushData, 3> Bushes;
+        std::span<const Placement> TreePlacements;
+        std::span<const Placement> BushPlacements;
+    };
+
+    // The CPU-side results for one kind of tree, filled in
+    // by the tasks that AddTreeTasks adds.
+    struct TreeAssets
+    {
+        Rendering::LSystem Trunk;
+        Rendering::LSystem Branches;
+        Rendering::ProceduralMesh::MeshPart TrunkMesh;
+        Rendering::ProceduralMesh::MeshPart BranchMesh;
+        DirectX::BoundingBox TrunkBoundingBox;
+        DirectX::BoundingBox BranchBoundingBox;
+        std::vector<BufferManager::InstanceData> BranchInstances;
+        DirectX::BoundingBox BranchesBoundingBox;
+        std::vector<BufferManager::InstanceData> LeafInstances;
+        DirectX::BoundingBox LeavesBoundingBox;
+
+        TreeData GetData() const
+        {
+            return {
+                { TrunkMesh.Vertices, TrunkMesh.Indices, TrunkBoundingBox },
+                { BranchMesh.Vertices, BranchMesh.Indices, BranchBoundingBox },
+                { BranchInstances, BranchesBoundingBox },
+                { LeafInstances, LeavesBoundingBox }
+            };
+        }
+    };
+
+    struct BushAssets
+    {
+        Rendering::LSystem System;
+        Rendering::ProceduralMesh::MeshPart TrunkMesh;
+        DirectX::BoundingBox TrunkBoundingBox;
+        std::vector<BufferManager::InstanceData> LeafInstances;
+        DirectX::BoundingBox LeavesBoundingBox;
+
+        BushData GetData() const
+        {
+            return {
+                { TrunkMesh.Vertices, TrunkMesh.Indices, TrunkBoundingBox },
+                { LeafInstances, LeavesBoundingBox }
+            };
+        }
+    };
+
+    struct SceneAssets
+    {
+        std::array<TreeAssets, 3> Trees;
+        std::array<BushAssets, 3> Bushes;
+        std::vector<Placement> TreePlacements;
+        std::vector<Placement> BushPlacements;
+
+        SceneData GetData() const
+        {
+            SceneData out;
+            for (int i = 0; i < Trees.size(); i++)
+            {
+                out.Trees[i] = Trees[i].GetData();
+            }
+            for (int i = 0; i < Bushes.size(); i++)
+            {
+                out.Bushes[i] = Bushes[i].GetData();
+            }
+            out.TreePlacements = TreePlacements;
+            out.BushPlacements = BushPlacements;
+
+            return out;
+        }
+    };
+
+    // Each task that needs random numbers gets its own generator, so the
+    // scene comes out the same no matter which order the tasks run in.
+    std::mt19937 MakeSceneGenerator(uint32_t seed, uint32_t stream)
+    {
+        std::seed_seq sequence{ seed, stream };
+        return std::mt19937(sequence);
+    }
+
+    void AddTreeTasks(TaskGraph& graph,
+        TreeAssets& assets,
+        const std::string& name,
+        const TreeRecipe& recipe,
+        std::mt19937 leafGenerator)
+    {
+        auto trunk = graph.AddTask(name + " trunk",
+            [&assets, &recipe]()
+            {
+                assets.Trunk = recipe.TrunkDefinition->Create();
+            });
+
+        auto branches = graph.AddTask(name + " branches",
+            [&assets, &recipe]()
+            {
+                assets.Branches = recipe.BranchDefinition->Create();
+            });
+
+        graph.AddTask(name + " trunk mesh",
+            [&assets]()
+            {
+                assets.TrunkMesh = Rendering::ProceduralMesh::Optimize(
+                    assets.Trunk.GetTrunk(), 0.1f, 0.1f);
+                assets.TrunkBoundingBox = Rendering::ProceduralMesh::ComputeBoundingBox(
+                    assets.TrunkMesh.Vertices);
+            },
+            { trunk });
+
+        auto branchMesh = graph.AddTask(name + " branch mesh",
+            [&assets]()
+            {
+                assets.BranchMesh = Rendering::ProceduralMesh::Optimize(
+                    assets.Branches.GetTrunk(), 0.4f, 0.1f);
+                assets.BranchBoundingBox = Rendering::ProceduralMesh::ComputeBoundingBox(
+                    assets.BranchMesh.Vertices);
+            },
+            { branches });
+
+        graph.AddTask(name + " branch instances",
+            [&assets]()
+            {
+                assets.BranchInstances = MakeBranchInstances(assets.Trunk);
+                assets.BranchesBoundingBox = ECS::Components::BoundingBoxComponent::CreateFromInstanceData(
+                    assets.BranchBoundingBox,
+                    assets.BranchInstances).BoundingBox;
+            },
+            { trunk, branchMesh });
+
+        graph.AddTask(name + " leaf instances",
+            [=, &assets, &recipe]() mutable
+            {
+                assets.LeafInstances = MakeLeafInstances(
+                    assets.Trunk.GetCombinedLeaves(assets.Branches),
+                    recipe.NumRows, recipe.NumCols, recipe.MaxRow, recipe.MaxCol,
+                    recipe.LeafOriginDimensions,
+                    leafGenerator);
+                assets.LeavesBoundingBox = ECS::Components::BoundingBoxComponent::CreateFromInstanceData(
+                    BillboardBoundingBox(recipe.LeafDimensions),
+                    assets.LeafInstances).BoundingBox;
+            },
+            { trunk, branches });
+    }
+
+    void AddBushTasks(TaskGraph& graph,
+        BushAssets& assets,
+        const std::string& name,
+        const BushRecipe& recipe,
+        std::mt19937 leafGenerator)
+    {
+        auto system = graph.AddTask(name,
+            [&assets, &recipe]()
+            {
+                assets.System = recipe.Definition->Create();
+            });
+
+        graph.AddTask(name + " mesh",
+            [&assets]()
+            {
+                assets.TrunkMesh = Rendering::ProceduralMesh::Optimize(
+                    assets.System.GetTrunk(), 0.4f, 0.2f);
+                assets.TrunkBoundingBox = Rendering::ProceduralMesh::ComputeBoundingBox(
+                    assets.TrunkMesh.Vertices);
+            },
+            { system });
+
+        graph.AddTask(name + " leaf instances",
+            [=, &assets, &recipe]() mutable
+            {
+                assets.LeafInstances = MakeLeafInstances(
+                    assets.System.GetLeafTransforms(),
+                    3, 4, 2, 3,
+                    recipe.LeafOriginDimensions,
+                    leafGenerator);
+                assets.LeavesBoundingBox = ECS::Components::BoundingBoxComponent::CreateFromInstanceData(
+                    BillboardBoundingBox(recipe.LeafDimensions),
+                    assets.LeafInstances).BoundingBox;
+            },
+            { system });
+    }
+
+    void HashDefinition(Fnv1a& hash, const Rendering::LSystemDefinition& definition)
+    {
+        hash.Add(definition.Rules.size());
+        for (const auto& [lhs, rhs] : definition.Rules)
+        {
+            hash.Add(lhs);
+            hash.Add(rhs);
+        }
+        hash.Add(definition.StartingRule);
+        hash.Add(definition.NumGenerations);
+        hash.Add(definition.NumVerticalSections);
+        hash.Add(definition.StartingRadius);
+        hash.Add(definition.RadiusFactor);
+        hash.Add(definition.AngleDegrees);
+        hash.Add(definition.MoveDistance);
+    }
+
+    // Hashes everything that goes into generating the scene, so that
+    // changing a rule or a parameter invalidates the scene cache.
+    uint64_t ComputeSceneCacheKey(uint32_t seed,
+        const std::array<TreeRecipe, 3>& treeRecipes,
+        const std::array<BushRecipe, 3>& bushRecipes,
+        const std::wstring& heightMapPath)
+    {
+        Fnv1a hash;
+        hash.Add(SceneGeneratorVersion);
+        hash.Add(seed);
+
+        for (const auto& recipe : treeRecipes)
+        {
+            HashDefinition(hash, *recipe.TrunkDefinition);
+            HashDefinition(hash, *recipe.BranchDefinition);
+            hash.Add(recipe.NumRows);
+            hash.Add(recipe.NumCols);
+            hash.Add(recipe.MaxRow);
+            hash.Add(recipe.MaxCol);
+            hash.Add(recipe.LeafOriginDimensions);
+            hash.Add(recipe.LeafDimensions);
+        }
+
+        for (const auto& recipe : bushRecipes)
+        {
+            HashDefinition(hash, *recipe.Definition);
+            hash.Add(recipe.LeafOriginDimensions);
+            hash.Add(recipe.LeafDimensions);
+        }
+
+        // The placements are projected onto the terrain, so a new
+        // heightmap needs a new cache too.
+        std::error_code error;
+        auto heightMapSize = std::filesystem::file_size(heightMapPath, error);
+        auto heightMapTime = std::filesystem::last_write_time(heightMapPath, error);
+        hash.Add(heightMapSize);
+        hash.Add(heightMapTime.time_since_epoch().count());
+
+        return hash.Get();
+    }
+
+    void AddMeshToCache(SceneCache::Writer& writer, const std::string& name, const MeshData& mesh)
+    {
+        writer.AddArray(name + ".vertices", mesh.Vertices);
+        writer.AddArray(name + ".indices", mesh.Indices);
+        writer.AddValue(name + ".bounds", mesh.BoundingBox);
+    }
+
+    void AddInstancesToCache(SceneCache::Writer& writer, const std::string& name, const InstanceSetData& instances)
+    {
+        writer.AddArray(name + ".instances", instances.Instances);
+        writer.AddValue(name + ".bounds", instances.BoundingBox);
+    }
+
+    bool WriteSceneCache(const std::wstring& path, uint64_t key, const SceneData& data)
+    {
+        SceneCache::Writer writer;
+
+        for (int i = 0; i < data.Trees.size(); i++)
+        {
+            auto name = "tree" + std::to_string(i);
+            AddMeshToCache(writer, name + ".trunk", data.Trees[i].Trunk);
+            AddMeshToCache(writer, name + ".branch", data.Trees[i].Branch);
+            AddInstancesToCache(writer, name + ".branches", data.Trees[i].Branches);
+            AddInstancesToCache(writer, name + ".leaves", data.Trees[i].Leaves);
+        }
+
+        for (int i = 0; i < data.Bushes.size(); i++)
+        {
+            auto name = "bush" + std::to_string(i);
+            AddMeshToCache(writer, name + ".trunk", data.Bushes[i].Trunk);
+            AddInstancesToCache(writer, name + ".leaves", data.Bushes[i].Leaves);
+        }
+
+        writer.AddArray("treePlacements", data.TreePlacements);
+        writer.AddArray("bushPlacements", data.BushPlacements);
+
+        return writer.Write(path, key);
+    }
+
+    bool ReadMeshFromCache(const SceneCache::MappedFile& file, const std::string& name, MeshData& mesh)
+    {
+        mesh.Vertices = file.GetArray<Rendering::ProceduralMesh::VertexType>(name + ".vertices");
+        mesh.Indices = file.GetArray<uint32_t>(name + ".indices");
+        auto bounds = file.GetValue<DirectX::BoundingBox>(name + ".bounds");
+        if (mesh.Vertices.empty() || mesh.Indices.empty() || bounds == nullptr)
+            return false;
+
+        mesh.BoundingBox = *bounds;
+        return true;
+    }
+
+    bool ReadInstancesFromCache(const SceneCache::MappedFile& file, const std::string& name, InstanceSetData& instances)
+    {
+        instances.Instances = file.GetArray<BufferManager::InstanceData>(name + ".instances");
+        auto bounds = file.GetValue<DirectX::BoundingBox>(name + ".bounds");
+        if (instances.Instances.empty() || bounds == nullptr)
+            return false;
+
+        instances.BoundingBox = *bounds;
+        return true;
+    }
+
+    // Points the spans in data into the mapped file.
+    // Returns false if anything is missing.
+    bool ReadSceneCache(const SceneCache::MappedFile& file, SceneData& data)
+    {
+        for (int i = 0; i < data.Trees.size(); i++)
+        {
+            auto name = "tree" + std::to_string(i);
+            if (!ReadMeshFromCache(file, name + ".trunk", data.Trees[i].Trunk)
+                || !ReadMeshFromCache(file, name + ".branch", data.Trees[i].Branch)
+                || !ReadInstancesFromCache(file, name + ".branches", data.Trees[i].Branches)
+                || !ReadInstancesFromCache(file, name + ".leaves", data.Trees[i].Leaves))
+            {
+                return false;
+            }
+        }
+
+        for (int i = 0; i < data.Bushes.size(); i++)
+        {
+            auto name = "bush" + std::to_string(i);
+            if (!ReadMeshFromCache(file, name + ".trunk", data.Bushes[i].Trunk)
+                || !ReadInstancesFromCache(file, name + ".leaves", data.Bushes[i].Leaves))
+            {
+                return false;
+            }
+        }
+
+        data.TreePlacements = file.GetArray<Placement>("treePlacements");
+        data.BushPlacements = file.GetArray<Placement>("bushPlacements");
+
+        return !data.TreePlacements.empty();
+    }
+
+    // Runs the task graph that generates the scene's CPU-side assets.
+    void BuildSceneAssets(SceneAssets& assets,
+        uint32_t seed,
+        const std::array<TreeRecipe, 3>& treeRecipes,
+        const std::array<BushRecipe, 3>& bushRecipes,
+        const JPH::HeightFieldShape* hfShape,
+        const Matrix& hfWorld)
+    {
+        // Everything up to the upload is CPU work that doesn't touch the
+        // device or the registry, so it runs as a graph of parallel tasks.
+        auto buildStart = std::chrono::high_resolution_clock::now();
+
+        TaskGraph graph;
+
+        for (uint32_t i = 0; i < assets.Trees.size(); i++)
+        {
+            AddTreeTasks(graph, assets.Trees[i], "Tree " + std::to_string(i + 1),
+                treeRecipes[i], MakeSceneGenerator(seed, 1 + i));
+        }
+
+        for (uint32_t i = 0; i < assets.Bushes.size(); i++)
+        {
+            AddBushTasks(graph, assets.Bushes[i], "Bush " + std::to_string(i + 1),
+                bushRecipes[i], MakeSceneGenerator(seed, 4 + i));
+        }
+
+        std::vector<Vector2> treePositions;
+
+        auto treePositionsTask = graph.AddTask("Tree positions",
+            [&treePositions]()
+            {
+                treePositions = Math::GeneratePoissonDiskSamples(150, 75, 3.f);
+            });
+
+        graph.AddTask("Tree placement",
+            [&]()
+            {
+                auto generator = MakeSceneGenerator(seed, 7);
+                std::uniform_int_distribution<size_t> typeDistribution(0, assets.Trees.size() - 1);
+                std::uniform_real_distribution<float> yawDistribution(0.f, DirectX::XM_2PI);
+
+                assets.TreePlacements.reserve(treePositions.size());
+
+                for (int i = 0; i < treePositions.size(); i++)
+                {
+                    auto treeIndex = typeDistribution(generator);
+                    auto yaw = yawDistribution(generator);
+
+                    assets.TreePlacements.push_back({
+                        PlaceOntoHeightField(hfShape,
+                            hfWorld,
+                            treePositions[i],
+                            0.02),
+                        yaw,
+                        static_cast<uint32_t>(treeIndex),
+                        static_cast<uint32_t>(i),
+                        0
+                        });
+                }
+            },
+            { treePositionsTask });
+
+        graph.AddTask("Bush placement",
+            [&]()
+            {
+                auto generator = MakeSceneGenerator(seed, 8);
+                std::uniform_int_distribution<int> countDistribution(0, 9);
+                std::uniform_int_distribution<int> jitterDistribution(33, 182);
+                std::uniform_int_distribution<size_t> typeDistribution(0, assets.Bushes.size() - 1);
+                std::uniform_real_distribution<float> yawDistribution(0.f, DirectX::XM_2PI);
+
+                // To position bushes, rotate the tree position by 90 degrees 
+                // and scale it down slightly. Then jitter a bit
+                auto bushPositionTransform = Matrix::CreateRotationY(DirectX::XMConvertToRadians(90))
+                    * Matrix::CreateScale(0.8);
+
+                for (int i = 0; i < treePositions.size(); i++)
+                {
+                    auto clusterPosition = Vector3(treePositions[i].x, 0, treePositions[i].y);
+                    clusterPosition = Vector3::Transform(clusterPosition, bushPositionTransform);
+
+                    int numBushes = countDistribution(generator);
+                    for (int j = 0; j < numBushes; j++)
+                    {
+                        auto jitterX = jitterDistribution(generator) / 33.f;
+                        auto jitterZ = jitterDistribution(generator) / 33.f;
+                        auto bushPosition = clusterPosition + Vector3(jitterX, 0, jitterZ);
+
+                        auto bushIndex = typeDistribution(generator);
+                        auto yaw = yawDistribution(generator);
+
+                        assets.BushPlacements.push_back({
+                            PlaceOntoHeightField(hfShape,
+                                hfWorld,
+                                Vector2(bushPosition.x, bushPosition.z),
+                                0.02),
+                            yaw,
+                            static_cast<uint32_t>(bushIndex),
+                            static_cast<uint32_t>(i),
+                            static_cast<uint32_t>(j)
+                            });
+                    }
+                }
+            },
+            { treePositionsTask });
+
+        graph.Run();
+
+        auto buildEnd = std::chrono::high_resolution_clock::now();
+
+        Logger::Get()->info("Built scene assets with {} tasks in {:.1f} ms (critical path {:.1f} ms)",
+            graph.GetTaskCount(),
+            std::chrono::duration<double, std::milli>(buildEnd - buildStart).count(),
+            graph.GetCriticalPathMilliseconds());
+    }
+
+    // Meshlets are worth building for large meshes that are
+    // drawn on their own, which the meshlet path can cull in parts.
+    BufferManager::MeshHandle UploadMesh(ID3D12Device* device,
+        DirectX::ResourceUploadBatch& uploadBatch,
+        const MeshData& mesh,
+        bool buildMeshlets = false)
+    {
+        return BufferManager::Get()->CreateFromOptimizedPart(device,
+            uploadBatch,
+            mesh.Vertices,
+            mesh.Indices,
+            mesh.BoundingBox,
+            buildMeshlets);
+    }
+
+    // For meshes that are instanced many times over, which
+    // are drawn in less detail the smaller they get on screen.
+    BufferManager::MeshHandle UploadLodMesh(ID3D12Device* device,
+        DirectX::ResourceUploadBatch& uploadBatch,
+        const MeshData& mesh)
+    {
+        return BufferManager::Get()->CreateFromOptimizedPart(device,
+            uploadBatch,
+            mesh.Vertices,
+            Rendering::ProceduralMesh::BuildLodChain(mesh.Vertices, mesh.Indices),
+            mesh.BoundingBox);
+    }
+
+    InstanceEntityData UploadInstances(ID3D12Device* device,
+        DirectX::ResourceUploadBatch& uploadBatch,
+        const InstanceSetData& instances,
+        BufferManager::MeshHandle meshHandle = {})
+    {
+        InstanceEntityData out;
+        out.MeshHandle = meshHandle;
+        out.InstanceBufferHandle = BufferManager::Get()->CreateInstanceBuffer(device,
+            uploadBatch,
+            instances.Instances);
+        out.InstanceCount = static_cast<uint32_t>(instances.Instances.size());
+        out.BoundingBox = instances.BoundingBox;
+
+        return out;
+    }
+
+    // As above, with the clusters that the renderer
+    // culls and picks levels of detail for.
+    InstanceEntityData UploadMeshInstances(ID3D12Device* device,
+        DirectX::ResourceUploadBatch& uploadBatch,
+        const InstanceSetData& instances,
+        BufferManager::MeshHandle meshHandle)
+    {
+        auto out = UploadInstances(device, uploadBatch, instances, meshHandle);
+
+        out.Clusters = Rendering::InstanceLodSelector::BuildClusters(instances.Instances,
+            BufferManager::Get()->GetMesh(meshHandle)->GetBoundingBox());
+
+        return out;
+    }
+
+    void CreateScene(ID3D12Device* device, ID3D12CommandQueue* cq, uint32_t seed = 1)
     {
         using namespace Gradient::ECS::Components;
+        using namespace Rendering::LSystemDefinitions;
 
         auto entityManager = EntityManager::Get();
         auto textureManager = TextureManager::Get();
@@ -712,17 +1282,26 @@ namespace Gradient::Scene
         //CreateDemoObjects(device, cq);
 
         auto water = AddEntity("water");
+        auto waterGrid = bm->CreateGrid(device,
+            cq,
+            800,
+            800,
+            100);
         entityManager->Registry.emplace<DrawableComponent>(water,
-            bm->CreateGrid(device,
-                cq,
-                800,
-                800,
-                100),
+            waterGrid,
             DrawableComponent::ShadingModel::Water);
 
+        // The flat grid, and as high as the waves can raise it
+        DirectX::BoundingBox waterBounds = bm->GetMesh(waterGrid)->GetBoundingBox();
+        waterBounds.Center.y += Pipelines::WaterPipeline::MaxWaveHeight / 2.f;
+        waterBounds.Extents.y += Pipelines::WaterPipeline::MaxWaveHeight / 2.f;
+        entityManager->Registry.emplace<BoundingBoxComponent>(water, waterBounds);
+
+        const std::wstring heightMapPath = L"Assets\\island_height_32bit.dds";
+
         textureManager->LoadDDS(device, cq,
             "islandHeightMap",
-            L"Assets\\island_height_32bit.dds");
+            heightMapPath);
 
         auto terrain = AddTerrain(device, cq,
             "terrain",
@@ -730,42 +1309,69 @@ namespace Gradient::Scene
             256,
             10,
             "islandHeightMap",
-            L"Assets\\island_height_32bit.dds");
+            heightMapPath);
 
-        std::vector<Tree> treeTypes;
+        const std::array<TreeRecipe, 3> treeRecipes = { {
+            { &TreeTrunk1, &TreeBranch1, 3, 4, 2, 3, { 0.17f, 0.20f }, { 0.20f, 0.20f } },
+            { &TreeTrunk2, &TreeBranch2, 3, 7, 0, 0, { 0.10f, 0.20f }, { 0.10f, 0.20f } },
+            { &TreeTrunk3, &TreeBranch3, 3, 7, 0, 0, { 0.10f, 0.20f }, { 0.10f, 0.20f } }
+        } };
+
+        const std::array<BushRecipe, 3> bushRecipes = { {
+            { &Bush1, { 0.06f, 0.06f }, { 0.06f, 0.06f } },
+            { &Bush2, { 0.06f, 0.06f }, { 0.06f, 0.06f } },
+            { &Bush3, { 0.03f, 0.05f }, { 0.06f, 0.06f } }
+        } };
+
+        // The generated meshes, instances and placements are baked into a
+        // cache file, and mapped straight back in on later runs.
+        const std::wstring cachePath = L"Cache\\scene.gscene";
+        auto cacheKey = ComputeSceneCacheKey(seed, treeRecipes, bushRecipes, heightMapPath);
+
+        auto loadStart = std::chrono::high_resolution_clock::now();
+
+        SceneCache::MappedFile cacheFile;
+        SceneAssets assets;
+        SceneData data;
+
+        if (cacheFile.Open(cachePath, cacheKey) && ReadSceneCache(cacheFile, data))
+        {
+            Logger::Get()->info("Loaded scene assets from the cache in {:.1f} ms",
+                std::chrono::duration<double, std::milli>(
+                    std::chrono::high_resolution_clock::now() - loadStart).count());
+        }
+        else
+        {
+            cacheFile.Close();
+
+            auto& terrainBody = entityManager->Registry.get<RigidBodyComponent>(terrain);
+            auto hfWorld = entityManager->GetWorldMatrix(terrain);
+
+            auto shape = bodyInterface.GetShape(terrainBody.BodyID);
+            const JPH::HeightFieldShape* hfShape = JPH::StaticCast<JPH::HeightFieldShape>(shape);
+
+            BuildSceneAssets(assets, seed, treeRecipes, bushRecipes, hfShape, hfWorld);
+            data = assets.GetData();
+
+            if (!WriteSceneCache(cachePath, cacheKey, data))
+            {
+                Logger::Get()->warn("Could not write the scene cache");
+            }
+        }
+
+        auto uploadStart = std::chrono::high_resolution_clock::now();
 
-        Rendering::LSystem treeTrunk;
-        treeTrunk.AddRule('T', "FFF[/+FX[--G]][////+FX[++G]]/////////+FX[-G]");
-        treeTrunk.AddRule('X', "F[/+FX[--G]][////+FX[++G]]/////////+FX[-G]");
-        treeTrunk.AddRule('G', "[//--L][//---L][\\^++L][\\\\&&++L]");
-        treeTrunk.AddRule('L', "L///+^L");
-        treeTrunk.StartingRadius = 0.3f;
-        treeTrunk.RadiusFactor = 0.5f;
-        treeTrunk.AngleDegrees = 25.7f;
-        treeTrunk.MoveDistance = 1.f;
-        treeTrunk.Build("T", 3);
-
-        Rendering::LSystem treeBranch;
-        treeBranch.AddRule('X', "FF/-F+F[--B]//F[^^B]//-FB");
-        treeBranch.AddRule('B', "F[//^^B]F[\\\\&L]G[+B]-BG");
-        treeBranch.AddRule('G', "F[//--L][//---L][\\^++L][\\\\&&++L][\\\\&&+++L]");
-        //treeBranch.AddRule('L', "L///+^L");
-        treeBranch.StartingRadius = 0.02f;
-        treeBranch.RadiusFactor = 1.f;
-        treeBranch.AngleDegrees = 20.f;
-        treeBranch.MoveDistance = 0.2f;
-        treeBranch.Build("X", 5, 3);
-
-        auto trunkMesh = bm->CreateFromPart(device, cq, treeTrunk.GetTrunk(), 0.1f, 0.1f);
-        auto branchData = MakeBranches(device, cq, treeTrunk, treeBranch);
-        auto leafData = MakeLeaves(device, cq, treeTrunk, treeBranch, 3, 4, 2, 3, { 0.17f, 0.20f });
-        Logger::Get()->info("Tree 1 has " + std::to_string(leafData.Instances.size()) + " leaves");
+        // All of the meshes and instance buffers go up in one batch.
+        DirectX::ResourceUploadBatch uploadBatch(device);
+        uploadBatch.Begin();
 
+        std::vector<Tree> treeTypes;
 
         treeTypes.push_back({
-            trunkMesh,
-            branchData,
-            leafData,
+            UploadMesh(device, uploadBatch, data.Trees[0].Trunk, true),
+            UploadMeshInstances(device, uploadBatch, data.Trees[0].Branches,
+                UploadLodMesh(device, uploadBatch, data.Trees[0].Branch)),
+            UploadInstances(device, uploadBatch, data.Trees[0].Leaves),
             0.3f,
             Rendering::PBRMaterial(
                 "bark_albedo",
@@ -783,40 +1389,14 @@ namespace Gradient::Scene
                 1.f,
                 true
             ),
-            { 0.20f, 0.20f }
+            treeRecipes[0].LeafDimensions
             });
 
-        Rendering::LSystem treeTrunk2;
-        treeTrunk2.AddRule('T', "F^F&F[/+FX[-G]][///+F^X[++G]]//////w/+F&X[-G][//^-L]");
-        treeTrunk2.AddRule('X', "F[^/+FX[-G][//^-L]][///+&FX[++G][//^-L]]///////+F^X[-G][//^-L]");
-        treeTrunk2.AddRule('G', "[//-L][/+L]");
-        //treeTrunk2.AddRule('L', "L///+^L");
-        treeTrunk2.StartingRadius = 0.2f;
-        treeTrunk2.RadiusFactor = 0.5f;
-        treeTrunk2.AngleDegrees = 30.f;
-        treeTrunk2.MoveDistance = 1.5f;
-        treeTrunk2.Build("T", 3);
-
-        Rendering::LSystem treeBranch2;
-        treeBranch2.AddRule('X', "F^F/-F+F[--B]//F[^^B]//-FB");
-        treeBranch2.AddRule('B', "F^[//^^B]F&[\\\\&L]G[+B]-BG");
-        treeBranch2.AddRule('G', "F[//--L][//---L][\\^++L]");
-        treeBranch2.StartingRadius = 0.04f;
-        treeBranch2.RadiusFactor = 0.95f;
-        treeBranch2.AngleDegrees = 30.f;
-        treeBranch2.MoveDistance = 0.2f;
-        treeBranch2.Build("X", 5, 3);
-
-        auto trunkMesh2 = bm->CreateFromPart(device, cq, treeTrunk2.GetTrunk(), 0.1f, 0.1f);
-        auto branchData2 = MakeBranches(device, cq, treeTrunk2, treeBranch2);
-        auto leafData2 = MakeLeaves(device, cq, treeTrunk2, treeBranch2, 3, 7, 0, 0, { 0.10f, 0.20f });
-        Logger::Get()->info("Tree 2 has " + std::to_string(leafData2.Instances.size()) + " leaves");
-
-
         treeTypes.push_back({
-            trunkMesh2,
-            branchData2,
-            leafData2,
+            UploadMesh(device, uploadBatch, data.Trees[1].Trunk, true),
+            UploadMeshInstances(device, uploadBatch, data.Trees[1].Branches,
+                UploadLodMesh(device, uploadBatch, data.Trees[1].Branch)),
+            UploadInstances(device, uploadBatch, data.Trees[1].Leaves),
             0.2f,
             Rendering::PBRMaterial(
                 "bark2_albedo",
@@ -833,40 +1413,14 @@ namespace Gradient::Scene
                 1.f,
                 true
             ),
-            {0.10f, 0.20f}
+            treeRecipes[1].LeafDimensions
             });
 
-        Rendering::LSystem treeTrunk3;
-        treeTrunk3.AddRule('T', "FFF&F[/+FX[-G]][///+FX[--B]]///////+F^X[-B][//^-L]");
-        treeTrunk3.AddRule('X', "F[^//+BX][///-BX]////--BX[//^-L]");
-        treeTrunk3.AddRule('B', "FG");
-        treeTrunk3.AddRule('G', "[//&&&-L][/^^^+L]");
-        treeTrunk3.StartingRadius = 0.25f;
-        treeTrunk3.RadiusFactor = 0.7f;
-        treeTrunk3.AngleDegrees = 20.f;
-        treeTrunk3.MoveDistance = 0.8f;
-        treeTrunk3.Build("T", 4);
-
-        Rendering::LSystem treeBranch3;
-        treeBranch3.AddRule('X', "F^^F//-F+F[--B]///F[^^B]//-FB");
-        treeBranch3.AddRule('B', "F^[//^^B]F&G[+B]-BG");
-        treeBranch3.AddRule('G', "F[///--L][//---L][\\\\&&+++L]");
-        treeBranch3.StartingRadius = 0.03f;
-        treeBranch3.RadiusFactor = 0.95f;
-        treeBranch3.AngleDegrees = 40.f;
-        treeBranch3.MoveDistance = 0.2f;
-        treeBranch3.Build("X", 5, 3);
-
-        auto trunkMesh3 = bm->CreateFromPart(device, cq, treeTrunk3.GetTrunk(), 0.1f, 0.1f);
-        auto branchData3 = MakeBranches(device, cq, treeTrunk3, treeBranch3);
-        auto leafData3 = MakeLeaves(device, cq, treeTrunk3, treeBranch3, 3, 7, 0, 0, { 0.10f, 0.20f });
-        Logger::Get()->info("Tree 3 has " + std::to_string(leafData3.Instances.size()) + " leaves");
-
-
         treeTypes.push_back({
-            trunkMesh3,
-            branchData3,
-            leafData3,
+            UploadMesh(device, uploadBatch, data.Trees[2].Trunk, true),
+            UploadMeshInstances(device, uploadBatch, data.Trees[2].Branches,
+                UploadLodMesh(device, uploadBatch, data.Trees[2].Branch)),
+            UploadInstances(device, uploadBatch, data.Trees[2].Leaves),
             0.25f,
             Rendering::PBRMaterial(
                 "bark3_albedo",
@@ -883,40 +1437,16 @@ namespace Gradient::Scene
                 1.f,
                 true
             ),
-            {0.10f, 0.20f}
+            treeRecipes[2].LeafDimensions
             });
 
-        std::vector<Vector2> treePositions
-            = Math::GeneratePoissonDiskSamples(150, 75, 3.f);
-
-        Logger::Get()->info("Generated " + std::to_string(treePositions.size()) + " trees");
-
-        auto& terrainBody = entityManager->Registry.get<RigidBodyComponent>(terrain);
-        auto hfWorld = entityManager->GetWorldMatrix(terrain);
-
-        auto shape = bodyInterface.GetShape(terrainBody.BodyID);
-        const JPH::HeightFieldShape* hfShape = JPH::StaticCast<JPH::HeightFieldShape>(shape);
-
-        size_t leafCount = 0;
-
-        for (int i = 0; i < treePositions.size(); i++)
+        for (int i = 0; i < treeTypes.size(); i++)
         {
-            auto treeIndex = rand() % treeTypes.size();
-
-            AddTree(device, cq, "tree" + std::to_string(i),
-                PlaceOntoHeightField(hfShape,
-                    hfWorld,
-                    treePositions[i],
-                    0.02),
-                treeTypes[treeIndex].Trunk,
-                treeTypes[treeIndex].Branches,
-                treeTypes[treeIndex].Leaves,
-                treeTypes[treeIndex].BarkMaterial,
-                treeTypes[treeIndex].LeafMaterial,
-                treeTypes[treeIndex].LeafDimensions,
-                treeTypes[treeIndex].TrunkRadius);
-
-            leafCount += treeTypes[treeIndex].Leaves.Instances.size();
+            Logger::Get()->info("Tree "
+                + std::to_string(i + 1)
+                + " has "
+                + std::to_string(treeTypes[i].Leaves.InstanceCount)
+                + " leaves");
         }
 
         struct Bush
@@ -927,96 +1457,73 @@ namespace Gradient::Scene
 
         std::vector<Bush> bushTypes;
 
-        Rendering::LSystem bushSystem;
-        bushSystem.AddRule('T', "FFFX");
-        bushSystem.AddRule('X', "F[/+FB[--L]][////+FB[++L]]/////////+FB[-L]");
-        bushSystem.AddRule('B', "FF[/+FB[-L-L]][////+F[+L+L]B[+L+L]]/////////+F[+L+L]B");
-        //bushSystem.AddRule('L', "+^L/&--L/&&+L");
-        //bushSystem.AddRule('L', "+^L/&--L");
-        bushSystem.StartingRadius = 0.01f;
-        bushSystem.RadiusFactor = 1.f;
-        bushSystem.AngleDegrees = 25.7f;
-        bushSystem.MoveDistance = 0.05f;
-
-        bushSystem.Build("T", 6, 3);
-
-        bushTypes.push_back({
-               bm->CreateFromPart(device, cq, bushSystem.GetTrunk(), 0.4f, 0.2f),
-               MakeLeaves(device, cq, bushSystem, {0.06f, 0.06f})
-            });
-
-        Rendering::LSystem bushSystem2;
-        bushSystem2.AddRule('T', "FF\\FX");
-        bushSystem2.AddRule('X', "F[/+FB[--L]][//&//+FB[++L]]//&/+FB[-L]");
-        bushSystem2.AddRule('B', "FF[/+FB[-L-L]][//&//+F[+L+L]B[+L+L]]/^//^/+F[+L+L]B");
-        bushSystem2.StartingRadius = 0.01f;
-        bushSystem2.RadiusFactor = 1.f;
-        bushSystem2.AngleDegrees = 20.f;
-        bushSystem2.MoveDistance = 0.07f;
-
-        bushSystem2.Build("T", 5, 3);
-
-        bushTypes.push_back({
-                bm->CreateFromPart(device, cq, bushSystem2.GetTrunk(), 0.4f, 0.2f),
-                MakeLeaves(device, cq, bushSystem2, {0.06f, 0.06f})
-            });
-
-        Rendering::LSystem bushSystem3;
-        bushSystem3.AddRule('T', "FX");
-        bushSystem3.AddRule('X', "F[/+FB[--L]][////+FB[++L]]/////////+FB[-L]");
-        bushSystem3.AddRule('B', "FF[/+FB[-L]][////+F[+L+L]B[+L]]/////////+F[+L]B");
-        bushSystem3.StartingRadius = 0.015f;
-        bushSystem3.RadiusFactor = 1.f;
-        bushSystem3.AngleDegrees = 30.f;
-        bushSystem3.MoveDistance = 0.05f;
-
-        bushSystem3.Build("T", 8, 3);
-
-        bushTypes.push_back({
-               bm->CreateFromPart(device, cq, bushSystem3.GetTrunk(), 0.4f, 0.2f),
-               MakeLeaves(device, cq, bushSystem3, {0.03f, 0.05f})
-            });
+        for (const auto& bushData : data.Bushes)
+        {
+            bushTypes.push_back({
+                UploadMesh(device, uploadBatch, bushData.Trunk, true),
+                UploadInstances(device, uploadBatch, bushData.Leaves)
+                });
+        }
 
         for (int i = 0; i < bushTypes.size(); i++)
         {
             Logger::Get()->info("Bush " 
                 + std::to_string(i + 1) 
                 + " has "
-                + std::to_string(bushTypes[i].Leaves.Instances.size()) 
+                + std::to_string(bushTypes[i].Leaves.InstanceCount) 
                 + " leaves");
         }
 
-        // To position bushes, rotate the tree position by 90 degrees 
-        // and scale it down slightly. Then jitter a bit
-        auto bushPositionTransform = Matrix::CreateRotationY(DirectX::XMConvertToRadians(90))
-            * Matrix::CreateScale(0.8);
+        auto uploadFinished = uploadBatch.End(cq);
 
-        size_t bushCount = 0;
-        for (int i = 0; i < treePositions.size(); i++)
+        // The entities only need the handles and bounding boxes,
+        // so they can be made while the upload is in flight.
+        Logger::Get()->info("Generated " + std::to_string(data.TreePlacements.size()) + " trees");
+
+        size_t leafCount = 0;
+
+        for (const auto& placement : data.TreePlacements)
         {
-            auto clusterPosition = Vector3(treePositions[i].x, 0, treePositions[i].y);
-            clusterPosition = Vector3::Transform(clusterPosition, bushPositionTransform);
+            const auto& treeType = treeTypes[placement.TypeIndex];
+
+            AddTree(device, cq, "tree" + std::to_string(placement.Cluster),
+                placement.Position,
+                placement.Yaw,
+                treeType.Trunk,
+                treeType.Branches,
+                treeType.Leaves,
+                treeType.BarkMaterial,
+                treeType.LeafMaterial,
+                treeType.LeafDimensions,
+                treeType.TrunkRadius);
+
+            leafCount += treeType.Leaves.InstanceCount;
+        }
 
-            int numBushes = rand() % 10;
-            for (int j = 0; j < numBushes; j++)
-            {
-                auto bushPosition = clusterPosition
-                    + Vector3((rand() % 150 + 33) / 33.f, 0, (rand() % 150 + 33) / 33.f);
-
-                auto bushIndex = rand() % bushTypes.size();
-
-                AddBush(device, cq, "bush" + std::to_string(i) + "-" + std::to_string(j),
-                    PlaceOntoHeightField(hfShape,
-                        hfWorld,
-                        Vector2(bushPosition.x, bushPosition.z),
-                        0.02),
-                    bushTypes[bushIndex].Trunk, bushTypes[bushIndex].Leaves, 0.06f);
-                leafCount += bushTypes[bushIndex].Leaves.Instances.size();
-                bushCount++;
-            }
+        for (const auto& placement : data.BushPlacements)
+        {
+            const auto& bushType = bushTypes[placement.TypeIndex];
+
+            AddBush(device, cq,
+                "bush" + std::to_string(placement.Cluster) + "-" + std::to_string(placement.IndexInCluster),
+                placement.Position,
+                placement.Yaw,
+                bushType.Trunk, bushType.Leaves, 0.06f);
+            leafCount += bushType.Leaves.InstanceCount;
         }
 
-        Logger::Get()->info("Generated " + std::to_string(bushCount) + " bushes");
+        // The buffers are copied into the batch's upload heap when they're
+        // queued, so the mapping is no longer needed.
+        cacheFile.Close();
+
+        uploadFinished.wait();
+
+        auto uploadEnd = std::chrono::high_resolution_clock::now();
+
+        Logger::Get()->info("Uploaded scene assets and created entities in {:.1f} ms",
+            std::chrono::duration<double, std::milli>(uploadEnd - uploadStart).count());
+
+        Logger::Get()->info("Generated " + std::to_string(data.BushPlacements.size()) + " bushes");
         Logger::Get()->info("Generated a total of " + std::to_string(leafCount) + " leaves");
     }
-}
\ No newline at end of file
+}
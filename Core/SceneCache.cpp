@@ -0,0 +1,258 @@
+#include "pch.h"
+
+#include "Core/SceneCache.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace Gradient::SceneCache
+{
+    namespace
+    {
+        constexpr char Magic[4] = { 'G', 'S', 'C', 'N' };
+        // Enough for InstanceData and the SIMD types
+        constexpr uint64_t DataAlignment = 16;
+        constexpr size_t MaxNameLength = 47;
+
+        struct FileHeader
+        {
+            char Magic[4];
+            uint32_t Version;
+            uint64_t Key;
+            uint64_t FileSize;
+            uint32_t NumSections;
+            uint32_t Pad;
+        };
+
+        struct SectionEntry
+        {
+            char Name[MaxNameLength + 1];
+            uint64_t Offset;
+            uint64_t Size;
+            uint32_t ElementSize;
+            uint32_t Pad;
+        };
+
+        uint64_t AlignUp(uint64_t value)
+        {
+            return (value + DataAlignment - 1) & ~(DataAlignment - 1);
+        }
+    }
+
+    void Writer::AddBytes(const std::string& name,
+        const void* data,
+        size_t size,
+        uint32_t elementSize)
+    {
+        assert(name.size() <= MaxNameLength);
+
+        Section section;
+        section.Name = name;
+        section.ElementSize = elementSize;
+        section.Data.resize(size);
+        if (size > 0)
+        {
+            std::memcpy(section.Data.data(), data, size);
+        }
+
+        m_sections.push_back(std::move(section));
+    }
+
+    bool Writer::Write(const std::wstring& path, uint64_t key) const
+    {
+        std::vector<SectionEntry> entries(m_sections.size());
+
+        uint64_t offset = AlignUp(sizeof(FileHeader) + sizeof(SectionEntry) * entries.size());
+
+        for (size_t i = 0; i < m_sections.size(); i++)
+        {
+            auto& entry = entries[i];
+            std::memset(&entry, 0, sizeof(entry));
+            std::memcpy(entry.Name, m_sections[i].Name.data(), m_sections[i].Name.size());
+            entry.Offset = offset;
+            entry.Size = m_sections[i].Data.size();
+            entry.ElementSize = m_sections[i].ElementSize;
+
+            offset = AlignUp(offset + entry.Size);
+        }
+
+        FileHeader header = {};
+        std::memcpy(header.Magic, Magic, sizeof(Magic));
+        header.Version = FormatVersion;
+        header.Key = key;
+        header.FileSize = offset;
+        header.NumSections = static_cast<uint32_t>(entries.size());
+
+        std::filesystem::path finalPath(path);
+        std::filesystem::path tempPath = finalPath;
+        tempPath += L".tmp";
+
+        std::error_code error;
+        if (finalPath.has_parent_path())
+        {
+            std::filesystem::create_directories(finalPath.parent_path(), error);
+        }
+
+        {
+            std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+            if (!file)
+                return false;
+
+            const char padding[DataAlignment] = {};
+            uint64_t written = 0;
+
+            auto writeBytes = [&](const void* data, uint64_t size)
+                {
+                    file.write(static_cast<const char*>(data), size);
+                    written += size;
+                };
+
+            auto pad = [&]()
+                {
+                    writeBytes(padding, AlignUp(written) - written);
+                };
+
+            writeBytes(&header, sizeof(header));
+            writeBytes(entries.data(), sizeof(SectionEntry) * entries.size());
+
+            for (const auto& section : m_sections)
+            {
+                pad();
+                writeBytes(section.Data.data(), section.Data.size());
+            }
+
+            pad();
+
+            if (!file)
+                return false;
+        }
+
+        std::filesystem::rename(tempPath, finalPath, error);
+        return !error;
+    }
+
+    MappedFile::~MappedFile()
+    {
+        Close();
+    }
+
+    bool MappedFile::Open(const std::wstring& path, uint64_t key)
+    {
+        Close();
+
+        m_file = CreateFileW(path.c_str(),
+            GENERIC_READ,
+            FILE_SHARE_READ,
+            nullptr,
+            OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+            nullptr);
+
+        if (m_file == INVALID_HANDLE_VALUE)
+            return false;
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(m_file, &fileSize)
+            || fileSize.QuadPart < static_cast<LONGLONG>(sizeof(FileHeader)))
+        {
+            Close();
+            return false;
+        }
+
+        m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (m_mapping == nullptr)
+        {
+            Close();
+            return false;
+        }
+
+        m_view = static_cast<const uint8_t*>(
+            MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+        if (m_view == nullptr)
+        {
+            Close();
+            return false;
+        }
+
+        m_size = static_cast<size_t>(fileSize.QuadPart);
+
+        const auto header = reinterpret_cast<const FileHeader*>(m_view);
+        const uint64_t tableEnd = sizeof(FileHeader)
+            + sizeof(SectionEntry) * static_cast<uint64_t>(header->NumSections);
+
+        if (std::memcmp(header->Magic, Magic, sizeof(Magic)) != 0
+            || header->Version != FormatVersion
+            || header->Key != key
+            || header->FileSize != m_size
+            || tableEnd > m_size)
+        {
+            Close();
+            return false;
+        }
+
+        const auto entries = reinterpret_cast<const SectionEntry*>(m_view + sizeof(FileHeader));
+        for (uint32_t i = 0; i < header->NumSections; i++)
+        {
+            const auto& entry = entries[i];
+            if (entry.Offset % DataAlignment != 0
+                || entry.Offset > m_size
+                || entry.Size > m_size - entry.Offset
+                || entry.Name[MaxNameLength] != '\0')
+            {
+                Close();
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    void MappedFile::Close()
+    {
+        if (m_view != nullptr)
+        {
+            UnmapViewOfFile(m_view);
+            m_view = nullptr;
+        }
+
+        if (m_mapping != nullptr)
+        {
+            CloseHandle(m_mapping);
+            m_mapping = nullptr;
+        }
+
+        if (m_file != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(m_file);
+            m_file = INVALID_HANDLE_VALUE;
+        }
+
+        m_size = 0;
+    }
+
+    std::pair<const void*, size_t> MappedFile::FindSection(const std::string& name,
+        uint32_t elementSize) const
+    {
+        if (m_view == nullptr)
+            return { nullptr, 0 };
+
+        const auto header = reinterpret_cast<const FileHeader*>(m_view);
+        const auto entries = reinterpret_cast<const SectionEntry*>(m_view + sizeof(FileHeader));
+
+        for (uint32_t i = 0; i < header->NumSections; i++)
+        {
+            const auto& entry = entries[i];
+
+            if (name == entry.Name)
+            {
+                if (entry.ElementSize != elementSize)
+                    return { nullptr, 0 };
+
+                return { m_view + entry.Offset, entry.Size };
+            }
+        }
+
+        return { nullptr, 0 };
+    }
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "pch.h"
+
+#include <span>
+#include <type_traits>
+
+namespace Gradient
+{
+    // 64-bit FNV-1a, for cache keys.
+    class Fnv1a
+    {
+    public:
+        void Add(const void* data, size_t size)
+        {
+            auto bytes = static_cast<const uint8_t*>(data);
+            for (size_t i = 0; i < size; i++)
+            {
+                m_hash ^= bytes[i];
+                m_hash *= 0x100000001B3ull;
+            }
+        }
+
+        template <typename T>
+        void Add(const T& value)
+        {
+            static_assert(std::is_trivially_copyable_v<T>);
+            Add(&value, sizeof(T));
+        }
+
+        void Add(const std::string& value)
+        {
+            // Include the length, so that "ab" + "c" and "a" + "bc" differ.
+            Add(value.size());
+            Add(value.data(), value.size());
+        }
+
+        uint64_t Get() const
+        {
+            return m_hash;
+        }
+
+    private:
+        uint64_t m_hash = 0xCBF29CE484222325ull;
+    };
+
+    // A versioned binary file of named arrays. Each array is aligned and
+    // stored exactly as it's laid out in memory, so a cache can be mapped
+    // and its arrays handed out in place, with no parsing.
+    //
+    // Only trivially copyable types can be stored, and the file is only
+    // meant to be read back by the build that wrote it.
+    namespace SceneCache
+    {
+        // Bump this whenever the file layout changes.
+        constexpr uint32_t FormatVersion = 1;
+
+        class Writer
+        {
+        public:
+            template <typename T>
+            void AddArray(const std::string& name, std::span<const T> data)
+            {
+                static_assert(std::is_trivially_copyable_v<T>);
+                AddBytes(name, data.data(), data.size_bytes(), sizeof(T));
+            }
+
+            template <typename T>
+            void AddValue(const std::string& name, const T& value)
+            {
+                AddArray(name, std::span<const T>(&value, 1));
+            }
+
+            // Writes to a temporary file and renames it, so a
+            // half-written cache is never picked up.
+            bool Write(const std::wstring& path, uint64_t key) const;
+
+        private:
+            struct Section
+            {
+                std::string Name;
+                uint32_t ElementSize;
+                std::vector<uint8_t> Data;
+            };
+
+            void AddBytes(const std::string& name,
+                const void* data,
+                size_t size,
+                uint32_t elementSize);
+
+            std::vector<Section> m_sections;
+        };
+
+        class MappedFile
+        {
+        public:
+            MappedFile() = default;
+            ~MappedFile();
+
+            MappedFile(const MappedFile&) = delete;
+            MappedFile& operator=(const MappedFile&) = delete;
+
+            // Returns false if the file is missing, is from another
+            // version, or was built with a different key.
+            bool Open(const std::wstring& path, uint64_t key);
+            void Close();
+
+            // Returns an empty span if there's no such array,
+            // or its elements aren't of type T.
+            template <typename T>
+            std::span<const T> GetArray(const std::string& name) const
+            {
+                static_assert(std::is_trivially_copyable_v<T>);
+
+                auto [data, size] = FindSection(name, sizeof(T));
+                return std::span<const T>(static_cast<const T*>(data), size / sizeof(T));
+            }
+
+            template <typename T>
+            const T* GetValue(const std::string& name) const
+            {
+                auto array = GetArray<T>(name);
+                return array.size() == 1 ? array.data() : nullptr;
+            }
+
+        private:
+            std::pair<const void*, size_t> FindSection(const std::string& name,
+                uint32_t elementSize) const;
+
+            HANDLE m_file = INVALID_HANDLE_VALUE;
+            HANDLE m_mapping = nullptr;
+            const uint8_t* m_view = nullptr;
+            size_t m_size = 0;
+        };
+    }
+}
@@ -0,0 +1,49 @@
+// Reduces the resolved depth buffer, or the level before, into a level 
+// of the depth pyramid, keeping the farthest depth under each texel.
+// HiZ::Build does the same thing on the CPU.
+
+cbuffer PyramidConstants : register(b0, space0)
+{
+    uint2 g_sourceSize;
+    uint2 g_destSize;
+    // Set for level 0, which reads from the depth buffer
+    uint g_fromDepth;
+};
+
+Texture2D<float> Depth : register(t0, space0);
+RWTexture2D<float> Source : register(u0, space0);
+RWTexture2D<float> Dest : register(u1, space0);
+
+// Level 0 is a power of two no larger than the depth buffer, so its 
+// texels cover up to three pixels across. Every level after it halves.
+void GetFootprint(uint destIndex, uint sourceSize, uint destSize, out uint first, out uint last)
+{
+    first = destIndex * sourceSize / destSize;
+    last = ((destIndex + 1) * sourceSize + destSize - 1) / destSize - 1;
+    last = min(last, sourceSize - 1);
+}
+
+[numthreads(8, 8, 1)]
+void DepthPyramid_CS(uint3 dtid : SV_DispatchThreadID)
+{
+    if (dtid.x >= g_destSize.x || dtid.y >= g_destSize.y)
+    {
+        return;
+    }
+
+    uint firstX, lastX, firstY, lastY;
+    GetFootprint(dtid.x, g_sourceSize.x, g_destSize.x, firstX, lastX);
+    GetFootprint(dtid.y, g_sourceSize.y, g_destSize.y, firstY, lastY);
+
+    float farthest = 0.f;
+    for (uint y = firstY; y <= lastY; y++)
+    {
+        for (uint x = firstX; x <= lastX; x++)
+        {
+            float depth = g_fromDepth ? Depth[uint2(x, y)] : Source[uint2(x, y)];
+            farthest = max(farthest, depth);
+        }
+    }
+
+    Dest[dtid.xy] = farthest;
+}
@@ -9,7 +9,7 @@ Texture2D heightmap : register(t0, space0);
 SamplerState linearSampler : register(s0, space0);
 
 Texture2D albedoMap : register(t0, space2);
-Texture2D shadowMap : register(t1, space2);
+Texture2DArray shadowMap : register(t1, space2);
 Texture2D normalMap : register(t2, space2);
 Texture2D aoMap : register(t3, space2);
 Texture2D metallicMap : register(t4, space2);
@@ -34,7 +34,6 @@ cbuffer Constants : register(b1, space2)
 {
     float3 cameraPosition;
     float uvTiling;
-    float4x4 shadowTransform; // TODO: put this into the light
 }
 
 struct InputType
@@ -75,7 +74,7 @@ float4 Heightmap_PS(InputType input) : SV_TARGET
 
     float3 directRadiance = DirectionalLightContribution(
         N, V, albedo, metalness, roughness, g_directionalLight,
-        shadowMap, shadowMapSampler, shadowTransform, input.worldPosition
+        shadowMap, shadowMapSampler, input.worldPosition
     );
     
     float3 pointRadiance = float3(0, 0, 0);
@@ -0,0 +1,98 @@
+#ifndef __HIZ_HLSLI__
+#define __HIZ_HLSLI__
+
+#ifndef FLT_MAX
+#define FLT_MAX 3.402823466e+38f
+#endif
+
+// Tests against a depth pyramid of the farthest depths, as
+// DepthPyramid_CS builds it. HiZ::IsOccluded does the same test
+// on the CPU, and has to be kept in step with this.
+
+// The box is projected with viewProj, which should be what the pyramid
+// was drawn with. Anything crossing the near plane or off the screen
+// counts as visible, and the frustum test deals with the rest.
+bool IsBoxOccluded(Texture2D<float> hiZ,
+    uint2 size,
+    uint levelCount,
+    matrix viewProj,
+    float3 center,
+    float3 extents)
+{
+    if (levelCount == 0)
+    {
+        return false;
+    }
+
+    float minX = FLT_MAX;
+    float minY = FLT_MAX;
+    float maxX = -FLT_MAX;
+    float maxY = -FLT_MAX;
+    float minDepth = 1.f;
+
+    for (int i = 0; i < 8; i++)
+    {
+        precise float x = (i & 1) ? center.x + extents.x : center.x - extents.x;
+        precise float y = (i & 2) ? center.y + extents.y : center.y - extents.y;
+        precise float z = (i & 4) ? center.z + extents.z : center.z - extents.z;
+
+        precise float clipX = x * viewProj[0].x + y * viewProj[1].x + z * viewProj[2].x + viewProj[3].x;
+        precise float clipY = x * viewProj[0].y + y * viewProj[1].y + z * viewProj[2].y + viewProj[3].y;
+        precise float clipZ = x * viewProj[0].z + y * viewProj[1].z + z * viewProj[2].z + viewProj[3].z;
+        precise float clipW = x * viewProj[0].w + y * viewProj[1].w + z * viewProj[2].w + viewProj[3].w;
+
+        if (clipW <= 0.f || clipZ < 0.f)
+        {
+            return false;
+        }
+
+        precise float u = clipX / clipW * 0.5f + 0.5f;
+        precise float v = 0.5f - clipY / clipW * 0.5f;
+
+        precise float depth = clipZ / clipW;
+
+        minX = min(minX, u);
+        minY = min(minY, v);
+        maxX = max(maxX, u);
+        maxY = max(maxY, v);
+        minDepth = min(minDepth, depth);
+    }
+
+    if (maxX < 0.f || maxY < 0.f || minX > 1.f || minY > 1.f)
+    {
+        return false;
+    }
+
+    minX = max(minX, 0.f);
+    minY = max(minY, 0.f);
+    maxX = min(maxX, 1.f);
+    maxY = min(maxY, 1.f);
+
+    uint lastLevel = levelCount - 1;
+    uint firstX = min(uint(minX * size.x), size.x - 1);
+    uint firstY = min(uint(minY * size.y), size.y - 1);
+    uint lastX = min(uint(maxX * size.x), size.x - 1);
+    uint lastY = min(uint(maxY * size.y), size.y - 1);
+
+    // The finest level where the rectangle covers two by two texels at most
+    uint level = 0;
+    while (level < lastLevel
+        && ((lastX >> level) - (firstX >> level) > 1
+            || (lastY >> level) - (firstY >> level) > 1))
+    {
+        level++;
+    }
+
+    float farthest = 0.f;
+    for (uint ty = firstY >> level; ty <= (lastY >> level); ty++)
+    {
+        for (uint tx = firstX >> level; tx <= (lastX >> level); tx++)
+        {
+            farthest = max(farthest, hiZ.Load(int3(tx, ty, level)));
+        }
+    }
+
+    return minDepth > farthest;
+}
+
+#endif
@@ -0,0 +1,169 @@
+// Compacts the indices of the instances in a buffer that are in the 
+// frustum, and optionally not behind the depth pyramid, in order, 
+// and writes the arguments to draw just those.
+// InstanceCuller::CullOnCpu does the same thing on the CPU, and has 
+// to be kept in step with this.
+
+#include "HiZ.hlsli"
+
+cbuffer CullingConstants : register(b0, space0)
+{
+    matrix g_occlusionViewProj;
+    uint2 g_hiZSize;
+    uint g_hiZLevels;
+};
+
+struct PassData
+{
+    float4 FrustumPlanes[6];
+    uint OcclusionCulling;
+    uint3 Pad;
+};
+
+struct DrawData
+{
+    matrix ParentWorld;
+    float InstanceRadius;
+    uint NumInstances;
+    uint FirstVisible;
+    uint IndexCount;
+    uint InstanceBuffer;
+    uint PassIndex;
+    uint2 Pad;
+};
+
+struct InstanceData
+{
+    float4 LocalPositionWithPad;
+    float4 RotationQuat;
+    float4 TexcoordUAndVRange;
+};
+
+struct DrawIndexedArguments
+{
+    uint IndexCountPerInstance;
+    uint InstanceCount;
+    uint StartIndexLocation;
+    int BaseVertexLocation;
+    uint StartInstanceLocation;
+};
+
+StructuredBuffer<DrawData> Draws : register(t0, space0);
+StructuredBuffer<PassData> Passes : register(t2, space0);
+RWStructuredBuffer<uint> VisibleInstances : register(u0, space0);
+RWStructuredBuffer<DrawIndexedArguments> Arguments : register(u1, space0);
+Texture2D<float> HiZ : register(t1, space0);
+
+#define NUM_THREADS 64
+
+groupshared uint gs_visibleSums[NUM_THREADS];
+groupshared uint gs_numVisible;
+
+static DrawData s_draw;
+static PassData s_pass;
+
+// The sphere is around the instance's origin, with a radius that covers
+// the mesh however it's rotated. The arithmetic is spelled out and 
+// precise, so that it's done in the same order as on the CPU.
+bool IsInstanceVisible(InstanceData instance)
+{
+    precise float3 position = instance.LocalPositionWithPad.xyz;
+    precise float3 center = position.x * s_draw.ParentWorld[0].xyz
+        + position.y * s_draw.ParentWorld[1].xyz
+        + position.z * s_draw.ParentWorld[2].xyz
+        + s_draw.ParentWorld[3].xyz;
+
+    for (int i = 0; i < 6; i++)
+    {
+        float4 plane = s_pass.FrustumPlanes[i];
+        precise float planeDistance = center.x * plane.x
+            + center.y * plane.y
+            + center.z * plane.z
+            + plane.w;
+
+        if (planeDistance < -s_draw.InstanceRadius)
+        {
+            return false;
+        }
+    }
+
+    // The sphere's bounding box, which is all the pyramid test takes
+    if (s_pass.OcclusionCulling)
+    {
+        float3 extents = float3(s_draw.InstanceRadius, s_draw.InstanceRadius, s_draw.InstanceRadius);
+        return !IsBoxOccluded(HiZ, g_hiZSize, g_hiZLevels, g_occlusionViewProj, center, extents);
+    }
+
+    return true;
+}
+
+// One group per draw, for every pass in the frame, which keeps the 
+// visible instances in the order they're in in the buffer. A group can
+// get through a few thousand instances quickly, so there's no need to 
+// split up bigger draws.
+[numthreads(NUM_THREADS, 1, 1)]
+void InstanceCulling_CS(uint gtid : SV_GroupIndex, uint3 gid : SV_GroupID)
+{
+    uint drawIndex = gid.x;
+    s_draw = Draws[drawIndex];
+    s_pass = Passes[s_draw.PassIndex];
+
+    // The same for the whole group, so it needn't be marked non-uniform
+    StructuredBuffer<InstanceData> instances = ResourceDescriptorHeap[s_draw.InstanceBuffer];
+
+    if (gtid == 0)
+    {
+        gs_numVisible = 0;
+    }
+
+    for (uint first = 0; first < s_draw.NumInstances; first += NUM_THREADS)
+    {
+        uint instanceIndex = first + gtid;
+
+        uint visible = 0;
+        if (instanceIndex < s_draw.NumInstances)
+        {
+            visible = IsInstanceVisible(instances[instanceIndex]) ? 1 : 0;
+        }
+
+        // Inclusive prefix sum of the visible flags
+        gs_visibleSums[gtid] = visible;
+        GroupMemoryBarrierWithGroupSync();
+
+        for (uint offset = 1; offset < NUM_THREADS; offset <<= 1)
+        {
+            uint sum = gtid >= offset ? gs_visibleSums[gtid - offset] : 0;
+            GroupMemoryBarrierWithGroupSync();
+            gs_visibleSums[gtid] += sum;
+            GroupMemoryBarrierWithGroupSync();
+        }
+
+        uint numVisible = gs_numVisible;
+
+        if (visible)
+        {
+            VisibleInstances[s_draw.FirstVisible + numVisible + gs_visibleSums[gtid] - 1] = instanceIndex;
+        }
+
+        GroupMemoryBarrierWithGroupSync();
+
+        if (gtid == NUM_THREADS - 1)
+        {
+            gs_numVisible = numVisible + gs_visibleSums[gtid];
+        }
+
+        GroupMemoryBarrierWithGroupSync();
+    }
+
+    if (gtid == 0)
+    {
+        DrawIndexedArguments arguments;
+        arguments.IndexCountPerInstance = s_draw.IndexCount;
+        arguments.InstanceCount = gs_numVisible;
+        arguments.StartIndexLocation = 0;
+        arguments.BaseVertexLocation = 0;
+        arguments.StartInstanceLocation = 0;
+
+        Arguments[drawIndex] = arguments;
+    }
+}
@@ -1,12 +1,19 @@
 #ifndef __LIGHT_STRUCTS_HLSLI__
 #define __LIGHT_STRUCTS_HLSLI__
 
+// Must match MaxShadowCascades in BufferStructs.h
+#define MAX_SHADOW_CASCADES 4
+
 struct DirectionalLight
 {
     float3 colour;
     float irradiance;
     float3 direction;
     float pad;
+    float4x4 shadowTransforms[MAX_SHADOW_CASCADES];
+    uint numCascades;
+    float shadowMapTexelSize;
+    float2 pad2;
 };
 
 struct PointLight
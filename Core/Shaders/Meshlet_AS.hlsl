@@ -0,0 +1,27 @@
+#include "Meshlets.hlsli"
+
+StructuredBuffer<Meshlet> Meshlets : register(t1, space0);
+
+groupshared MeshletPayload s_payload;
+
+// One meshlet per thread. Only the meshlets that pass
+// are handed to Meshlet_MS, in the order they came in.
+[numthreads(MESHLETS_PER_GROUP, 1, 1)]
+void Meshlet_AS(uint dtid : SV_DispatchThreadID)
+{
+    bool visible = false;
+
+    if (dtid < g_numMeshlets)
+    {
+        visible = IsMeshletVisible(Meshlets[dtid]);
+    }
+
+    if (visible)
+    {
+        uint index = WavePrefixCountBits(visible);
+        s_payload.MeshletIndices[index] = dtid;
+    }
+
+    uint numVisible = WaveActiveCountBits(visible);
+    DispatchMesh(numVisible, 1, 1, s_payload);
+}
@@ -0,0 +1,63 @@
+#include "Meshlets.hlsli"
+
+struct VertexType
+{
+    float3 position;
+    float3 normal;
+    float2 tex;
+};
+
+struct OutputType
+{
+    float4 position : SV_POSITION;
+    float2 tex : TEXCOORD0;
+    float3 normal : NORMAL;
+    float3 worldPosition : POSITION1;
+};
+
+StructuredBuffer<VertexType> Vertices : register(t0, space0);
+StructuredBuffer<Meshlet> Meshlets : register(t1, space0);
+StructuredBuffer<uint> MeshletVertices : register(t2, space0);
+StructuredBuffer<uint> MeshletTriangles : register(t3, space0);
+
+#define NUM_THREADS 128
+
+// One meshlet per group, with a vertex and a triangle per thread.
+// The vertices are transformed the same way as in WVP_VS.
+[numthreads(NUM_THREADS, 1, 1)]
+[outputtopology("triangle")]
+void Meshlet_MS(
+    in uint gtid : SV_GroupThreadID,
+    in uint gid : SV_GroupID,
+    in payload MeshletPayload payload,
+    out indices uint3 tris[MAX_MESHLET_TRIANGLES],
+    out vertices OutputType verts[MAX_MESHLET_VERTICES])
+{
+    Meshlet meshlet = Meshlets[payload.MeshletIndices[gid]];
+
+    uint numVertices = meshlet.Counts & 0xff;
+    uint numTriangles = (meshlet.Counts >> 8) & 0xff;
+
+    SetMeshOutputCounts(numVertices, numTriangles);
+
+    if (gtid < numVertices)
+    {
+        VertexType input = Vertices[MeshletVertices[meshlet.VertexOffset + gtid]];
+
+        OutputType output;
+        output.position = mul(float4(input.position, 1), worldViewProjectionMatrix);
+        output.tex = input.tex;
+        output.normal = normalize(mul(input.normal, (float3x3) worldMatrix));
+
+        float4 worldPosHomo = mul(float4(input.position, 1), worldMatrix);
+        output.worldPosition = worldPosHomo.xyz / worldPosHomo.w;
+
+        verts[gtid] = output;
+    }
+
+    if (gtid < numTriangles)
+    {
+        uint packed = MeshletTriangles[meshlet.TriangleOffset + gtid];
+        tris[gtid] = uint3(packed & 0xff, (packed >> 8) & 0xff, (packed >> 16) & 0xff);
+    }
+}
@@ -0,0 +1,96 @@
+#ifndef __MESHLETS_HLSLI__
+#define __MESHLETS_HLSLI__
+
+// Shared by Meshlet_AS and Meshlet_MS. Meshlets::Cull does the
+// same culling on the CPU, and has to be kept in step with this.
+
+#define MESHLETS_PER_GROUP 32
+#define MAX_MESHLET_VERTICES 64
+#define MAX_MESHLET_TRIANGLES 124
+
+cbuffer MatrixBuffer : register(b0, space0)
+{
+    matrix worldMatrix;
+    matrix worldViewProjectionMatrix;
+};
+
+cbuffer MeshletCulling : register(b1, space0)
+{
+    float4 g_cullingFrustumPlanes[6];
+    float3 g_cameraPosition;
+    float g_worldScale;
+    uint g_numMeshlets;
+    uint g_coneCulling;
+};
+
+struct Meshlet
+{
+    float3 Center;
+    float Radius;
+    // Axis and cutoff, as snorm8s
+    uint Cone;
+    uint VertexOffset;
+    uint TriangleOffset;
+    // Vertex count in the low byte, triangle count in the next
+    uint Counts;
+};
+
+struct MeshletPayload
+{
+    uint MeshletIndices[MESHLETS_PER_GROUP];
+};
+
+float UnpackSnorm8(uint packed, uint shift)
+{
+    int value = int(packed << (24 - shift)) >> 24;
+    return float(value) / 127.f;
+}
+
+bool IsMeshletVisible(Meshlet meshlet)
+{
+    precise float3 position = meshlet.Center;
+    precise float3 center = position.x * worldMatrix[0].xyz
+        + position.y * worldMatrix[1].xyz
+        + position.z * worldMatrix[2].xyz
+        + worldMatrix[3].xyz;
+
+    precise float radius = meshlet.Radius * g_worldScale;
+
+    for (int i = 0; i < 6; i++)
+    {
+        float4 plane = g_cullingFrustumPlanes[i];
+        precise float planeDistance = center.x * plane.x
+            + center.y * plane.y
+            + center.z * plane.z
+            + plane.w;
+
+        if (planeDistance < -radius)
+        {
+            return false;
+        }
+    }
+
+    if (g_coneCulling == 0)
+    {
+        return true;
+    }
+
+    float3 axis = float3(UnpackSnorm8(meshlet.Cone, 0),
+        UnpackSnorm8(meshlet.Cone, 8),
+        UnpackSnorm8(meshlet.Cone, 16));
+    float cutoff = UnpackSnorm8(meshlet.Cone, 24);
+
+    // The scale is uniform, so only the axis needs rotating
+    precise float3 worldAxis = (axis.x * worldMatrix[0].xyz
+        + axis.y * worldMatrix[1].xyz
+        + axis.z * worldMatrix[2].xyz) / g_worldScale;
+
+    precise float3 view = center - g_cameraPosition;
+    precise float viewDistance = sqrt(view.x * view.x + view.y * view.y + view.z * view.z);
+
+    // Back-facing from anywhere in the sphere
+    precise float facing = view.x * worldAxis.x + view.y * worldAxis.y + view.z * worldAxis.z;
+    return facing < cutoff * viewDistance + radius;
+}
+
+#endif
@@ -183,14 +183,13 @@ float3 DirectionalLightContribution(float3 N,
     float metallic,
     float roughness,
     DirectionalLight light,
-    Texture2D shadowMap,
+    Texture2DArray shadowMap,
     SamplerComparisonState shadowMapSampler,
-    float4x4 shadowTransform,
     float3 worldPosition)
 {
     float shadowFactor = calculateShadowFactor(shadowMap,
         shadowMapSampler,
-        shadowTransform,
+        light,
         worldPosition);
     
     if (shadowFactor < 0.001f)
@@ -213,15 +212,14 @@ float3 DirectionalLightContributionWithSSS(float3 N,
     float metallic,
     float roughness,
     DirectionalLight light,
-    Texture2D shadowMap,
+    Texture2DArray shadowMap,
     SamplerComparisonState shadowMapSampler,
-    float4x4 shadowTransform,
     float3 worldPosition,
     float3 sss)
 {
     float shadowFactor = calculateShadowFactor(shadowMap,
         shadowMapSampler,
-        shadowTransform,
+        light,
         worldPosition);
     
     if (shadowFactor < 0.001f)
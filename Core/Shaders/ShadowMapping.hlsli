@@ -4,23 +4,51 @@
 #include "CubeMap.hlsli"
 #include "LightStructs.hlsli"
 
+// Finds the first cascade whose shadow map contains the position. 
+// Cascades are ordered from nearest to farthest, so this picks the
+// sharpest one. Returns false if the position is outside all of them.
+bool selectShadowCascade(
+    DirectionalLight light,
+    float3 worldPosition,
+    out float4 shadowUV,
+    out uint cascade)
+{
+    shadowUV = float4(0, 0, 0, 1);
+    cascade = 0;
+    
+    for (uint i = 0; i < light.numCascades; i++)
+    {
+        // TODO: Move this multiplication to the vertex shader
+        float4 uv = mul(float4(worldPosition, 1.f), light.shadowTransforms[i]);
+        uv.xyz /= uv.w;
+        
+        // Keep clear of the edges, so the PCF kernel stays in the map
+        float margin = 3.f * light.shadowMapTexelSize;
+        
+        if (all(uv.xy >= margin)
+            && all(uv.xy <= 1.f - margin)
+            && uv.z >= 0
+            && uv.z <= 1)
+        {
+            shadowUV = uv;
+            cascade = i;
+            return true;
+        }
+    }
+    
+    return false;
+}
+
 float calculateShadowFactor(
-    Texture2D shadowMap,
+    Texture2DArray shadowMap,
     SamplerComparisonState shadowMapSampler,
-    float4x4 shadowTransform,
+    DirectionalLight light,
     float3 worldPosition)
 {
-    // TODO: Move this multiplication to the vertex shader
-    float4 shadowUV = mul(float4(worldPosition, 1.f), shadowTransform);
-    
-    shadowUV.xyz /= shadowUV.w;
+    float4 shadowUV;
+    uint cascade;
     
-    if (shadowUV.x < 0
-        || shadowUV.x > 1
-        || shadowUV.y < 0
-        || shadowUV.y > 1
-        || shadowUV.z < 0 
-        || shadowUV.z > 1)
+    if (!selectShadowCascade(light, worldPosition, shadowUV, cascade))
     {
         return 1.f;
     }
@@ -45,8 +73,7 @@ float calculateShadowFactor(
     float constant = 1.f / (dpdx.x * dpdy.y - dpdy.x * dpdx.y);
     float2 zPartials = constant * mul(float2(dpdx.z, dpdy.z), right);
     
-    // TODO: Pass the shadow map resolution through
-    const float dx = 1.f / 4096.f;
+    const float dx = light.shadowMapTexelSize;
     
     // Use a dithered pattern to obtain a result similar to 16 
     // samples per pixel.
@@ -85,7 +112,7 @@ float calculateShadowFactor(
     {
         float2 finalOffsets = offsets[i] * dx;
         shadowFactor += saturate(shadowMap.SampleCmpLevelZero(shadowMapSampler,
-            shadowUV.xy + finalOffsets,
+            float3(shadowUV.xy + finalOffsets, cascade),
             shadowUV.z + dot(finalOffsets, zPartials)
         ).r);
     }
@@ -94,28 +121,21 @@ float calculateShadowFactor(
 }
 
 float calculateShadowFactorNoLargeKernel(
-    Texture2D shadowMap,
+    Texture2DArray shadowMap,
     SamplerComparisonState shadowMapSampler,
-    float4x4 shadowTransform,
+    DirectionalLight light,
     float3 worldPosition)
 {
-    // TODO: Move this multiplication to the vertex shader
-    float4 shadowUV = mul(float4(worldPosition, 1.f), shadowTransform);
-    
-    shadowUV.xyz /= shadowUV.w;
+    float4 shadowUV;
+    uint cascade;
     
-    if (shadowUV.x < 0
-        || shadowUV.x > 1
-        || shadowUV.y < 0
-        || shadowUV.y > 1
-        || shadowUV.z < 0
-        || shadowUV.z > 1)
+    if (!selectShadowCascade(light, worldPosition, shadowUV, cascade))
     {
         return 1.f;
     }
     
     return saturate(shadowMap.SampleCmpLevelZero(shadowMapSampler,
-            shadowUV.xy,
+            float3(shadowUV.xy, cascade),
             shadowUV.z));
 }
 
@@ -6,7 +6,7 @@
 SamplerState linearSampler : register(s0, space3);
 SamplerComparisonState shadowMapSampler : register(s1, space3);
 
-Texture2D shadowMap : register(t1, space3);
+Texture2DArray shadowMap : register(t1, space3);
 TextureCube environmentMap : register(t2, space3);
 TextureCubeArray pointShadowMaps : register(t3, space3);
 
@@ -23,7 +23,6 @@ cbuffer Constants : register(b1, space3)
 {
     float3 cameraPosition;
     float maxAmplitude;
-    float4x4 shadowTransform; // TODO: put this into the light
     float thicknessPower;
     float sharpness;
     float refractiveIndex;
@@ -67,7 +66,7 @@ float4 Water_PS(InputType input) : SV_TARGET
     
     float3 directRadiance = DirectionalLightContribution(
         N, V, albedo, metalness, roughness, g_directionalLight,
-        shadowMap, shadowMapSampler, shadowTransform, input.worldPosition
+        shadowMap, shadowMapSampler, input.worldPosition
     );
 
     float3 directSSS = directionalLightSSS(g_directionalLight,
@@ -5,7 +5,7 @@
 #include "Utils.hlsli"
 
 Texture2D albedoMap : register(t0, space1);
-Texture2D shadowMap : register(t1, space1);
+Texture2DArray shadowMap : register(t1, space1);
 Texture2D normalMap : register(t2, space1);
 Texture2D aoMap : register(t3, space1);
 Texture2D metalnessMap : register(t4, space1);
@@ -33,7 +33,6 @@ cbuffer Constants : register(b1, space1)
     float uvTiling;
     float3 emissiveRadiance;
     float pad2;
-    float4x4 shadowTransform; // TODO: put this into the light
 };
 
 struct InputType
@@ -73,7 +72,7 @@ float4 PBR_PS(InputType input) : SV_TARGET
     
     float3 directRadiance = DirectionalLightContribution(
         N, V, albedo, metalness, roughness, g_directionalLight,
-        shadowMap, shadowMapSampler, shadowTransform, input.worldPosition
+        shadowMap, shadowMapSampler, input.worldPosition
     );
 
     float3 pointRadiance = float3(0, 0, 0);
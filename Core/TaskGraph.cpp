@@ -0,0 +1,124 @@
+#include "Core/TaskGraph.h"
+#include "Core/Jobs/JobSystem.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+
+namespace Gradient
+{
+    TaskGraph::TaskHandle TaskGraph::AddTask(const std::string& name,
+        std::function<void()> fn,
+        const std::vector<TaskHandle>& dependencies)
+    {
+        TaskHandle handle = m_tasks.size();
+
+        for (auto dependency : dependencies)
+        {
+            assert(dependency < handle);
+        }
+
+        m_tasks.push_back({ name, std::move(fn), dependencies });
+
+        return handle;
+    }
+
+    void TaskGraph::Run()
+    {
+        auto jobSystem = Jobs::JobSystem::Get();
+        assert(jobSystem != nullptr);
+
+        Run(*jobSystem);
+    }
+
+    void TaskGraph::Run(Jobs::JobSystem& jobSystem)
+    {
+        if (m_tasks.empty())
+            return;
+
+        std::vector<std::atomic<size_t>> remainingDependencies(m_tasks.size());
+        std::vector<std::vector<TaskHandle>> dependents(m_tasks.size());
+
+        for (TaskHandle i = 0; i < m_tasks.size(); i++)
+        {
+            remainingDependencies[i].store(m_tasks[i].Dependencies.size());
+
+            for (auto dependency : m_tasks[i].Dependencies)
+            {
+                dependents[dependency].push_back(i);
+            }
+        }
+
+        Jobs::JobCounter counter;
+
+        // A task submits its dependents before its own job finishes,
+        // so the counter can't reach zero until every task has run.
+        std::function<void(TaskHandle)> submit = [&](TaskHandle handle)
+            {
+                jobSystem.Submit([&, handle]()
+                    {
+                        auto& task = m_tasks[handle];
+                        auto start = std::chrono::high_resolution_clock::now();
+                        task.Fn();
+                        auto end = std::chrono::high_resolution_clock::now();
+                        task.Milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+
+                        for (auto dependent : dependents[handle])
+                        {
+                            if (remainingDependencies[dependent].fetch_sub(1) == 1)
+                            {
+                                submit(dependent);
+                            }
+                        }
+                    }, &counter);
+            };
+
+        for (TaskHandle i = 0; i < m_tasks.size(); i++)
+        {
+            if (m_tasks[i].Dependencies.empty())
+            {
+                submit(i);
+            }
+        }
+
+        jobSystem.Wait(counter);
+    }
+
+    size_t TaskGraph::GetTaskCount() const
+    {
+        return m_tasks.size();
+    }
+
+    double TaskGraph::GetTaskMilliseconds(TaskHandle handle) const
+    {
+        return m_tasks[handle].Milliseconds;
+    }
+
+    double TaskGraph::GetCriticalPathMilliseconds() const
+    {
+        // Tasks only depend on earlier tasks, so this
+        // is already a topological order.
+        std::vector<double> finishTimes(m_tasks.size());
+        double out = 0;
+
+        for (TaskHandle i = 0; i < m_tasks.size(); i++)
+        {
+            double start = 0;
+            for (auto dependency : m_tasks[i].Dependencies)
+            {
+                start = std::max(start, finishTimes[dependency]);
+            }
+
+            finishTimes[i] = start + m_tasks[i].Milliseconds;
+            out = std::max(out, finishTimes[i]);
+        }
+
+        return out;
+    }
+
+    const std::string& TaskGraph::GetTaskName(TaskHandle handle) const
+    {
+        return m_tasks[handle].Name;
+    }
+}
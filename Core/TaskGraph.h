@@ -0,0 +1,56 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace Gradient::Jobs
+{
+    class JobSystem;
+}
+
+// Nothing here touches D3D12 or the precompiled header, so the
+// graph can be built and checked on any platform.
+namespace Gradient
+{
+    // A set of CPU tasks with dependencies between them.
+    // Run() executes every task after all of its dependencies have
+    // finished, and runs independent tasks in parallel on the JobSystem.
+    //
+    // Tasks should only write to their own outputs, so the results
+    // don't depend on the order in which the workers pick them up.
+    class TaskGraph
+    {
+    public:
+        using TaskHandle = size_t;
+
+        // Dependencies must have been added before this task,
+        // which rules out cycles.
+        TaskHandle AddTask(const std::string& name,
+            std::function<void()> fn,
+            const std::vector<TaskHandle>& dependencies = {});
+
+        // On the engine's job system
+        void Run();
+        void Run(Jobs::JobSystem& jobSystem);
+
+        size_t GetTaskCount() const;
+        // Valid after Run()
+        double GetTaskMilliseconds(TaskHandle handle) const;
+        // The longest chain of dependent tasks, in milliseconds.
+        // No amount of threads can make Run() faster than this.
+        double GetCriticalPathMilliseconds() const;
+        const std::string& GetTaskName(TaskHandle handle) const;
+
+    private:
+        struct Task
+        {
+            std::string Name;
+            std::function<void()> Fn;
+            std::vector<TaskHandle> Dependencies;
+            double Milliseconds = 0;
+        };
+
+        std::vector<Task> m_tasks;
+    };
+}
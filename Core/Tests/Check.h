@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+// Nothing here touches D3D12, so the portable tests
+// can be built and run on any platform.
+namespace Gradient::Tests
+{
+    // Collects the checks that fail, so every test gets to run
+    // and the runner can report all of them before it fails.
+    class Results
+    {
+    public:
+        // Returns the condition, so a test can skip what depends on it
+        bool Check(bool condition, std::string description)
+        {
+            m_numChecks++;
+            if (!condition)
+            {
+                m_failures.push_back(std::move(description));
+            }
+            return condition;
+        }
+
+        int GetCheckCount() const
+        {
+            return m_numChecks;
+        }
+
+        const std::vector<std::string>& GetFailures() const
+        {
+            return m_failures;
+        }
+
+    private:
+        int m_numChecks = 0;
+        std::vector<std::string> m_failures;
+    };
+}
@@ -0,0 +1,138 @@
+#include "pch.h"
+
+#include "Core/Tests/Tests.h"
+#include "Core/Math.h"
+#include "Core/Jobs/JobSystem.h"
+#include "Core/Rendering/BoundingVolumeHierarchy.h"
+
+#include <random>
+
+namespace Gradient::Tests
+{
+    namespace
+    {
+        // What the tree's plane test does for one box
+        bool IsInsidePlanes(const DirectX::BoundingBox& box,
+            const std::array<DirectX::XMFLOAT4, 6>& planes)
+        {
+            for (const auto& plane : planes)
+            {
+                float distance = plane.x * box.Center.x
+                    + plane.y * box.Center.y
+                    + plane.z * box.Center.z
+                    + plane.w;
+                float radius = std::abs(plane.x) * box.Extents.x
+                    + std::abs(plane.y) * box.Extents.y
+                    + std::abs(plane.z) * box.Extents.z;
+
+                if (distance + radius < 0)
+                    return false;
+            }
+
+            return true;
+        }
+    }
+
+    void RunCullingTests(Results& results)
+    {
+        using namespace DirectX::SimpleMath;
+        using Rendering::BoundingVolumeHierarchy;
+
+        constexpr uint32_t numItems = 10000;
+
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<float> positionDist(-200.f, 200.f);
+        std::uniform_real_distribution<float> sizeDist(0.5f, 4.f);
+
+        std::vector<BoundingVolumeHierarchy::Item> items(numItems);
+        for (uint32_t i = 0; i < numItems; i++)
+        {
+            items[i].Bounds = DirectX::BoundingBox(
+                Vector3(positionDist(rng), positionDist(rng) * 0.1f, positionDist(rng)),
+                Vector3(sizeDist(rng), sizeDist(rng), sizeDist(rng)));
+            items[i].Id = i;
+        }
+
+        BoundingVolumeHierarchy bvh;
+        bvh.Build(items);
+
+        auto frustum = Math::MakeFrustum(
+            Matrix::CreateLookAt(Vector3(0, 10, 0), Vector3(1, 9, 1), Vector3::UnitY),
+            Matrix::CreatePerspectiveFieldOfView(DirectX::XM_PIDIV4, 16.f / 9.f, 0.1f, 150.f));
+        auto planes = Math::GetPlanes(frustum);
+
+        Jobs::JobSystem jobSystem(3);
+
+        // The plane query has to return exactly what testing every
+        // item would, whether or not it's shared out across threads
+        auto checkPlaneQuery = [&](const std::string& when)
+            {
+                std::vector<uint32_t> expected;
+                for (const auto& item : items)
+                {
+                    if (IsInsidePlanes(item.Bounds, planes))
+                    {
+                        expected.push_back(item.Id);
+                    }
+                }
+
+                std::vector<uint32_t> ids;
+                bvh.Query(planes, ids);
+                std::sort(ids.begin(), ids.end());
+
+                results.Check(ids == expected,
+                    "plane query " + when + " found " + std::to_string(ids.size())
+                    + " items, testing each found " + std::to_string(expected.size()));
+
+                ids.clear();
+                bvh.Query(planes, ids, jobSystem);
+                std::sort(ids.begin(), ids.end());
+
+                results.Check(ids == expected,
+                    "threaded plane query " + when + " found " + std::to_string(ids.size())
+                    + " items, testing each found " + std::to_string(expected.size()));
+            };
+
+        checkPlaneQuery("after building");
+
+        // A tenth of the items move, and the tree is refitted around them
+        std::uniform_real_distribution<float> moveDist(-20.f, 20.f);
+        for (uint32_t i = 0; i < numItems; i += 10)
+        {
+            items[i].Bounds.Center.x += moveDist(rng);
+            items[i].Bounds.Center.z += moveDist(rng);
+            bvh.SetBounds(i, items[i].Bounds);
+        }
+        bvh.Refit();
+
+        checkPlaneQuery("after refitting");
+
+        // The other queries may be conservative, but mustn't miss anything
+        auto checkNoneMissed = [&](const std::string& name, auto&& volume)
+            {
+                std::vector<uint32_t> ids;
+                bvh.Query(volume, ids);
+                std::sort(ids.begin(), ids.end());
+
+                bool noneMissed = true;
+                for (const auto& item : items)
+                {
+                    if (volume.Intersects(item.Bounds)
+                        && !std::binary_search(ids.begin(), ids.end(), item.Id))
+                    {
+                        noneMissed = false;
+                    }
+                }
+
+                results.Check(noneMissed, name + " query missed an intersecting item");
+                results.Check(std::adjacent_find(ids.begin(), ids.end()) == ids.end(),
+                    name + " query returned an item twice");
+            };
+
+        checkNoneMissed("frustum", frustum);
+        checkNoneMissed("sphere", DirectX::BoundingSphere(Vector3(20.f, 0.f, -30.f), 25.f));
+        checkNoneMissed("oriented box", DirectX::BoundingOrientedBox(Vector3(-40.f, 0.f, 10.f),
+            Vector3(30.f, 10.f, 5.f),
+            Quaternion::CreateFromAxisAngle(Vector3::UnitY, 0.6f)));
+    }
+}
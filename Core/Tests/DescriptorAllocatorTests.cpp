@@ -0,0 +1,214 @@
+#include "Core/Tests/PortableTests.h"
+#include "Core/DescriptorAllocator.h"
+#include "Core/IndexFreeList.h"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+namespace Gradient::Tests
+{
+    namespace
+    {
+        // The allocator's other tests cover the list under contention
+        void TestFreeList(Results& results)
+        {
+            constexpr uint32_t capacity = 4;
+            IndexFreeList list(capacity);
+
+            uint32_t held[capacity];
+            bool allocated = true;
+            for (uint32_t i = 0; i < capacity; i++)
+            {
+                allocated = allocated && list.TryAllocate(held[i]) && held[i] == i;
+            }
+            results.Check(allocated, "a new list didn't hand out its indices in order");
+
+            uint32_t index;
+            results.Check(!list.TryAllocate(index) && index == IndexFreeList::InvalidIndex,
+                "trying to allocate from a full list didn't fail");
+
+            list.Free(held[1]);
+            list.Free(held[3]);
+            results.Check(list.TryAllocate(index) && index == held[3],
+                "the last index freed wasn't the first handed back");
+            results.Check(list.TryAllocate(index) && index == held[1],
+                "a freed index was lost");
+            results.Check(list.GetHighWaterMark() == capacity,
+                "the high water mark doesn't count every index");
+        }
+
+        void TestFencedFrees(Results& results)
+        {
+            constexpr uint32_t capacity = 16;
+            DescriptorAllocator allocator(capacity);
+
+            std::vector<uint32_t> held;
+            for (uint32_t i = 0; i < capacity; i++)
+            {
+                held.push_back(allocator.Allocate());
+            }
+
+            std::sort(held.begin(), held.end());
+            results.Check(std::adjacent_find(held.begin(), held.end()) == held.end()
+                && held.back() < capacity,
+                "filling the allocator didn't hand out every index once");
+            results.Check(allocator.GetHighWaterMark() == capacity,
+                "the high water mark doesn't count every index");
+
+            bool threw = false;
+            try
+            {
+                allocator.Allocate();
+            }
+            catch (const std::runtime_error&)
+            {
+                threw = true;
+            }
+            results.Check(threw, "allocating from a full allocator didn't throw");
+
+            // Nothing comes back until the fence has passed it
+            allocator.FreeAfter(held[0], 2);
+            allocator.FreeAfter(held[1], 3);
+            allocator.Reclaim(1);
+
+            threw = false;
+            try
+            {
+                allocator.Allocate();
+            }
+            catch (const std::runtime_error&)
+            {
+                threw = true;
+            }
+            results.Check(threw, "an index came back before its fence was reached");
+
+            allocator.Reclaim(2);
+            results.Check(allocator.Allocate() == held[0],
+                "reaching the fence didn't hand back the index waiting on it");
+
+            allocator.Free(held[2]);
+            results.Check(allocator.Allocate() == held[2],
+                "freeing an index didn't hand it back straight away");
+
+            allocator.Reclaim(3);
+            results.Check(allocator.Allocate() == held[1],
+                "the index waiting on a later fence was lost");
+        }
+
+        void TestConcurrentUse(Results& results)
+        {
+            constexpr uint32_t capacity = 4096;
+            constexpr int numOperations = 100000;
+
+            // Every thread allocates and frees at once, half of the frees waiting
+            // on a fence that another thread keeps advancing and reclaiming. No
+            // index may ever be handed to two owners at the same time.
+            const uint32_t numThreads = std::clamp(std::thread::hardware_concurrency(), 2u, 16u);
+            constexpr uint32_t maxHeldPerThread = 128;
+
+            DescriptorAllocator shared(capacity);
+            std::vector<std::atomic<uint8_t>> owned(capacity);
+            std::atomic<uint64_t> completedFence = 0;
+            std::atomic<bool> stop = false;
+            std::atomic<bool> doubleAllocated = false;
+
+            std::thread reclaimer([&]()
+                {
+                    while (!stop.load())
+                    {
+                        shared.Reclaim(completedFence.fetch_add(1) + 1);
+                        std::this_thread::yield();
+                    }
+                });
+
+            std::vector<std::thread> workers;
+            for (uint32_t t = 0; t < numThreads; t++)
+            {
+                workers.emplace_back([&, t]()
+                    {
+                        std::mt19937 rng(t);
+                        std::vector<uint32_t> mine;
+                        mine.reserve(maxHeldPerThread);
+
+                        for (int i = 0; i < numOperations; i++)
+                        {
+                            if (mine.size() < maxHeldPerThread && (rng() & 1))
+                            {
+                                uint32_t index;
+                                try
+                                {
+                                    index = shared.Allocate();
+                                }
+                                catch (const std::runtime_error&)
+                                {
+                                    // Everything free is still waiting on the fence
+                                    continue;
+                                }
+
+                                if (owned[index].exchange(1) != 0)
+                                {
+                                    doubleAllocated = true;
+                                }
+                                mine.push_back(index);
+                            }
+                            else if (!mine.empty())
+                            {
+                                auto index = mine.back();
+                                mine.pop_back();
+                                owned[index] = 0;
+
+                                if (rng() & 1)
+                                {
+                                    shared.Free(index);
+                                }
+                                else
+                                {
+                                    shared.FreeAfter(index, completedFence.load() + 1);
+                                }
+                            }
+                        }
+
+                        for (auto index : mine)
+                        {
+                            owned[index] = 0;
+                            shared.Free(index);
+                        }
+                    });
+            }
+
+            for (auto& worker : workers)
+            {
+                worker.join();
+            }
+
+            stop = true;
+            reclaimer.join();
+
+            results.Check(!doubleAllocated, "an index was handed to two owners at once");
+
+            // Once the fence has passed everything, every index should be free exactly once
+            shared.Reclaim(std::numeric_limits<uint64_t>::max());
+            std::vector<uint8_t> seen(capacity);
+            bool unique = true;
+            for (uint32_t i = 0; i < capacity && unique; i++)
+            {
+                auto index = shared.Allocate();
+                unique = index < capacity && seen[index] == 0;
+                if (unique) seen[index] = 1;
+            }
+
+            results.Check(unique, "an index was free more than once after reclaiming everything");
+        }
+    }
+
+    void RunDescriptorAllocatorTests(Results& results)
+    {
+        TestFreeList(results);
+        TestFencedFrees(results);
+        TestConcurrentUse(results);
+    }
+}
@@ -0,0 +1,99 @@
+#include "pch.h"
+
+#include "Core/Tests/Tests.h"
+#include "Core/FrameArena.h"
+#include "Core/HeapAllocations.h"
+#include "Core/Math.h"
+#include "Core/Rendering/BoundingVolumeHierarchy.h"
+#include "Core/Rendering/RenderQueue.h"
+
+#include <random>
+
+namespace Gradient::Tests
+{
+    void RunFrameArenaTests(Results& results)
+    {
+        using namespace DirectX::SimpleMath;
+        using Rendering::BoundingVolumeHierarchy;
+        using Rendering::RenderQueue;
+
+        constexpr int numFrames = 10;
+        constexpr int warmupFrames = 3;
+        constexpr uint32_t numItems = 10000;
+
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<float> positionDist(-200.f, 200.f);
+        std::uniform_int_distribution<uint32_t> materialDist(0, 99);
+        std::uniform_real_distribution<float> angleDist(0.f, DirectX::XM_2PI);
+
+        std::vector<BoundingVolumeHierarchy::Item> items(numItems);
+        for (uint32_t i = 0; i < numItems; i++)
+        {
+            items[i].Bounds = DirectX::BoundingBox(
+                Vector3(positionDist(rng), positionDist(rng) * 0.1f, positionDist(rng)),
+                Vector3(1.f));
+            items[i].Id = i;
+        }
+
+        BoundingVolumeHierarchy bvh;
+        bvh.Build(items);
+
+        std::vector<std::array<DirectX::XMFLOAT4, 6>> views;
+        for (int i = 0; i < 8; i++)
+        {
+            float angle = angleDist(rng);
+            auto frustum = Math::MakeFrustum(
+                Matrix::CreateLookAt(Vector3(0, 10, 0), Vector3(std::sin(angle), 9.5f, std::cos(angle)), Vector3::UnitY),
+                Matrix::CreatePerspectiveFieldOfView(DirectX::XM_PIDIV4, 16.f / 9.f, 0.1f, 150.f));
+            views.push_back(Math::GetPlanes(frustum));
+        }
+
+        // The CPU side of the render path, with everything it keeps
+        // between frames kept here: a culling query per view, which
+        // keeps its traversal stack in the arena, then a render queue
+        // sorted across the job system.
+        std::vector<uint32_t> visibleIds;
+        RenderQueue queue;
+        auto frame = [&]()
+            {
+                for (const auto& planes : views)
+                {
+                    visibleIds.clear();
+                    bvh.Query(planes, visibleIds);
+
+                    queue.Clear();
+                    for (auto id : visibleIds)
+                    {
+                        queue.Add(RenderQueue::MakeKey(RenderQueue::Pipeline::Pbr,
+                            RenderQueue::DrawType::PixelDepthReadOnly,
+                            false,
+                            id % 100,
+                            id % 1000,
+                            static_cast<float>(id)),
+                            static_cast<entt::entity>(id));
+                    }
+                    queue.Sort(true);
+                }
+
+                FrameArena::ResetAll();
+            };
+
+        for (int i = 0; i < warmupFrames; i++)
+        {
+            frame();
+        }
+
+        // Once warmed up, frames shouldn't touch the heap at all,
+        // through the arena or anything else on any thread.
+        auto allocationsBefore = HeapAllocations::GetCount();
+        for (int i = 0; i < numFrames; i++)
+        {
+            frame();
+        }
+
+        // Read before the check, which allocates its description
+        const auto numAllocations = HeapAllocations::GetCount() - allocationsBefore;
+        results.Check(numAllocations == 0,
+            "warmed up frames made " + std::to_string(numAllocations) + " heap allocations");
+    }
+}
@@ -0,0 +1,255 @@
+#include "pch.h"
+
+#include "Core/Tests/Tests.h"
+#include "Core/Math.h"
+#include "Core/Rendering/InstanceCuller.h"
+#include "Core/Rendering/InstanceLodSelector.h"
+#include "Core/Rendering/ProceduralMesh.h"
+
+#include <random>
+
+namespace Gradient::Tests
+{
+    namespace
+    {
+        using namespace DirectX::SimpleMath;
+        using Rendering::InstanceCuller;
+        using Rendering::InstanceLodSelector;
+        using Rendering::ProceduralMesh;
+
+        void TestInstanceCulling(Results& results)
+        {
+            auto frustum = Math::MakeFrustum(
+                Matrix::CreateLookAt(Vector3(0, 10, 0), Vector3(1, 9, 1), Vector3::UnitY),
+                Matrix::CreatePerspectiveFieldOfView(DirectX::XM_PIDIV4, 16.f / 9.f, 0.1f, 300.f));
+            auto planes = Math::GetPlanes(frustum);
+
+            // A branch mesh, placed off its origin like the L-system parts are
+            DirectX::BoundingBox meshBounds(Vector3(0.f, 1.5f, 0.f), Vector3(0.3f, 1.5f, 0.3f));
+
+            constexpr uint32_t numInstances = 10000;
+
+            std::mt19937 rng(1);
+            std::uniform_real_distribution<float> positionDist(-200.f, 200.f);
+            std::uniform_real_distribution<float> angleDist(0.f, DirectX::XM_2PI);
+
+            std::vector<BufferManager::InstanceData> instances(numInstances);
+            for (auto& instance : instances)
+            {
+                instance.Position = Vector3(positionDist(rng), positionDist(rng) * 0.1f, positionDist(rng));
+                instance.RotationQuat = Quaternion::CreateFromYawPitchRoll(angleDist(rng), angleDist(rng), 0.f);
+            }
+
+            Matrix world = Matrix::CreateScale(1.5f) * Matrix::CreateTranslation(50.f, 0.f, 50.f);
+            float radius = InstanceCuller::GetInstanceRadius(meshBounds, world);
+
+            std::vector<uint32_t> visible;
+            uint32_t numVisible = InstanceCuller::CullOnCpu(instances, world, radius, planes, visible);
+
+            results.Check(numVisible == visible.size()
+                && std::is_sorted(visible.begin(), visible.end())
+                && std::adjacent_find(visible.begin(), visible.end()) == visible.end(),
+                "the visible instances weren't each listed once, in order");
+
+            // Every instance whose mesh is in the frustum has to be kept
+            bool noneMissed = true;
+            for (uint32_t i = 0; i < numInstances; i++)
+            {
+                const auto& instance = instances[i];
+                Matrix instanceWorld = Matrix::CreateFromQuaternion(instance.RotationQuat)
+                    * Matrix::CreateTranslation(instance.Position)
+                    * world;
+
+                DirectX::BoundingOrientedBox instanceBox;
+                DirectX::BoundingOrientedBox::CreateFromBoundingBox(instanceBox, meshBounds);
+                instanceBox.Transform(instanceBox, instanceWorld);
+
+                if (frustum.Intersects(instanceBox))
+                {
+                    noneMissed = noneMissed && std::binary_search(visible.begin(), visible.end(), i);
+                }
+            }
+
+            results.Check(noneMissed, "an instance in the frustum was culled");
+        }
+
+        void TestInstanceLods(Results& results)
+        {
+            // A bent branch, a frustum at a time like the L-system builds it
+            std::mt19937 rng(1);
+            std::uniform_real_distribution<float> bendDist(-0.15f, 0.15f);
+
+            std::vector<ProceduralMesh::AngledFrustumParameters> segments;
+            Vector3 bottom = Vector3::Zero;
+            Quaternion rotation = Quaternion::Identity;
+            float radius = 0.2f;
+            for (int i = 0; i < 40; i++)
+            {
+                auto bend = Quaternion::CreateFromYawPitchRoll(bendDist(rng), bendDist(rng), bendDist(rng));
+                segments.push_back({ bottom, rotation, radius, radius * 0.97f, Vector3(0, 0.1f, 0), bend });
+
+                bottom += Vector3::Transform(Vector3(0, 0.1f, 0), rotation);
+                rotation = bend * rotation;
+                radius *= 0.97f;
+            }
+
+            auto branch = ProceduralMesh::Optimize(ProceduralMesh::CreateAngledFrustumParts(segments, 8));
+            auto meshBounds = ProceduralMesh::ComputeBoundingBox(branch.Vertices);
+            auto lodChain = ProceduralMesh::BuildLodChain(branch.Vertices, branch.Indices);
+
+            // Each level should be smaller, and no more accurate, than the last
+            results.Check(!lodChain.Lods.empty(), "the LOD chain is empty");
+            for (size_t i = 0; i < lodChain.Lods.size(); i++)
+            {
+                const auto& lod = lodChain.Lods[i];
+                results.Check(lod.FirstIndex + lod.IndexCount <= lodChain.Indices.size()
+                    && (i == 0 || (lod.IndexCount < lodChain.Lods[i - 1].IndexCount
+                        && lod.Error >= lodChain.Lods[i - 1].Error)),
+                    "LOD " + std::to_string(i) + " doesn't follow on from the one before it");
+            }
+
+            InstanceLodSelector::View view{
+                Vector3(0, 10, 0),
+                // A 1080p view with a 45 degree vertical field of view
+                0.5f * 1080.f / std::tan(DirectX::XM_PIDIV4 * 0.5f),
+                1.f
+            };
+
+            auto frustum = Math::MakeFrustum(
+                Matrix::CreateLookAt(view.CameraPosition, Vector3(1, 9, 1), Vector3::UnitY),
+                Matrix::CreatePerspectiveFieldOfView(DirectX::XM_PIDIV4, 16.f / 9.f, 0.1f, 300.f));
+            auto planes = Math::GetPlanes(frustum);
+
+            // Runs of nearby branches, like the trees in the scene have
+            constexpr uint32_t numInstances = 10000;
+            std::uniform_real_distribution<float> treeDist(-200.f, 200.f);
+            std::uniform_real_distribution<float> branchDist(-3.f, 3.f);
+            std::uniform_real_distribution<float> angleDist(0.f, DirectX::XM_2PI);
+
+            std::vector<BufferManager::InstanceData> instances(numInstances);
+            Vector3 treePosition;
+            for (uint32_t i = 0; i < numInstances; i++)
+            {
+                if (i % 100 == 0)
+                {
+                    treePosition = Vector3(treeDist(rng), 0.f, treeDist(rng));
+                }
+
+                instances[i].Position = treePosition
+                    + Vector3(branchDist(rng), branchDist(rng) + 5.f, branchDist(rng));
+                instances[i].RotationQuat = Quaternion::CreateFromYawPitchRoll(angleDist(rng), angleDist(rng), 0.f);
+            }
+
+            Matrix world = Matrix::CreateScale(1.5f) * Matrix::CreateTranslation(50.f, 0.f, 50.f);
+
+            const float instanceRadius = InstanceCuller::GetInstanceRadius(meshBounds, world);
+            std::vector<uint32_t> visibleInstances;
+            InstanceCuller::CullOnCpu(instances, world, instanceRadius, planes, visibleInstances);
+
+            // A wall across the whole view, 30 units in front of the camera
+            constexpr uint32_t depthWidth = 256;
+            constexpr uint32_t depthHeight = 144;
+            const Matrix viewProj = Matrix::CreateLookAt(view.CameraPosition, Vector3(1, 9, 1), Vector3::UnitY)
+                * Matrix::CreatePerspectiveFieldOfView(DirectX::XM_PIDIV4, 16.f / 9.f, 0.1f, 300.f);
+            auto forward = Vector3(1, -1, 1);
+            forward.Normalize();
+            const Vector3 wallPoint = view.CameraPosition + 30.f * forward;
+            auto wallClip = Vector4::Transform(Vector4(wallPoint.x, wallPoint.y, wallPoint.z, 1.f), viewProj);
+
+            std::vector<float> depths(depthWidth * depthHeight, wallClip.z / wallClip.w);
+            Rendering::HiZ::Pyramid pyramid;
+            Rendering::HiZ::Build(depths, depthWidth, depthHeight, viewProj, pyramid);
+            const Rendering::HiZ::Pyramid* occluders[] = { &pyramid };
+
+            std::vector<uint32_t> unoccludedInstances;
+            InstanceCuller::CullOnCpu(instances, world, instanceRadius, planes, unoccludedInstances, &pyramid);
+
+            for (uint32_t clusterSize : { 1u, InstanceLodSelector::DefaultClusterSize })
+            {
+                const std::string prefix = "clusters of " + std::to_string(clusterSize) + ": ";
+
+                auto clusters = InstanceLodSelector::BuildClusters(instances, meshBounds, clusterSize);
+
+                InstanceLodSelector selector;
+                selector.Select(clusters, lodChain.Lods, world, view, planes);
+
+                // Each visible cluster's instances should be in its level's
+                // range exactly once, in order, and nothing else should be.
+                auto bucketed = selector.GetInstances();
+                auto ranges = selector.GetRanges();
+                auto clusterLods = selector.GetClusterLods();
+
+                if (!results.Check(ranges.size() == lodChain.Lods.size(),
+                    prefix + "there isn't a range for every level"))
+                    continue;
+
+                std::vector<uint32_t> expected;
+                for (uint32_t lod = 0; lod < ranges.size(); lod++)
+                {
+                    expected.clear();
+                    for (size_t i = 0; i < clusters.size(); i++)
+                    {
+                        if (clusterLods[i] != lod) continue;
+
+                        for (uint32_t j = 0; j < clusters[i].InstanceCount; j++)
+                        {
+                            expected.push_back(clusters[i].FirstInstance + j);
+                        }
+                    }
+
+                    const auto& range = ranges[lod];
+                    results.Check(range.InstanceCount == expected.size()
+                        && range.FirstInstance + range.InstanceCount <= bucketed.size()
+                        && std::equal(expected.begin(),
+                            expected.end(),
+                            bucketed.begin() + range.FirstInstance),
+                        prefix + "level " + std::to_string(lod) + " has the wrong instances");
+                }
+
+                // Culling a cluster shouldn't cull any of its instances
+                // that are in the frustum.
+                std::vector<uint32_t> instanceLods(numInstances, InstanceLodSelector::Culled);
+                for (size_t i = 0; i < clusters.size(); i++)
+                {
+                    for (uint32_t j = 0; j < clusters[i].InstanceCount; j++)
+                    {
+                        instanceLods[clusters[i].FirstInstance + j] = clusterLods[i];
+                    }
+                }
+
+                bool noneMissed = true;
+                for (auto index : visibleInstances)
+                {
+                    noneMissed = noneMissed && instanceLods[index] != InstanceLodSelector::Culled;
+                }
+
+                results.Check(noneMissed, prefix + "a cluster culled an instance in the frustum");
+
+                // Behind the wall, whole clusters should go, but never
+                // one with an instance that the wall doesn't hide.
+                auto numCulled = std::count(clusterLods.begin(), clusterLods.end(), InstanceLodSelector::Culled);
+
+                selector.Select(clusters, lodChain.Lods, world, view, planes, occluders);
+                clusterLods = selector.GetClusterLods();
+
+                bool noneHidden = true;
+                for (auto index : unoccludedInstances)
+                {
+                    auto cluster = std::find_if(clusters.begin(), clusters.end(),
+                        [&](const auto& c) { return index >= c.FirstInstance && index < c.FirstInstance + c.InstanceCount; });
+                    noneHidden = noneHidden && clusterLods[cluster - clusters.begin()] != InstanceLodSelector::Culled;
+                }
+
+                results.Check(std::count(clusterLods.begin(), clusterLods.end(), InstanceLodSelector::Culled) > numCulled,
+                    prefix + "the occluders didn't cull any clusters");
+                results.Check(noneHidden, prefix + "the occluders culled a cluster with an unhidden instance");
+            }
+        }
+    }
+
+    void RunInstanceTests(Results& results)
+    {
+        TestInstanceCulling(results);
+        TestInstanceLods(results);
+    }
+}
@@ -0,0 +1,191 @@
+#include "Core/Tests/PortableTests.h"
+#include "Core/Jobs/JobSystem.h"
+#include "Core/HeapAllocations.h"
+
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace Gradient::Tests
+{
+    namespace
+    {
+        using Jobs::JobCounter;
+        using Jobs::JobSystem;
+
+        void TestParallelFor(Results& results, JobSystem& jobSystem)
+        {
+            constexpr size_t count = 100000;
+            std::vector<uint32_t> visits(count);
+
+            jobSystem.ParallelFor(count, 1000, [&](size_t begin, size_t end)
+                {
+                    for (size_t i = begin; i < end; i++)
+                    {
+                        visits[i]++;
+                    }
+                });
+
+            bool once = true;
+            for (auto v : visits)
+            {
+                once = once && v == 1;
+            }
+            results.Check(once, "ParallelFor didn't visit every index once");
+        }
+
+        void TestExceptions(Results& results, JobSystem& jobSystem)
+        {
+            constexpr int numJobs = 64;
+
+            // A throwing job still counts as done, and the rest still run
+            JobCounter counter;
+            std::atomic<int> numRan = 0;
+            for (int i = 0; i < numJobs; i++)
+            {
+                jobSystem.Submit([&numRan, i]()
+                    {
+                        numRan++;
+                        if (i == numJobs / 2)
+                            throw std::runtime_error("job failed");
+                    }, &counter);
+            }
+
+            bool threw = false;
+            try
+            {
+                jobSystem.Wait(counter);
+            }
+            catch (const std::runtime_error&)
+            {
+                threw = true;
+            }
+
+            results.Check(threw, "Wait didn't rethrow a job's exception");
+            results.Check(numRan == numJobs, "a job that threw stopped the others from running");
+
+            // The exception is only rethrown once
+            jobSystem.Submit([]() {}, &counter);
+            threw = false;
+            try
+            {
+                jobSystem.Wait(counter);
+            }
+            catch (...)
+            {
+                threw = true;
+            }
+            results.Check(!threw, "a counter rethrew an exception it had already rethrown");
+
+            // Every other batch has to finish before ParallelFor rethrows,
+            // since they all refer to its stack. Both the batches run as
+            // jobs and the one run by the caller can throw.
+            constexpr size_t numBatches = 32;
+            for (size_t failing : { size_t(0), numBatches - 1 })
+            {
+                std::atomic<size_t> numFinished = 0;
+                threw = false;
+                try
+                {
+                    jobSystem.ParallelFor(numBatches, 1, [&](size_t begin, size_t)
+                        {
+                            if (begin == failing)
+                                throw std::runtime_error("batch failed");
+
+                            std::this_thread::yield();
+                            numFinished++;
+                        });
+                }
+                catch (const std::runtime_error&)
+                {
+                    threw = true;
+                    results.Check(numFinished == numBatches - 1,
+                        "ParallelFor rethrew before its other batches had finished");
+                }
+
+                results.Check(threw, "ParallelFor didn't rethrow batch "
+                    + std::to_string(failing) + "'s exception");
+            }
+        }
+
+        void TestPooledJobs(Results& results, JobSystem& jobSystem)
+        {
+            constexpr int numFrames = 10;
+            constexpr int numJobs = 1000;
+
+            // Shaped like a frame's work, submitted from a thread that
+            // isn't a worker so that it goes through the shared queue.
+            std::atomic<int> numRan = 0;
+            auto frame = [&]()
+                {
+                    JobCounter counter;
+                    for (int i = 0; i < numJobs; i++)
+                    {
+                        jobSystem.Submit([&numRan]() { numRan++; }, &counter);
+                    }
+                    jobSystem.Wait(counter);
+                };
+
+            frame();
+
+            const auto allocationsBefore = HeapAllocations::GetCount();
+            for (int i = 0; i < numFrames; i++)
+            {
+                frame();
+            }
+
+            // Read before the check, which allocates its description
+            const auto numAllocations = HeapAllocations::GetCount() - allocationsBefore;
+            results.Check(numAllocations == 0, "submitting jobs allocated from the heap");
+            results.Check(numRan == numJobs * (numFrames + 1), "a pooled job never ran");
+        }
+
+        void TestConcurrentSubmits(Results& results, JobSystem& jobSystem)
+        {
+            // Threads that aren't workers submit through the shared queue,
+            // and workers submit to their own deques, both at once.
+            constexpr int numThreads = 4;
+            constexpr int numJobs = 2000;
+
+            std::atomic<int> numRan = 0;
+            std::vector<std::thread> threads;
+            for (int t = 0; t < numThreads; t++)
+            {
+                threads.emplace_back([&]()
+                    {
+                        JobCounter counter;
+                        for (int i = 0; i < numJobs; i++)
+                        {
+                            jobSystem.Submit([&]()
+                                {
+                                    JobCounter inner;
+                                    jobSystem.Submit([&]() { numRan++; }, &inner);
+                                    jobSystem.Wait(inner);
+                                    numRan++;
+                                }, &counter);
+                        }
+                        jobSystem.Wait(counter);
+                    });
+            }
+
+            for (auto& thread : threads)
+            {
+                thread.join();
+            }
+
+            results.Check(numRan == numThreads * numJobs * 2, "a submitted job never ran");
+        }
+    }
+
+    void RunJobSystemTests(Results& results)
+    {
+        // A system of its own, so that the tests don't depend on the engine's
+        JobSystem jobSystem(3);
+
+        TestParallelFor(results, jobSystem);
+        TestExceptions(results, jobSystem);
+        TestPooledJobs(results, jobSystem);
+        TestConcurrentSubmits(results, jobSystem);
+    }
+}
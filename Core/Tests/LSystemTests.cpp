@@ -0,0 +1,114 @@
+#include "pch.h"
+
+#include "Core/Tests/Tests.h"
+#include "Core/Rendering/LSystem.h"
+#include "Core/Rendering/LSystemDefinitions.h"
+
+#include <unordered_map>
+
+namespace Gradient::Tests
+{
+    namespace
+    {
+        // Expands one generation at a time, the obvious way
+        std::string ExpandNaively(const Rendering::LSystemDefinition& definition)
+        {
+            std::unordered_map<char, std::string> rules(
+                definition.Rules.begin(), definition.Rules.end());
+
+            std::string current = definition.StartingRule;
+            for (int i = 0; i < definition.NumGenerations; i++)
+            {
+                std::string next;
+                for (char c : current)
+                {
+                    auto rule = rules.find(c);
+                    next += rule != rules.end() ? rule->second : std::string(1, c);
+                }
+                current = std::move(next);
+            }
+
+            return current;
+        }
+
+        float MaxDifference(const DirectX::SimpleMath::Vector3& a,
+            const DirectX::SimpleMath::Vector3& b)
+        {
+            return std::max({ std::abs(a.x - b.x), std::abs(a.y - b.y), std::abs(a.z - b.z) });
+        }
+    }
+
+    void RunLSystemTests(Results& results)
+    {
+        for (const auto& [name, definition] : Rendering::LSystemDefinitions::All)
+        {
+            const std::string prefix = std::string(name) + ": ";
+
+            Rendering::LSystem lsystem;
+            definition.Configure(lsystem);
+
+            const auto expected = ExpandNaively(definition);
+
+            results.Check(lsystem.Expand(definition.StartingRule, definition.NumGenerations) == expected,
+                prefix + "parallel expansion differs from expanding naively");
+            results.Check(lsystem.ExpandedLength(definition.StartingRule, definition.NumGenerations) == expected.size(),
+                prefix + "expanded length is wrong");
+
+            std::string streamed;
+            lsystem.ForEachExpandedSymbol(definition.StartingRule,
+                definition.NumGenerations,
+                [&streamed](char c)
+                {
+                    streamed += c;
+                });
+            results.Check(streamed == expected,
+                prefix + "streamed symbols differ from expanding naively");
+
+            // The compiled turtle program folds rotations together,
+            // so it only has to match the reference to rounding.
+            Rendering::LSystem reference;
+            definition.Configure(reference);
+            reference.UseReferenceInterpreter = true;
+            reference.Build(definition.StartingRule, definition.NumGenerations, definition.NumVerticalSections);
+
+            Rendering::LSystem compiled;
+            definition.Configure(compiled);
+            compiled.Build(definition.StartingRule, definition.NumGenerations, definition.NumVerticalSections);
+
+            const auto& referenceTrunk = reference.GetTrunk();
+            const auto& compiledTrunk = compiled.GetTrunk();
+            if (results.Check(referenceTrunk.Vertices.size() == compiledTrunk.Vertices.size()
+                && referenceTrunk.Indices == compiledTrunk.Indices,
+                prefix + "compiled trunk has a different topology to the reference"))
+            {
+                float maxError = 0.f;
+                for (size_t i = 0; i < referenceTrunk.Vertices.size(); i++)
+                {
+                    maxError = std::max(maxError,
+                        MaxDifference(referenceTrunk.Vertices[i].position, compiledTrunk.Vertices[i].position));
+                }
+                results.Check(maxError < 1e-4f,
+                    prefix + "compiled trunk is " + std::to_string(maxError) + " away from the reference");
+            }
+
+            const auto& referenceLeaves = reference.GetLeafTransforms();
+            const auto& compiledLeaves = compiled.GetLeafTransforms();
+            if (results.Check(referenceLeaves.size() == compiledLeaves.size(),
+                prefix + "compiled leaf count differs from the reference"))
+            {
+                float maxError = 0.f;
+                for (size_t i = 0; i < referenceLeaves.size(); i++)
+                {
+                    maxError = std::max(maxError,
+                        MaxDifference(referenceLeaves[i].Translation, compiledLeaves[i].Translation));
+
+                    // q and -q are the same rotation
+                    const float dot = std::abs(referenceLeaves[i].Rotation.Dot(compiledLeaves[i].Rotation));
+                    maxError = std::max(maxError, 1.f - dot);
+                }
+                results.Check(maxError < 1e-4f,
+                    prefix + "compiled leaves are " + std::to_string(maxError) + " away from the reference");
+            }
+        }
+    }
+}
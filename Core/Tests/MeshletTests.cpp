@@ -0,0 +1,318 @@
+#include "Core/Tests/PortableTests.h"
+#include "Core/Rendering/Meshlets.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+namespace Gradient::Tests
+{
+    namespace
+    {
+        namespace Meshlets = Rendering::Meshlets;
+        using DirectX::XMFLOAT3;
+        using DirectX::XMFLOAT4;
+        using DirectX::XMFLOAT4X4;
+
+        // Only the plain structs from DirectXMath are used here, so
+        // the vector maths is spelled out instead.
+        XMFLOAT3 Add(const XMFLOAT3& a, const XMFLOAT3& b)
+        {
+            return XMFLOAT3(a.x + b.x, a.y + b.y, a.z + b.z);
+        }
+
+        XMFLOAT3 Subtract(const XMFLOAT3& a, const XMFLOAT3& b)
+        {
+            return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z);
+        }
+
+        XMFLOAT3 Scale(const XMFLOAT3& a, float s)
+        {
+            return XMFLOAT3(a.x * s, a.y * s, a.z * s);
+        }
+
+        float Dot(const XMFLOAT3& a, const XMFLOAT3& b)
+        {
+            return a.x * b.x + a.y * b.y + a.z * b.z;
+        }
+
+        XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b)
+        {
+            return XMFLOAT3(a.y * b.z - a.z * b.y,
+                a.z * b.x - a.x * b.z,
+                a.x * b.y - a.y * b.x);
+        }
+
+        float Length(const XMFLOAT3& a)
+        {
+            return std::sqrt(Dot(a, a));
+        }
+
+        XMFLOAT3 Normalize(const XMFLOAT3& a)
+        {
+            return Scale(a, 1.f / Length(a));
+        }
+
+        // Row vectors, as DirectXMath and the shaders use them
+        XMFLOAT3 Transform(const XMFLOAT3& p, const XMFLOAT4X4& m)
+        {
+            return XMFLOAT3(p.x * m._11 + p.y * m._21 + p.z * m._31 + m._41,
+                p.x * m._12 + p.y * m._22 + p.z * m._32 + m._42,
+                p.x * m._13 + p.y * m._23 + p.z * m._33 + m._43);
+        }
+
+        // Scales uniformly, turns about Y and then moves, like the trees in the scene
+        XMFLOAT4X4 MakeWorld(float scale, float angle, const XMFLOAT3& translation)
+        {
+            const float c = std::cos(angle) * scale;
+            const float s = std::sin(angle) * scale;
+
+            return XMFLOAT4X4(
+                c, 0.f, -s, 0.f,
+                0.f, scale, 0.f, 0.f,
+                s, 0.f, c, 0.f,
+                translation.x, translation.y, translation.z, 1.f);
+        }
+
+        // Facing inwards, so that points inside are in front of every plane
+        std::array<XMFLOAT4, 6> MakeFrustumPlanes(const XMFLOAT3& eye,
+            const XMFLOAT3& target,
+            float fieldOfView,
+            float aspectRatio,
+            float nearPlane,
+            float farPlane)
+        {
+            const XMFLOAT3 forward = Normalize(Subtract(target, eye));
+            const XMFLOAT3 right = Normalize(Cross(forward, XMFLOAT3(0.f, 1.f, 0.f)));
+            const XMFLOAT3 up = Cross(right, forward);
+
+            const float tanY = std::tan(fieldOfView * 0.5f);
+            const float tanX = tanY * aspectRatio;
+
+            auto plane = [&eye](const XMFLOAT3& normal, float offset)
+                {
+                    const float length = Length(normal);
+                    return XMFLOAT4(normal.x / length,
+                        normal.y / length,
+                        normal.z / length,
+                        (offset - Dot(normal, eye)) / length);
+                };
+
+            return {
+                plane(forward, -nearPlane),
+                plane(Scale(forward, -1.f), farPlane),
+                plane(Add(Scale(forward, tanX), right), 0.f),
+                plane(Subtract(Scale(forward, tanX), right), 0.f),
+                plane(Add(Scale(forward, tanY), up), 0.f),
+                plane(Subtract(Scale(forward, tanY), up), 0.f),
+            };
+        }
+
+        struct Mesh
+        {
+            std::vector<XMFLOAT3> Positions;
+            std::vector<uint32_t> Indices;
+        };
+
+        // A tapering tube that bends as it rises, like a trunk
+        Mesh CreateTube(uint32_t numRings, uint32_t numSides, float bend)
+        {
+            Mesh mesh;
+
+            XMFLOAT3 centre(0.f, 0.f, 0.f);
+            for (uint32_t ring = 0; ring < numRings; ring++)
+            {
+                const float radius = 0.5f * (1.f - 0.6f * ring / numRings);
+                for (uint32_t side = 0; side < numSides; side++)
+                {
+                    const float angle = 6.2831853f * side / numSides;
+                    mesh.Positions.push_back(Add(centre,
+                        XMFLOAT3(radius * std::cos(angle), 0.f, radius * std::sin(angle))));
+                }
+
+                centre = Add(centre, XMFLOAT3(bend * std::sin(0.3f * ring), 0.25f, bend * std::cos(0.2f * ring)));
+            }
+
+            for (uint32_t ring = 0; ring + 1 < numRings; ring++)
+            {
+                for (uint32_t side = 0; side < numSides; side++)
+                {
+                    const uint32_t a = ring * numSides + side;
+                    const uint32_t b = ring * numSides + (side + 1) % numSides;
+                    const uint32_t c = a + numSides;
+                    const uint32_t d = b + numSides;
+
+                    mesh.Indices.insert(mesh.Indices.end(), { a, c, b, b, c, d });
+                }
+            }
+
+            return mesh;
+        }
+    }
+
+    void RunMeshletTests(Results& results)
+    {
+        struct NamedMesh
+        {
+            const char* Name;
+            Mesh Tube;
+        };
+
+        const NamedMesh meshes[] = {
+            { "straight tube", CreateTube(40, 12, 0.f) },
+            { "bent tube", CreateTube(120, 16, 0.2f) },
+            { "thin tube", CreateTube(400, 5, 0.05f) },
+        };
+
+        for (const auto& [name, mesh] : meshes)
+        {
+            const std::string prefix = std::string(name) + ": ";
+
+            auto meshlets = Meshlets::Build(&mesh.Positions[0].x,
+                mesh.Positions.size(),
+                sizeof(XMFLOAT3),
+                mesh.Indices);
+
+            // Every triangle should be in exactly one meshlet, wound the
+            // same way, and no meshlet should be more than Meshlet_MS outputs.
+            auto canonical = [](uint32_t a, uint32_t b, uint32_t c)
+                {
+                    if (b < a && b < c) return std::array<uint32_t, 3>{ b, c, a };
+                    if (c < a && c < b) return std::array<uint32_t, 3>{ c, a, b };
+                    return std::array<uint32_t, 3>{ a, b, c };
+                };
+
+            std::vector<std::array<uint32_t, 3>> expected;
+            for (size_t i = 0; i + 2 < mesh.Indices.size(); i += 3)
+            {
+                expected.push_back(canonical(mesh.Indices[i], mesh.Indices[i + 1], mesh.Indices[i + 2]));
+            }
+
+            bool inRange = true;
+            std::vector<std::array<uint32_t, 3>> built;
+            for (const auto& meshlet : meshlets.Meshlets)
+            {
+                const uint32_t numVertices = Meshlets::GetVertexCount(meshlet);
+                const uint32_t numTriangles = Meshlets::GetTriangleCount(meshlet);
+                inRange = numVertices <= Meshlets::MaxVertices
+                    && numTriangles <= Meshlets::MaxTriangles
+                    && meshlet.VertexOffset + numVertices <= meshlets.Vertices.size()
+                    && meshlet.TriangleOffset + numTriangles <= meshlets.Triangles.size();
+                if (!inRange) break;
+
+                for (uint32_t i = 0; i < numTriangles && inRange; i++)
+                {
+                    const uint32_t packed = meshlets.Triangles[meshlet.TriangleOffset + i];
+                    std::array<uint32_t, 3> local = { packed & 0xff, (packed >> 8) & 0xff, (packed >> 16) & 0xff };
+                    inRange = local[0] < numVertices && local[1] < numVertices && local[2] < numVertices;
+                    if (!inRange) break;
+
+                    built.push_back(canonical(meshlets.Vertices[meshlet.VertexOffset + local[0]],
+                        meshlets.Vertices[meshlet.VertexOffset + local[1]],
+                        meshlets.Vertices[meshlet.VertexOffset + local[2]]));
+                }
+            }
+
+            if (!results.Check(inRange, prefix + "a meshlet is bigger than Meshlet_MS outputs or out of range"))
+                continue;
+
+            std::sort(expected.begin(), expected.end());
+            std::sort(built.begin(), built.end());
+            results.Check(built == expected, prefix + "the meshlets don't hold every triangle exactly once");
+
+            const auto world = MakeWorld(1.5f, 0.7f, XMFLOAT3(20.f, 0.f, -10.f));
+
+            XMFLOAT3 boundsMin = Transform(mesh.Positions[0], world);
+            XMFLOAT3 boundsMax = boundsMin;
+            for (const auto& position : mesh.Positions)
+            {
+                const auto p = Transform(position, world);
+                boundsMin = XMFLOAT3(std::min(boundsMin.x, p.x), std::min(boundsMin.y, p.y), std::min(boundsMin.z, p.z));
+                boundsMax = XMFLOAT3(std::max(boundsMax.x, p.x), std::max(boundsMax.y, p.y), std::max(boundsMax.z, p.z));
+            }
+
+            const XMFLOAT3 center = Scale(Add(boundsMin, boundsMax), 0.5f);
+            const float extent = 0.5f * Length(Subtract(boundsMax, boundsMin));
+
+            struct CameraSetup
+            {
+                const char* Name;
+                XMFLOAT3 Position;
+                XMFLOAT3 Target;
+            };
+
+            const CameraSetup cameras[] = {
+                { "far", Add(center, Scale(XMFLOAT3(3.f, 0.5f, 0.f), extent)), center },
+                { "near", Add(center, Scale(XMFLOAT3(0.f, 0.f, 0.8f), extent)), center },
+                { "from below", XMFLOAT3(center.x + extent, boundsMin.y + 1.f, center.z), center },
+                { "off to the side", Add(center, Scale(XMFLOAT3(-2.f, 0.f, 0.f), extent)), Add(center, Scale(XMFLOAT3(-2.f, 0.f, 1.5f), extent)) },
+            };
+
+            std::vector<uint32_t> visibleMeshlets;
+            std::vector<uint8_t> meshletVisible;
+
+            for (const auto& camera : cameras)
+            {
+                const auto planes = MakeFrustumPlanes(camera.Position,
+                    camera.Target,
+                    0.785398f,
+                    16.f / 9.f,
+                    0.1f,
+                    1000.f);
+
+                Meshlets::CullAll(meshlets.Meshlets,
+                    world,
+                    camera.Position,
+                    planes,
+                    true,
+                    visibleMeshlets);
+
+                // A triangle that's in the frustum and faces the camera must
+                // be in a visible meshlet. The rasterizer culls counterclockwise
+                // triangles after the right-handed projection, which are the
+                // ones whose normals, by the winding, face away.
+                meshletVisible.assign(meshlets.Meshlets.size(), 0);
+                for (auto index : visibleMeshlets)
+                {
+                    meshletVisible[index] = 1;
+                }
+
+                bool noneMissed = true;
+                for (size_t m = 0; m < meshlets.Meshlets.size(); m++)
+                {
+                    const auto& meshlet = meshlets.Meshlets[m];
+                    for (uint32_t i = 0; i < Meshlets::GetTriangleCount(meshlet); i++)
+                    {
+                        const uint32_t packed = meshlets.Triangles[meshlet.TriangleOffset + i];
+                        XMFLOAT3 p[3];
+                        for (int k = 0; k < 3; k++)
+                        {
+                            const uint32_t local = (packed >> (8 * k)) & 0xff;
+                            p[k] = Transform(mesh.Positions[meshlets.Vertices[meshlet.VertexOffset + local]], world);
+                        }
+
+                        const XMFLOAT3 normal = Cross(Subtract(p[1], p[0]), Subtract(p[2], p[0]));
+                        const XMFLOAT3 toCamera = Subtract(camera.Position, p[0]);
+                        if (Dot(normal, toCamera) <= 1e-3f * Length(normal) * Length(toCamera))
+                            continue;
+
+                        bool inFrustum = true;
+                        for (const auto& plane : planes)
+                        {
+                            for (const auto& point : p)
+                            {
+                                inFrustum = inFrustum
+                                    && point.x * plane.x + point.y * plane.y + point.z * plane.z + plane.w > 1e-3f;
+                            }
+                        }
+
+                        noneMissed = noneMissed && (!inFrustum || meshletVisible[m]);
+                    }
+                }
+
+                results.Check(noneMissed,
+                    prefix + "seen " + camera.Name + ", a meshlet with a front-facing triangle in view was culled");
+            }
+        }
+    }
+}
@@ -0,0 +1,233 @@
+#include "pch.h"
+
+#include "Core/Tests/Tests.h"
+#include "Core/Rendering/DepthRasterizer.h"
+#include "Core/Rendering/HiZ.h"
+#include "Core/Rendering/SoftwareOcclusionCuller.h"
+
+#include <random>
+
+namespace Gradient::Tests
+{
+    namespace
+    {
+        using namespace DirectX::SimpleMath;
+        using Rendering::DepthRasterizer;
+        using Rendering::SoftwareOcclusionCuller;
+        namespace HiZ = Rendering::HiZ;
+
+        // Rolling hills, laid out like the scene's terrain
+        struct Hills
+        {
+            static constexpr uint32_t SampleCount = 257;
+            static constexpr float GridWidth = 400.f;
+            static constexpr float TerrainHeight = 40.f;
+
+            std::vector<float> Heights;
+
+            Hills()
+                : Heights(SampleCount * SampleCount)
+            {
+                for (uint32_t z = 0; z < SampleCount; z++)
+                {
+                    for (uint32_t x = 0; x < SampleCount; x++)
+                    {
+                        Heights[z * SampleCount + x] = 0.5f
+                            + 0.25f * std::sin(x * 0.05f) * std::cos(z * 0.07f)
+                            + 0.25f * std::sin(z * 0.11f + x * 0.02f);
+                    }
+                }
+            }
+
+            float HeightAt(float worldX, float worldZ) const
+            {
+                const float scale = GridWidth / (SampleCount - 1);
+                const auto x = std::min(static_cast<uint32_t>((worldX + GridWidth / 2.f) / scale), SampleCount - 1);
+                const auto z = std::min(static_cast<uint32_t>((worldZ + GridWidth / 2.f) / scale), SampleCount - 1);
+                return Heights[z * SampleCount + x] * TerrainHeight;
+            }
+
+            // Trees standing on the terrain, all over it
+            std::vector<DirectX::BoundingBox> CreateBoxes() const
+            {
+                std::mt19937 rng(1);
+                std::uniform_real_distribution<float> positionDist(-GridWidth / 2.f + 10.f, GridWidth / 2.f - 10.f);
+                std::uniform_real_distribution<float> sizeDist(0.5f, 3.f);
+
+                std::vector<DirectX::BoundingBox> boxes(10000);
+                for (auto& box : boxes)
+                {
+                    const float x = positionDist(rng);
+                    const float z = positionDist(rng);
+                    const float size = sizeDist(rng);
+                    box.Center = Vector3(x, HeightAt(x, z) + size * 2.f, z);
+                    box.Extents = Vector3(size, size * 2.f, size);
+                }
+                return boxes;
+            }
+
+            Matrix CreateViewProj() const
+            {
+                const Vector3 cameraPosition(0.f, HeightAt(0.f, -180.f) + 4.f, -180.f);
+                return Matrix::CreateLookAt(cameraPosition, Vector3(0.f, 15.f, 0.f), Vector3::UnitY)
+                    * Matrix::CreatePerspectiveFieldOfView(DirectX::XM_PIDIV4, 16.f / 9.f, 0.1f, 300.f);
+            }
+        };
+
+        // A box is truly hidden if every pixel its rectangle touches
+        // is nearer than its nearest corner.
+        bool IsHidden(const DirectX::BoundingBox& box,
+            std::span<const float> depths,
+            uint32_t width,
+            uint32_t height,
+            const Matrix& viewProj)
+        {
+            DirectX::XMFLOAT3 corners[DirectX::BoundingBox::CORNER_COUNT];
+            box.GetCorners(corners);
+
+            float minX = std::numeric_limits<float>::max();
+            float minY = std::numeric_limits<float>::max();
+            float maxX = std::numeric_limits<float>::lowest();
+            float maxY = std::numeric_limits<float>::lowest();
+            float minDepth = 1.f;
+            for (const auto& corner : corners)
+            {
+                Vector4 clip = Vector4::Transform(Vector4(corner.x, corner.y, corner.z, 1.f), viewProj);
+                if (clip.w <= 0.f || clip.z < 0.f)
+                    return false;
+
+                minX = std::min(minX, (clip.x / clip.w * 0.5f + 0.5f) * width);
+                minY = std::min(minY, (0.5f - clip.y / clip.w * 0.5f) * height);
+                maxX = std::max(maxX, (clip.x / clip.w * 0.5f + 0.5f) * width);
+                maxY = std::max(maxY, (0.5f - clip.y / clip.w * 0.5f) * height);
+                minDepth = std::min(minDepth, clip.z / clip.w);
+            }
+
+            if (maxX < 0.f || maxY < 0.f || minX >= width || minY >= height)
+                return false;
+
+            const auto firstX = static_cast<uint32_t>(std::max(minX, 0.f));
+            const auto firstY = static_cast<uint32_t>(std::max(minY, 0.f));
+            const auto lastX = std::min(static_cast<uint32_t>(maxX), width - 1);
+            const auto lastY = std::min(static_cast<uint32_t>(maxY), height - 1);
+
+            for (uint32_t y = firstY; y <= lastY; y++)
+            {
+                for (uint32_t x = firstX; x <= lastX; x++)
+                {
+                    if (depths[y * width + x] >= minDepth)
+                        return false;
+                }
+            }
+
+            return true;
+        }
+
+        void TestHiZ(Results& results, const Hills& hills)
+        {
+            auto occluder = DepthRasterizer::CreateHeightfieldOccluder(hills.Heights,
+                Hills::SampleCount,
+                Hills::GridWidth,
+                Hills::TerrainHeight,
+                Vector3::Zero,
+                4);
+
+            // Not a power of two, so level 0 of the pyramid has to cover more than one pixel
+            constexpr uint32_t width = 960;
+            constexpr uint32_t height = 540;
+            const auto viewProj = hills.CreateViewProj();
+
+            DepthRasterizer rasterizer(width, height);
+            rasterizer.Clear();
+            rasterizer.DrawTriangles(occluder.Positions, occluder.Indices, viewProj);
+            auto depths = rasterizer.GetDepths();
+
+            HiZ::Pyramid pyramid;
+            HiZ::Build(depths, width, height, viewProj, pyramid);
+
+            // Hi-Z is conservative, so it may keep some hidden
+            // boxes, but must never cull one that isn't hidden.
+            size_t numWrong = 0;
+            size_t numCulled = 0;
+            for (const auto& box : hills.CreateBoxes())
+            {
+                if (!HiZ::IsOccluded(pyramid, box.Center, box.Extents)) continue;
+
+                numCulled++;
+                numWrong += !IsHidden(box, depths, width, height, viewProj);
+            }
+
+            results.Check(numCulled > 0, "the pyramid didn't cull anything behind the hills");
+            results.Check(numWrong == 0,
+                "the pyramid culled " + std::to_string(numWrong) + " boxes that aren't hidden");
+        }
+
+        void TestSoftwareOcclusion(Results& results, const Hills& hills)
+        {
+            auto grid = DepthRasterizer::CreateHeightfieldOccluder(hills.Heights,
+                Hills::SampleCount,
+                Hills::GridWidth,
+                Hills::TerrainHeight,
+                Vector3::Zero,
+                1);
+            auto occluder = DepthRasterizer::SimplifyOccluder(grid, 4096);
+
+            constexpr uint32_t width = SoftwareOcclusionCuller::Width;
+            constexpr uint32_t height = SoftwareOcclusionCuller::Height;
+            const auto viewProj = hills.CreateViewProj();
+
+            // Four pixels at a time has to give exactly what one at a time does
+            DepthRasterizer rasterizer(width, height);
+            rasterizer.Clear();
+            rasterizer.AddTriangles(occluder.Positions, occluder.Indices, viewProj);
+            for (uint32_t band = 0; band < rasterizer.GetBandCount(); band++)
+            {
+                rasterizer.DrawBandReference(band);
+            }
+            std::vector<float> referenceDepths(rasterizer.GetDepths().begin(), rasterizer.GetDepths().end());
+
+            rasterizer.Clear();
+            rasterizer.AddTriangles(occluder.Positions, occluder.Indices, viewProj);
+            for (uint32_t band = 0; band < rasterizer.GetBandCount(); band++)
+            {
+                rasterizer.DrawBand(band);
+            }
+
+            results.Check(std::equal(referenceDepths.begin(), referenceDepths.end(),
+                rasterizer.GetDepths().begin(), rasterizer.GetDepths().end()),
+                "drawing four pixels at a time differs from one at a time");
+
+            // The simplified occluder must never cull anything
+            // that the full heightfield doesn't hide.
+            SoftwareOcclusionCuller culler;
+            std::array<SoftwareOcclusionCuller::Occluder, 1> occluders = { {
+                { &occluder, Matrix::Identity }
+            } };
+            culler.Render(occluders, viewProj);
+
+            DepthRasterizer fullRasterizer(width, height);
+            fullRasterizer.Clear();
+            fullRasterizer.DrawTriangles(grid.Positions, grid.Indices, viewProj);
+            HiZ::Pyramid fullPyramid;
+            HiZ::Build(fullRasterizer.GetDepths(), width, height, viewProj, fullPyramid);
+
+            size_t numWrong = 0;
+            for (const auto& box : hills.CreateBoxes())
+            {
+                numWrong += culler.IsOccluded(box)
+                    && !HiZ::IsOccluded(fullPyramid, box.Center, box.Extents);
+            }
+
+            results.Check(numWrong == 0,
+                "the simplified occluder culled " + std::to_string(numWrong)
+                + " boxes that the full heightfield doesn't hide");
+        }
+    }
+
+    void RunOcclusionTests(Results& results)
+    {
+        const Hills hills;
+        TestHiZ(results, hills);
+        TestSoftwareOcclusion(results, hills);
+    }
+}
@@ -0,0 +1,49 @@
+#include "Core/Tests/PortableTests.h"
+
+#include <cstdio>
+#include <vector>
+
+// Runs the groups in PortableTests.h outside the engine, for the
+// target in CMakeLists.txt. Exits with the number of failed checks.
+int main()
+{
+    using namespace Gradient::Tests;
+
+    struct Group
+    {
+        const char* Name;
+        void (*Run)(Results&);
+    };
+
+    // A vector, since it can be empty when the dependencies are missing
+    const std::vector<Group> groups = {
+        { "Descriptor allocator", RunDescriptorAllocatorTests },
+        { "Job system", RunJobSystemTests },
+        { "Task graph", RunTaskGraphTests },
+#ifdef GRADIENT_TEST_MESHLETS
+        { "Meshlets", RunMeshletTests },
+#endif
+    };
+
+    int numFailures = 0;
+    for (const auto& group : groups)
+    {
+        Results results;
+        group.Run(results);
+
+        const auto& failures = results.GetFailures();
+        std::printf("%s: %d checks, %zu failed\n",
+            group.Name,
+            results.GetCheckCount(),
+            failures.size());
+
+        for (const auto& failure : failures)
+        {
+            std::printf("    FAILED: %s\n", failure.c_str());
+        }
+
+        numFailures += static_cast<int>(failures.size());
+    }
+
+    return numFailures;
+}
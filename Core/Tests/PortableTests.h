@@ -0,0 +1,13 @@
+#pragma once
+
+#include "Core/Tests/Check.h"
+
+// Nothing here touches D3D12 or the precompiled header, so these
+// groups are also built into the portable target in CMakeLists.txt.
+namespace Gradient::Tests
+{
+    void RunMeshletTests(Results& results);
+    void RunDescriptorAllocatorTests(Results& results);
+    void RunJobSystemTests(Results& results);
+    void RunTaskGraphTests(Results& results);
+}
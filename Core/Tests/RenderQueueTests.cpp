@@ -0,0 +1,284 @@
+#include "pch.h"
+
+#include "Core/Tests/Tests.h"
+#include "Core/GenerationalSet.h"
+#include "Core/Rendering/InstanceBatcher.h"
+#include "Core/Rendering/ParallelRecorder.h"
+#include "Core/Rendering/RenderQueue.h"
+
+#include <deque>
+#include <mutex>
+#include <random>
+#include <set>
+
+namespace Gradient::Tests
+{
+    namespace
+    {
+        void TestPrepassSet(Results& results)
+        {
+            constexpr uint32_t numEntities = 100000;
+
+            std::vector<entt::entity> drawOrder(numEntities);
+            for (uint32_t i = 0; i < numEntities; i++)
+            {
+                drawOrder[i] = static_cast<entt::entity>(i);
+            }
+            std::shuffle(drawOrder.begin(), drawOrder.end(), std::mt19937(1));
+
+            // Cleared between frames, so run it twice
+            GenerationalSet generational;
+            for (int frame = 0; frame < 2; frame++)
+            {
+                std::set<entt::entity> expected;
+                generational.Clear();
+                for (uint32_t i = 0; i < numEntities; i++)
+                {
+                    if ((i + frame) % 10 == 0) continue;
+
+                    expected.insert(drawOrder[i]);
+                    generational.Insert(entt::to_entity(drawOrder[i]));
+                }
+
+                bool matches = true;
+                for (auto entity : drawOrder)
+                {
+                    matches = matches
+                        && generational.Contains(entt::to_entity(entity)) == expected.contains(entity);
+                }
+
+                results.Check(matches, "the generational set disagreed with std::set");
+            }
+        }
+
+        void TestRenderQueue(Results& results)
+        {
+            using Rendering::RenderQueue;
+            using DrawType = RenderQueue::DrawType;
+
+            for (uint32_t numDraws : { 1000u, 100000u })
+            {
+                std::mt19937 rng(1);
+                std::uniform_int_distribution<uint32_t> pipelineDist(0, 3);
+                std::uniform_int_distribution<uint32_t> materialDist(0, 99);
+                std::uniform_int_distribution<uint32_t> meshDist(0, 999);
+                std::uniform_real_distribution<float> depthDist(0.f, 1000.f);
+
+                std::vector<RenderQueue::Item> items(numDraws);
+                for (uint32_t i = 0; i < numDraws; i++)
+                {
+                    auto material = materialDist(rng);
+                    items[i].Key = RenderQueue::MakeKey(
+                        static_cast<RenderQueue::Pipeline>(pipelineDist(rng)),
+                        i % 4 == 0 ? DrawType::PixelDepthReadWrite : DrawType::PixelDepthReadOnly,
+                        material % 8 == 0,
+                        material,
+                        meshDist(rng),
+                        depthDist(rng));
+                    items[i].Entity = static_cast<entt::entity>(i);
+                }
+
+                auto expected = items;
+                std::stable_sort(expected.begin(), expected.end(),
+                    [](const auto& a, const auto& b) { return a.Key < b.Key; });
+
+                // The radix sort has to be stable too, so entities
+                // with the same key should keep their order.
+                for (bool parallel : { false, true })
+                {
+                    RenderQueue queue;
+                    for (const auto& item : items) queue.Add(item.Key, item.Entity);
+                    queue.Sort(parallel);
+
+                    results.Check(std::equal(expected.begin(), expected.end(),
+                        queue.GetItems().begin(), queue.GetItems().end(),
+                        [](const auto& a, const auto& b)
+                        {
+                            return a.Key == b.Key && a.Entity == b.Entity;
+                        }),
+                        std::string(parallel ? "parallel" : "serial") + " radix sort of "
+                            + std::to_string(numDraws) + " draws disagreed with std::stable_sort");
+                }
+            }
+        }
+
+        void TestInstanceBatcher(Results& results)
+        {
+            using namespace DirectX::SimpleMath;
+            using Rendering::InstanceBatcher;
+            using Rendering::PBRMaterial;
+            using DrawType = InstanceBatcher::DrawType;
+
+            // Materials are compared by value, so these 
+            // just need to differ from each other.
+            std::vector<PBRMaterial> materials(8);
+            for (size_t i = 0; i < materials.size(); i++)
+            {
+                materials[i].Tiling = 1.f + i;
+                materials[i].Masked = i % 2 == 0;
+            }
+
+            constexpr uint32_t numDraws = 1500;
+
+            struct TestDraw
+            {
+                entt::entity Entity;
+                BufferManager::MeshHandle Mesh;
+                const PBRMaterial* Material;
+                Matrix World;
+            };
+
+            std::mt19937 rng(1);
+            std::uniform_int_distribution<size_t> meshDist(0, 15);
+            std::uniform_int_distribution<size_t> materialDist(0, materials.size() - 1);
+            std::uniform_real_distribution<float> positionDist(-500.f, 500.f);
+            std::uniform_real_distribution<float> angleDist(0.f, DirectX::XM_2PI);
+
+            std::vector<TestDraw> draws(numDraws);
+            for (uint32_t i = 0; i < numDraws; i++)
+            {
+                // Mostly unscaled like the trees, with some scaled
+                // copies and a few that can't be instanced.
+                Matrix scale = Matrix::Identity;
+                if (i % 10 == 1) scale = Matrix::CreateScale(2.f);
+                if (i % 50 == 2) scale = Matrix::CreateScale(1.f, 3.f, 1.f);
+
+                draws[i] = TestDraw{
+                    static_cast<entt::entity>(i),
+                    meshDist(rng),
+                    &materials[materialDist(rng)],
+                    scale
+                        * Matrix::CreateFromYawPitchRoll(angleDist(rng), angleDist(rng), 0.f)
+                        * Matrix::CreateTranslation(positionDist(rng), positionDist(rng), positionDist(rng))
+                };
+            }
+
+            InstanceBatcher batcher;
+            uint32_t rejected = 0;
+            for (const auto& draw : draws)
+            {
+                if (!batcher.Add(draw.Entity, DrawType::PixelDepthReadOnly, draw.Mesh, *draw.Material, draw.World))
+                    rejected++;
+            }
+            batcher.Build();
+
+            // Each instance, put through the batch's world matrix the
+            // way the instanced vertex shader does, should land where 
+            // one of the draws with its mesh and material would have.
+            float maxError = 0.f;
+            size_t batchedDraws = 0;
+            for (const auto& batch : batcher.GetBatches())
+            {
+                for (uint32_t i = 0; i < batch.InstanceCount; i++)
+                {
+                    const auto& instance = batcher.GetInstances()[batch.FirstInstance + i];
+                    Matrix world = Matrix::CreateFromQuaternion(instance.RotationQuat)
+                        * Matrix::CreateTranslation(instance.Position)
+                        * batch.World;
+
+                    float error = std::numeric_limits<float>::max();
+                    for (const auto& draw : draws)
+                    {
+                        if (draw.Mesh != batch.Mesh || *draw.Material != *batch.Material) continue;
+
+                        float drawError = 0.f;
+                        for (int row = 0; row < 4; row++)
+                        {
+                            for (int column = 0; column < 4; column++)
+                            {
+                                drawError = std::max(drawError, std::abs(world.m[row][column] - draw.World.m[row][column]));
+                            }
+                        }
+                        error = std::min(error, drawError);
+                    }
+                    maxError = std::max(maxError, error);
+                }
+
+                batchedDraws += batch.InstanceCount;
+            }
+
+            results.Check(batchedDraws + batcher.GetUnbatched().size() + rejected == numDraws,
+                "the batcher lost or duplicated draws");
+            results.Check(maxError < 1e-2f,
+                "an instance was " + std::to_string(maxError) + " away from its draw");
+        }
+
+        void TestParallelRecorder(Results& results)
+        {
+            using Rendering::ICommandListPool;
+            using Rendering::ParallelRecorder;
+
+            // Stands in for the bundles, keeping the draws each list
+            // got so the submitted order can be checked.
+            class TestPool : public ICommandListPool
+            {
+            public:
+                void Record(ListHandle list, size_t draw)
+                {
+                    m_lists[list].push_back(draw);
+                }
+
+                ListHandle Acquire() override
+                {
+                    std::lock_guard lock(m_mutex);
+                    m_lists.emplace_back();
+                    return static_cast<ListHandle>(m_lists.size() - 1);
+                }
+
+                void Close(ListHandle) override
+                {
+                }
+
+                void Submit(std::span<const ListHandle> lists) override
+                {
+                    for (auto list : lists)
+                    {
+                        Submitted.insert(Submitted.end(), m_lists[list].begin(), m_lists[list].end());
+                    }
+                }
+
+                std::vector<size_t> Submitted;
+
+            private:
+                std::mutex m_mutex;
+                // A deque, so lists stay put while others are acquired
+                std::deque<std::vector<size_t>> m_lists;
+            };
+
+            for (size_t numDraws : { 1u, 100u, 10000u })
+            {
+                for (size_t chunks : { 1u, 4u, 16u })
+                {
+                    TestPool pool;
+                    ParallelRecorder recorder(64, chunks);
+                    recorder.Record(pool, numDraws,
+                        [&](ICommandListPool::ListHandle list, size_t, size_t begin, size_t end)
+                        {
+                            for (size_t i = begin; i < end; i++)
+                            {
+                                pool.Record(list, i);
+                            }
+                        });
+
+                    bool inOrder = pool.Submitted.size() == numDraws;
+                    for (size_t i = 0; inOrder && i < numDraws; i++)
+                    {
+                        inOrder = pool.Submitted[i] == i;
+                    }
+
+                    results.Check(inOrder,
+                        std::to_string(numDraws) + " draws in up to " + std::to_string(chunks)
+                            + " chunks weren't submitted in order");
+                }
+            }
+        }
+    }
+
+    void RunRenderQueueTests(Results& results)
+    {
+        TestPrepassSet(results);
+        TestRenderQueue(results);
+        TestInstanceBatcher(results);
+        TestParallelRecorder(results);
+    }
+}
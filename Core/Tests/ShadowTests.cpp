@@ -0,0 +1,202 @@
+#include "pch.h"
+
+#include "Core/Tests/Tests.h"
+#include "Core/Math.h"
+#include "Core/Rendering/ShadowCascades.h"
+#include "Core/Rendering/ShadowCacheTracker.h"
+#include "Core/Rendering/DepthCubeArray.h"
+
+namespace Gradient::Tests
+{
+    namespace
+    {
+        using Rendering::DepthCubeArray;
+        using Rendering::ShadowCacheTracker;
+
+        // Updates every face of a cube light, the way the renderer 
+        // does, and returns the faces that asked for a redraw.
+        uint32_t UpdateCube(ShadowCacheTracker& tracker,
+            const DirectX::SimpleMath::Vector3& lightPosition,
+            float range)
+        {
+            auto projection = DepthCubeArray::GetProjection(0.1f, range);
+
+            uint32_t staleFaceMask = 0;
+            for (uint32_t face = 0; face < DepthCubeArray::NumFaces; face++)
+            {
+                ShadowCacheTracker::LightState state{
+                    ShadowCacheTracker::MakeKey(DepthCubeArray::GetFaceView(lightPosition, face), projection),
+                    DepthCubeArray::GetFaceBounds(lightPosition, face, range)
+                };
+
+                if (tracker.Update(face, state))
+                {
+                    staleFaceMask |= 1 << face;
+                }
+            }
+            return staleFaceMask;
+        }
+    }
+
+    void RunShadowCacheTests(Results& results)
+    {
+        using namespace DirectX::SimpleMath;
+
+        constexpr float range = 10.f;
+        const Vector3 lightPosition(0.f, 5.f, 0.f);
+
+        ShadowCacheTracker tracker;
+        tracker.Resize(DepthCubeArray::NumFaces);
+
+        results.Check(UpdateCube(tracker, lightPosition, range) == DepthCubeArray::AllFaces,
+            "a new cube light didn't draw every face");
+
+        // Dynamic casters never touch the tracker, so moving 
+        // them must leave the static copies alone.
+        results.Check(UpdateCube(tracker, lightPosition, range) == 0,
+            "a frame with only dynamic changes redrew a face");
+
+        // A static caster moving on the +X side, from one spot 
+        // to another. The faces that see it must be redrawn, and
+        // the faces that would only see it mirrored through the 
+        // light must not be.
+        const Vector3 offsetBefore(6.f, 2.f, 2.f);
+        const Vector3 offsetAfter(8.f, 2.f, 2.f);
+        DirectX::BoundingBox before(lightPosition + offsetBefore, Vector3(0.5f));
+        DirectX::BoundingBox after(lightPosition + offsetAfter, Vector3(0.5f));
+
+        uint32_t seen = 0;
+        uint32_t unseen = 0;
+        for (uint32_t face = 0; face < DepthCubeArray::NumFaces; face++)
+        {
+            auto frustum = DepthCubeArray::GetFaceFrustum(lightPosition, face, 0.1f, range);
+            bool seesCaster = frustum.Intersects(before) || frustum.Intersects(after);
+            bool seesMirror = frustum.Intersects(DirectX::BoundingBox(lightPosition - offsetBefore, Vector3(0.5f)))
+                || frustum.Intersects(DirectX::BoundingBox(lightPosition - offsetAfter, Vector3(0.5f)));
+
+            if (seesCaster) seen |= 1 << face;
+            if (seesMirror && !seesCaster) unseen |= 1 << face;
+        }
+
+        tracker.InvalidateIntersecting(before);
+        tracker.InvalidateIntersecting(after);
+        auto redrawn = UpdateCube(tracker, lightPosition, range);
+
+        results.Check(seen != 0 && unseen != 0, "the moved caster was placed badly");
+        results.Check((redrawn & seen) == seen,
+            "a face that sees a moved static caster wasn't redrawn");
+        results.Check((redrawn & unseen) == 0,
+            "a moved static caster redrew a face facing away from it");
+
+        // Moving the light changes every face's view
+        results.Check(UpdateCube(tracker, lightPosition + Vector3(0.f, 1.f, 0.f), range) == DepthCubeArray::AllFaces,
+            "moving the light didn't redraw every face");
+
+        tracker.InvalidateAll();
+        for (uint32_t face = 0; face < DepthCubeArray::NumFaces; face++)
+        {
+            results.Check(!tracker.IsValid(face), "invalidating everything left a face valid");
+        }
+    }
+
+    void RunCubeFaceTests(Results& results)
+    {
+        using namespace DirectX::SimpleMath;
+
+        // A light above terrain shaped like the scene's, seen from above
+        const DirectX::BoundingSphere lightRange(Vector3(0.f, 20.f, 0.f), 15.f);
+        const DirectX::BoundingBox terrain(Vector3(0.f, 4.f, 0.f), Vector3(128.f, 5.f, 128.f));
+        auto cameraFrustum = Math::MakeFrustum(
+            Matrix::CreateLookAt(Vector3(0.f, 30.f, -60.f), Vector3::Zero, Vector3::UnitY),
+            Matrix::CreatePerspectiveFieldOfView(DirectX::XM_PIDIV4, 16.f / 9.f, 0.1f, 300.f));
+
+        results.Check(DepthCubeArray::GetReceivingFaces(lightRange, 0.1f, cameraFrustum, {}) == 0,
+            "a light with no receivers kept a face");
+
+        // Everything in range receives, as when something has no bounds
+        const DirectX::BoundingBox everything(lightRange.Center,
+            DirectX::XMFLOAT3(lightRange.Radius, lightRange.Radius, lightRange.Radius));
+        auto allVisible = DepthCubeArray::GetReceivingFaces(lightRange, 0.1f, cameraFrustum,
+            std::span(&everything, 1));
+
+        uint32_t expectedVisible = 0;
+        uint32_t upFace = 0;
+        for (uint32_t face = 0; face < DepthCubeArray::NumFaces; face++)
+        {
+            auto frustum = DepthCubeArray::GetFaceFrustum(lightRange.Center, face, 0.1f, lightRange.Radius);
+            if (frustum.Intersects(cameraFrustum)) expectedVisible |= 1 << face;
+            if (frustum.Contains(lightRange.Center + Vector3(0.f, 10.f, 0.f)) == DirectX::CONTAINS) upFace = 1 << face;
+        }
+
+        results.Check(allVisible == expectedVisible,
+            "receivers everywhere didn't keep every face the camera sees into");
+
+        // The terrain is entirely below the light, so the face looking up can't see it
+        auto terrainFaces = DepthCubeArray::GetReceivingFaces(lightRange, 0.1f, cameraFrustum,
+            std::span(&terrain, 1));
+
+        results.Check(upFace != 0 && (allVisible & upFace) != 0, "the light's up face was placed badly");
+        results.Check((terrainFaces & upFace) == 0, "the face looking away from the terrain wasn't skipped");
+        results.Check(terrainFaces != 0 && (terrainFaces & ~allVisible) == 0,
+            "the terrain didn't keep the faces that look at it");
+    }
+
+    void RunShadowCascadeTests(Results& results)
+    {
+        using namespace DirectX::SimpleMath;
+        namespace ShadowCascades = Rendering::ShadowCascades;
+
+        constexpr int numFrames = 300;
+        constexpr uint32_t numCascades = 4;
+        constexpr uint32_t resolution = 2048;
+        constexpr float sceneRadius = 200.f;
+
+        Vector3 lightDirection(-0.7f, -0.7f, 0.7f);
+        lightDirection.Normalize();
+        auto lightView = Matrix::CreateLookAt(-2.f * sceneRadius * lightDirection,
+            Vector3::Zero,
+            Vector3::UnitY);
+
+        auto projection = Matrix::CreatePerspectiveFieldOfView(DirectX::XM_PIDIV4,
+            16.f / 9.f,
+            0.1f,
+            70.f);
+
+        auto splits = ShadowCascades::ComputeSplitDistances(0.1f, 70.f, numCascades, 0.75f);
+
+        // The texel size must never change, beyond rounding in the
+        // projection, and each slice must be inside its cascade.
+        bool stableTexels = true;
+        bool covered = true;
+        std::array<Matrix, numCascades> previous;
+
+        for (int i = 0; i < numFrames; i++)
+        {
+            Vector3 forward(std::sin(0.3f), -0.1f, std::cos(0.3f));
+            Vector3 position = Vector3(0.f, 2.f, 0.f) + i * 0.05f * Vector3(forward.x, 0.f, forward.z);
+            auto frustum = Math::MakeFrustum(
+                Matrix::CreateLookAt(position, position + forward, Vector3::UnitY),
+                projection);
+
+            for (uint32_t c = 0; c < numCascades; c++)
+            {
+                auto slice = ShadowCascades::GetSlice(frustum, splits[c], splits[c + 1]);
+                auto cascade = ShadowCascades::FitCascade(slice, lightView, sceneRadius, resolution);
+
+                covered = covered && cascade.Bounds.Contains(slice) == DirectX::CONTAINS;
+
+                if (i > 0)
+                {
+                    stableTexels = stableTexels
+                        && std::abs(cascade.Projection._11 - previous[c]._11) <= 1e-5f * std::abs(previous[c]._11)
+                        && std::abs(cascade.Projection._22 - previous[c]._22) <= 1e-5f * std::abs(previous[c]._22);
+                }
+
+                previous[c] = cascade.Projection;
+            }
+        }
+
+        results.Check(stableTexels, "a cascade's texel size changed as the camera moved");
+        results.Check(covered, "a view slice wasn't inside its cascade");
+    }
+}
@@ -0,0 +1,116 @@
+#include "Core/Tests/PortableTests.h"
+#include "Core/TaskGraph.h"
+#include "Core/Jobs/JobSystem.h"
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Gradient::Tests
+{
+    namespace
+    {
+        using Jobs::JobSystem;
+
+        void TestDependencies(Results& results, JobSystem& jobSystem)
+        {
+            // Layers of tasks, each depending on a few from the layer before.
+            // Every task records when it finished, so the order can be checked.
+            constexpr size_t numLayers = 8;
+            constexpr size_t tasksPerLayer = 16;
+
+            TaskGraph graph;
+            std::atomic<uint32_t> clock = 0;
+            std::vector<uint32_t> finished(numLayers * tasksPerLayer);
+            std::vector<uint32_t> started(numLayers * tasksPerLayer);
+
+            for (size_t layer = 0; layer < numLayers; layer++)
+            {
+                for (size_t i = 0; i < tasksPerLayer; i++)
+                {
+                    std::vector<TaskGraph::TaskHandle> dependencies;
+                    if (layer > 0)
+                    {
+                        const size_t previous = (layer - 1) * tasksPerLayer;
+                        dependencies.push_back(previous + i);
+                        dependencies.push_back(previous + (i + 1) % tasksPerLayer);
+                    }
+
+                    const size_t index = layer * tasksPerLayer + i;
+                    graph.AddTask("Task " + std::to_string(index),
+                        [&, index]()
+                        {
+                            started[index] = clock.fetch_add(1) + 1;
+                            std::this_thread::yield();
+                            finished[index] = clock.fetch_add(1) + 1;
+                        },
+                        dependencies);
+                }
+            }
+
+            graph.Run(jobSystem);
+
+            bool allRan = true;
+            bool inOrder = true;
+            for (size_t index = 0; index < graph.GetTaskCount(); index++)
+            {
+                allRan = allRan && finished[index] != 0;
+
+                const size_t layer = index / tasksPerLayer;
+                if (layer == 0) continue;
+
+                const size_t i = index % tasksPerLayer;
+                const size_t previous = (layer - 1) * tasksPerLayer;
+                inOrder = inOrder
+                    && started[index] > finished[previous + i]
+                    && started[index] > finished[previous + (i + 1) % tasksPerLayer];
+            }
+
+            results.Check(allRan, "a task in the graph never ran");
+            results.Check(inOrder, "a task started before one of its dependencies finished");
+            results.Check(graph.GetCriticalPathMilliseconds() >= graph.GetTaskMilliseconds(0),
+                "the critical path is shorter than one of its tasks");
+        }
+
+        void TestExceptions(Results& results, JobSystem& jobSystem)
+        {
+            TaskGraph graph;
+            bool dependentRan = false;
+
+            auto failing = graph.AddTask("Failing",
+                []()
+                {
+                    throw std::runtime_error("task failed");
+                });
+            graph.AddTask("Dependent",
+                [&]()
+                {
+                    dependentRan = true;
+                },
+                { failing });
+
+            bool threw = false;
+            try
+            {
+                graph.Run(jobSystem);
+            }
+            catch (const std::runtime_error&)
+            {
+                threw = true;
+            }
+
+            results.Check(threw, "a task's exception didn't reach the thread running the graph");
+            results.Check(!dependentRan, "a task ran after one of its dependencies threw");
+        }
+    }
+
+    void RunTaskGraphTests(Results& results)
+    {
+        JobSystem jobSystem(3);
+
+        TestDependencies(results, jobSystem);
+        TestExceptions(results, jobSystem);
+    }
+}
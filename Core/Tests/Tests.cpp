@@ -0,0 +1,65 @@
+#include "pch.h"
+
+#include "Core/Tests/Tests.h"
+#include "Core/Logger.h"
+
+#include <spdlog/sinks/basic_file_sink.h>
+
+namespace Gradient::Tests
+{
+    int RunAll()
+    {
+        auto logger = Logger::Get();
+        logger->sinks().push_back(
+            std::make_shared<spdlog::sinks::basic_file_sink_mt>("tests.log", true));
+
+        logger->info("Running tests");
+
+        struct Group
+        {
+            const char* Name;
+            void (*Run)(Results&);
+        };
+
+        const Group groups[] = {
+            { "L-systems", RunLSystemTests },
+            { "Culling", RunCullingTests },
+            { "Shadow cascades", RunShadowCascadeTests },
+            { "Shadow cache", RunShadowCacheTests },
+            { "Cube faces", RunCubeFaceTests },
+            { "Frame arena", RunFrameArenaTests },
+            { "Render queue", RunRenderQueueTests },
+            { "Instances", RunInstanceTests },
+            { "Meshlets", RunMeshletTests },
+            { "Occlusion", RunOcclusionTests },
+            { "Descriptor allocator", RunDescriptorAllocatorTests },
+            { "Job system", RunJobSystemTests },
+            { "Task graph", RunTaskGraphTests },
+        };
+
+        int numFailures = 0;
+        for (const auto& group : groups)
+        {
+            Results results;
+            group.Run(results);
+
+            const auto& failures = results.GetFailures();
+            logger->info("  {}: {} checks, {} failed",
+                group.Name,
+                results.GetCheckCount(),
+                failures.size());
+
+            for (const auto& failure : failures)
+            {
+                logger->error("    FAILED: {}", failure);
+            }
+
+            numFailures += static_cast<int>(failures.size());
+        }
+
+        logger->info("Finished running tests, {} failed", numFailures);
+        logger->flush();
+
+        return numFailures;
+    }
+}
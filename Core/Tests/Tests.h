@@ -0,0 +1,23 @@
+#pragma once
+
+#include "pch.h"
+
+#include "Core/Tests/PortableTests.h"
+
+namespace Gradient::Tests
+{
+    // Correctness tests, kept apart from the benchmarks so that they
+    // can fail. None of these need a device, so they run headless with
+    // the --test argument, which exits with the number of failed checks.
+    int RunAll();
+
+    void RunLSystemTests(Results& results);
+    void RunCullingTests(Results& results);
+    void RunShadowCascadeTests(Results& results);
+    void RunShadowCacheTests(Results& results);
+    void RunCubeFaceTests(Results& results);
+    void RunFrameArenaTests(Results& results);
+    void RunRenderQueueTests(Results& results);
+    void RunInstanceTests(Results& results);
+    void RunOcclusionTests(Results& results);
+}
@@ -11,6 +11,14 @@ namespace Gradient::GUI
 
         ImGui::Text("FPS: %.2f", this->FPS);
         ImGui::Text("msPF: %.2f", 1000.f / this->FPS);
+        ImGui::Text("Frame arena: %.1f KB, %llu heap blocks",
+            this->FrameArenaBytes / 1024.f,
+            this->FrameArenaHeapAllocations);
+        ImGui::Text("Heap allocations: %llu", this->HeapAllocations);
+        ImGui::Text("PSO changes: %u", this->PipelineStateChanges);
+        ImGui::Text("Root signature changes: %u", this->RootSignatureChanges);
+        ImGui::Text("Descriptor changes: %u", this->DescriptorChanges);
+        ImGui::Text("Skipped binds: %u", this->SkippedBinds);
 
         ImGui::End();
     }
@@ -10,5 +10,19 @@ namespace Gradient::GUI
         void Draw();
 
         float FPS = 0.f;
+
+        size_t FrameArenaBytes = 0;
+        // Should stay the same from frame to frame once warmed up
+        uint64_t FrameArenaHeapAllocations = 0;
+        // Every allocation made through operator new in the last
+        // frame, on any thread, including the frame arenas' own
+        uint64_t HeapAllocations = 0;
+
+        // Binds made on the command list, and those skipped
+        // because the state was already bound
+        uint32_t PipelineStateChanges = 0;
+        uint32_t RootSignatureChanges = 0;
+        uint32_t DescriptorChanges = 0;
+        uint32_t SkippedBinds = 0;
     };
 }
\ No newline at end of file
@@ -28,6 +28,17 @@ namespace Gradient::GUI
                 ImGui::TreePop();
             }
 
+            ImGui::Checkbox("Cache static shadows", &CacheStaticShadows);
+            ImGui::Checkbox("Instance repeated meshes", &AutoInstancing);
+            ImGui::Checkbox("Record draws in parallel", &ParallelRecording);
+            ImGui::Checkbox("Cull instances on the GPU", &GpuInstanceCulling);
+            ImGui::Checkbox("Instance levels of detail", &InstanceLod);
+            ImGui::SliderFloat("LOD pixel error", &LodPixelError, 0.1f, 16.f);
+            ImGui::Checkbox("Cull meshlets", &MeshletCulling);
+            ImGui::Checkbox("Occlusion cull instances", &OcclusionCulling);
+            ImGui::Checkbox("Occlusion cull entities (reprojected)", &ReprojectedOcclusionCulling);
+            ImGui::Checkbox("Occlusion cull entities (terrain)", &SoftwareOcclusionCulling);
+
             //if (ImGui::TreeNode("Point lights"))
             //{
             //    for (int i = 0; i < 2; i++)
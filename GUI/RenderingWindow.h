@@ -19,6 +19,16 @@ namespace Gradient::GUI
         DirectX::XMFLOAT3 LightColour = { 0, 0, 0 };
         float Irradiance;
         float AmbientIrradiance;
+        bool CacheStaticShadows = true;
+        bool AutoInstancing = true;
+        bool ParallelRecording = true;
+        bool GpuInstanceCulling = true;
+        bool InstanceLod = true;
+        float LodPixelError = 1.f;
+        bool MeshletCulling = true;
+        bool OcclusionCulling = true;
+        bool ReprojectedOcclusionCulling = true;
+        bool SoftwareOcclusionCulling = true;
 
         float BloomExposure = 0.f;
         float BloomIntensity = 0.f;
@@ -6,6 +6,9 @@
 #include "Game.h"
 #include "directxtk12/Keyboard.h"
 #include "Core/GraphicsMemoryManager.h"
+#include "Core/FrameArena.h"
+#include "Core/HeapAllocations.h"
+#include "Core/RenderStateCache.h"
 #include "Core/TextureManager.h"
 #include "Core/BufferManager.h"
 #include "Core/Rendering/TextureDrawer.h"
@@ -157,6 +160,16 @@ void Game::Update(DX::StepTimer const& timer)
     m_renderer->DirectionalLight->SetLightDirection(m_renderingWindow.LightDirection);
     m_renderer->DirectionalLight->SetColour(DirectX::SimpleMath::Color(m_renderingWindow.LightColour));
     m_renderer->DirectionalLight->SetIrradiance(m_renderingWindow.Irradiance);
+    m_renderer->CacheStaticShadows = m_renderingWindow.CacheStaticShadows;
+    m_renderer->AutoInstancing = m_renderingWindow.AutoInstancing;
+    m_renderer->ParallelRecording = m_renderingWindow.ParallelRecording;
+    m_renderer->GpuInstanceCulling = m_renderingWindow.GpuInstanceCulling;
+    m_renderer->InstanceLod = m_renderingWindow.InstanceLod;
+    m_renderer->LodPixelError = m_renderingWindow.LodPixelError;
+    m_renderer->MeshletCulling = m_renderingWindow.MeshletCulling;
+    m_renderer->OcclusionCulling = m_renderingWindow.OcclusionCulling;
+    m_renderer->ReprojectedOcclusionCulling = m_renderingWindow.ReprojectedOcclusionCulling;
+    m_renderer->SoftwareOcclusionCulling = m_renderingWindow.SoftwareOcclusionCulling;
 
     // TODO: Move this into the window
     auto lightView = entityManager->Registry.view<Gradient::ECS::Components::PointLightComponent>();
@@ -236,6 +249,9 @@ void Game::Render()
         cullingCamera = &m_debugSavedCamera;
     }
 
+    // Prepare has waited for the GPU to finish with this frame index
+    m_renderer->BeginFrame(m_deviceResources->GetCurrentFrameIndex());
+
     m_renderer->Render(cl,
         m_deviceResources->GetScreenViewport(),
         &frameCamera,
@@ -243,6 +259,8 @@ void Game::Render()
         m_tonemappedRenderTexture.get(),
         m_deviceResources->GetOutputSize());
 
+    m_renderer->SubmitInstanceCulling(m_deviceResources->GetCommandQueue());
+
     ImGui_ImplDX12_NewFrame();
     ImGui_ImplWin32_NewFrame();
     ImGui::NewFrame();
@@ -277,6 +295,22 @@ void Game::Render()
 
     auto gmm = Gradient::GraphicsMemoryManager::Get();
     gmm->Commit(m_deviceResources->GetCommandQueue());
+
+    // Shown next frame, since the window has already been drawn
+    m_perfWindow.FrameArenaBytes = Gradient::FrameArena::GetTotalBytesUsed();
+    m_perfWindow.FrameArenaHeapAllocations = Gradient::FrameArena::GetHeapAllocationCount();
+    Gradient::FrameArena::ResetAll();
+
+    auto heapAllocationCount = Gradient::HeapAllocations::GetCount();
+    m_perfWindow.HeapAllocations = heapAllocationCount - m_lastHeapAllocationCount;
+    m_lastHeapAllocationCount = heapAllocationCount;
+
+    auto bindCounters = Gradient::RenderStateCache::GetFrameCounters();
+    m_perfWindow.PipelineStateChanges = bindCounters.PipelineStates;
+    m_perfWindow.RootSignatureChanges = bindCounters.RootSignatures;
+    m_perfWindow.DescriptorChanges = bindCounters.Descriptors;
+    m_perfWindow.SkippedBinds = bindCounters.Skipped;
+    Gradient::RenderStateCache::ResetFrameCounters();
 }
 
 #pragma endregion
@@ -106,6 +106,7 @@ private:
     Gradient::GUI::PhysicsWindow m_physicsWindow;
     Gradient::GUI::RenderingWindow m_renderingWindow;
     Gradient::GUI::PerformanceWindow m_perfWindow;
+    uint64_t m_lastHeapAllocationCount = 0;
     Gradient::GUI::EntityWindow m_entityWindow;
     Gradient::GUI::ControlsWindow m_controlsWindow;
                                                               
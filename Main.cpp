@@ -7,6 +7,9 @@
 #include "directxtk12/Keyboard.h"
 #include "directxtk12/Mouse.h"
 #include "Core/Logger.h"
+#include "Core/Benchmarks.h"
+#include "Core/Tests/Tests.h"
+#include "Core/Jobs/JobSystem.h"
 
 #include "GUI/imgui_impl_win32.h"
 
@@ -44,7 +47,6 @@ extern "C" { __declspec(dllexport) extern const char* D3D12SDKPath = ".\\D3D12\\
 int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _In_ LPWSTR lpCmdLine, _In_ int nCmdShow)
 {
     UNREFERENCED_PARAMETER(hPrevInstance);
-    UNREFERENCED_PARAMETER(lpCmdLine);
 
     Gradient::Logger::Initialize();
     Gradient::Logger::Get()->info("Initialized logger");
@@ -52,6 +54,26 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
     if (!XMVerifyCPUSupport())
         return 1;
 
+    Gradient::Jobs::JobSystem::Initialize();
+
+    // Run the CPU benchmarks headless, without creating a window.
+    if (lpCmdLine != nullptr && wcsstr(lpCmdLine, L"--benchmark") != nullptr)
+    {
+        Gradient::Benchmarks::RunAll();
+        Gradient::Jobs::JobSystem::Shutdown();
+        Gradient::Logger::Destroy();
+        return 0;
+    }
+
+    // Run the correctness tests headless, failing with the number of failed checks.
+    if (lpCmdLine != nullptr && wcsstr(lpCmdLine, L"--test") != nullptr)
+    {
+        int numFailures = Gradient::Tests::RunAll();
+        Gradient::Jobs::JobSystem::Shutdown();
+        Gradient::Logger::Destroy();
+        return numFailures;
+    }
+
     HRESULT hr = CoInitializeEx(nullptr, COINITBASE_MULTITHREADED);
     if (FAILED(hr))
         return 1;
@@ -129,6 +151,7 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
 
         CoUninitialize();
 
+        Gradient::Jobs::JobSystem::Shutdown();
         Gradient::Logger::Destroy();
         return static_cast<int>(msg.wParam);
     }
@@ -139,6 +162,7 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
 
     g_game.reset();
     CoUninitialize();
+    Gradient::Jobs::JobSystem::Shutdown();
     Gradient::Logger::Destroy();
     return 1;
 }